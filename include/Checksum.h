@@ -0,0 +1,44 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace P2POverlay {
+
+/**
+ * CRC-32C (Castagnoli) as used by iSCSI, ext4 and SCTP
+ *
+ * Uses the SSE4.2 crc32 instruction when the CPU has it and a
+ * slicing-by-8 table otherwise. Pass a previous result as crc to checksum
+ * data in several pieces.
+ */
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+constexpr size_t SHA256_DIGEST_SIZE = 32;
+
+/**
+ * SHA-256 (FIPS 180-4)
+ *
+ * Uses the x86 SHA extensions when the CPU has them (roughly four times
+ * the throughput of the portable rounds) and portable code otherwise.
+ */
+class Sha256 {
+public:
+    Sha256();
+    
+    void update(const void* data, size_t size);
+    void finish(uint8_t digest[SHA256_DIGEST_SIZE]);
+    
+private:
+    uint32_t state_[8];
+    uint8_t buffer_[64];
+    size_t buffered_;
+    uint64_t length_;
+};
+
+void sha256(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+} // namespace P2POverlay
+
+#endif // CHECKSUM_H
@@ -0,0 +1,144 @@
+#ifndef CHUNK_FORMAT_H
+#define CHUNK_FORMAT_H
+
+#include "Common.h"
+#include "MerkleTree.h"
+#include <vector>
+
+namespace P2POverlay {
+
+// Header bytes before the optional digest
+constexpr size_t CHUNK_HEADER_SIZE = 2 * sizeof(uint64_t) + 3 * sizeof(uint32_t) + sizeof(uint8_t);
+
+// Chunk header flags
+constexpr uint8_t CHUNK_FLAG_LAST = 0x01;      // Final chunk of the transfer
+constexpr uint8_t CHUNK_FLAG_DIGEST = 0x02;    // Header ends with a CRC-32C of the payload
+constexpr uint8_t CHUNK_FLAG_PROOF = 0x04;     // Merkle root and proof follow the header
+constexpr uint8_t CHUNK_FLAG_PARITY = 0x08;    // Reed-Solomon parity of a group of chunks
+
+// Parity fields: group chunks u8, parity chunks u8, parity index u8, total size u64
+constexpr size_t CHUNK_PARITY_FIELDS_SIZE = 3 * sizeof(uint8_t) + sizeof(uint64_t);
+
+/**
+ * Fixed-layout header in front of every DATA_CHUNK payload
+ *
+ * Wire layout (little-endian): transfer ID u64, sequence u32, total chunks
+ * u32, flags u8, byte offset u64, payload length u32, then the payload
+ * digest u32 when CHUNK_FLAG_DIGEST is set, then the parity fields when
+ * CHUNK_FLAG_PARITY is set, then the transfer's Merkle root, a sibling
+ * count u8 and the siblings when CHUNK_FLAG_PROOF is set.
+ *
+ * A parity chunk's sequence is its group's index and its offset is the
+ * group's first byte; its payload is one shard, as long as the group's
+ * longest chunk.
+ */
+struct ChunkHeader {
+    uint64_t transferID;
+    uint32_t sequence;
+    uint32_t totalChunks;
+    uint8_t flags;
+    uint64_t offset;     // Position of the payload in the transfer
+    uint32_t length;
+    uint32_t digest;
+    uint8_t groupChunks;     // Parity chunks only: data chunks per group
+    uint8_t parityChunks;    // ...parity chunks per group
+    uint8_t parityIndex;
+    uint64_t totalSize;      // ...and the transfer's size, for its last chunk
+    MerkleHash root;
+    std::vector<MerkleHash> proof;
+    
+    ChunkHeader() : transferID(0), sequence(0), totalChunks(0), flags(0), offset(0), length(0), digest(0),
+                    groupChunks(0), parityChunks(0), parityIndex(0), totalSize(0), root() {}
+    
+    size_t encodedSize() const {
+        return CHUNK_HEADER_SIZE + ((flags & CHUNK_FLAG_DIGEST) ? sizeof(digest) : 0) +
+               ((flags & CHUNK_FLAG_PARITY) ? CHUNK_PARITY_FIELDS_SIZE : 0) +
+               ((flags & CHUNK_FLAG_PROOF) ? (1 + proof.size()) * SHA256_DIGEST_SIZE + 1 : 0);
+    }
+};
+
+/**
+ * Decoded chunk whose payload points into the buffer it was decoded from;
+ * valid only as long as that buffer is
+ */
+struct ChunkView {
+    ChunkHeader header;
+    const uint8_t* payload;
+    size_t payloadSize;
+    
+    ChunkView() : payload(nullptr), payloadSize(0) {}
+};
+
+/**
+ * Request for chunks of published content, sent to one swarm source, or
+ * for the missing chunks of an interrupted push (chunk size 0: the
+ * sender's own chunking)
+ *
+ * Wire layout (little-endian): content ID u64, chunk size u32, run count
+ * u32, then per run of consecutive indices its first index u32 and
+ * length u32.
+ */
+struct ChunkRequest {
+    uint64_t contentID;
+    uint32_t chunkSize;
+    std::vector<uint32_t> chunks;
+    
+    ChunkRequest() : contentID(0), chunkSize(0) {}
+};
+
+// Writes the header at out, which must hold header.encodedSize() bytes
+void encodeChunkHeader(const ChunkHeader& header, uint8_t* out);
+
+// Sets the digest flag and value for payload, or clears them
+void setChunkDigest(ChunkHeader& header, const uint8_t* payload, bool enabled);
+
+// False for a truncated header, a length that disagrees with the buffer or a digest mismatch
+bool decodeChunk(const uint8_t* data, size_t size, ChunkView& view);
+
+/**
+ * Sender's answer to a resume request
+ *
+ * Wire layout (little-endian): transfer ID u64, accepted u8, total size
+ * u64, chunks to be resent u32.
+ */
+struct TransferResume {
+    uint64_t transferID;
+    bool accepted;
+    uint64_t totalSize;
+    uint32_t chunkCount;
+    
+    TransferResume() : transferID(0), accepted(false), totalSize(0), chunkCount(0) {}
+};
+
+// Requests expanding to more than CHUNK_REQUEST_MAX_CHUNKS indices are rejected
+std::vector<uint8_t> encodeChunkRequest(const ChunkRequest& request);
+bool decodeChunkRequest(const uint8_t* data, size_t size, ChunkRequest& request);
+
+std::vector<uint8_t> encodeTransferResume(const TransferResume& resume);
+bool decodeTransferResume(const uint8_t* data, size_t size, TransferResume& resume);
+
+/**
+ * Sent ahead of a push whose chunks carry Merkle proofs, so the receiver
+ * holds the root before the first chunk and checks every chunk against it
+ *
+ * Wire layout (little-endian): transfer ID u64, total size u64, chunk
+ * size u32, total chunks u32, Merkle root, then a CRC-32C of all of it.
+ */
+struct TransferSetup {
+    uint64_t transferID;
+    uint64_t totalSize;
+    uint32_t chunkSize;
+    uint32_t totalChunks;
+    MerkleHash root;
+    
+    TransferSetup() : transferID(0), totalSize(0), chunkSize(0), totalChunks(0), root() {}
+};
+
+std::vector<uint8_t> encodeTransferSetup(const TransferSetup& setup);
+
+// False for a wrong length or a CRC-32C mismatch
+bool decodeTransferSetup(const uint8_t* data, size_t size, TransferSetup& setup);
+
+} // namespace P2POverlay
+
+#endif // CHUNK_FORMAT_H
@@ -0,0 +1,65 @@
+#ifndef CHUNK_SIZER_H
+#define CHUNK_SIZER_H
+
+#include "Common.h"
+#include "Node.h"
+#include <map>
+
+namespace P2POverlay {
+
+/**
+ * Picks the chunk size of each new push from the path to its destination
+ *
+ * The inputs are the destination's peer counters: smoothed RTT, send
+ * throughput and retransmissions. Loss comes first: when the share of
+ * retransmitted messages since the last decision exceeds the target,
+ * chunks shrink in proportion, since a long chunk is the likelier one to
+ * need a resend and the costlier one to resend. Otherwise the chunk
+ * window should hold one bandwidth-delay product. While the RTT stays
+ * near the lowest seen, the path is not queueing and can take more than
+ * it gets, so chunks grow; once it rises, they settle on the size that
+ * fills the window. Each decision moves at most a factor of two (four
+ * for loss) from the last one for the same path.
+ *
+ * A transfer keeps the size it started with: receivers take the
+ * chunking from the chunk headers, so there is nothing to renegotiate.
+ *
+ * Not thread-safe; the owner serializes access.
+ */
+class ChunkSizer {
+public:
+    ChunkSizer(size_t minChunkSize = DATA_MIN_CHUNK_SIZE, size_t maxChunkSize = DATA_MAX_CHUNK_SIZE);
+    
+    // Bounds of every size chosen from now on
+    void setLimits(size_t minChunkSize, size_t maxChunkSize);
+    size_t getMinChunkSize() const { return minChunkSize_; }
+    size_t getMaxChunkSize() const { return maxChunkSize_; }
+    
+    // Size for a transfer starting now; fallback until the path is measured
+    size_t chooseChunkSize(NodeID destinationID, const PeerStatsSnapshot& stats, size_t window, size_t fallback);
+    void removePath(NodeID destinationID);
+    
+    // Statistics
+    size_t getLastChunkSize(NodeID destinationID) const;
+    double getLossRate(NodeID destinationID) const;
+    
+private:
+    size_t minChunkSize_;
+    size_t maxChunkSize_;
+    
+    // What the previous decision for a destination saw and chose
+    struct PathState {
+        size_t chunkSize = 0;
+        uint64_t baseRttMicros = 0;     // Lowest smoothed RTT seen
+        uint64_t messagesSent = 0;      // Counters at the last loss sample
+        uint64_t retransmissions = 0;
+        double lossRate = 0.0;
+    };
+    std::map<NodeID, PathState> paths_;
+    
+    size_t clamp(double size) const;
+};
+
+} // namespace P2POverlay
+
+#endif // CHUNK_SIZER_H
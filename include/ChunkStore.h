@@ -0,0 +1,145 @@
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include "Common.h"
+#include <vector>
+#include <map>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <string>
+
+namespace P2POverlay {
+
+/**
+ * 128-bit content key of a chunk
+ */
+struct ChunkKey {
+    uint64_t high;
+    uint64_t low;
+    
+    ChunkKey() : high(0), low(0) {}
+    ChunkKey(uint64_t h, uint64_t l) : high(h), low(l) {}
+    
+    bool operator==(const ChunkKey& other) const { return high == other.high && low == other.low; }
+    bool operator!=(const ChunkKey& other) const { return !(*this == other); }
+    bool operator<(const ChunkKey& other) const {
+        return high != other.high ? high < other.high : low < other.low;
+    }
+};
+
+// Fast non-cryptographic hash of a chunk; identifies content, does not authenticate it
+ChunkKey hashChunk(const uint8_t* data, size_t size);
+
+/**
+ * How a blob is cut into chunks
+ */
+enum class ChunkingMode {
+    FIXED,              // Every chunk is the average size
+    CONTENT_DEFINED     // Boundaries follow the content, so an insert only changes nearby chunks
+};
+
+/**
+ * A blob as the ordered list of its chunks
+ */
+struct ChunkManifest {
+    uint64_t totalSize;
+    std::vector<ChunkKey> keys;
+    std::vector<uint32_t> sizes;
+    
+    ChunkManifest() : totalSize(0) {}
+    
+    // Byte offset of every chunk in the blob
+    std::vector<uint64_t> offsets() const;
+};
+
+/**
+ * Offer of a blob to a peer, answered with the chunks it still wants
+ *
+ * Wire layout (little-endian): transfer ID u64, data type length u16 and
+ * bytes, total size u64, chunk count u32, then per chunk its key (high
+ * u64, low u64) and size u32.
+ */
+struct ChunkOffer {
+    uint64_t transferID;
+    std::string dataType;
+    ChunkManifest manifest;
+    
+    ChunkOffer() : transferID(0) {}
+};
+
+std::vector<uint8_t> encodeChunkOffer(const ChunkOffer& offer);
+bool decodeChunkOffer(const uint8_t* data, size_t size, ChunkOffer& offer);
+
+/**
+ * Content-addressed local store of chunks
+ *
+ * Identical chunks are stored once, whichever blob or transfer they came
+ * from. A chunk is pinned while its reference count is non-zero (e.g.
+ * while a transfer may still need to send it); unpinned chunks stay
+ * cached and are evicted least recently used first once the store grows
+ * past its capacity.
+ */
+class ChunkStore {
+public:
+    explicit ChunkStore(ChunkingMode mode = ChunkingMode::CONTENT_DEFINED,
+                        size_t capacityBytes = CHUNK_STORE_CAPACITY_BYTES);
+    
+    // Chunk boundaries of a blob, as sizes in order
+    std::vector<uint32_t> split(const uint8_t* data, size_t size) const;
+    
+    // Single chunks
+    ChunkKey put(const uint8_t* data, size_t size);
+    bool get(const ChunkKey& key, std::vector<uint8_t>& out);
+    bool read(const ChunkKey& key, size_t offset, uint8_t* buffer, size_t length);
+    bool contains(const ChunkKey& key) const;
+    
+    // Pins; a chunk with references is never evicted
+    bool addRef(const ChunkKey& key);
+    void release(const ChunkKey& key);
+    
+    // Whole blobs: storing pins every chunk until the manifest is released
+    ChunkManifest storeBlob(const uint8_t* data, size_t size);
+    bool assemble(const ChunkManifest& manifest, std::vector<uint8_t>& out);
+    void releaseManifest(const ChunkManifest& manifest);
+    
+    // Indices of manifest chunks not in the store
+    std::vector<uint32_t> missing(const ChunkManifest& manifest) const;
+    
+    // Configuration
+    void setCapacity(size_t capacityBytes);
+    ChunkingMode getMode() const { return mode_; }
+    
+    // Statistics
+    size_t getChunkCount() const;
+    size_t getStoredBytes() const { return storedBytes_; }
+    size_t getDuplicateBytes() const { return duplicateBytes_; }
+    size_t getEvictions() const { return evictions_; }
+    
+private:
+    struct Entry {
+        std::vector<uint8_t> data;
+        size_t refs = 0;
+        std::list<ChunkKey>::iterator lruPosition;   // Valid only while unpinned
+    };
+    
+    ChunkingMode mode_;
+    mutable std::mutex mutex_;
+    std::map<ChunkKey, Entry> chunks_;
+    std::list<ChunkKey> lru_;    // Unpinned chunks, most recently used first
+    size_t capacityBytes_;
+    
+    // Statistics
+    std::atomic<size_t> storedBytes_;
+    std::atomic<size_t> duplicateBytes_;
+    std::atomic<size_t> evictions_;
+    
+    // Caller must hold mutex_
+    ChunkKey putLocked(const uint8_t* data, size_t size);
+    void touchLocked(Entry& entry);
+    void evictLocked();
+};
+
+} // namespace P2POverlay
+
+#endif // CHUNK_STORE_H
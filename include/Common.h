@@ -27,7 +27,15 @@ enum class MessageType : uint8_t {
     MESSAGE_ACK = 9,
     DATA_CHUNK = 10,
     TRANSFER_REQUEST = 11,
-    TRANSFER_RESPONSE = 12
+    TRANSFER_RESPONSE = 12,
+    SWIM_PING = 13,
+    SWIM_PING_REQ = 14,
+    SWIM_ACK = 15,
+    CHUNK_OFFER = 16,
+    CHUNK_WANT = 17,
+    DELTA_OFFER = 18,
+    DELTA_SIGNATURES = 19,
+    TRANSFER_SETUP = 20
 };
 
 // Network configuration constants
@@ -36,6 +44,109 @@ constexpr int HEARTBEAT_INTERVAL_SEC = 30;
 constexpr int NODE_TIMEOUT_SEC = 90;
 constexpr int MAX_PEERS = 10;
 
+// Frame header layout: type, sender, receiver, timestamp, payload size,
+// then flags, the length of an optional piggyback trailer, the ID of the
+// node that put the frame on this connection (the sender only when the
+// frame was not relayed) and the relays the frame may still cross
+constexpr size_t FRAME_HEADER_SIZE = 41;
+constexpr size_t FRAME_FLAGS_OFFSET = 29;
+constexpr size_t FRAME_PIGGYBACK_LENGTH_OFFSET = 30;
+constexpr size_t FRAME_HOP_OFFSET = 32;
+constexpr size_t FRAME_HOP_LIMIT_OFFSET = 40;
+constexpr uint8_t FRAME_HOP_LIMIT = 16;          // Hop limit of a frame leaving its sender
+constexpr uint8_t FRAME_FLAG_PIGGYBACK = 0x01;
+constexpr uint8_t FRAME_FLAG_RELIABLE = 0x02;    // Payload starts with a reliable-channel envelope
+constexpr uint8_t FRAME_FLAG_ACK = 0x04;         // Reliable envelope is followed by an ACK block
+constexpr uint8_t FRAME_FLAG_ACK_NOW = 0x08;     // Sender's window is full: acknowledge immediately
+constexpr uint8_t FRAME_FLAG_ORDERED = 0x10;     // Reliable envelope is followed by an ordered-channel header
+constexpr uint8_t FRAME_FLAG_COMPRESSED = 0x20;  // Payload is compressed (codec and original size come first)
+constexpr uint8_t FRAME_FLAG_ACCEPTS_LZ4 = 0x40; // Sender decodes LZ4-compressed frames
+constexpr uint8_t FRAME_FLAG_ACCEPTS_ZSTD = 0x80; // Sender decodes zstd-compressed frames
+constexpr size_t MAX_PIGGYBACK_BYTES = 512;
+
+// Frame compression configuration
+constexpr size_t COMPRESSION_MIN_BYTES = 256;             // Smaller payloads are sent as they are
+constexpr size_t COMPRESSION_SAMPLE_BYTES = 4096;         // Larger payloads are tried on a sample this size first
+constexpr double COMPRESSION_MIN_SAVING = 0.1;            // Share a payload must shrink by to be sent compressed
+constexpr size_t COMPRESSION_MAX_PAYLOAD = 64 * 1024 * 1024;  // Largest payload compressed, and largest accepted
+
+// Per-peer statistics configuration
+constexpr size_t CACHE_LINE_SIZE = 64;
+constexpr size_t PEER_STATS_CAPACITY = 256;   // Must be a power of two
+constexpr uint64_t THROUGHPUT_WINDOW_US = 1000000;
+
+// Reliable channel configuration
+constexpr size_t RELIABLE_SEND_WINDOW = 64;         // Unacknowledged messages in flight per peer
+constexpr size_t RELIABLE_RECEIVE_WINDOW = 1024;    // Sequences buffered above the cumulative ACK
+constexpr size_t MAX_SACK_RANGES = 4;
+constexpr int FAST_RETRANSMIT_DUP_ACKS = 3;
+constexpr int RELIABLE_INITIAL_RTO_MS = 1000;   // Before the first RTT sample (RFC 6298)
+constexpr int RELIABLE_MIN_RTO_MS = 200;
+constexpr int RELIABLE_MAX_RTO_MS = 60000;
+constexpr double RELIABLE_RTO_JITTER = 0.25;    // Random extension of a backed-off timeout
+constexpr int RELIABLE_MAX_RETRIES = 8;
+constexpr size_t RELIABLE_ACK_EVERY = 8;            // In-order messages covered by one delayed ACK
+constexpr int RELIABLE_ACK_DELAY_US = 20000;        // Longest an ACK is held back
+constexpr int RELIABLE_TIMER_INTERVAL_MS = 10;
+constexpr size_t ORDERED_REORDER_BUFFER_BYTES = 1024 * 1024;  // Held-back payload per ordered channel
+
+// Data exchange configuration
+constexpr size_t DATA_CHUNK_WINDOW = 32;    // Chunks in flight per outgoing transfer
+constexpr uint64_t DATA_MAX_TRANSFER_BYTES = uint64_t(1) << 32;    // Largest transfer reassembled in memory
+constexpr uint32_t DATA_MAX_TRANSFER_CHUNKS = uint32_t(1) << 24;   // Bounds a transfer's received-chunk bitmap
+constexpr size_t SWARM_INITIAL_PIPELINE = 4;    // Requests outstanding at a source before its rate is known
+constexpr size_t SWARM_MAX_PIPELINE = 64;
+constexpr int SWARM_PIPELINE_MS = 250;          // Each source is kept this much of its own throughput ahead
+constexpr int SWARM_REQUEST_TIMEOUT_MS = 2000;  // Shortest wait before a request moves to another source
+constexpr size_t CHUNK_REQUEST_MAX_CHUNKS = size_t(1) << 22;   // Indices one chunk request may expand to
+constexpr uint32_t DATA_RESUME_CHECKPOINT_CHUNKS = 64;  // Journaled chunks between bitmap checkpoints
+constexpr int DATA_RESUME_STALL_MS = 10000;     // Idle incoming push asks its sender for the missing chunks
+constexpr size_t DATA_MIN_CHUNK_SIZE = 1024;            // Default bounds of adaptive chunk sizing
+constexpr size_t DATA_MAX_CHUNK_SIZE = 256 * 1024;
+constexpr double DATA_CHUNK_LOSS_TARGET = 0.01;         // Retransmitted share of messages above which chunks shrink
+constexpr uint64_t DATA_CHUNK_LOSS_SAMPLE = 32;         // Messages sent before a new loss sample counts
+constexpr size_t DATA_SCHEDULER_QUANTUM = 16 * 1024;    // Bytes a weight-1 transfer may send per round
+constexpr size_t DATA_SCHEDULER_MAX_BYPASS = 8;         // Smaller transfers admitted ahead of a queued one before it goes next
+constexpr uint32_t DELTA_MIN_BLOCK_SIZE = 512;          // Bounds of the block size delta signatures are taken over
+constexpr uint32_t DELTA_MAX_BLOCK_SIZE = 64 * 1024;
+
+// Chunk store configuration (content-defined chunk bounds in bytes)
+constexpr size_t CHUNK_STORE_MIN_CHUNK = 2 * 1024;
+constexpr size_t CHUNK_STORE_AVERAGE_CHUNK = 8 * 1024;  // Must be a power of two
+constexpr size_t CHUNK_STORE_MAX_CHUNK = 64 * 1024;
+constexpr size_t CHUNK_STORE_CAPACITY_BYTES = 256 * 1024 * 1024;   // Unpinned chunks beyond this are evicted
+
+// Congestion control configuration (windows in messages)
+constexpr size_t CONGESTION_INITIAL_WINDOW = 10;    // RFC 6928
+constexpr size_t CONGESTION_MIN_WINDOW = 1;         // After a retransmit timeout
+constexpr size_t CONGESTION_MAX_WINDOW = 1024;
+constexpr double CONGESTION_DELAY_ALPHA = 2.0;      // Delay-based mode grows below this many queued messages...
+constexpr double CONGESTION_DELAY_BETA = 4.0;       // ...and shrinks above this many
+
+// Durable outbox configuration
+constexpr size_t OUTBOX_SEGMENT_BYTES = 4 * 1024 * 1024;
+constexpr int OUTBOX_GROUP_COMMIT_US = 2000;            // Flusher waits this long for more records
+constexpr size_t OUTBOX_GROUP_COMMIT_BYTES = 256 * 1024; // ...unless this much is already buffered
+constexpr double OUTBOX_FORWARD_LIVE_FRACTION = 0.25;   // Oldest segment this little live is copied forward
+
+// Failure detection configuration
+constexpr size_t FAILURE_DETECTOR_WINDOW = 100;
+constexpr size_t FAILURE_DETECTOR_MIN_SAMPLES = 3;
+constexpr double FAILURE_DETECTOR_MIN_STDDEV_MS = 500.0;
+constexpr double PHI_ROUTING_EVICTION_THRESHOLD = 5.0;
+constexpr double PHI_HARD_REMOVAL_THRESHOLD = 10.0;
+constexpr double FAILURE_DETECTOR_MIN_SAMPLE_INTERVAL_MS = HEARTBEAT_INTERVAL_SEC * 500.0;  // Shorter gaps only refresh liveness
+constexpr int FAILURE_DETECTION_INTERVAL_SEC = 5;  // Upper bound between sweeps
+constexpr int CHURN_COALESCE_WINDOW_MS = 250;        // Joins/failures applied as one batch
+
+// SWIM membership configuration
+constexpr int SWIM_PROTOCOL_PERIOD_MS = 1000;
+constexpr int SWIM_PING_TIMEOUT_MS = 300;
+constexpr size_t SWIM_INDIRECT_PROBES = 3;
+constexpr int SWIM_SUSPICION_MULTIPLIER = 4;
+constexpr int SWIM_DISSEMINATION_FACTOR = 3;
+constexpr size_t SWIM_MAX_PIGGYBACK_UPDATES = 6;
+
 // Network address structure
 struct NetworkAddress {
     std::string host;
@@ -60,8 +171,11 @@ struct Message {
     NodeID receiverID;
     std::vector<uint8_t> payload;
     uint64_t timestamp;
+    uint8_t flags;
+    uint8_t hopLimit;   // Relays left before the frame is dropped
     
-    Message() : type(MessageType::DATA_MESSAGE), senderID(0), receiverID(0), timestamp(0) {}
+    Message() : type(MessageType::DATA_MESSAGE), senderID(0), receiverID(0), timestamp(0), flags(0),
+                hopLimit(FRAME_HOP_LIMIT) {}
 };
 
 } // namespace P2POverlay
@@ -0,0 +1,59 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include "Common.h"
+#include <vector>
+
+namespace P2POverlay {
+
+enum class CompressionCodec : uint8_t {
+    NONE = 0,
+    LZ4 = 1,    // Built in
+    ZSTD = 2    // Only when built with P2P_WITH_ZSTD
+};
+
+// Whether this build can encode and decode the codec
+bool isCodecAvailable(CompressionCodec codec);
+
+// FRAME_FLAG_ACCEPTS_* bits for every codec this build decodes
+uint8_t acceptedCodecFlags();
+
+// Codec to use towards a peer that advertised acceptedFlags: the preferred
+// one if it takes it, else LZ4 if it takes that, else NONE
+CompressionCodec negotiateCodec(CompressionCodec preferred, uint8_t acceptedFlags);
+
+/**
+ * LZ4 block format: sequences of a token, literal bytes and a back
+ * reference of at least four bytes into the previous 64 KB. The
+ * compressor is single-pass greedy with one hash table probe per
+ * position and skips ahead faster the longer it goes without a match,
+ * so incompressible input costs little.
+ */
+
+// Compressed size, or 0 if the output would exceed capacity
+size_t lz4Compress(const uint8_t* data, size_t size, uint8_t* out, size_t capacity);
+
+// False unless the input decodes to exactly size bytes
+bool lz4Decompress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize);
+
+// Output capacity that always fits lz4Compress of size bytes
+size_t lz4CompressBound(size_t size);
+
+/**
+ * Compressed payload: codec u8, original size u32, then the codec's
+ * output. compressPayload returns false and leaves out alone when the
+ * payload is too small, too large, or shrinks by less than
+ * COMPRESSION_MIN_SAVING. Payloads above COMPRESSION_SAMPLE_BYTES are
+ * judged on a sample first, so one that will not compress costs a
+ * sample's worth of work.
+ */
+bool compressPayload(CompressionCodec codec, const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+bool decompressPayload(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+// Decompress a received frame's payload and clear FRAME_FLAG_COMPRESSED;
+// frames without the flag are left alone. False if the payload does not decode
+bool decompressFrame(Message& message);
+
+} // namespace P2POverlay
+
+#endif // COMPRESSION_H
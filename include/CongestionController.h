@@ -0,0 +1,95 @@
+#ifndef CONGESTION_CONTROLLER_H
+#define CONGESTION_CONTROLLER_H
+
+#include "Common.h"
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+namespace P2POverlay {
+
+/**
+ * How the congestion window reacts between losses
+ */
+enum class CongestionMode {
+    LOSS_BASED,    // AIMD: grow until a loss, then halve
+    DELAY_BASED    // Vegas: hold the queue built on the path between two bounds
+};
+
+/**
+ * Congestion state of one destination
+ */
+struct CongestionFlow {
+    double window;                // Messages allowed in flight
+    double slowStartThreshold;
+    NodeID pathKey;               // Flows with the same key share a bottleneck
+    uint64_t smoothedRttMicros;
+    uint64_t baseRttMicros;       // Lowest RTT seen: the path without queueing
+    uint64_t roundMinRttMicros;   // Lowest RTT in the current round trip
+    std::chrono::steady_clock::time_point roundStart;
+    std::chrono::steady_clock::time_point lastDecrease;
+    
+    CongestionFlow() : window(CONGESTION_INITIAL_WINDOW), slowStartThreshold(CONGESTION_MAX_WINDOW),
+                       pathKey(0), smoothedRttMicros(0), baseRttMicros(0), roundMinRttMicros(0) {}
+};
+
+/**
+ * Per-destination congestion windows for overlay-level flows
+ *
+ * Windows start small and double every round trip (slow start) up to the
+ * threshold, then grow by one message per round trip. A loss reported by
+ * the reliable layer halves the window once per round trip; a retransmit
+ * timeout collapses it to the minimum. In delay-based mode the window
+ * additionally stops growing, or shrinks, once the measured RTT shows
+ * messages queueing on the path.
+ *
+ * Destinations reached through the same first relay share fate: a loss
+ * on one of them shrinks every flow on that relay, so competing flows
+ * converge to equal shares instead of the most aggressive one taking
+ * the relay's capacity.
+ */
+class CongestionController {
+public:
+    explicit CongestionController(CongestionMode mode = CongestionMode::LOSS_BASED);
+    
+    // Signals from the reliable layer
+    void onAck(NodeID destinationID, size_t ackedMessages, uint64_t rttMicros);
+    void onLoss(NodeID destinationID);
+    void onTimeout(NodeID destinationID);
+    void removeFlow(NodeID destinationID);
+    
+    // Window queries
+    size_t getWindow(NodeID destinationID);
+    size_t getSlowStartThreshold(NodeID destinationID);
+    
+    // Configuration
+    void setMode(CongestionMode mode) { mode_ = mode; }
+    CongestionMode getMode() const { return mode_; }
+    void setPathResolver(std::function<NodeID(NodeID)> resolver);
+    
+    // Statistics
+    size_t getFlowCount() const;
+    size_t getLossEvents() const { return lossEvents_; }
+    size_t getTimeouts() const { return timeouts_; }
+    
+private:
+    mutable std::mutex mutex_;
+    std::map<NodeID, CongestionFlow> flows_;
+    std::atomic<CongestionMode> mode_;
+    std::function<NodeID(NodeID)> pathResolver_;
+    
+    // Statistics
+    std::atomic<size_t> lossEvents_;
+    std::atomic<size_t> timeouts_;
+    
+    // Caller must hold mutex_
+    CongestionFlow& flowLocked(NodeID destinationID);
+    void decreaseLocked(CongestionFlow& flow, std::chrono::steady_clock::time_point now);
+    void adjustForDelayLocked(CongestionFlow& flow, std::chrono::steady_clock::time_point now);
+};
+
+} // namespace P2POverlay
+
+#endif // CONGESTION_CONTROLLER_H
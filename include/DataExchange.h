@@ -5,12 +5,23 @@
 #include "Node.h"
 #include "NetworkManager.h"
 #include "MessageRouter.h"
+#include "ReliableMessaging.h"
+#include "ChunkFormat.h"
+#include "TransferJournal.h"
+#include "SwarmScheduler.h"
+#include "ChunkStore.h"
+#include "ChunkSizer.h"
+#include "TransferScheduler.h"
+#include "DeltaEncoding.h"
 #include <vector>
 #include <map>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
 #include <functional>
 #include <string>
+#include <atomic>
+#include <algorithm>
 
 namespace P2POverlay {
 
@@ -21,10 +32,11 @@ struct DataChunk {
     uint64_t chunkID;
     uint32_t sequenceNumber;
     uint32_t totalChunks;
+    uint64_t offset;
     std::vector<uint8_t> data;
     bool isLastChunk;
     
-    DataChunk() : chunkID(0), sequenceNumber(0), totalChunks(0), isLastChunk(false) {}
+    DataChunk() : chunkID(0), sequenceNumber(0), totalChunks(0), offset(0), isLastChunk(false) {}
 };
 
 /**
@@ -48,14 +60,23 @@ struct DataTransfer {
     std::string dataType;
     size_t totalSize;
     size_t transferredSize;
+    size_t chunkSize;          // Pushes sent from this node: the size they were cut into
+    TransferPriority priority;
     TransferStatus status;
     std::chrono::system_clock::time_point startTime;
     std::chrono::system_clock::time_point lastUpdate;
     
     DataTransfer() : transferID(0), sourceID(0), destinationID(0), 
-                     totalSize(0), transferredSize(0), status(TransferStatus::PENDING) {}
+                     totalSize(0), transferredSize(0), chunkSize(0), priority(TransferPriority::NORMAL),
+                     status(TransferStatus::PENDING) {}
 };
 
+/**
+ * Reads up to length bytes at offset into buffer and returns the count.
+ * Called concurrently for different offsets of the same transfer.
+ */
+using ChunkSource = std::function<size_t(size_t offset, uint8_t* buffer, size_t length)>;
+
 /**
  * Handles data exchange between nodes
  */
@@ -68,16 +89,56 @@ public:
     );
     ~DataExchange();
     
-    // Data sending
-    uint64_t sendData(NodeID targetID, const std::vector<uint8_t>& data, const std::string& dataType = "generic");
+    // Data sending: pushes return once the first chunk window is queued and
+    // report completion through the callback. sendData chunks carry Merkle
+    // proofs; sendStream's do not, as that would read the source up front.
+    // sendDeduplicated sends only chunks missing from the receiver's store,
+    // sendDelta only the differences from a transfer the receiver holds
+    uint64_t sendData(NodeID targetID, const std::vector<uint8_t>& data, const std::string& dataType = "generic",
+                      TransferPriority priority = TransferPriority::NORMAL);
+    uint64_t sendStream(NodeID targetID, ChunkSource source, size_t totalSize, const std::string& dataType = "generic",
+                        TransferPriority priority = TransferPriority::NORMAL);
+    uint64_t sendDeduplicated(NodeID targetID, const std::vector<uint8_t>& data, const std::string& dataType = "generic",
+                              TransferPriority priority = TransferPriority::NORMAL);
+    uint64_t sendDelta(NodeID targetID, const std::vector<uint8_t>& data, uint64_t basisID,
+                       const std::string& dataType = "generic", TransferPriority priority = TransferPriority::NORMAL);
     bool sendDataChunk(NodeID targetID, const DataChunk& chunk);
     bool cancelTransfer(uint64_t transferID);
+    bool setTransferPriority(uint64_t transferID, TransferPriority priority);
     
     // Data receiving
     void handleDataChunk(const DataChunk& chunk, NodeID sourceID);
+    bool handleChunkMessage(const Message& message);
+    bool handleChunkOffer(const Message& message);
+    bool handleChunkWant(const Message& message);
+    bool handleDeltaOffer(const Message& message);
+    bool handleDeltaSignatures(const Message& message);
+    bool handleTransferSetup(const Message& message);
     std::vector<uint8_t> getReceivedData(uint64_t transferID) const;
     bool isTransferComplete(uint64_t transferID) const;
     
+    // Content served to swarm downloads
+    bool publishContent(uint64_t contentID, ChunkSource source, size_t totalSize);
+    void unpublishContent(uint64_t contentID);
+    bool handleTransferRequest(const Message& message);
+    
+    // Interrupted pushes: the receiver asks its sender for the missing chunks
+    bool resumeTransfer(uint64_t transferID);
+    void resumeStalledTransfers();
+    bool handleTransferResponse(const Message& message);
+    
+    // Incoming pushes survive a restart; enabling resumes journaled ones
+    bool enableTransferJournal(const std::string& directory);
+    std::shared_ptr<TransferJournal> getTransferJournal() const { return transferJournal_; }
+    
+    // Multi-source download; the transfer ID is the content ID
+    uint64_t downloadContent(uint64_t contentID, size_t totalSize, const std::vector<NodeID>& sources,
+                             const MerkleHash& expectedRoot = MerkleHash());
+    MerkleHash getContentRoot(uint64_t contentID, uint32_t chunkSize);
+    bool addSwarmSource(uint64_t contentID, NodeID sourceID, const std::vector<bool>& have = std::vector<bool>());
+    void removeSwarmSource(uint64_t contentID, NodeID sourceID);
+    void retrySwarmRequests();
+    
     // Transfer management
     std::vector<DataTransfer> getActiveTransfers() const;
     DataTransfer getTransferInfo(uint64_t transferID) const;
@@ -91,32 +152,194 @@ public:
     // Configuration
     void setChunkSize(size_t chunkSize) { chunkSize_ = chunkSize; }
     size_t getChunkSize() const { return chunkSize_; }
-    void setMaxConcurrentTransfers(size_t maxTransfers) { maxConcurrentTransfers_ = maxTransfers; }
+    void setChunkWindow(size_t chunks) { chunkWindow_ = std::max<size_t>(chunks, 1); }
+    void setChunkDigests(bool enabled) { chunkDigests_ = enabled; }
+    void setMerkleProofs(bool enabled) { merkleProofs_ = enabled; }
+    size_t getChunkWindow() const { return chunkWindow_; }
+    void setMaxConcurrentTransfers(size_t maxTransfers);
+    size_t getMaxConcurrentTransfers() const;
+    
+    // Pushes take their chunk size from the measured path to the destination,
+    // between the limits; setChunkSize is the size until a path is measured
+    void setAdaptiveChunkSize(bool enabled) { adaptiveChunkSize_ = enabled; }
+    void setChunkSizeLimits(size_t minChunkSize, size_t maxChunkSize);
+    
+    // Parity chunks per group of data chunks for new pushes (0 parity: off);
+    // a push started with parity can change its count for the groups still to come
+    void setErasureCoding(size_t groupChunks, size_t parityChunks);
+    bool setTransferParity(uint64_t transferID, size_t parityChunks);
+    
+    // Chunks sent through the reliable layer are paced by its congestion window
+    void setReliableMessaging(std::shared_ptr<ReliableMessaging> reliableMessaging) { reliableMessaging_ = reliableMessaging; }
+    
+    // Chunks sent and received by deduplicated transfers are kept here
+    void setChunkStore(std::shared_ptr<ChunkStore> chunkStore) { chunkStore_ = chunkStore; }
+    std::shared_ptr<ChunkStore> getChunkStore() const { return chunkStore_; }
     
     // Statistics
     size_t getSentDataSize() const { return sentDataSize_; }
     size_t getReceivedDataSize() const { return receivedDataSize_; }
     size_t getCompletedTransfers() const { return completedTransfers_; }
     size_t getFailedTransfers() const { return failedTransfers_; }
+    size_t getRejectedChunks() const { return rejectedChunks_; }
+    size_t getCorruptChunks() const { return corruptChunks_; }
+    size_t getServedChunks() const { return servedChunks_; }
+    size_t getDeduplicatedBytes() const { return deduplicatedBytes_; }
+    size_t getDeltaSavedBytes() const { return deltaSavedBytes_; }
+    size_t getResumedTransfers() const { return resumedTransfers_; }
+    size_t getParityChunks() const { return parityChunks_; }
+    size_t getRecoveredChunks() const { return recoveredChunks_; }
+    size_t getQueuedTransfers() const;
     
 private:
     std::shared_ptr<Node> node_;
     std::shared_ptr<NetworkManager> networkManager_;
     std::shared_ptr<MessageRouter> messageRouter_;
+    std::shared_ptr<ReliableMessaging> reliableMessaging_;
+    std::shared_ptr<ChunkStore> chunkStore_;
+    std::shared_ptr<TransferJournal> transferJournal_;
     
     // Transfer management
     mutable std::mutex transfersMutex_;
     std::map<uint64_t, DataTransfer> outgoingTransfers_;
     std::map<uint64_t, DataTransfer> incomingTransfers_;
     
+    // Chunks of one parity group read so far, zero-padded to the chunk size
+    struct ParityGroup {
+        std::vector<uint8_t> shards;
+        uint32_t filled = 0;
+    };
+    
+    // Sender side of a pipelined transfer (guarded by transfersMutex_)
+    struct OutgoingStream {
+        NodeID targetID;
+        ChunkSource source;
+        size_t totalSize;
+        size_t chunkSize;
+        uint32_t totalChunks;
+        uint32_t nextChunk;      // Next chunk to read from the source
+        uint32_t inFlight;       // Sent and not yet acknowledged
+        uint32_t completed;
+        uint32_t epoch = 0;      // Bumped by a resume; older completions are ignored
+        
+        // Only the listed chunks are sent (a resume or a deduplicated
+        // transfer); a deduplicated transfer's chunks each have their own
+        // offset and size (empty for fixed-size chunks)
+        std::vector<uint32_t> sequences;
+        std::vector<uint64_t> offsets;
+        std::vector<uint32_t> sizes;
+        
+        std::shared_ptr<const MerkleTree> tree;   // Null when sent without proofs
+        bool awaitingSetup = false;               // No chunk goes until the receiver has the root
+        
+        // Erasure coding of the initial fixed-size plan (0 parity: off)
+        uint32_t groupChunks = 0;
+        uint32_t parityChunks = 0;
+        std::map<uint32_t, ParityGroup> parityGroups;
+    };
+    std::map<uint64_t, OutgoingStream> outgoingStreams_;
+    std::map<uint64_t, OutgoingStream> suspendedStreams_;   // Failed pushes a resume can restart
+    TransferScheduler scheduler_;                           // Pushes holding or awaiting a slot
+    
+    // Swarm state (guarded by transfersMutex_)
+    struct PublishedContent {
+        ChunkSource source;
+        size_t totalSize;
+        std::map<uint32_t, std::shared_ptr<const MerkleTree>> trees;   // Per requested chunk size
+    };
+    struct SwarmDownload {
+        SwarmScheduler scheduler;
+        uint32_t chunkSize;
+        
+        SwarmDownload(uint32_t totalChunks, uint32_t size) : scheduler(totalChunks, size), chunkSize(size) {}
+    };
+    std::map<uint64_t, PublishedContent> published_;
+    std::map<uint64_t, SwarmDownload> swarms_;
+    
+    // Offered blobs, pinned in the chunk store until the transfer ends
+    std::map<uint64_t, ChunkManifest> offers_;
+    
+    // Delta pushes waiting for the receiver's block signatures
+    struct PendingDelta {
+        std::shared_ptr<const std::vector<uint8_t>> data;
+        TransferPriority priority;
+    };
+    std::map<uint64_t, PendingDelta> pendingDeltas_;
+    
+    // Completions handed to reliable messaging can outlive this object and
+    // run on its timer thread. Each one registers here while it runs; the
+    // destructor marks the object dead and waits for running ones to finish
+    struct CompletionGuard {
+        std::mutex mutex;
+        std::condition_variable idle;
+        bool alive = true;
+        size_t running = 0;
+    };
+    std::shared_ptr<CompletionGuard> completionGuard_;
+    
+    // Incoming transfer: chunk payloads are copied straight to their offset
+    struct IncomingAssembly {
+        std::vector<uint8_t> buffer;
+        std::vector<bool> received;
+        uint32_t receivedCount = 0;
+        MerkleHash root{};
+        bool rootKnown = false;
+        bool rootFromFirstChunk = false;    // Swarm download started without a root
+        bool unproven = false;   // Holds chunks rebuilt from parity or taken before the root
+        bool failed = false;     // A push that delivered a corrupt chunk
+        size_t chunkSize = 0;    // Length of every chunk but the last, once known
+        
+        // Journaled pushes: chunks written to disk, and how many since the
+        // bitmap was last checkpointed
+        bool journaled = false;
+        std::vector<bool> persisted;
+        uint32_t persistedCount = 0;
+        uint32_t uncheckpointed = 0;
+        
+        // Parity shards by group until the group's chunks are all in;
+        // the layout comes from the first parity chunk
+        std::map<uint32_t, std::vector<std::vector<uint8_t>>> parity;
+        uint32_t groupChunks = 0;
+        size_t shardSize = 0;
+        uint64_t totalSize = 0;
+    };
+    
+    // Chunk rebuilt from parity, accounted for once the assembly lock is released
+    struct RecoveredChunk {
+        uint32_t sequence;
+        uint64_t offset;
+        size_t length;
+        bool last;
+    };
+    
     // Received data buffers
     mutable std::mutex receivedDataMutex_;
-    std::map<uint64_t, std::map<uint32_t, DataChunk>> receivedChunks_;
-    std::map<uint64_t, std::vector<uint8_t>> completedData_;
+    std::map<uint64_t, IncomingAssembly> assemblies_;
+    std::map<uint64_t, std::shared_ptr<const std::vector<uint8_t>>> completedData_;   // Immutable once stored
+    
+    // Deduplicated incoming transfers: arriving chunks must match the offer
+    struct IncomingManifest {
+        ChunkManifest manifest;
+        std::vector<uint64_t> offsets;
+    };
+    std::map<uint64_t, IncomingManifest> incomingManifests_;
+    
+    // Incoming delta pushes: the transfer whose data the script copies from
+    struct IncomingDelta {
+        uint64_t basisID;
+        uint32_t blockSize;
+    };
+    std::map<uint64_t, IncomingDelta> incomingDeltas_;
     
     // Configuration
     size_t chunkSize_;
-    size_t maxConcurrentTransfers_;
+    std::atomic<size_t> chunkWindow_;
+    std::atomic<bool> chunkDigests_;
+    std::atomic<bool> merkleProofs_;
+    std::atomic<size_t> fecGroupChunks_;
+    std::atomic<size_t> fecParityChunks_;
+    std::atomic<bool> adaptiveChunkSize_;
+    ChunkSizer chunkSizer_;   // Guarded by transfersMutex_
     
     // Callbacks
     std::function<void(NodeID, const std::vector<uint8_t>&, const std::string&)> onDataReceived_;
@@ -128,10 +351,53 @@ private:
     std::atomic<size_t> receivedDataSize_;
     std::atomic<size_t> completedTransfers_;
     std::atomic<size_t> failedTransfers_;
+    std::atomic<size_t> rejectedChunks_;
+    std::atomic<size_t> corruptChunks_;
+    std::atomic<size_t> servedChunks_;
+    std::atomic<size_t> deduplicatedBytes_;
+    std::atomic<size_t> deltaSavedBytes_;
+    std::atomic<size_t> resumedTransfers_;
+    std::atomic<size_t> parityChunks_;
+    std::atomic<size_t> recoveredChunks_;
     
     // Internal methods
     uint64_t generateTransferID();
-    std::vector<DataChunk> splitData(const std::vector<uint8_t>& data, uint64_t transferID);
+    Message makeChunkMessage(NodeID targetID, ChunkHeader& header) const;
+    void storeChunk(const ChunkView& chunk, NodeID sourceID);
+    void storeParity(const ChunkView& chunk, NodeID sourceID);
+    void collectParity(uint64_t transferID, uint32_t epoch, const ChunkHeader& header, const uint8_t* payload);
+    void sendParity(uint64_t transferID, NodeID targetID, const ChunkHeader& first, std::vector<uint8_t> shards,
+                    uint32_t count, uint32_t groupChunks, uint32_t parityChunks, size_t totalSize);
+    void acceptRecovered(uint64_t transferID, NodeID sourceID, const std::vector<RecoveredChunk>& recovered);
+    
+    // Caller must hold receivedDataMutex_
+    IncomingAssembly* openAssemblyLocked(uint64_t transferID, uint32_t totalChunks, size_t chunkSize);
+    bool fitsChunkLayoutLocked(IncomingAssembly& assembly, const ChunkHeader& header, size_t payloadSize);
+    void recoverGroupLocked(IncomingAssembly& assembly, uint32_t group, std::vector<RecoveredChunk>& recovered);
+    bool bufferMatchesRootLocked(const IncomingAssembly& assembly) const;
+    
+    // Caller must hold transfersMutex_
+    DataTransfer& incomingTransferLocked(uint64_t transferID, NodeID sourceID);
+    uint64_t startStream(NodeID targetID, ChunkSource source, size_t totalSize, const std::string& dataType, bool proofs,
+                         TransferPriority priority, uint64_t transferID = 0);
+    void admitTransfersLocked();
+    bool markTransferCompleteLocked(uint64_t transferID, bool success);
+    void rejectCorruptChunk(uint64_t transferID, NodeID sourceID, uint32_t sequence);
+    std::shared_ptr<const MerkleTree> buildTree(const ChunkSource& source, size_t totalSize, size_t chunkSize) const;
+    std::shared_ptr<const MerkleTree> contentTree(uint64_t contentID, uint32_t chunkSize);
+    bool resumePush(const ChunkRequest& request, NodeID requesterID);
+    void journalChunk(uint64_t transferID, const ChunkView& chunk);
+    void failIncomingPush(uint64_t transferID, NodeID sourceID);
+    void pumpTransfers();
+    void completeChunk(uint64_t transferID, uint32_t epoch, size_t bytes, bool success);
+    void completeSetup(uint64_t transferID, bool delivered);
+    
+    // Wraps a completion that uses this object in completionGuard_
+    std::function<void(uint64_t, bool)> guardCompletion(std::function<void(uint64_t, bool)> completion);
+    void pumpSwarm(uint64_t contentID);
+    bool sendControlMessage(NodeID targetID, MessageType type, const std::vector<uint8_t>& payload,
+                            std::function<void(uint64_t, bool)> completion = nullptr);
+    void releaseOfferLocked(uint64_t transferID);
     bool reassembleData(uint64_t transferID);
     void updateTransferProgress(uint64_t transferID, size_t bytesTransferred);
     void markTransferComplete(uint64_t transferID, bool success);
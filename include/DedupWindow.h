@@ -0,0 +1,63 @@
+#ifndef DEDUP_WINDOW_H
+#define DEDUP_WINDOW_H
+
+#include "Common.h"
+#include <vector>
+
+namespace P2POverlay {
+
+/**
+ * Contiguous block of received sequences [first, last]
+ */
+struct SackRange {
+    uint64_t first;
+    uint64_t last;
+};
+
+/**
+ * Per-sender duplicate filter over a sequence space
+ *
+ * Every sequence below the cumulative point has been seen; sequences in
+ * the window above it are tracked in a circular bitmap indexed by
+ * sequence modulo the capacity. Lookups and inserts are O(1) and memory
+ * is fixed at capacity / 8 bytes, however long the stream runs.
+ */
+class DedupWindow {
+public:
+    explicit DedupWindow(size_t capacity = RELIABLE_RECEIVE_WINDOW);
+    
+    // Records a sequence; false if it was seen before or lies outside the window
+    bool insert(uint64_t sequence);
+    bool contains(uint64_t sequence) const;
+    bool inWindow(uint64_t sequence) const;
+    
+    // Treats every sequence below the given one as seen
+    void advanceTo(uint64_t sequence);
+    void reset();
+    
+    // Window state
+    uint64_t getCumulative() const { return cumulative_; }
+    bool hasGaps() const { return outOfOrder_ > 0; }
+    size_t getOutOfOrderCount() const { return outOfOrder_; }
+    size_t getCapacity() const { return capacity_; }
+    std::vector<SackRange> getRanges(size_t maxRanges) const;
+    
+    // Memory accounting
+    size_t getMemoryUsage() const;
+    
+private:
+    std::vector<uint64_t> bits_;
+    size_t capacity_;
+    uint64_t cumulative_;    // Lowest sequence not yet seen
+    uint64_t highest_;       // Highest out-of-order sequence seen
+    size_t outOfOrder_;      // Bits set above the cumulative point
+    
+    bool testBit(uint64_t sequence) const;
+    void setBit(uint64_t sequence);
+    void clearBit(uint64_t sequence);
+    void absorbContiguous();
+};
+
+} // namespace P2POverlay
+
+#endif // DEDUP_WINDOW_H
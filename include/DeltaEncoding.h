@@ -0,0 +1,102 @@
+#ifndef DELTA_ENCODING_H
+#define DELTA_ENCODING_H
+
+#include "Common.h"
+#include "Checksum.h"
+#include <vector>
+#include <string>
+
+namespace P2POverlay {
+
+/**
+ * rsync's weak checksum of a block: s1 is the byte sum and s2 the sum of
+ * the running s1, both mod 2^16, packed as s1 | s2 << 16
+ *
+ * Computed 32 (AVX2) or 16 (SSSE3) bytes at a time on CPUs that have them.
+ */
+uint32_t weakChecksum(const uint8_t* data, size_t size);
+
+/**
+ * Weak checksum of a fixed-size window that slides one byte at a time
+ */
+class RollingChecksum {
+public:
+    RollingChecksum() : s1_(0), s2_(0), size_(0) {}
+    
+    void reset(const uint8_t* data, size_t size);
+    
+    // Drops out from the front of the window and appends in at the back
+    void roll(uint8_t out, uint8_t in) {
+        s1_ += static_cast<uint32_t>(in) - out;
+        s2_ += s1_ - static_cast<uint32_t>(size_ * out);
+    }
+    
+    uint32_t value() const { return (s1_ & 0xFFFF) | (s2_ << 16); }
+    
+private:
+    uint32_t s1_;
+    uint32_t s2_;
+    size_t size_;
+};
+
+/**
+ * Signatures of the receiver's copy of a blob, one per full block
+ *
+ * Wire layout (little-endian): transfer ID u64, block size u32, block
+ * count u32, then per block the weak checksum u32 and strong hash u64. A
+ * trailing partial block has no signature and is never copied.
+ */
+struct BlockSignature {
+    uint32_t weak;
+    uint64_t strong;
+};
+
+struct DeltaSignatures {
+    uint64_t transferID;
+    uint32_t blockSize;
+    std::vector<BlockSignature> blocks;
+    
+    DeltaSignatures() : transferID(0), blockSize(0) {}
+};
+
+std::vector<uint8_t> encodeDeltaSignatures(const DeltaSignatures& signatures);
+bool decodeDeltaSignatures(const uint8_t* data, size_t size, DeltaSignatures& signatures);
+
+// Block size for a basis of the given size: about its square root, as rsync picks
+uint32_t chooseDeltaBlockSize(uint64_t basisSize);
+DeltaSignatures computeSignatures(const uint8_t* basis, size_t size, uint32_t blockSize);
+
+/**
+ * Offer of a new version of a blob the receiver holds as transfer basisID
+ *
+ * Wire layout (little-endian): transfer ID u64, basis ID u64, total size
+ * u64, data type length u16 and bytes.
+ */
+struct DeltaOffer {
+    uint64_t transferID;
+    uint64_t basisID;
+    uint64_t totalSize;
+    std::string dataType;
+    
+    DeltaOffer() : transferID(0), basisID(0), totalSize(0) {}
+};
+
+std::vector<uint8_t> encodeDeltaOffer(const DeltaOffer& offer);
+bool decodeDeltaOffer(const uint8_t* data, size_t size, DeltaOffer& offer);
+
+/**
+ * Delta script turning the basis into data: the result's size and
+ * SHA-256, then a list of operations, each a tag byte followed by
+ * either a run of basis blocks to copy (first u32, count u32) or
+ * literal bytes (length u32 and the bytes)
+ */
+std::vector<uint8_t> encodeDelta(const DeltaSignatures& signatures, const uint8_t* data, size_t size);
+
+// Rebuilds the data from the basis; false on a malformed script or a
+// result whose digest does not match (a basis that changed, say)
+bool applyDelta(const uint8_t* basis, size_t basisSize, uint32_t blockSize, const uint8_t* delta, size_t deltaSize,
+                std::vector<uint8_t>& result);
+
+} // namespace P2POverlay
+
+#endif // DELTA_ENCODING_H
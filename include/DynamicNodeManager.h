@@ -5,12 +5,17 @@
 #include "Node.h"
 #include "NetworkManager.h"
 #include "TopologyManager.h"
+#include "FailureDetector.h"
 #include <vector>
 #include <map>
+#include <set>
 #include <mutex>
 #include <memory>
 #include <chrono>
 #include <functional>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 namespace P2POverlay {
 
@@ -22,7 +27,18 @@ enum class NodeState {
     ACTIVE,
     LEAVING,
     FAILED,
-    UNKNOWN
+    UNKNOWN,
+    SUSPECTED   // Appended so the values above keep their printed numbers
+};
+
+constexpr size_t NODE_STATE_COUNT = static_cast<size_t>(NodeState::SUSPECTED) + 1;
+
+/**
+ * What a failure verdict is used for; each use has its own phi threshold
+ */
+enum class FailureUse {
+    ROUTING_EVICTION,   // Stop routing through the node
+    HARD_REMOVAL        // Remove the node from the overlay
 };
 
 /**
@@ -61,6 +77,14 @@ public:
     bool removeNodeGracefully(NodeID nodeID);
     bool removeNodeForced(NodeID nodeID);
     
+    // Churn coalescing: changes queued within one window are applied as a
+    // single topology batch with one repair pass and one TOPOLOGY_UPDATE
+    void queueNodeAddition(NodeID nodeID, const NetworkAddress& address);
+    void queueNodeRemoval(NodeID nodeID, bool graceful = false);
+    size_t flushChurn();
+    size_t getPendingChurnCount() const;
+    void setChurnWindowMs(int windowMs) { churnWindowMs_ = windowMs; }
+    
     // Node state management
     NodeState getNodeState(NodeID nodeID) const;
     void setNodeState(NodeID nodeID, NodeState state);
@@ -70,28 +94,42 @@ public:
     void detectFailedNodes(int timeoutSeconds = NODE_TIMEOUT_SEC);
     std::vector<NodeID> getFailedNodes() const;
     bool recoverFromNodeFailure(NodeID failedNodeID);
-    void startFailureDetection(int intervalSeconds = 30);
+    void startFailureDetection(int intervalSeconds = FAILURE_DETECTION_INTERVAL_SEC);
     void stopFailureDetection();
     
+    // Phi-accrual suspicion; call for every frame received from the node
+    void recordHeartbeat(NodeID nodeID);
+    double getSuspicionLevel(NodeID nodeID) const;
+    bool isNodeSuspected(NodeID nodeID, FailureUse use = FailureUse::ROUTING_EVICTION) const;
+    void setPhiThreshold(FailureUse use, double threshold);
+    double getPhiThreshold(FailureUse use) const;
+    PhiAccrualFailureDetector& getFailureDetector() { return failureDetector_; }
+    
     // Network integrity
     bool maintainNetworkIntegrity();
     bool repairNetworkAfterNodeRemoval(NodeID removedNodeID);
+    bool repairNetworkAfterRemovals(const std::vector<NodeID>& removedNodes);
     bool ensureConnectivity();
     
     // Topology updates
-    void propagateTopologyUpdate(const std::vector<NodeID>& updatedNodes);
+    void propagateTopologyUpdate(const std::vector<NodeID>& removedNodes,
+                                 const std::vector<std::pair<NodeID, NetworkAddress>>& addedNodes = {});
     void handleTopologyChange(NodeID changedNodeID, bool added);
     
-    // Statistics and monitoring
+    // Statistics and monitoring (counts are O(1) and lock-free)
+    size_t getNodeCountByState(NodeState state) const;
     size_t getActiveNodeCount() const;
     size_t getFailedNodeCount() const;
     std::vector<NodeInfo> getAllNodeInfo() const;
     NodeInfo getNodeInfo(NodeID nodeID) const;
+    size_t getChurnBatchesApplied() const { return churnBatchesApplied_; }
+    size_t getTopologyUpdatesSent() const { return topologyUpdatesSent_; }
     
     // Callbacks
     void setOnNodeAddedCallback(std::function<void(NodeID, const NetworkAddress&)> callback);
     void setOnNodeRemovedCallback(std::function<void(NodeID)> callback);
     void setOnNodeFailedCallback(std::function<void(NodeID)> callback);
+    void setOnNodeSuspectedCallback(std::function<void(NodeID, bool)> callback);
     void setOnNetworkRepairedCallback(std::function<void()> callback);
     
 private:
@@ -99,27 +137,93 @@ private:
     std::shared_ptr<NetworkManager> networkManager_;
     std::shared_ptr<TopologyManager> topologyManager_;
     
+    // Failure-check deadlines ordered by time; ties broken by node ID
+    using DeadlineQueue = std::set<std::pair<std::chrono::steady_clock::time_point, NodeID>>;
+    
+    // Registry entry: node info plus its links in the intrusive list of
+    // nodes sharing its state and its position in the deadline queue
+    struct RegistryEntry {
+        NodeInfo info;
+        RegistryEntry* statePrev;
+        RegistryEntry* stateNext;
+        DeadlineQueue::iterator deadline;
+        bool scheduled;
+        
+        RegistryEntry() : statePrev(nullptr), stateNext(nullptr), scheduled(false) {}
+    };
+    
     // Node tracking
     mutable std::mutex nodesMutex_;
-    std::map<NodeID, NodeInfo> nodeRegistry_;
+    std::map<NodeID, RegistryEntry> nodeRegistry_;
+    RegistryEntry* stateHeads_[NODE_STATE_COUNT];
+    std::atomic<size_t> stateCounts_[NODE_STATE_COUNT];
+    DeadlineQueue deadlines_;
     
     // Failure detection
     std::atomic<bool> failureDetectionActive_;
+    std::thread detectionThread_;
+    std::mutex detectionMutex_;
+    std::condition_variable detectionCondition_;
+    std::atomic<int64_t> detectionIntervalMs_;
+    PhiAccrualFailureDetector failureDetector_;
+    std::atomic<double> routingEvictionPhi_;
+    std::atomic<double> hardRemovalPhi_;
+    
+    // Churn coalescing
+    enum class ChurnType {
+        ADD,
+        LEAVE,
+        FAIL
+    };
+    struct ChurnEvent {
+        ChurnType type;
+        NetworkAddress address;
+        
+        ChurnEvent() : type(ChurnType::ADD) {}
+        explicit ChurnEvent(ChurnType eventType, const NetworkAddress& eventAddress = NetworkAddress())
+            : type(eventType), address(eventAddress) {}
+    };
+    mutable std::mutex churnMutex_;
+    std::map<NodeID, ChurnEvent> pendingChurn_;
+    std::chrono::steady_clock::time_point churnWindowStart_;
+    std::atomic<int> churnWindowMs_;
+    std::atomic<size_t> churnBatchesApplied_;
+    std::atomic<size_t> topologyUpdatesSent_;
     
     // Callbacks
     std::function<void(NodeID, const NetworkAddress&)> onNodeAdded_;
     std::function<void(NodeID)> onNodeRemoved_;
     std::function<void(NodeID)> onNodeFailed_;
+    std::function<void(NodeID, bool)> onNodeSuspected_;
     std::function<void()> onNetworkRepaired_;
     
     // Internal methods
     bool validateNodeAddition(NodeID nodeID, const NetworkAddress& address) const;
     void updateNodeLastSeen(NodeID nodeID);
+    
+    void failureDetectionLoop();
+    
+    // Churn batch handling (caller must not hold nodesMutex_)
+    void queueChurn(NodeID nodeID, const ChurnEvent& event);
+    void cancelQueuedFailure(NodeID nodeID);
+    std::vector<NodeID> applyChurnBatch(const std::map<NodeID, ChurnEvent>& events);
+    
+    // Registry bookkeeping (caller must hold nodesMutex_)
+    RegistryEntry& insertEntry(const NodeInfo& info);
+    void eraseEntry(std::map<NodeID, RegistryEntry>::iterator it);
+    void transitionState(RegistryEntry& entry, NodeState state);
+    void linkState(RegistryEntry& entry);
+    void unlinkState(RegistryEntry& entry);
+    void scheduleDeadline(RegistryEntry& entry, std::chrono::steady_clock::time_point deadline);
+    void unscheduleDeadline(RegistryEntry& entry);
+    std::chrono::milliseconds expectedHeartbeatInterval(NodeID nodeID) const;
+    
+    // Failure count helpers (caller must hold nodesMutex_)
     void incrementFailureCount(NodeID nodeID);
     void resetFailureCount(NodeID nodeID);
     bool shouldRemoveNode(NodeID nodeID) const;
     void notifyNodeRemoval(NodeID nodeID);
-    std::vector<NodeID> findReplacementConnections(NodeID removedNodeID) const;
+    std::vector<NodeID> findReplacementConnections(const std::vector<NodeID>& removedNodes) const;
     bool establishReplacementConnections(const std::vector<NodeID>& replacements);
 };
 
@@ -0,0 +1,46 @@
+#ifndef ERASURE_CODE_H
+#define ERASURE_CODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace P2POverlay {
+
+// GF(2^8) arithmetic (polynomial 0x11D)
+uint8_t gfMultiply(uint8_t a, uint8_t b);
+uint8_t gfInverse(uint8_t a);
+
+// dst ^= coefficient * src over size bytes; SIMD table lookups where available
+void gfMultiplyAdd(uint8_t* dst, const uint8_t* src, uint8_t coefficient, size_t size);
+
+/**
+ * Systematic Reed-Solomon code over GF(2^8) with a Cauchy parity matrix
+ *
+ * A group of dataShards equal-sized shards gets parityShards parity
+ * shards; any dataShards of the dataShards + parityShards shards rebuild
+ * the rest. Data and parity counts together are limited to 256.
+ */
+class ReedSolomon {
+public:
+    ReedSolomon(size_t dataShards, size_t parityShards);
+    
+    size_t getDataShards() const { return dataShards_; }
+    size_t getParityShards() const { return parityShards_; }
+    
+    // Writes parityShards parity shards of shardSize bytes from the data shards
+    void encode(const std::vector<const uint8_t*>& data, const std::vector<uint8_t*>& parity, size_t shardSize) const;
+    
+    // Shards are data shards then parity shards; fills in every missing data
+    // shard, false if fewer than dataShards shards are present
+    bool reconstruct(const std::vector<uint8_t*>& shards, const std::vector<bool>& present, size_t shardSize) const;
+    
+private:
+    size_t dataShards_;
+    size_t parityShards_;
+    std::vector<uint8_t> parityMatrix_;   // parityShards x dataShards, row-major
+};
+
+} // namespace P2POverlay
+
+#endif // ERASURE_CODE_H
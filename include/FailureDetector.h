@@ -0,0 +1,85 @@
+#ifndef FAILURE_DETECTOR_H
+#define FAILURE_DETECTOR_H
+
+#include "Common.h"
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+
+namespace P2POverlay {
+
+/**
+ * Sliding window of heartbeat inter-arrival times for one peer
+ */
+struct HeartbeatHistory {
+    std::vector<double> intervalsMs;
+    size_t nextIndex;
+    size_t sampleCount;
+    double sum;
+    double sumOfSquares;
+    std::chrono::steady_clock::time_point lastHeartbeat;
+    bool hasHeartbeat;
+    
+    HeartbeatHistory() : nextIndex(0), sampleCount(0), sum(0.0), sumOfSquares(0.0), hasHeartbeat(false) {}
+};
+
+/**
+ * Phi-accrual failure detector (Hayashibara et al.)
+ *
+ * Instead of a binary alive/dead verdict, reports a suspicion level phi
+ * derived from the distribution of recent heartbeat inter-arrival times.
+ * Callers pick the threshold that fits their use: a low phi is enough to
+ * route around a peer, a high phi is required before removing it.
+ */
+class PhiAccrualFailureDetector {
+public:
+    PhiAccrualFailureDetector(
+        size_t windowSize = FAILURE_DETECTOR_WINDOW,
+        size_t minSamples = FAILURE_DETECTOR_MIN_SAMPLES,
+        double minStdDeviationMs = FAILURE_DETECTOR_MIN_STDDEV_MS,
+        double acceptablePauseMs = 0.0
+    );
+    ~PhiAccrualFailureDetector();
+    
+    // Heartbeat recording
+    void heartbeat(NodeID nodeID);
+    void heartbeat(NodeID nodeID, std::chrono::steady_clock::time_point arrival);
+    void remove(NodeID nodeID);
+    void clear();
+    
+    // Suspicion queries
+    double phi(NodeID nodeID) const;
+    double phi(NodeID nodeID, std::chrono::steady_clock::time_point now) const;
+    bool isAvailable(NodeID nodeID, double threshold) const;
+    bool hasHistory(NodeID nodeID) const;
+    
+    // Window statistics
+    size_t getSampleCount(NodeID nodeID) const;
+    double getMeanIntervalMs(NodeID nodeID) const;
+    double getStdDeviationMs(NodeID nodeID) const;
+    
+    // Configuration
+    void setMinStdDeviationMs(double minStdDeviationMs) { minStdDeviationMs_ = minStdDeviationMs; }
+    void setAcceptablePauseMs(double acceptablePauseMs) { acceptablePauseMs_ = acceptablePauseMs; }
+    void setMinSampleIntervalMs(double minSampleIntervalMs) { minSampleIntervalMs_ = minSampleIntervalMs; }
+    
+private:
+    size_t windowSize_;
+    size_t minSamples_;
+    double minStdDeviationMs_;
+    double acceptablePauseMs_;
+    double minSampleIntervalMs_;
+    
+    mutable std::mutex historiesMutex_;
+    std::map<NodeID, HeartbeatHistory> histories_;
+    
+    // Internal methods
+    double computePhi(const HeartbeatHistory& history, std::chrono::steady_clock::time_point now) const;
+    double meanOf(const HeartbeatHistory& history) const;
+    double stdDeviationOf(const HeartbeatHistory& history) const;
+};
+
+} // namespace P2POverlay
+
+#endif // FAILURE_DETECTOR_H
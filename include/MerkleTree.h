@@ -0,0 +1,49 @@
+#ifndef MERKLE_TREE_H
+#define MERKLE_TREE_H
+
+#include "Checksum.h"
+#include <array>
+#include <vector>
+
+namespace P2POverlay {
+
+using MerkleHash = std::array<uint8_t, SHA256_DIGEST_SIZE>;
+
+// Leaves and interior nodes are hashed with different prefixes, so a node
+// can never be passed off as a chunk; a leaf also covers the chunk's offset
+MerkleHash hashMerkleLeaf(const uint8_t* data, size_t size, uint64_t offset);
+MerkleHash hashMerkleNode(const MerkleHash& left, const MerkleHash& right);
+
+/**
+ * Binary SHA-256 hash tree over the chunks of a transfer
+ *
+ * A node without a sibling at the end of a level moves up unchanged.
+ * With the root known, each chunk is checked on arrival from its own
+ * hash and the siblings on its path (log2 of the chunk count hashes),
+ * so a transfer whose chunks all verified is the object the root names.
+ */
+class MerkleTree {
+public:
+    MerkleTree() = default;
+    explicit MerkleTree(std::vector<MerkleHash> leaves);
+    
+    const MerkleHash& root() const;
+    size_t leafCount() const { return levels_.empty() ? 0 : levels_.front().size(); }
+    
+    // Sibling hashes from the leaf up to the root
+    std::vector<MerkleHash> proof(size_t index) const;
+    
+    // Root implied by a leaf and its proof; false if the proof has the wrong length
+    static bool rootFromProof(const MerkleHash& leaf, size_t index, size_t leafCount,
+                              const std::vector<MerkleHash>& proof, MerkleHash& root);
+    
+    // Number of siblings in a proof for a tree of leafCount leaves
+    static size_t proofLength(size_t index, size_t leafCount);
+    
+private:
+    std::vector<std::vector<MerkleHash>> levels_;   // Leaves first, root last
+};
+
+} // namespace P2POverlay
+
+#endif // MERKLE_TREE_H
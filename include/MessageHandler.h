@@ -32,6 +32,9 @@ public:
     void handleTopologyUpdate(const Message& message);
     void handlePeerDiscovery(const Message& message);
     
+    // Route an additional message type to an external component
+    void registerHandler(MessageType type, std::function<void(const Message&)> handler);
+    
     // Message creation
     Message createJoinRequest(NodeID targetNodeID);
     Message createJoinResponse(NodeID targetNodeID, bool accepted, const std::vector<NodeID>& peerList);
@@ -41,6 +44,22 @@ public:
     Message createTopologyUpdate(const std::vector<NodeID>& updatedNodes);
     Message createPeerDiscoveryRequest(NodeID targetNodeID, int maxPeers);
     
+    // Heartbeat each peer whose link carried nothing outgoing for
+    // idleMicros, through send; returns how many went out. A sent heartbeat
+    // is outgoing traffic, so it keeps the peer idle-free for the interval
+    size_t sendIdleHeartbeats(uint64_t idleMicros, const std::function<bool(NodeID, const Message&)>& send);
+    
+    // Payload encoding shared with components that send without a handler
+    static std::vector<uint8_t> serializeNodeList(const std::vector<NodeID>& nodes);
+    static std::vector<NodeID> deserializeNodeList(const std::vector<uint8_t>& data);
+    static std::vector<uint8_t> serializeTopologyChanges(
+        const std::vector<NodeID>& removedNodes,
+        const std::vector<std::pair<NodeID, NetworkAddress>>& addedNodes);
+    static bool deserializeTopologyChanges(
+        const std::vector<uint8_t>& data,
+        std::vector<NodeID>& removedNodes,
+        std::vector<std::pair<NodeID, NetworkAddress>>& addedNodes);
+        
 private:
     std::shared_ptr<Node> node_;
     std::shared_ptr<NetworkManager> networkManager_;
@@ -51,8 +70,6 @@ private:
     
     // Helper methods
     uint64_t getCurrentTimestamp() const;
-    std::vector<uint8_t> serializeNodeList(const std::vector<NodeID>& nodes);
-    std::vector<NodeID> deserializeNodeList(const std::vector<uint8_t>& data);
 };
 
 } // namespace P2POverlay
@@ -11,6 +11,7 @@
 #include <memory>
 #include <queue>
 #include <chrono>
+#include <functional>
 
 namespace P2POverlay {
 
@@ -63,6 +64,15 @@ public:
     bool forwardMessage(const Message& message, const RoutingInfo& routingInfo);
     void handleIncomingRoute(const Message& message, const RoutingInfo& routingInfo);
     
+    // Receive side: a frame addressed to another node goes on to its next
+    // hop with one hop less left, and true is returned so it is not
+    // processed here. Frames out of hops or without a route are dropped
+    bool relayIncoming(const Message& message);
+    
+    // Sends to a neighbour go through the transport if one is set (tests),
+    // else through the network manager
+    void setTransport(std::function<bool(NodeID, const Message&)> transport) { transport_ = transport; }
+    
     // Routing table management
     void updateRoutingTable();
     void clearRoutingTable();
@@ -71,12 +81,14 @@ public:
     // Statistics
     size_t getRoutedMessageCount() const { return routedMessageCount_; }
     size_t getForwardedMessageCount() const { return forwardedMessageCount_; }
+    size_t getDroppedRelayCount() const { return droppedRelayCount_; }
     double getAverageHopCount() const;
     
 private:
     std::shared_ptr<Node> node_;
     std::shared_ptr<NetworkManager> networkManager_;
     std::shared_ptr<TopologyManager> topologyManager_;
+    std::function<bool(NodeID, const Message&)> transport_;
     
     // Routing table: destination -> next hop
     mutable std::mutex routingTableMutex_;
@@ -91,9 +103,11 @@ private:
     // Statistics
     std::atomic<size_t> routedMessageCount_;
     std::atomic<size_t> forwardedMessageCount_;
+    std::atomic<size_t> droppedRelayCount_;
     std::atomic<size_t> totalHopCount_;
     
     // Internal methods
+    bool transmit(NodeID peerID, const Message& message);
     std::vector<NodeID> computeShortestPath(NodeID targetID) const;
     NodeID getNextHop(NodeID targetID) const;
     bool isMessageSeen(uint64_t messageID) const;
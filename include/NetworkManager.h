@@ -3,6 +3,7 @@
 
 #include "Common.h"
 #include "Node.h"
+#include "Compression.h"
 #include <Poco/Net/TCPServer.h>
 #include <Poco/Net/TCPServerConnection.h>
 #include <Poco/Net/TCPServerConnectionFactory.h>
@@ -14,6 +15,7 @@
 #include <queue>
 #include <mutex>
 #include <map>
+#include <chrono>
 
 namespace P2POverlay {
 
@@ -41,6 +43,36 @@ public:
     // Message receiving callback
     void setMessageCallback(std::function<void(const Message&)> callback);
     
+    // Called with the neighbour that sent each delivered frame, before the
+    // message callback; the message's senderID is its origin, which may be
+    // several hops away
+    void setFrameReceivedCallback(std::function<void(NodeID)> callback);
+    
+    // Wire frame: a FRAME_HEADER_SIZE header, the payload (compressed if
+    // the peer decodes it) and the piggyback trailer. encodeFrame builds
+    // the frame sendMessageToPeer writes; receiveFrame parses one read off
+    // a connection and delivers it, or returns false if the sizes disagree
+    std::vector<uint8_t> encodeFrame(NodeID peerID, const Message& message);
+    bool receiveFrame(const uint8_t* frame, size_t size);
+    
+    // Hands a frame read off a connection to the callbacks; hopID is the
+    // neighbour that sent it, from the frame header. frameBytes counts
+    // header, payload and trailer as they crossed the link
+    void deliverFrame(NodeID hopID, Message& message, const std::vector<uint8_t>& piggyback, size_t frameBytes);
+    
+    // Piggybacked metadata: the provider's bytes ride in a trailer after the
+    // payload of outgoing frames and are handed to the handler on receipt
+    void setPiggybackProvider(std::function<std::vector<uint8_t>(const Message&)> provider);
+    void setPiggybackHandler(std::function<void(NodeID, const std::vector<uint8_t>&)> handler);
+    
+    // Frame compression: every frame advertises the codecs this node
+    // decodes, and payloads to a peer that advertised the chosen codec (or
+    // failing that LZ4) go compressed unless they do not shrink. NONE, the
+    // default, sends everything as it is
+    void setCompression(CompressionCodec codec);
+    CompressionCodec getCompression() const { return compression_; }
+    CompressionCodec getPeerCodec(NodeID peerID) const;
+    
     // Connection management
     std::vector<NodeID> getConnectedPeers() const;
     bool isConnectedTo(NodeID peerID) const;
@@ -48,6 +80,12 @@ public:
     // Network statistics
     size_t getSentMessageCount() const { return sentMessageCount_; }
     size_t getReceivedMessageCount() const { return receivedMessageCount_; }
+    size_t getPiggybackedBytesSent() const { return piggybackedBytesSent_; }
+    size_t getCompressedFrames() const { return compressedFrames_; }
+    size_t getIncompressibleFrames() const { return incompressibleFrames_; }
+    size_t getCompressionSavedBytes() const { return compressionSavedBytes_; }
+    uint64_t getCompressionMicros() const { return compressionMicros_; }
+    uint64_t getDecompressionMicros() const { return decompressionMicros_; }
     
 private:
     std::shared_ptr<Node> node_;
@@ -63,15 +101,30 @@ private:
     
     // Message handling
     std::function<void(const Message&)> messageCallback_;
+    std::function<void(NodeID)> frameReceivedCallback_;
+    std::function<std::vector<uint8_t>(const Message&)> piggybackProvider_;
+    std::function<void(NodeID, const std::vector<uint8_t>&)> piggybackHandler_;
     std::queue<Message> incomingMessages_;
     mutable std::mutex messageQueueMutex_;
     
+    // Compression: FRAME_FLAG_ACCEPTS_* bits each neighbour's last frame carried
+    std::atomic<CompressionCodec> compression_;
+    mutable std::mutex codecsMutex_;
+    std::map<NodeID, uint8_t> peerCodecs_;
+    
     // Statistics
     std::atomic<size_t> sentMessageCount_;
     std::atomic<size_t> receivedMessageCount_;
+    std::atomic<size_t> piggybackedBytesSent_;
+    std::atomic<size_t> compressedFrames_;
+    std::atomic<size_t> incompressibleFrames_;
+    std::atomic<size_t> compressionSavedBytes_;
+    std::atomic<uint64_t> compressionMicros_;
+    std::atomic<uint64_t> decompressionMicros_;
     
     // Internal helper methods
     void handleIncomingConnection(Poco::Net::StreamSocket& socket);
+    uint8_t peerCodecFlags(NodeID peerID) const;
     bool serializeMessage(const Message& msg, std::vector<uint8_t>& buffer);
     bool deserializeMessage(const std::vector<uint8_t>& buffer, Message& msg);
     
@@ -7,9 +7,91 @@
 #include <mutex>
 #include <atomic>
 #include <chrono>
+#include <memory>
 
 namespace P2POverlay {
 
+/**
+ * Point-in-time copy of a peer's performance counters
+ */
+struct PeerStatsSnapshot {
+    NodeID peerID;
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    uint64_t messagesSent;
+    uint64_t messagesReceived;
+    uint64_t sendErrors;
+    uint64_t retransmissions;
+    uint64_t lastSendMicros;
+    uint64_t lastReceiveMicros;
+    uint64_t rttSamples;
+    double smoothedRttMs;
+    double rttVarianceMs;
+    double sendThroughputBps;
+    double receiveThroughputBps;
+    double errorRate;
+    
+    PeerStatsSnapshot() : peerID(0), bytesSent(0), bytesReceived(0), messagesSent(0),
+                          messagesReceived(0), sendErrors(0), retransmissions(0), lastSendMicros(0),
+                          lastReceiveMicros(0), rttSamples(0), smoothedRttMs(0.0),
+                          rttVarianceMs(0.0), sendThroughputBps(0.0),
+                          receiveThroughputBps(0.0), errorRate(0.0) {}
+};
+
+/**
+ * Lock-free performance counters for a single peer
+ *
+ * Send, receive and RTT state each sit on their own cache line so the
+ * sending thread and the connection handler threads never write to the
+ * same line. Readers only perform relaxed atomic loads.
+ */
+class PeerStats {
+public:
+    PeerStats() = default;
+    
+    void recordSent(size_t bytes);
+    void recordSendError();
+    void recordRetransmission();
+    void recordReceived(size_t bytes);
+    void recordRttSample(uint64_t rttMicros);
+    void reset();
+    
+    uint64_t getSmoothedRttMicros() const { return rtt_.smoothed.load(std::memory_order_relaxed); }
+    uint64_t getRttVarianceMicros() const { return rtt_.variance.load(std::memory_order_relaxed); }
+    uint64_t getRttSampleCount() const { return rtt_.samples.load(std::memory_order_relaxed); }
+    uint64_t getLastSendMicros() const { return send_.lastMicros.load(std::memory_order_relaxed); }
+    uint64_t getLastReceiveMicros() const { return receive_.lastMicros.load(std::memory_order_relaxed); }
+    
+    PeerStatsSnapshot snapshot(NodeID peerID) const;
+    
+    // Monotonic clock shared by all statistics timestamps
+    static uint64_t nowMicros();
+    
+private:
+    struct alignas(CACHE_LINE_SIZE) DirectionCounters {
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> messages{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> retransmissions{0};   // Send side only
+        std::atomic<uint64_t> lastMicros{0};
+        std::atomic<uint64_t> windowStartMicros{0};
+        std::atomic<uint64_t> windowBytes{0};
+        std::atomic<uint64_t> rateBytesPerSec{0};
+    };
+    
+    struct alignas(CACHE_LINE_SIZE) RttEstimate {
+        std::atomic<uint64_t> smoothed{0};
+        std::atomic<uint64_t> variance{0};
+        std::atomic<uint64_t> samples{0};
+    };
+    
+    DirectionCounters send_;
+    DirectionCounters receive_;
+    RttEstimate rtt_;
+    
+    static void record(DirectionCounters& counters, size_t bytes);
+};
+
 /**
  * Represents a peer node in the P2P overlay network
  */
@@ -39,6 +121,15 @@ public:
     std::chrono::system_clock::time_point getLastSeen() const;
     bool isAlive(int timeoutSeconds = NODE_TIMEOUT_SEC) const;
     
+    // Per-peer statistics (lookups never take a lock)
+    PeerStats* trackPeerStats(NodeID peerID);
+    PeerStats* getPeerStats(NodeID peerID);
+    const PeerStats* getPeerStats(NodeID peerID) const;
+    PeerStatsSnapshot getPeerStatsSnapshot(NodeID peerID) const;
+    std::vector<PeerStatsSnapshot> getAllPeerStats() const;
+    void untrackPeerStats(NodeID peerID);
+    std::vector<NodeID> getIdlePeers(uint64_t idleMicros) const;
+    
     // Network operations
     bool sendMessage(const Message& message);
     bool receiveMessage(Message& message);
@@ -61,12 +152,22 @@ private:
     mutable std::mutex heartbeatMutex_;
     std::chrono::system_clock::time_point lastSeen_;
     
+    // Per-peer statistics: open-addressed table, lock-free probes,
+    // slot claims serialized by peerStatsMutex_
+    struct alignas(CACHE_LINE_SIZE) PeerStatsSlot {
+        std::atomic<NodeID> peerID{0};
+        PeerStats stats;
+    };
+    std::unique_ptr<PeerStatsSlot[]> peerStatsSlots_;
+    std::mutex peerStatsMutex_;
+    
     // Topology information
     mutable std::mutex topologyMutex_;
     std::vector<NodeID> topologyNeighbors_;
+    
+    const PeerStatsSlot* findPeerStatsSlot(NodeID peerID) const;
 };
 
 } // namespace P2POverlay
 
 #endif // NODE_H
-
@@ -9,6 +9,7 @@
 #include "NodeDiscovery.h"
 #include "NodeRegistration.h"
 #include "DynamicNodeManager.h"
+#include "SwimMembership.h"
 #include <vector>
 #include <memory>
 #include <thread>
@@ -39,6 +40,11 @@ public:
     std::shared_ptr<NetworkManager> getNetworkManager() const { return networkManager_; }
     std::shared_ptr<TopologyManager> getTopologyManager() const { return topologyManager_; }
     std::shared_ptr<DynamicNodeManager> getDynamicNodeManager() const { return dynamicNodeManager_; }
+    std::shared_ptr<SwimMembership> getSwimMembership() const { return swimMembership_; }
+    
+    // Liveness protocol
+    void setMembershipMode(MembershipMode mode);
+    MembershipMode getMembershipMode() const { return membershipMode_; }
     
 private:
     NodeID nodeID_;
@@ -53,6 +59,8 @@ private:
     std::shared_ptr<NodeDiscovery> nodeDiscovery_;
     std::shared_ptr<NodeRegistration> nodeRegistration_;
     std::shared_ptr<DynamicNodeManager> dynamicNodeManager_;
+    std::shared_ptr<SwimMembership> swimMembership_;
+    std::atomic<MembershipMode> membershipMode_;
     
     // Thread
     std::thread nodeThread_;
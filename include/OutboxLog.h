@@ -0,0 +1,148 @@
+#ifndef OUTBOX_LOG_H
+#define OUTBOX_LOG_H
+
+#include "Common.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+
+namespace P2POverlay {
+
+/**
+ * Unacknowledged reliable message recovered from the outbox log
+ */
+struct OutboxEntry {
+    uint64_t messageID;
+    NodeID destinationID;
+    Message message;
+    uint32_t orderedChannel;    // 0 for unordered messages
+    
+    OutboxEntry() : messageID(0), destinationID(0), orderedChannel(0) {}
+};
+
+/**
+ * Segmented write-ahead log of pending reliable messages
+ *
+ * Appends and resolutions (acknowledged or failed) are buffered in memory
+ * and written by a flusher thread that lingers briefly so concurrent
+ * writers share one fsync (group commit). Each record carries a CRC-32C;
+ * replay stops at the first torn record. Segments roll at a size limit
+ * and are deleted oldest-first once every message in them is resolved.
+ *
+ * A few long-unresolved messages would otherwise keep the oldest segment,
+ * and so every later one, on disk. Once no more than
+ * OUTBOX_FORWARD_LIVE_FRACTION of the oldest segment is live, its live
+ * appends are copied into the active segment and it goes as soon as the
+ * copies are durable; copies remember where the original was logged, so
+ * replay keeps the original order. Disk use is thus bounded by the
+ * segments written since the oldest segment that is still mostly live.
+ */
+class OutboxLog {
+public:
+    explicit OutboxLog(const std::string& directory, size_t segmentBytes = OUTBOX_SEGMENT_BYTES);
+    ~OutboxLog();
+    
+    // Lifecycle: open replays existing segments and starts the flusher
+    bool open(std::vector<OutboxEntry>& recovered);
+    void close();
+    bool isOpen() const { return running_; }
+    
+    // Logging: each call returns a log sequence number, 0 if nothing was logged
+    uint64_t append(uint64_t messageID, NodeID destinationID, const Message& message, uint32_t orderedChannel = 0);
+    uint64_t resolve(uint64_t messageID);
+    
+    // Durability
+    bool waitDurable(uint64_t lsn);
+    bool sync();
+    uint64_t getDurableLsn() const { return durableLsn_; }
+    
+    // Configuration
+    void setGroupCommitDelayUs(int delayUs) { groupCommitDelayUs_ = delayUs; }
+    
+    // Statistics
+    size_t getLiveMessageCount() const;
+    size_t getSegmentCount() const;
+    size_t getSyncCount() const { return syncCount_; }
+    size_t getRecordsWritten() const { return recordsWritten_; }
+    size_t getSegmentsDeleted() const { return segmentsDeleted_; }
+    size_t getRecordsForwarded() const { return recordsForwarded_; }
+    
+private:
+    std::string directory_;
+    size_t segmentBytes_;
+    
+    // Buffered records waiting for the flusher, tagged with their segment
+    struct PendingChunk {
+        uint64_t segment;
+        std::vector<uint8_t> bytes;
+    };
+    
+    mutable std::mutex mutex_;
+    std::condition_variable flushCondition_;
+    std::condition_variable durableCondition_;
+    std::vector<PendingChunk> buffer_;
+    size_t bufferedBytes_;
+    uint64_t activeSegment_;
+    size_t activeSegmentBytes_;
+    // An unresolved message: the segment holding its latest append and that record's size
+    struct LiveRecord {
+        uint64_t segment;
+        size_t bytes;
+    };
+    
+    // Unresolved appends in a segment and their bytes, all bytes written to
+    // it, and the LSN its live appends were copied forward at
+    struct SegmentUsage {
+        size_t liveCount;
+        size_t liveBytes;
+        size_t totalBytes;
+        uint64_t forwardLsn;
+        
+        SegmentUsage() : liveCount(0), liveBytes(0), totalBytes(0), forwardLsn(0) {}
+    };
+    
+    // Segment and offset a message was first logged at; replay orders by it
+    using LogPosition = std::pair<uint64_t, uint64_t>;
+    
+    std::map<uint64_t, LiveRecord> liveMessages_;   // Message ID -> where it is logged
+    std::map<uint64_t, SegmentUsage> segments_;
+    uint64_t nextLsn_;
+    std::atomic<uint64_t> durableLsn_;
+    std::atomic<bool> running_;
+    bool failed_;
+    std::atomic<int> groupCommitDelayUs_;
+    std::thread flusherThread_;
+    
+    // Flusher-owned file state
+    int fd_;
+    uint64_t fdSegment_;
+    
+    // Statistics
+    std::atomic<size_t> syncCount_;
+    std::atomic<size_t> recordsWritten_;
+    std::atomic<size_t> segmentsDeleted_;
+    std::atomic<size_t> recordsForwarded_;
+    
+    // Internal methods
+    std::string segmentPath(uint64_t segment) const;
+    std::vector<uint64_t> listSegments() const;
+    bool replaySegment(uint64_t segment, bool isLast, std::map<uint64_t, OutboxEntry>& live,
+                       std::map<uint64_t, LogPosition>& order);
+    void flusherLoop();
+    bool writeBatch(const std::vector<PendingChunk>& batch);
+    bool openSegmentFile(uint64_t segment);
+    void closeSegmentFile();
+    
+    // Caller must hold mutex_; truncation releases it around file reads and removals
+    uint64_t enqueueRecord(std::vector<uint8_t>&& record);
+    void truncateResolvedSegments(std::unique_lock<std::mutex>& lock);
+    bool forwardLiveRecords(uint64_t segment, const std::vector<uint8_t>& data);
+};
+
+} // namespace P2POverlay
+
+#endif // OUTBOX_LOG_H
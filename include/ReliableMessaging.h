@@ -4,12 +4,23 @@
 #include "Common.h"
 #include "Node.h"
 #include "NetworkManager.h"
+#include "DedupWindow.h"
+#include "OutboxLog.h"
+#include "CongestionController.h"
+#include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <queue>
 #include <mutex>
 #include <memory>
 #include <chrono>
 #include <functional>
+#include <atomic>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <condition_variable>
 
 namespace P2POverlay {
 
@@ -32,15 +43,130 @@ struct ReliableMessage {
     NodeID destinationID;
     AckStatus ackStatus;
     int retryCount;
+    uint64_t sequence;
+    uint32_t orderedChannel;    // 0 for unordered messages
+    uint64_t orderedSequence;
+    std::function<void(uint64_t, bool)> completion;    // Called once: acknowledged or given up
+    bool transmitted;
     std::chrono::system_clock::time_point sendTime;
     std::chrono::system_clock::time_point lastRetry;
+    std::chrono::milliseconds retransmitTimeout;
     
     ReliableMessage() : messageID(0), destinationID(0), 
-                        ackStatus(AckStatus::PENDING), retryCount(0) {}
+                        ackStatus(AckStatus::PENDING), retryCount(0),
+                        sequence(0), orderedChannel(0), orderedSequence(0), transmitted(false),
+                        retransmitTimeout(RELIABLE_INITIAL_RTO_MS) {}
+};
+
+/**
+ * Retransmission deadline of one transmitted message
+ */
+struct RetryDeadline {
+    std::chrono::system_clock::time_point deadline;
+    uint64_t sequence;
+    
+    bool operator>(const RetryDeadline& other) const { return deadline > other.deadline; }
+};
+
+/**
+ * Earliest retransmission deadline of one peer's channel
+ */
+struct ChannelDeadline {
+    std::chrono::system_clock::time_point deadline;
+    NodeID peerID;
+    
+    bool operator>(const ChannelDeadline& other) const { return deadline > other.deadline; }
+};
+
+/**
+ * Sender side of a reliable channel to one peer
+ */
+struct SendChannel {
+    uint64_t nextSequence;                 // Next sequence number to assign
+    uint64_t nextTransmit;                 // Lowest sequence not yet transmitted
+    std::map<uint64_t, uint64_t> unacked;  // Sequence -> message ID
+    uint64_t lastCumulativeAck;
+    int duplicateAcks;
+    int backoffShift;                      // Kept until a valid RTT sample (Karn)
+    uint64_t smoothedRttMicros;            // End-to-end estimate, relays included
+    uint64_t rttVarianceMicros;
+    uint64_t rttSamples;
+    
+    // Ordered channels: next sequence and the ones not yet acknowledged
+    struct OrderedState {
+        uint64_t nextSequence = 1;
+        std::set<uint64_t> unacked;
+    };
+    std::map<uint32_t, OrderedState> ordered;
+    
+    // Earliest deadline first; entries left stale by an ACK or a later
+    // deadline are dropped when they reach the top
+    std::priority_queue<RetryDeadline, std::vector<RetryDeadline>, std::greater<RetryDeadline>> deadlines;
+    std::chrono::system_clock::time_point dueAt;    // This channel's entry in the due-channel heap
+    
+    SendChannel() : nextSequence(1), nextTransmit(1), lastCumulativeAck(1), duplicateAcks(0),
+                    backoffShift(0), smoothedRttMicros(0), rttVarianceMicros(0), rttSamples(0),
+                    dueAt(std::chrono::system_clock::time_point::max()) {}
+};
+
+/**
+ * Receive-side reorder buffer of one ordered channel
+ */
+struct OrderedStream {
+    uint64_t nextDeliver;                    // Next sequence the application gets
+    std::map<uint64_t, Message> pending;     // Arrived ahead of nextDeliver
+    size_t bufferedBytes;
+    
+    OrderedStream() : nextDeliver(1), bufferedBytes(0) {}
+};
+
+/**
+ * Receiver side of a reliable channel from one peer
+ */
+struct ReceiveChannel {
+    uint32_t epoch;                 // Sender instance the sequence space belongs to
+    DedupWindow window;             // Sequences already delivered
+    size_t unacknowledged;          // In-order arrivals since the last ACK
+    bool ackPending;
+    std::chrono::steady_clock::time_point ackDeadline;
+    std::map<uint32_t, OrderedStream> ordered;
+    
+    ReceiveChannel() : epoch(0), unacknowledged(0), ackPending(false) {}
+    
+    size_t reorderBytes() const {
+        size_t total = 0;
+        for (const auto& pair : ordered) {
+            total += pair.second.bufferedBytes;
+        }
+        return total;
+    }
 };
 
 /**
  * Provides reliable message delivery with acknowledgments
+ *
+ * Each peer gets a sequence-numbered channel. Up to a send window of
+ * messages are in flight at once; the receiver answers every reliable
+ * frame with a cumulative ACK plus SACK ranges, and three duplicate ACKs
+ * trigger a retransmission of the first hole without waiting for the
+ * retry timeout. In-order arrivals are acknowledged in batches, either
+ * every few messages, after a short delay or riding on the next reliable
+ * frame back to the sender; gaps and duplicates are acknowledged at once.
+ * A fixed-size window per sender suppresses duplicates, so every message
+ * reaches the application exactly once.
+ *
+ * Messages sent on a named channel are additionally delivered in send
+ * order. Each ordered channel has its own reorder buffer, so a loss only
+ * holds back later messages of the same channel; unordered messages are
+ * never held back.
+ *
+ * The retry timeout follows the peer's smoothed RTT and RTT variance
+ * (RFC 6298): samples from retransmitted messages are ignored, and each
+ * timeout doubles the channel's RTO, plus jitter, until a clean sample
+ * arrives.
+ *
+ * New transmissions are further limited by a per-peer congestion window,
+ * which grows with ACKs and shrinks on fast retransmits and timeouts.
  */
 class ReliableMessaging {
 public:
@@ -52,16 +178,51 @@ public:
     
     // Reliable sending
     uint64_t sendReliableMessage(NodeID targetID, const Message& message);
+    uint64_t sendReliableMessage(NodeID targetID, const Message& message, const std::string& channel);
+    uint64_t sendReliableMessage(NodeID targetID, const Message& message, const std::string& channel,
+                                 std::function<void(uint64_t, bool)> completion);
+    static uint32_t channelID(const std::string& channel);
     bool acknowledgeMessage(uint64_t messageID, NodeID senderID);
     
+    // Durable outbox: pending messages survive a crash and are resent on
+    // the next start. Enable before sending; synchronous mode returns from
+    // sendReliableMessage only once the message is on disk.
+    bool enableDurableOutbox(const std::string& directory, bool synchronous = false);
+    bool flushOutbox();
+    std::shared_ptr<OutboxLog> getOutbox() const { return outbox_; }
+    
+    // Congestion control: limits messages in flight per peer below the send window
+    CongestionController& getCongestionController() { return congestion_; }
+    
+    // Incoming frames: handleIncomingMessage strips the reliable envelope and
+    // appends what is ready for the application, which for an ordered
+    // channel may be several messages or none
+    bool handleIncomingMessage(const Message& frame, std::vector<Message>& delivered);
+    void handleAck(const Message& ack);
+    void flushDelayedAcks();
+    
+    // Timer thread driving delayed ACKs and retransmissions
+    void startTimers();
+    void stopTimers();
+    
     // Message tracking
     bool isMessageAcknowledged(uint64_t messageID) const;
-    void retryPendingMessages(int timeoutSeconds = 30, int maxRetries = 3);
+    size_t getInFlightCount(NodeID peerID) const;
+    size_t getBufferedPayloadBytes() const;    // Held for messages not yet acknowledged
+    void retryPendingMessages();
     void cleanupAcknowledgedMessages(int timeoutSeconds = 300);
     
     // Configuration
-    void setRetryTimeout(int timeoutSeconds) { retryTimeout_ = timeoutSeconds; }
+    void setRtoBounds(int minRtoMs, int maxRtoMs);
     void setMaxRetries(int maxRetries) { maxRetries_ = maxRetries; }
+    int getRetransmitTimeoutMs(NodeID peerID) const;
+    void setAckPolicy(size_t everyMessages, int delayMicros);
+    void setReorderBufferLimit(size_t bytes) { reorderBufferLimit_ = bytes; }
+    void setSendWindow(size_t window) { sendWindow_ = std::max<size_t>(window, 1); }
+    size_t getSendWindow() const { return sendWindow_; }
+    
+    // Frames leave through NetworkManager::sendMessageToPeer unless overridden
+    void setTransport(std::function<bool(NodeID, const Message&)> transport);
     
     // Callbacks
     void setOnMessageDeliveredCallback(std::function<void(uint64_t, NodeID)> callback);
@@ -71,6 +232,14 @@ public:
     size_t getSentMessages() const { return sentMessages_; }
     size_t getAcknowledgedMessages() const { return acknowledgedMessages_; }
     size_t getFailedMessages() const { return failedMessages_; }
+    size_t getRetransmissions() const { return retransmissions_; }
+    size_t getFastRetransmits() const { return fastRetransmits_; }
+    size_t getDuplicatesReceived() const { return duplicatesReceived_; }
+    size_t getAcksSent() const { return acksSent_; }
+    size_t getAcksPiggybacked() const { return acksPiggybacked_; }
+    size_t getDedupMemoryUsage() const;
+    size_t getReorderBufferBytes() const { return reorderBufferBytes_; }
+    size_t getReorderRejections() const { return reorderRejections_; }
     double getDeliveryRate() const;
     
 private:
@@ -81,11 +250,41 @@ private:
     mutable std::mutex pendingMessagesMutex_;
     std::map<uint64_t, ReliableMessage> pendingMessages_;
     
+    // Per-peer channels (guarded by pendingMessagesMutex_)
+    std::map<NodeID, SendChannel> sendChannels_;
+    std::map<NodeID, ReceiveChannel> receiveChannels_;
+    
+    // Channels by earliest deadline, so a retry pass visits only the ones
+    // that are due; an entry that no longer matches its channel's dueAt is
+    // stale and skipped
+    std::priority_queue<ChannelDeadline, std::vector<ChannelDeadline>, std::greater<ChannelDeadline>> dueChannels_;
+    uint32_t epoch_;
+    std::mt19937 random_;
+    
     // Configuration
-    int retryTimeout_;
-    int maxRetries_;
+    std::atomic<int> minRtoMs_;
+    std::atomic<int> maxRtoMs_;
+    std::atomic<int> maxRetries_;
+    std::atomic<size_t> sendWindow_;
+    std::atomic<size_t> ackEvery_;
+    std::atomic<int> ackDelayUs_;
+    std::atomic<size_t> reorderBufferLimit_;
+    
+    // Timer thread
+    std::thread timerThread_;
+    std::mutex timerMutex_;
+    std::condition_variable timerCondition_;
+    std::atomic<bool> timersRunning_;
+    
+    // Congestion control, fed with ACKs and losses of every channel
+    CongestionController congestion_;
+    
+    // Durable outbox
+    std::shared_ptr<OutboxLog> outbox_;
+    bool synchronousOutbox_;
     
     // Callbacks
+    std::function<bool(NodeID, const Message&)> transport_;
     std::function<void(uint64_t, NodeID)> onMessageDelivered_;
     std::function<void(uint64_t, NodeID)> onMessageFailed_;
     
@@ -93,12 +292,49 @@ private:
     std::atomic<size_t> sentMessages_;
     std::atomic<size_t> acknowledgedMessages_;
     std::atomic<size_t> failedMessages_;
+    std::atomic<size_t> retransmissions_;
+    std::atomic<size_t> fastRetransmits_;
+    std::atomic<size_t> duplicatesReceived_;
+    std::atomic<size_t> acksSent_;
+    std::atomic<size_t> acksPiggybacked_;
+    std::atomic<size_t> reorderBufferBytes_;
+    std::atomic<size_t> reorderRejections_;
     
     // Internal methods
     uint64_t generateMessageID();
-    bool sendWithRetry(const ReliableMessage& reliableMsg);
     void markMessageAcknowledged(uint64_t messageID);
     void markMessageFailed(uint64_t messageID);
+    
+    // Settled message, reported to the callbacks once the lock is released
+    struct MessageOutcome {
+        uint64_t messageID;
+        NodeID peerID;
+        bool delivered;
+        std::function<void(uint64_t, bool)> completion;
+    };
+    void notifyOutcomes(std::vector<MessageOutcome>& outcomes);
+    
+    // Caller must hold pendingMessagesMutex_
+    void queueLocked(uint64_t messageID, NodeID targetID, const Message& message, uint32_t orderedChannel,
+                     std::vector<Message>& frames);
+    void releaseOrderedLocked(const ReliableMessage& reliableMsg);
+    void releaseOrdered(OrderedStream& stream, uint64_t senderBase, std::vector<Message>& delivered);
+    bool acknowledgeLocked(uint64_t messageID, std::vector<MessageOutcome>& outcomes);
+    bool failLocked(uint64_t messageID, std::vector<Message>& frames, std::vector<MessageOutcome>& outcomes);
+    void scheduleRetryLocked(SendChannel& channel, const ReliableMessage& reliableMsg);
+    void recordRttLocked(SendChannel& channel, uint64_t rttMicros);
+    void fillSendWindow(NodeID peerID, SendChannel& channel, std::vector<Message>& frames);
+    Message buildFrame(const ReliableMessage& reliableMsg, uint64_t base);
+    Message buildAck(NodeID peerID, ReceiveChannel& channel);
+    void appendAckBlock(std::vector<uint8_t>& buffer, ReceiveChannel& channel);
+    uint64_t sendBase(const SendChannel& channel) const;
+    std::chrono::milliseconds currentRto(const SendChannel& channel) const;
+    std::chrono::milliseconds backOff(std::chrono::milliseconds timeout);
+    
+    // Called without pendingMessagesMutex_ held
+    bool transmit(NodeID peerID, const Message& frame);
+    void applyAck(NodeID peerID, const uint8_t* data, size_t size);
+    void timerLoop();
 };
 
 } // namespace P2POverlay
@@ -0,0 +1,102 @@
+#ifndef SWARM_SCHEDULER_H
+#define SWARM_SCHEDULER_H
+
+#include "Common.h"
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+
+namespace P2POverlay {
+
+/**
+ * One chunk to request from one source
+ */
+struct SwarmRequest {
+    NodeID sourceID;
+    uint32_t chunk;
+};
+
+/**
+ * Decides which chunk of a multi-source download to request from which
+ * holder
+ *
+ * Each source gets a request pipeline sized to its measured throughput,
+ * so fast holders carry more of the download. Chunks are picked rarest
+ * first: the ones held by the fewest sources go out before a source that
+ * has them disappears. Requests that outlive their deadline are taken
+ * away from the slow source and rescheduled; once every missing chunk is
+ * requested, idle sources duplicate the oldest outstanding requests so
+ * a single straggler cannot hold up the end of the download.
+ *
+ * Not thread-safe; the owner serializes access.
+ */
+class SwarmScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    SwarmScheduler(uint32_t totalChunks, size_t chunkSize);
+    
+    // Sources; an empty bitmap means the source has every chunk
+    void addSource(NodeID sourceID, const std::vector<bool>& have = std::vector<bool>());
+    void removeSource(NodeID sourceID);
+    void onHave(NodeID sourceID, uint32_t chunk);
+    
+    // Requests to send now; they count as outstanding from this call on
+    std::vector<SwarmRequest> schedule(Clock::time_point now);
+    
+    // Returns false for a chunk that was already received
+    bool onChunkReceived(NodeID sourceID, uint32_t chunk, size_t bytes, Clock::time_point now);
+    
+    // A chunk from this source failed verification: it is asked for elsewhere
+    void onChunkRejected(NodeID sourceID, uint32_t chunk);
+    
+    // Drops requests past their deadline; returns how many were dropped
+    size_t expire(Clock::time_point now);
+    
+    // Queries
+    bool isComplete() const { return receivedCount_ == totalChunks_; }
+    uint32_t getReceivedCount() const { return receivedCount_; }
+    size_t getOutstanding(NodeID sourceID) const;
+    size_t getPipelineDepth(NodeID sourceID) const;
+    double getSourceRate(NodeID sourceID) const;
+    size_t getSourceCount() const { return sources_.size(); }
+    size_t getReassignments() const { return reassignments_; }
+    
+private:
+    struct Source {
+        std::vector<bool> have;      // Empty: has everything
+        size_t outstanding = 0;
+        double bytesPerSecond = 0;   // Smoothed delivery rate, 0 until measured
+        Clock::time_point lastDelivery;
+        size_t delivered = 0;
+        size_t timeouts = 0;
+        size_t rejected = 0;
+    };
+    
+    struct Outstanding {
+        NodeID sourceID;
+        Clock::time_point requested;
+        Clock::time_point deadline;
+    };
+    
+    uint32_t totalChunks_;
+    size_t chunkSize_;
+    uint32_t receivedCount_;
+    size_t reassignments_;
+    std::vector<bool> received_;
+    std::vector<uint32_t> availability_;                 // Sources holding each chunk
+    std::map<uint32_t, std::set<uint32_t>> unrequested_; // Availability -> missing, unrequested chunks
+    std::map<uint32_t, std::vector<Outstanding>> outstanding_;
+    std::map<NodeID, Source> sources_;
+    
+    bool hasChunk(const Source& source, uint32_t chunk) const;
+    void setAvailability(uint32_t chunk, uint32_t availability);
+    void request(NodeID sourceID, Source& source, uint32_t chunk, Clock::time_point now,
+                 std::vector<SwarmRequest>& requests);
+    void dropRequest(uint32_t chunk, std::vector<Outstanding>::iterator it);
+};
+
+} // namespace P2POverlay
+
+#endif // SWARM_SCHEDULER_H
@@ -0,0 +1,200 @@
+#ifndef SWIM_MEMBERSHIP_H
+#define SWIM_MEMBERSHIP_H
+
+#include "Common.h"
+#include "Node.h"
+#include "NetworkManager.h"
+#include "TopologyManager.h"
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <atomic>
+
+namespace P2POverlay {
+
+/**
+ * How a node establishes liveness of its peers
+ */
+enum class MembershipMode {
+    HEARTBEAT,   // Periodic heartbeat to every peer
+    SWIM         // One randomized probe per protocol period
+};
+
+/**
+ * Member status as seen by the SWIM protocol
+ */
+enum class MemberStatus : uint8_t {
+    ALIVE = 0,
+    SUSPECT = 1,
+    DEAD = 2
+};
+
+/**
+ * Membership information for a single member
+ */
+struct SwimMember {
+    NodeID nodeID;
+    NetworkAddress address;
+    MemberStatus status;
+    uint32_t incarnation;
+    std::chrono::steady_clock::time_point stateChangeTime;
+    
+    SwimMember() : nodeID(0), status(MemberStatus::ALIVE), incarnation(0) {}
+};
+
+/**
+ * Membership change disseminated by piggybacking on protocol traffic
+ */
+struct MembershipUpdate {
+    NodeID nodeID;
+    NetworkAddress address;
+    MemberStatus status;
+    uint32_t incarnation;
+    
+    MembershipUpdate() : nodeID(0), status(MemberStatus::ALIVE), incarnation(0) {}
+};
+
+/**
+ * SWIM-style membership and failure detection (Das et al.)
+ *
+ * Each protocol period probes a single member chosen round-robin from a
+ * shuffled list. If the direct probe is not acknowledged in time, k other
+ * members probe it on our behalf (ping-req). Unconfirmed members become
+ * SUSPECT and are declared DEAD after a suspicion timeout unless they
+ * refute it with a higher incarnation. Membership updates ride on probe
+ * traffic, so per-node overhead is constant in the cluster size.
+ */
+class SwimMembership {
+public:
+    SwimMembership(
+        std::shared_ptr<Node> node,
+        std::shared_ptr<NetworkManager> networkManager,
+        std::shared_ptr<TopologyManager> topologyManager
+    );
+    ~SwimMembership();
+    
+    // Membership
+    bool addMember(NodeID nodeID, const NetworkAddress& address);
+    bool removeMember(NodeID nodeID);
+    std::vector<SwimMember> getMembers() const;
+    MemberStatus getMemberStatus(NodeID nodeID) const;
+    size_t getAliveMemberCount() const;
+    uint32_t getIncarnation() const;
+    
+    // Protocol driver, call at least every few hundred milliseconds
+    void tick();
+    
+    // Message handling
+    void handleMessage(const Message& message);
+    void handlePing(const Message& message);
+    void handlePingRequest(const Message& message);
+    void handleAck(const Message& message);
+    
+    // Piggybacked dissemination
+    std::vector<uint8_t> collectPiggyback(size_t maxUpdates = SWIM_MAX_PIGGYBACK_UPDATES);
+    void applyPiggyback(NodeID senderID, const std::vector<uint8_t>& data);
+    
+    // Configuration
+    void setProtocolPeriodMs(int periodMs) { protocolPeriodMs_ = periodMs; }
+    void setPingTimeoutMs(int timeoutMs) { pingTimeoutMs_ = timeoutMs; }
+    void setIndirectProbeCount(size_t count) { indirectProbeCount_ = count; }
+    void setSuspicionMultiplier(int multiplier) { suspicionMultiplier_ = multiplier; }
+    
+    // Probes leave through NetworkManager::sendMessageToPeer unless
+    // overridden; a member that is not a neighbour needs a routed transport
+    void setTransport(std::function<bool(NodeID, const Message&)> transport);
+    
+    // Callbacks
+    void setOnMemberJoinedCallback(std::function<void(NodeID, const NetworkAddress&)> callback);
+    void setOnMemberSuspectedCallback(std::function<void(NodeID)> callback);
+    void setOnMemberFailedCallback(std::function<void(NodeID)> callback);
+    
+    // Statistics
+    size_t getProbesSent() const { return probesSent_; }
+    size_t getIndirectProbesSent() const { return indirectProbesSent_; }
+    size_t getFailedProbes() const { return failedProbes_; }
+    
+private:
+    std::shared_ptr<Node> node_;
+    std::shared_ptr<NetworkManager> networkManager_;
+    std::shared_ptr<TopologyManager> topologyManager_;
+    
+    // Member list and probe order
+    mutable std::mutex membersMutex_;
+    std::map<NodeID, SwimMember> members_;
+    std::set<NodeID> suspects_;
+    std::vector<NodeID> probeOrder_;
+    size_t probeIndex_;
+    uint32_t incarnation_;
+    std::mt19937_64 random_;
+    
+    // Outstanding probe for the current protocol period
+    struct ProbeState {
+        bool active;
+        NodeID target;
+        uint64_t sequence;
+        bool indirectSent;
+        bool acknowledged;
+        bool unsent;       // The direct probe could not be sent
+        std::chrono::steady_clock::time_point periodStart;
+        
+        ProbeState() : active(false), target(0), sequence(0), indirectSent(false), acknowledged(false),
+                       unsent(false) {}
+    };
+    ProbeState probe_;
+    uint64_t nextSequence_;
+    
+    // Dissemination buffer: latest update per member and its send count
+    struct PendingUpdate {
+        MembershipUpdate update;
+        int transmissions;
+    };
+    std::map<NodeID, PendingUpdate> pendingUpdates_;
+    
+    // Configuration
+    int protocolPeriodMs_;
+    int pingTimeoutMs_;
+    size_t indirectProbeCount_;
+    int suspicionMultiplier_;
+    
+    // Callbacks
+    std::function<bool(NodeID, const Message&)> transport_;
+    std::function<void(NodeID, const NetworkAddress&)> onMemberJoined_;
+    std::function<void(NodeID)> onMemberSuspected_;
+    std::function<void(NodeID)> onMemberFailed_;
+    
+    // Statistics
+    std::atomic<size_t> probesSent_;
+    std::atomic<size_t> indirectProbesSent_;
+    std::atomic<size_t> failedProbes_;
+    
+    // Internal methods (caller must hold membersMutex_ unless noted)
+    NodeID selectProbeTarget();
+    std::vector<NodeID> selectIndirectHelpers(NodeID target, size_t count);
+    void markSuspect(NodeID nodeID, std::vector<NodeID>& suspected);
+    void expireSuspects(std::chrono::steady_clock::time_point now, std::vector<NodeID>& failed);
+    bool applyUpdate(const MembershipUpdate& update, std::vector<NodeID>& joined,
+                     std::vector<NodeID>& suspected, std::vector<NodeID>& failed);
+    void queueUpdate(const MembershipUpdate& update);
+    void insertIntoProbeOrder(NodeID nodeID);
+    int maxTransmissions() const;
+    std::chrono::milliseconds suspicionTimeout() const;
+    void appendPiggyback(std::vector<uint8_t>& buffer, size_t maxUpdates);
+    Message createProbeMessage(MessageType type, NodeID receiverID, uint64_t sequence,
+                               NodeID target, NodeID requester);
+    
+    // Called without membersMutex_ held
+    bool transmit(const Message& message);
+    void processPiggyback(const uint8_t* data, size_t size);
+    void notifyChanges(const std::vector<NodeID>& joined, const std::vector<NodeID>& suspected,
+                       const std::vector<NodeID>& failed);
+};
+
+} // namespace P2POverlay
+
+#endif // SWIM_MEMBERSHIP_H
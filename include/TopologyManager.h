@@ -23,6 +23,8 @@ public:
     bool addNode(NodeID nodeID, const NetworkAddress& address);
     bool removeNode(NodeID nodeID);
     bool updateNodeAddress(NodeID nodeID, const NetworkAddress& newAddress);
+    size_t applyBatch(const std::vector<std::pair<NodeID, NetworkAddress>>& addedNodes,
+                      const std::vector<NodeID>& removedNodes);
     
     // Node discovery
     std::vector<NodeID> discoverPeers(NodeID requestingNodeID, int maxPeers = MAX_PEERS);
@@ -68,6 +70,11 @@ private:
     void removeNodeFromGraph(NodeID nodeID);
     void addEdge(NodeID from, NodeID to);
     void removeEdge(NodeID from, NodeID to);
+    
+    // Caller must hold topologyMutex_
+    bool addNodeLocked(NodeID nodeID, const NetworkAddress& address);
+    void validateTopologyLocked();
+    bool isTopologyConnectedLocked() const;
 };
 
 } // namespace P2POverlay
@@ -0,0 +1,79 @@
+#ifndef TRANSFER_JOURNAL_H
+#define TRANSFER_JOURNAL_H
+
+#include "Common.h"
+#include "MerkleTree.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+namespace P2POverlay {
+
+/**
+ * Progress of one incoming transfer as last checkpointed
+ */
+struct JournalEntry {
+    uint64_t transferID;
+    NodeID sourceID;
+    uint64_t totalSize;          // 0 until the last chunk has arrived
+    MerkleHash root;
+    bool rootKnown;
+    std::vector<bool> received;  // One bit per chunk, written to disk packed
+    
+    JournalEntry() : transferID(0), sourceID(0), totalSize(0), root(), rootKnown(false) {}
+};
+
+/**
+ * On-disk state of incoming pushes, so a restart resumes them
+ *
+ * Each transfer has a partial file that chunks are written into at
+ * their offset, and a bitmap file naming the chunks known to be in it.
+ * A checkpoint flushes the partial file before it replaces the bitmap
+ * (write, fsync, rename), so the bitmap never claims a chunk that a
+ * crash could have lost; chunks written after the last checkpoint are
+ * simply fetched again.
+ */
+class TransferJournal {
+public:
+    explicit TransferJournal(const std::string& directory);
+    ~TransferJournal();
+    
+    // Lifecycle: open loads every transfer with a valid bitmap
+    bool open(std::vector<JournalEntry>& recovered);
+    void close();
+    
+    // Per-transfer files; writes to a transfer that was not begun fail
+    bool begin(uint64_t transferID);
+    bool writeChunk(uint64_t transferID, uint64_t offset, const uint8_t* data, size_t size);
+    bool checkpoint(const JournalEntry& entry, uint32_t receivedCount);
+    bool readData(uint64_t transferID, std::vector<uint8_t>& data) const;
+    void remove(uint64_t transferID);
+    
+    // Statistics
+    size_t getOpenTransferCount() const;
+    size_t getCheckpointCount() const { return checkpoints_; }
+    
+private:
+    std::string directory_;
+    
+    // Open partial files and the chunk count their bitmap last recorded
+    struct OpenTransfer {
+        int fd;
+        uint32_t checkpointed;
+    };
+    
+    mutable std::mutex mutex_;
+    std::map<uint64_t, OpenTransfer> open_;
+    
+    std::atomic<size_t> checkpoints_;
+    
+    std::string dataPath(uint64_t transferID) const;
+    std::string bitmapPath(uint64_t transferID) const;
+    bool loadBitmap(const std::string& path, JournalEntry& entry) const;
+};
+
+} // namespace P2POverlay
+
+#endif // TRANSFER_JOURNAL_H
@@ -0,0 +1,102 @@
+#ifndef TRANSFER_SCHEDULER_H
+#define TRANSFER_SCHEDULER_H
+
+#include "Common.h"
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+
+namespace P2POverlay {
+
+/**
+ * Traffic class of an outgoing transfer; higher classes are admitted
+ * first and get a larger share of the link once running
+ */
+enum class TransferPriority {
+    BACKGROUND = 0,
+    NORMAL = 1,
+    INTERACTIVE = 2
+};
+
+/**
+ * Admission and chunk interleaving for outgoing transfers
+ *
+ * At most maxActive transfers run at once. The rest wait in one queue per
+ * class and destination: the highest class with anything waiting goes
+ * first, its destinations take turns, and within a destination the
+ * smallest transfer is admitted first, so a burst of small transfers is
+ * not stuck behind a large one. A transfer passed over by smaller ones
+ * DATA_SCHEDULER_MAX_BYPASS times is admitted next regardless of size.
+ *
+ * Running transfers share the link by deficit round robin: each turn a
+ * transfer earns its class weight times DATA_SCHEDULER_QUANTUM bytes of
+ * credit and sends chunks while the credit covers them. A transfer that
+ * cannot send right now is passed over without earning credit, so
+ * credit never piles up beyond one quantum and one chunk.
+ *
+ * Not thread-safe; the owner serializes access.
+ */
+class TransferScheduler {
+public:
+    explicit TransferScheduler(size_t maxActive);
+    
+    // Admission
+    void setMaxActive(size_t maxActive) { maxActive_ = std::max<size_t>(maxActive, 1); }
+    size_t getMaxActive() const { return maxActive_; }
+    void enqueue(uint64_t transferID, NodeID destinationID, TransferPriority priority, size_t totalSize);
+    std::vector<uint64_t> admit();
+    bool setPriority(uint64_t transferID, TransferPriority priority);
+    void remove(uint64_t transferID);
+    
+    // Next running transfer to send a chunk; readyBytes gives the size of
+    // a transfer's next chunk, or 0 if it cannot send one now
+    uint64_t next(const std::function<size_t(uint64_t)>& readyBytes);
+    
+    // State
+    bool contains(uint64_t transferID) const { return queued_.count(transferID) != 0; }
+    bool isActive(uint64_t transferID) const;
+    std::vector<uint64_t> getActive() const;
+    size_t getActiveCount() const { return active_.size(); }
+    size_t getWaitingCount() const { return queued_.size() - active_.size(); }
+    
+    static size_t weight(TransferPriority priority);
+    
+private:
+    size_t maxActive_;
+    uint64_t arrivals_;
+    
+    struct Waiting {
+        uint64_t transferID;
+        size_t totalSize;
+        uint64_t arrival;
+        size_t bypassed;
+    };
+    
+    // Waiting transfers by class (highest last) and destination, with
+    // the destination each class served last
+    std::map<TransferPriority, std::map<NodeID, std::vector<Waiting>>> waiting_;
+    std::map<TransferPriority, NodeID> lastDestination_;
+    
+    struct Running {
+        uint64_t transferID;
+        TransferPriority priority;
+        size_t deficit;
+    };
+    std::vector<Running> active_;
+    size_t cursor_;
+    
+    // Every transfer known to the scheduler, running or waiting
+    struct Entry {
+        NodeID destinationID;
+        TransferPriority priority;
+    };
+    std::map<uint64_t, Entry> queued_;
+    
+    bool admitOne();
+    void removeWaiting(uint64_t transferID, const Entry& entry);
+};
+
+} // namespace P2POverlay
+
+#endif // TRANSFER_SCHEDULER_H
@@ -0,0 +1,277 @@
+#include "Checksum.h"
+#include <cstring>
+#include <algorithm>
+
+// The SSE4.2 and SHA kernels are compiled for their instructions whatever
+// the build targets, and picked at run time when the CPU has them
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define P2P_HAVE_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace P2POverlay {
+
+namespace {
+
+constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;  // Reflected 0x1EDC6F41
+
+struct Crc32cTables {
+    uint32_t table[8][256];
+    
+    Crc32cTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int slice = 1; slice < 8; ++slice) {
+                uint32_t previous = table[slice - 1][i];
+                table[slice][i] = (previous >> 8) ^ table[0][previous & 0xFF];
+            }
+        }
+    }
+};
+
+const Crc32cTables& tables() {
+    static const Crc32cTables instance;
+    return instance;
+}
+
+// Both kernels take and return the inverted CRC
+uint32_t crc32cPortable(const uint8_t* bytes, size_t size, uint32_t crc) {
+    const Crc32cTables& t = tables();
+    
+    // Slicing-by-8: one table lookup per byte, eight bytes per step
+    while (size >= 8) {
+        uint32_t low;
+        uint32_t high;
+        std::memcpy(&low, bytes, sizeof(low));
+        std::memcpy(&high, bytes + 4, sizeof(high));
+        low ^= crc;
+        crc = t.table[7][low & 0xFF] ^ t.table[6][(low >> 8) & 0xFF] ^
+              t.table[5][(low >> 16) & 0xFF] ^ t.table[4][low >> 24] ^
+              t.table[3][high & 0xFF] ^ t.table[2][(high >> 8) & 0xFF] ^
+              t.table[1][(high >> 16) & 0xFF] ^ t.table[0][high >> 24];
+        bytes += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *bytes++) & 0xFF];
+        size--;
+    }
+    return crc;
+}
+
+#ifdef P2P_HAVE_X86_DISPATCH
+__attribute__((target("sse4.2")))
+uint32_t crc32cInstruction(const uint8_t* bytes, size_t size, uint32_t crc) {
+    while (size >= sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        crc = static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+        bytes += sizeof(word);
+        size -= sizeof(word);
+    }
+    while (size > 0) {
+        crc = _mm_crc32_u8(crc, *bytes++);
+        size--;
+    }
+    return crc;
+}
+#endif
+
+using Crc32cKernel = uint32_t (*)(const uint8_t*, size_t, uint32_t);
+
+Crc32cKernel selectCrc32c() {
+#ifdef P2P_HAVE_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        return crc32cInstruction;
+    }
+#endif
+    return crc32cPortable;
+}
+
+} // namespace
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+    static const Crc32cKernel kernel = selectCrc32c();
+    return ~kernel(static_cast<const uint8_t*>(data), size, ~crc);
+}
+
+namespace {
+
+const uint32_t SHA256_ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#ifdef P2P_HAVE_X86_DISPATCH
+__attribute__((target("sha,sse4.1")))
+void sha256BlocksInstructions(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    
+    // The instructions keep the state as ABEF / CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+    
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i savedAbef = state0;
+        __m128i savedCdgh = state1;
+        __m128i w[4];
+        
+        // Four rounds per step; the schedule for later steps is computed alongside
+        for (int step = 0; step < 16; ++step) {
+            __m128i& current = w[step % 4];
+            if (step < 4) {
+                current = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * step)), byteSwap);
+            }
+            
+            __m128i message = _mm_add_epi32(current,
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(&SHA256_ROUND_CONSTANTS[4 * step])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+            if (step >= 3 && step < 15) {
+                __m128i& next = w[(step + 1) % 4];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(current, w[(step + 3) % 4], 4));
+                next = _mm_sha256msg2_epu32(next, current);
+            }
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0E));
+            if (step >= 1 && step < 13) {
+                w[(step + 3) % 4] = _mm_sha256msg1_epu32(w[(step + 3) % 4], current);
+            }
+        }
+        
+        state0 = _mm_add_epi32(state0, savedAbef);
+        state1 = _mm_add_epi32(state1, savedCdgh);
+    }
+    
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), _mm_alignr_epi8(state1, tmp, 8));
+}
+#endif
+
+inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+void sha256BlocksPortable(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t(data[4 * i]) << 24) | (uint32_t(data[4 * i + 1]) << 16) |
+                   (uint32_t(data[4 * i + 2]) << 8) | uint32_t(data[4 * i + 3]);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+                          SHA256_ROUND_CONSTANTS[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+using Sha256Kernel = void (*)(uint32_t*, const uint8_t*, size_t);
+
+Sha256Kernel selectSha256() {
+#ifdef P2P_HAVE_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) {
+        return sha256BlocksInstructions;
+    }
+#endif
+    return sha256BlocksPortable;
+}
+
+void sha256Blocks(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    static const Sha256Kernel kernel = selectSha256();
+    kernel(state, data, blocks);
+}
+
+} // namespace
+
+Sha256::Sha256() : buffered_(0), length_(0) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    std::memcpy(state_, initial, sizeof(state_));
+}
+
+void Sha256::update(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    length_ += size;
+    
+    if (buffered_ > 0) {
+        size_t take = std::min(size, sizeof(buffer_) - buffered_);
+        std::memcpy(buffer_ + buffered_, bytes, take);
+        buffered_ += take;
+        bytes += take;
+        size -= take;
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+        sha256Blocks(state_, buffer_, 1);
+        buffered_ = 0;
+    }
+    
+    // Whole blocks straight from the caller's buffer
+    sha256Blocks(state_, bytes, size / 64);
+    bytes += size - size % 64;
+    buffered_ = size % 64;
+    std::memcpy(buffer_, bytes, buffered_);
+}
+
+void Sha256::finish(uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint64_t bits = length_ * 8;
+    uint8_t padding[72] = {0x80};
+    size_t padLength = (buffered_ < 56 ? 56 : 120) - buffered_;
+    for (int i = 0; i < 8; ++i) {
+        padding[padLength + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    update(padding, padLength + 8);
+    
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = static_cast<uint8_t>(state_[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(state_[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(state_[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(state_[i]);
+    }
+}
+
+void sha256(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    Sha256 hash;
+    hash.update(data, size);
+    hash.finish(digest);
+}
+
+} // namespace P2POverlay
@@ -0,0 +1,237 @@
+#include "ChunkFormat.h"
+#include "Checksum.h"
+#include <cstring>
+
+namespace P2POverlay {
+
+namespace {
+
+uint8_t* writeBytes(uint8_t* out, const void* data, size_t size) {
+    std::memcpy(out, data, size);
+    return out + size;
+}
+
+const uint8_t* readBytes(const uint8_t* in, void* out, size_t size) {
+    std::memcpy(out, in, size);
+    return in + size;
+}
+
+} // namespace
+
+void encodeChunkHeader(const ChunkHeader& header, uint8_t* out) {
+    out = writeBytes(out, &header.transferID, sizeof(header.transferID));
+    out = writeBytes(out, &header.sequence, sizeof(header.sequence));
+    out = writeBytes(out, &header.totalChunks, sizeof(header.totalChunks));
+    out = writeBytes(out, &header.flags, sizeof(header.flags));
+    out = writeBytes(out, &header.offset, sizeof(header.offset));
+    out = writeBytes(out, &header.length, sizeof(header.length));
+    if (header.flags & CHUNK_FLAG_DIGEST) {
+        out = writeBytes(out, &header.digest, sizeof(header.digest));
+    }
+    if (header.flags & CHUNK_FLAG_PARITY) {
+        out = writeBytes(out, &header.groupChunks, sizeof(header.groupChunks));
+        out = writeBytes(out, &header.parityChunks, sizeof(header.parityChunks));
+        out = writeBytes(out, &header.parityIndex, sizeof(header.parityIndex));
+        out = writeBytes(out, &header.totalSize, sizeof(header.totalSize));
+    }
+    if (header.flags & CHUNK_FLAG_PROOF) {
+        uint8_t count = static_cast<uint8_t>(header.proof.size());
+        out = writeBytes(out, header.root.data(), header.root.size());
+        out = writeBytes(out, &count, sizeof(count));
+        for (const MerkleHash& sibling : header.proof) {
+            out = writeBytes(out, sibling.data(), sibling.size());
+        }
+    }
+}
+
+void setChunkDigest(ChunkHeader& header, const uint8_t* payload, bool enabled) {
+    if (enabled) {
+        header.flags |= CHUNK_FLAG_DIGEST;
+        header.digest = crc32c(payload, header.length);
+    } else {
+        header.flags &= static_cast<uint8_t>(~CHUNK_FLAG_DIGEST);
+        header.digest = 0;
+    }
+}
+
+bool decodeChunk(const uint8_t* data, size_t size, ChunkView& view) {
+    if (size < CHUNK_HEADER_SIZE) {
+        return false;
+    }
+    
+    ChunkHeader& header = view.header;
+    const uint8_t* in = data;
+    in = readBytes(in, &header.transferID, sizeof(header.transferID));
+    in = readBytes(in, &header.sequence, sizeof(header.sequence));
+    in = readBytes(in, &header.totalChunks, sizeof(header.totalChunks));
+    in = readBytes(in, &header.flags, sizeof(header.flags));
+    in = readBytes(in, &header.offset, sizeof(header.offset));
+    in = readBytes(in, &header.length, sizeof(header.length));
+    
+    header.digest = 0;
+    header.groupChunks = 0;
+    header.parityChunks = 0;
+    header.parityIndex = 0;
+    header.totalSize = 0;
+    header.proof.clear();
+    if (header.flags & CHUNK_FLAG_DIGEST) {
+        if (size < CHUNK_HEADER_SIZE + sizeof(header.digest)) {
+            return false;
+        }
+        in = readBytes(in, &header.digest, sizeof(header.digest));
+    }
+    if (header.flags & CHUNK_FLAG_PARITY) {
+        if (static_cast<size_t>(data + size - in) < CHUNK_PARITY_FIELDS_SIZE) {
+            return false;
+        }
+        in = readBytes(in, &header.groupChunks, sizeof(header.groupChunks));
+        in = readBytes(in, &header.parityChunks, sizeof(header.parityChunks));
+        in = readBytes(in, &header.parityIndex, sizeof(header.parityIndex));
+        in = readBytes(in, &header.totalSize, sizeof(header.totalSize));
+        if (header.groupChunks == 0 || header.parityIndex >= header.parityChunks ||
+            header.groupChunks + header.parityChunks > 256) {
+            return false;
+        }
+    }
+    if (header.flags & CHUNK_FLAG_PROOF) {
+        uint8_t count = 0;
+        if (static_cast<size_t>(data + size - in) < SHA256_DIGEST_SIZE + sizeof(count)) {
+            return false;
+        }
+        in = readBytes(in, header.root.data(), header.root.size());
+        in = readBytes(in, &count, sizeof(count));
+        if (static_cast<size_t>(data + size - in) < count * SHA256_DIGEST_SIZE) {
+            return false;
+        }
+        header.proof.resize(count);
+        for (MerkleHash& sibling : header.proof) {
+            in = readBytes(in, sibling.data(), sibling.size());
+        }
+    }
+    
+    size_t headerSize = header.encodedSize();
+    if (size < headerSize || size - headerSize != header.length ||
+        header.sequence >= header.totalChunks) {
+        return false;
+    }
+    
+    view.payload = data + headerSize;
+    view.payloadSize = header.length;
+    
+    // Corruption the transport checksum missed, or a buggy relay
+    return !(header.flags & CHUNK_FLAG_DIGEST) || crc32c(view.payload, view.payloadSize) == header.digest;
+}
+
+std::vector<uint8_t> encodeChunkRequest(const ChunkRequest& request) {
+    // Missing chunks of a resumed transfer are mostly long runs
+    std::vector<std::pair<uint32_t, uint32_t>> runs;
+    for (uint32_t chunk : request.chunks) {
+        if (!runs.empty() && runs.back().first + runs.back().second == chunk && runs.back().second < UINT32_MAX) {
+            runs.back().second++;
+        } else {
+            runs.emplace_back(chunk, 1);
+        }
+    }
+    
+    uint32_t count = static_cast<uint32_t>(runs.size());
+    std::vector<uint8_t> data(sizeof(uint64_t) + 2 * sizeof(uint32_t) + count * 2 * sizeof(uint32_t));
+    uint8_t* out = data.data();
+    out = writeBytes(out, &request.contentID, sizeof(request.contentID));
+    out = writeBytes(out, &request.chunkSize, sizeof(request.chunkSize));
+    out = writeBytes(out, &count, sizeof(count));
+    for (const auto& run : runs) {
+        out = writeBytes(out, &run.first, sizeof(run.first));
+        out = writeBytes(out, &run.second, sizeof(run.second));
+    }
+    return data;
+}
+
+bool decodeChunkRequest(const uint8_t* data, size_t size, ChunkRequest& request) {
+    const size_t fixed = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    const size_t runSize = 2 * sizeof(uint32_t);
+    if (size < fixed) {
+        return false;
+    }
+    
+    uint32_t count = 0;
+    const uint8_t* in = data;
+    in = readBytes(in, &request.contentID, sizeof(request.contentID));
+    in = readBytes(in, &request.chunkSize, sizeof(request.chunkSize));
+    in = readBytes(in, &count, sizeof(count));
+    if ((size - fixed) / runSize != count || (size - fixed) % runSize != 0) {
+        return false;
+    }
+    
+    request.chunks.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t first = 0;
+        uint32_t length = 0;
+        in = readBytes(in, &first, sizeof(first));
+        in = readBytes(in, &length, sizeof(length));
+        if (length == 0 || length > CHUNK_REQUEST_MAX_CHUNKS - request.chunks.size() ||
+            first > UINT32_MAX - (length - 1)) {
+            return false;
+        }
+        for (uint32_t j = 0; j < length; ++j) {
+            request.chunks.push_back(first + j);
+        }
+    }
+    return true;
+}
+
+std::vector<uint8_t> encodeTransferResume(const TransferResume& resume) {
+    uint8_t accepted = resume.accepted ? 1 : 0;
+    std::vector<uint8_t> data(2 * sizeof(uint64_t) + sizeof(accepted) + sizeof(uint32_t));
+    uint8_t* out = data.data();
+    out = writeBytes(out, &resume.transferID, sizeof(resume.transferID));
+    out = writeBytes(out, &accepted, sizeof(accepted));
+    out = writeBytes(out, &resume.totalSize, sizeof(resume.totalSize));
+    writeBytes(out, &resume.chunkCount, sizeof(resume.chunkCount));
+    return data;
+}
+
+bool decodeTransferResume(const uint8_t* data, size_t size, TransferResume& resume) {
+    uint8_t accepted = 0;
+    if (size != 2 * sizeof(uint64_t) + sizeof(accepted) + sizeof(uint32_t)) {
+        return false;
+    }
+    
+    const uint8_t* in = data;
+    in = readBytes(in, &resume.transferID, sizeof(resume.transferID));
+    in = readBytes(in, &accepted, sizeof(accepted));
+    in = readBytes(in, &resume.totalSize, sizeof(resume.totalSize));
+    readBytes(in, &resume.chunkCount, sizeof(resume.chunkCount));
+    resume.accepted = accepted != 0;
+    return true;
+}
+
+std::vector<uint8_t> encodeTransferSetup(const TransferSetup& setup) {
+    std::vector<uint8_t> data(2 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + SHA256_DIGEST_SIZE + sizeof(uint32_t));
+    uint8_t* out = data.data();
+    out = writeBytes(out, &setup.transferID, sizeof(setup.transferID));
+    out = writeBytes(out, &setup.totalSize, sizeof(setup.totalSize));
+    out = writeBytes(out, &setup.chunkSize, sizeof(setup.chunkSize));
+    out = writeBytes(out, &setup.totalChunks, sizeof(setup.totalChunks));
+    out = writeBytes(out, setup.root.data(), setup.root.size());
+    uint32_t check = crc32c(data.data(), static_cast<size_t>(out - data.data()));
+    writeBytes(out, &check, sizeof(check));
+    return data;
+}
+
+bool decodeTransferSetup(const uint8_t* data, size_t size, TransferSetup& setup) {
+    if (size != 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + SHA256_DIGEST_SIZE + sizeof(uint32_t)) {
+        return false;
+    }
+    
+    const uint8_t* in = data;
+    in = readBytes(in, &setup.transferID, sizeof(setup.transferID));
+    in = readBytes(in, &setup.totalSize, sizeof(setup.totalSize));
+    in = readBytes(in, &setup.chunkSize, sizeof(setup.chunkSize));
+    in = readBytes(in, &setup.totalChunks, sizeof(setup.totalChunks));
+    in = readBytes(in, setup.root.data(), setup.root.size());
+    uint32_t check = 0;
+    readBytes(in, &check, sizeof(check));
+    return check == crc32c(data, static_cast<size_t>(in - data));
+}
+
+} // namespace P2POverlay
@@ -0,0 +1,80 @@
+#include "ChunkSizer.h"
+#include <algorithm>
+
+namespace P2POverlay {
+
+ChunkSizer::ChunkSizer(size_t minChunkSize, size_t maxChunkSize)
+    : minChunkSize_(DATA_MIN_CHUNK_SIZE), maxChunkSize_(DATA_MAX_CHUNK_SIZE) {
+    setLimits(minChunkSize, maxChunkSize);
+}
+
+void ChunkSizer::setLimits(size_t minChunkSize, size_t maxChunkSize) {
+    minChunkSize_ = std::max<size_t>(minChunkSize, 1);
+    maxChunkSize_ = std::max(maxChunkSize, minChunkSize_);
+}
+
+size_t ChunkSizer::chooseChunkSize(NodeID destinationID, const PeerStatsSnapshot& stats, size_t window,
+                                   size_t fallback) {
+    PathState& path = paths_[destinationID];
+    double size = static_cast<double>(path.chunkSize > 0 ? path.chunkSize : clamp(static_cast<double>(fallback)));
+    
+    // Loss since the previous sample; a few messages say too little. The
+    // counters restart when the peer's statistics are reset.
+    if (stats.messagesSent < path.messagesSent || stats.retransmissions < path.retransmissions) {
+        path.messagesSent = 0;
+        path.retransmissions = 0;
+    }
+    double sample = 0.0;
+    uint64_t sent = stats.messagesSent - path.messagesSent;
+    if (sent >= DATA_CHUNK_LOSS_SAMPLE) {
+        sample = std::min(1.0, static_cast<double>(stats.retransmissions - path.retransmissions) / sent);
+        path.lossRate = path.messagesSent == 0 ? sample : (path.lossRate + sample) / 2;
+        path.messagesSent = stats.messagesSent;
+        path.retransmissions = stats.retransmissions;
+    }
+    
+    uint64_t rttMicros = stats.rttSamples > 0 ? static_cast<uint64_t>(stats.smoothedRttMs * 1000.0) : 0;
+    if (rttMicros > 0) {
+        path.baseRttMicros = path.baseRttMicros == 0 ? rttMicros : std::min(path.baseRttMicros, rttMicros);
+    }
+    
+    if (path.lossRate > DATA_CHUNK_LOSS_TARGET) {
+        // Shrink only on new losses, so one lossy spell is not counted
+        // twice; a clean spell holds the size until the average recovers
+        if (sample > DATA_CHUNK_LOSS_TARGET) {
+            size *= std::max(DATA_CHUNK_LOSS_TARGET / path.lossRate, 0.25);
+        }
+    } else if (rttMicros > 0 && stats.sendThroughputBps > 0) {
+        // Within half again of the lowest RTT the path is not queueing;
+        // beyond it the window should hold no more than the pipe
+        double fill = stats.sendThroughputBps * rttMicros / 1e6 / std::max<size_t>(window, 1);
+        if (2 * rttMicros <= 3 * path.baseRttMicros) {
+            size *= 2;
+        } else {
+            size = std::max(std::min(size, fill), size / 2);
+        }
+    }
+    
+    path.chunkSize = clamp(size);
+    return path.chunkSize;
+}
+
+void ChunkSizer::removePath(NodeID destinationID) {
+    paths_.erase(destinationID);
+}
+
+size_t ChunkSizer::getLastChunkSize(NodeID destinationID) const {
+    auto it = paths_.find(destinationID);
+    return it != paths_.end() ? it->second.chunkSize : 0;
+}
+
+double ChunkSizer::getLossRate(NodeID destinationID) const {
+    auto it = paths_.find(destinationID);
+    return it != paths_.end() ? it->second.lossRate : 0.0;
+}
+
+size_t ChunkSizer::clamp(double size) const {
+    return std::min(std::max(static_cast<size_t>(size), minChunkSize_), maxChunkSize_);
+}
+
+} // namespace P2POverlay
@@ -0,0 +1,354 @@
+#include "ChunkStore.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace P2POverlay {
+
+namespace {
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Random per-byte values of the gear rolling hash, the same on every node
+const std::array<uint64_t, 256>& gearTable() {
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> values{};
+        uint64_t state = 0x6a09e667f3bcc909ULL;
+        for (auto& value : values) {
+            state += 0x9e3779b97f4a7c15ULL;    // splitmix64
+            value = fmix(state);
+        }
+        return values;
+    }();
+    return table;
+}
+
+constexpr int log2Size(size_t value) {
+    int bits = 0;
+    while (value > 1) {
+        value >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+template <typename T>
+uint8_t* writeValue(uint8_t* out, T value) {
+    std::memcpy(out, &value, sizeof(T));
+    return out + sizeof(T);
+}
+
+template <typename T>
+const uint8_t* readValue(const uint8_t* in, T& value) {
+    std::memcpy(&value, in, sizeof(T));
+    return in + sizeof(T);
+}
+
+} // namespace
+
+ChunkKey hashChunk(const uint8_t* data, size_t size) {
+    // Two 64-bit lanes over 8-byte words, finished with murmur3's mixer
+    uint64_t a = 0x9e3779b97f4a7c15ULL ^ size;
+    uint64_t b = 0xc2b2ae3d27d4eb4fULL + size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        a = rotl(a ^ (word * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+        b = rotl(b + word, 27) * 0x52dce729ULL + a;
+    }
+    
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + i, size - i);
+    a ^= fmix(tail ^ 0xff51afd7ed558ccdULL);
+    b += tail;
+    return ChunkKey(fmix(a + b), fmix(b ^ rotl(a, 17)));
+}
+
+std::vector<uint64_t> ChunkManifest::offsets() const {
+    std::vector<uint64_t> result(sizes.size());
+    uint64_t offset = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        result[i] = offset;
+        offset += sizes[i];
+    }
+    return result;
+}
+
+std::vector<uint8_t> encodeChunkOffer(const ChunkOffer& offer) {
+    uint16_t typeLength = static_cast<uint16_t>(std::min<size_t>(offer.dataType.size(), UINT16_MAX));
+    uint32_t count = static_cast<uint32_t>(offer.manifest.keys.size());
+    std::vector<uint8_t> data(sizeof(uint64_t) + sizeof(uint16_t) + typeLength + sizeof(uint64_t) +
+                              sizeof(uint32_t) + count * (2 * sizeof(uint64_t) + sizeof(uint32_t)));
+    
+    uint8_t* out = data.data();
+    out = writeValue(out, offer.transferID);
+    out = writeValue(out, typeLength);
+    std::memcpy(out, offer.dataType.data(), typeLength);
+    out += typeLength;
+    out = writeValue(out, offer.manifest.totalSize);
+    out = writeValue(out, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        out = writeValue(out, offer.manifest.keys[i].high);
+        out = writeValue(out, offer.manifest.keys[i].low);
+        out = writeValue(out, offer.manifest.sizes[i]);
+    }
+    return data;
+}
+
+bool decodeChunkOffer(const uint8_t* data, size_t size, ChunkOffer& offer) {
+    const uint8_t* end = data + size;
+    uint16_t typeLength = 0;
+    if (size < sizeof(uint64_t) + sizeof(uint16_t)) {
+        return false;
+    }
+    data = readValue(data, offer.transferID);
+    data = readValue(data, typeLength);
+    if (static_cast<size_t>(end - data) < typeLength + sizeof(uint64_t) + sizeof(uint32_t)) {
+        return false;
+    }
+    offer.dataType.assign(reinterpret_cast<const char*>(data), typeLength);
+    data += typeLength;
+    
+    uint32_t count = 0;
+    ChunkManifest& manifest = offer.manifest;
+    data = readValue(data, manifest.totalSize);
+    data = readValue(data, count);
+    const size_t entrySize = 2 * sizeof(uint64_t) + sizeof(uint32_t);
+    if (static_cast<size_t>(end - data) != count * entrySize) {
+        return false;
+    }
+    
+    uint64_t total = 0;
+    manifest.keys.resize(count);
+    manifest.sizes.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        data = readValue(data, manifest.keys[i].high);
+        data = readValue(data, manifest.keys[i].low);
+        data = readValue(data, manifest.sizes[i]);
+        total += manifest.sizes[i];
+    }
+    return total == manifest.totalSize;
+}
+
+ChunkStore::ChunkStore(ChunkingMode mode, size_t capacityBytes)
+    : mode_(mode), capacityBytes_(capacityBytes), storedBytes_(0), duplicateBytes_(0), evictions_(0) {
+}
+
+std::vector<uint32_t> ChunkStore::split(const uint8_t* data, size_t size) const {
+    std::vector<uint32_t> sizes;
+    if (mode_ == ChunkingMode::FIXED) {
+        for (size_t offset = 0; offset < size; offset += CHUNK_STORE_AVERAGE_CHUNK) {
+            sizes.push_back(static_cast<uint32_t>(std::min(CHUNK_STORE_AVERAGE_CHUNK, size - offset)));
+        }
+        return sizes;
+    }
+    
+    // Gear rolling hash: a boundary wherever the top bits of the hash over
+    // the last 64 bytes are zero, which happens once per average chunk
+    const auto& gear = gearTable();
+    const int shift = 64 - log2Size(CHUNK_STORE_AVERAGE_CHUNK);
+    size_t start = 0;
+    while (start < size) {
+        size_t remaining = size - start;
+        if (remaining <= CHUNK_STORE_MIN_CHUNK) {
+            sizes.push_back(static_cast<uint32_t>(remaining));
+            break;
+        }
+        
+        size_t limit = std::min(remaining, CHUNK_STORE_MAX_CHUNK);
+        size_t cut = limit;
+        uint64_t hash = 0;
+        for (size_t i = CHUNK_STORE_MIN_CHUNK - 64; i < limit; ++i) {
+            hash = (hash << 1) + gear[data[start + i]];
+            if (i >= CHUNK_STORE_MIN_CHUNK && (hash >> shift) == 0) {
+                cut = i + 1;
+                break;
+            }
+        }
+        sizes.push_back(static_cast<uint32_t>(cut));
+        start += cut;
+    }
+    return sizes;
+}
+
+ChunkKey ChunkStore::put(const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ChunkKey key = putLocked(data, size);
+    evictLocked();
+    return key;
+}
+
+bool ChunkStore::get(const ChunkKey& key, std::vector<uint8_t>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = chunks_.find(key);
+    if (it == chunks_.end()) {
+        return false;
+    }
+    
+    out = it->second.data;
+    touchLocked(it->second);
+    return true;
+}
+
+bool ChunkStore::read(const ChunkKey& key, size_t offset, uint8_t* buffer, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = chunks_.find(key);
+    if (it == chunks_.end() || offset > it->second.data.size() || length > it->second.data.size() - offset) {
+        return false;
+    }
+    
+    std::memcpy(buffer, it->second.data.data() + offset, length);
+    touchLocked(it->second);
+    return true;
+}
+
+bool ChunkStore::contains(const ChunkKey& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chunks_.count(key) > 0;
+}
+
+bool ChunkStore::addRef(const ChunkKey& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = chunks_.find(key);
+    if (it == chunks_.end()) {
+        return false;
+    }
+    
+    Entry& entry = it->second;
+    if (entry.refs++ == 0) {
+        lru_.erase(entry.lruPosition);
+    }
+    return true;
+}
+
+void ChunkStore::release(const ChunkKey& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = chunks_.find(key);
+    if (it == chunks_.end() || it->second.refs == 0) {
+        return;
+    }
+    
+    Entry& entry = it->second;
+    if (--entry.refs == 0) {
+        entry.lruPosition = lru_.insert(lru_.begin(), key);
+        evictLocked();
+    }
+}
+
+ChunkManifest ChunkStore::storeBlob(const uint8_t* data, size_t size) {
+    ChunkManifest manifest;
+    manifest.totalSize = size;
+    manifest.sizes = split(data, size);
+    manifest.keys.reserve(manifest.sizes.size());
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t offset = 0;
+    for (uint32_t chunkSize : manifest.sizes) {
+        ChunkKey key = putLocked(data + offset, chunkSize);
+        Entry& entry = chunks_[key];
+        if (entry.refs++ == 0) {
+            lru_.erase(entry.lruPosition);
+        }
+        manifest.keys.push_back(key);
+        offset += chunkSize;
+    }
+    evictLocked();
+    return manifest;
+}
+
+bool ChunkStore::assemble(const ChunkManifest& manifest, std::vector<uint8_t>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.resize(static_cast<size_t>(manifest.totalSize));
+    size_t offset = 0;
+    for (size_t i = 0; i < manifest.keys.size(); ++i) {
+        auto it = chunks_.find(manifest.keys[i]);
+        if (it == chunks_.end() || it->second.data.size() != manifest.sizes[i] ||
+            offset + manifest.sizes[i] > out.size()) {
+            return false;
+        }
+        std::memcpy(out.data() + offset, it->second.data.data(), manifest.sizes[i]);
+        touchLocked(it->second);
+        offset += manifest.sizes[i];
+    }
+    return offset == out.size();
+}
+
+void ChunkStore::releaseManifest(const ChunkManifest& manifest) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const ChunkKey& key : manifest.keys) {
+        auto it = chunks_.find(key);
+        if (it != chunks_.end() && it->second.refs > 0 && --it->second.refs == 0) {
+            it->second.lruPosition = lru_.insert(lru_.begin(), key);
+        }
+    }
+    evictLocked();
+}
+
+std::vector<uint32_t> ChunkStore::missing(const ChunkManifest& manifest) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < manifest.keys.size(); ++i) {
+        if (!chunks_.count(manifest.keys[i])) {
+            indices.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return indices;
+}
+
+void ChunkStore::setCapacity(size_t capacityBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacityBytes_ = capacityBytes;
+    evictLocked();
+}
+
+size_t ChunkStore::getChunkCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chunks_.size();
+}
+
+ChunkKey ChunkStore::putLocked(const uint8_t* data, size_t size) {
+    ChunkKey key = hashChunk(data, size);
+    auto it = chunks_.find(key);
+    if (it != chunks_.end()) {
+        duplicateBytes_ += size;
+        touchLocked(it->second);
+        return key;
+    }
+    
+    Entry& entry = chunks_[key];
+    entry.data.assign(data, data + size);
+    entry.lruPosition = lru_.insert(lru_.begin(), key);
+    storedBytes_ += size;
+    return key;
+}
+
+void ChunkStore::touchLocked(Entry& entry) {
+    if (entry.refs == 0) {
+        lru_.splice(lru_.begin(), lru_, entry.lruPosition);
+    }
+}
+
+void ChunkStore::evictLocked() {
+    // Only unpinned chunks are on the list, so the tail is always evictable
+    while (storedBytes_ > capacityBytes_ && !lru_.empty()) {
+        auto it = chunks_.find(lru_.back());
+        storedBytes_ -= it->second.data.size();
+        chunks_.erase(it);
+        lru_.pop_back();
+        evictions_++;
+    }
+}
+
+} // namespace P2POverlay
@@ -0,0 +1,328 @@
+#include "Compression.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(P2P_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace P2POverlay {
+
+namespace {
+
+constexpr size_t LZ4_MIN_MATCH = 4;
+constexpr size_t LZ4_LAST_LITERALS = 5;    // The block always ends in at least this many literals
+constexpr size_t LZ4_MATCH_LIMIT = 12;     // No match starts within this many bytes of the end
+constexpr size_t LZ4_MAX_OFFSET = 65535;
+constexpr int LZ4_HASH_BITS = 14;
+
+constexpr size_t PAYLOAD_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t);
+
+#if defined(P2P_HAVE_ZSTD)
+constexpr int ZSTD_LEVEL = 3;
+#endif
+
+uint32_t read32(const uint8_t* in) {
+    uint32_t value;
+    std::memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+uint64_t read64(const uint8_t* in) {
+    uint64_t value;
+    std::memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+uint32_t hashSequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// Continuation bytes of a length whose token nibble is 15
+uint8_t* writeLength(uint8_t* out, size_t length) {
+    for (; length >= 255; length -= 255) {
+        *out++ = 255;
+    }
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+bool readLength(const uint8_t*& in, const uint8_t* end, size_t& length) {
+    uint8_t byte = 0;
+    do {
+        if (in == end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// One sequence; a match length of 0 makes it the closing literals-only one
+bool writeSequence(uint8_t*& out, const uint8_t* outEnd, const uint8_t* literals, size_t literalLength,
+                   size_t offset, size_t matchLength) {
+    size_t worst = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+    if (static_cast<size_t>(outEnd - out) < worst) {
+        return false;
+    }
+    
+    uint8_t* token = out++;
+    *token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+    if (literalLength >= 15) {
+        out = writeLength(out, literalLength - 15);
+    }
+    if (literalLength > 0) {
+        std::memcpy(out, literals, literalLength);
+        out += literalLength;
+    }
+    if (matchLength == 0) {
+        return true;
+    }
+    
+    *out++ = static_cast<uint8_t>(offset & 0xFF);
+    *out++ = static_cast<uint8_t>(offset >> 8);
+    size_t code = matchLength - LZ4_MIN_MATCH;
+    *token |= static_cast<uint8_t>(std::min<size_t>(code, 15));
+    if (code >= 15) {
+        out = writeLength(out, code - 15);
+    }
+    return true;
+}
+
+size_t encode(CompressionCodec codec, const uint8_t* data, size_t size, uint8_t* out, size_t capacity) {
+    switch (codec) {
+        case CompressionCodec::LZ4:
+            return lz4Compress(data, size, out, capacity);
+#if defined(P2P_HAVE_ZSTD)
+        case CompressionCodec::ZSTD: {
+            size_t written = ZSTD_compress(out, capacity, data, size, ZSTD_LEVEL);
+            return ZSTD_isError(written) ? 0 : written;
+        }
+#endif
+        default:
+            return 0;
+    }
+}
+
+bool decode(CompressionCodec codec, const uint8_t* data, size_t size, uint8_t* out, size_t outSize) {
+    switch (codec) {
+        case CompressionCodec::LZ4:
+            return lz4Decompress(data, size, out, outSize);
+#if defined(P2P_HAVE_ZSTD)
+        case CompressionCodec::ZSTD: {
+            size_t written = ZSTD_decompress(out, outSize, data, size);
+            return !ZSTD_isError(written) && written == outSize;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+bool isCodecAvailable(CompressionCodec codec) {
+#if defined(P2P_HAVE_ZSTD)
+    return codec == CompressionCodec::NONE || codec == CompressionCodec::LZ4 || codec == CompressionCodec::ZSTD;
+#else
+    return codec == CompressionCodec::NONE || codec == CompressionCodec::LZ4;
+#endif
+}
+
+uint8_t acceptedCodecFlags() {
+    return FRAME_FLAG_ACCEPTS_LZ4 | (isCodecAvailable(CompressionCodec::ZSTD) ? FRAME_FLAG_ACCEPTS_ZSTD : 0);
+}
+
+CompressionCodec negotiateCodec(CompressionCodec preferred, uint8_t acceptedFlags) {
+    if (preferred == CompressionCodec::ZSTD && isCodecAvailable(CompressionCodec::ZSTD) &&
+        (acceptedFlags & FRAME_FLAG_ACCEPTS_ZSTD)) {
+        return CompressionCodec::ZSTD;
+    }
+    if (preferred != CompressionCodec::NONE && (acceptedFlags & FRAME_FLAG_ACCEPTS_LZ4)) {
+        return CompressionCodec::LZ4;
+    }
+    return CompressionCodec::NONE;
+}
+
+size_t lz4CompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t lz4Compress(const uint8_t* data, size_t size, uint8_t* out, size_t capacity) {
+    if (size > UINT32_MAX) {
+        return 0;
+    }
+    
+    uint8_t* op = out;
+    const uint8_t* const outEnd = out + capacity;
+    const uint8_t* const end = data + size;
+    const uint8_t* anchor = data;
+    if (size > LZ4_MATCH_LIMIT) {
+        // Last position each 4-byte sequence was seen at; a stale or
+        // colliding entry is caught by comparing the bytes
+        std::vector<uint32_t> table(size_t(1) << LZ4_HASH_BITS, 0);
+        const uint8_t* const searchEnd = end - LZ4_MATCH_LIMIT;
+        const uint8_t* const matchEnd = end - LZ4_LAST_LITERALS;
+        const uint8_t* ip = data;
+        size_t misses = 0;
+        while (ip <= searchEnd) {
+            uint32_t sequence = read32(ip);
+            uint32_t& slot = table[hashSequence(sequence)];
+            const uint8_t* candidate = data + slot;
+            slot = static_cast<uint32_t>(ip - data);
+            if (candidate >= ip || static_cast<size_t>(ip - candidate) > LZ4_MAX_OFFSET || read32(candidate) != sequence) {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            
+            while (ip > anchor && candidate > data && ip[-1] == candidate[-1]) {
+                --ip;
+                --candidate;
+            }
+            const uint8_t* matchStart = ip;
+            ip += LZ4_MIN_MATCH;
+            candidate += LZ4_MIN_MATCH;
+            while (ip + sizeof(uint64_t) <= matchEnd && read64(ip) == read64(candidate)) {
+                ip += sizeof(uint64_t);
+                candidate += sizeof(uint64_t);
+            }
+            while (ip < matchEnd && *ip == *candidate) {
+                ++ip;
+                ++candidate;
+            }
+            
+            if (!writeSequence(op, outEnd, anchor, static_cast<size_t>(matchStart - anchor),
+                               static_cast<size_t>(ip - candidate), static_cast<size_t>(ip - matchStart))) {
+                return 0;
+            }
+            anchor = ip;
+            if (ip <= searchEnd) {
+                table[hashSequence(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - data);
+            }
+        }
+    }
+    
+    if (!writeSequence(op, outEnd, anchor, static_cast<size_t>(end - anchor), 0, 0)) {
+        return 0;
+    }
+    return static_cast<size_t>(op - out);
+}
+
+bool lz4Decompress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize) {
+    const uint8_t* ip = data;
+    const uint8_t* const end = data + size;
+    uint8_t* op = out;
+    uint8_t* const outEnd = out + outSize;
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(ip, end, literalLength)) {
+            return false;
+        }
+        if (literalLength > static_cast<size_t>(end - ip) || literalLength > static_cast<size_t>(outEnd - op)) {
+            return false;
+        }
+        if (literalLength > 0) {
+            std::memcpy(op, ip, literalLength);
+            op += literalLength;
+            ip += literalLength;
+        }
+        if (ip == end) {
+            break;
+        }
+        
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !readLength(ip, end, matchLength)) {
+            return false;
+        }
+        matchLength += LZ4_MIN_MATCH;
+        if (offset == 0 || offset > static_cast<size_t>(op - out) || matchLength > static_cast<size_t>(outEnd - op)) {
+            return false;
+        }
+        
+        // A match closer than its length repeats bytes it is writing
+        const uint8_t* match = op - offset;
+        if (offset >= matchLength) {
+            std::memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            for (size_t i = 0; i < matchLength; ++i) {
+                *op++ = match[i];
+            }
+        }
+    }
+    return op == outEnd;
+}
+
+bool compressPayload(CompressionCodec codec, const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    if (codec == CompressionCodec::NONE || !isCodecAvailable(codec) || size < COMPRESSION_MIN_BYTES ||
+        size > COMPRESSION_MAX_PAYLOAD) {
+        return false;
+    }
+    
+    // Output that would not save enough is abandoned as soon as it outgrows
+    // the limit, and a sample that does not compress rules out the rest
+    if (size > COMPRESSION_SAMPLE_BYTES) {
+        std::vector<uint8_t> sample(COMPRESSION_SAMPLE_BYTES);
+        size_t sampleLimit = static_cast<size_t>(COMPRESSION_SAMPLE_BYTES * (1.0 - COMPRESSION_MIN_SAVING));
+        if (encode(codec, data, COMPRESSION_SAMPLE_BYTES, sample.data(), sampleLimit) == 0) {
+            return false;
+        }
+    }
+    size_t limit = static_cast<size_t>(size * (1.0 - COMPRESSION_MIN_SAVING)) - PAYLOAD_HEADER_SIZE;
+    std::vector<uint8_t> buffer(PAYLOAD_HEADER_SIZE + limit);
+    size_t compressed = encode(codec, data, size, buffer.data() + PAYLOAD_HEADER_SIZE, limit);
+    if (compressed == 0) {
+        return false;
+    }
+    
+    uint32_t originalSize = static_cast<uint32_t>(size);
+    buffer[0] = static_cast<uint8_t>(codec);
+    std::memcpy(buffer.data() + sizeof(uint8_t), &originalSize, sizeof(originalSize));
+    buffer.resize(PAYLOAD_HEADER_SIZE + compressed);
+    out.swap(buffer);
+    return true;
+}
+
+bool decompressPayload(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    if (size < PAYLOAD_HEADER_SIZE) {
+        return false;
+    }
+    
+    CompressionCodec codec = static_cast<CompressionCodec>(data[0]);
+    uint32_t originalSize = 0;
+    std::memcpy(&originalSize, data + sizeof(uint8_t), sizeof(originalSize));
+    if (originalSize > COMPRESSION_MAX_PAYLOAD) {
+        return false;
+    }
+    
+    std::vector<uint8_t> buffer(originalSize);
+    if (!decode(codec, data + PAYLOAD_HEADER_SIZE, size - PAYLOAD_HEADER_SIZE, buffer.data(), buffer.size())) {
+        return false;
+    }
+    out.swap(buffer);
+    return true;
+}
+
+bool decompressFrame(Message& message) {
+    if (!(message.flags & FRAME_FLAG_COMPRESSED)) {
+        return true;
+    }
+    
+    std::vector<uint8_t> payload;
+    if (!decompressPayload(message.payload.data(), message.payload.size(), payload)) {
+        return false;
+    }
+    message.payload.swap(payload);
+    message.flags &= static_cast<uint8_t>(~FRAME_FLAG_COMPRESSED);
+    return true;
+}
+
+} // namespace P2POverlay
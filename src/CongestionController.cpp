@@ -0,0 +1,140 @@
+#include "CongestionController.h"
+#include <algorithm>
+
+namespace P2POverlay {
+
+CongestionController::CongestionController(CongestionMode mode)
+    : mode_(mode), lossEvents_(0), timeouts_(0) {
+}
+
+void CongestionController::onAck(NodeID destinationID, size_t ackedMessages, uint64_t rttMicros) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CongestionFlow& flow = flowLocked(destinationID);
+    auto now = std::chrono::steady_clock::now();
+    
+    if (rttMicros > 0) {
+        flow.smoothedRttMicros = flow.smoothedRttMicros == 0 ? rttMicros
+                                 : (7 * flow.smoothedRttMicros + rttMicros) / 8;
+        flow.baseRttMicros = flow.baseRttMicros == 0 ? rttMicros : std::min(flow.baseRttMicros, rttMicros);
+        flow.roundMinRttMicros = flow.roundMinRttMicros == 0 ? rttMicros
+                                 : std::min(flow.roundMinRttMicros, rttMicros);
+    }
+    
+    if (flow.window < flow.slowStartThreshold) {
+        // Slow start: one more message per acknowledged one doubles the window every round trip
+        flow.window = std::min(flow.window + ackedMessages, flow.slowStartThreshold);
+    } else if (mode_ == CongestionMode::LOSS_BASED) {
+        // Additive increase: one message per window's worth of ACKs
+        flow.window += static_cast<double>(ackedMessages) / flow.window;
+    }
+    
+    if (mode_ == CongestionMode::DELAY_BASED) {
+        adjustForDelayLocked(flow, now);
+    }
+    
+    flow.window = std::min(std::max(flow.window, static_cast<double>(CONGESTION_MIN_WINDOW)),
+                           static_cast<double>(CONGESTION_MAX_WINDOW));
+}
+
+void CongestionController::onLoss(NodeID destinationID) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    NodeID pathKey = flowLocked(destinationID).pathKey;
+    auto now = std::chrono::steady_clock::now();
+    
+    // Every flow through the same relay backs off together
+    for (auto& pair : flows_) {
+        if (pair.second.pathKey == pathKey) {
+            decreaseLocked(pair.second, now);
+        }
+    }
+    lossEvents_++;
+}
+
+void CongestionController::onTimeout(NodeID destinationID) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CongestionFlow& flow = flowLocked(destinationID);
+    
+    flow.slowStartThreshold = std::max(flow.window / 2, 2.0);
+    flow.window = CONGESTION_MIN_WINDOW;
+    flow.lastDecrease = std::chrono::steady_clock::now();
+    
+    // The route may have moved; the next ACKs rebuild the window on the new one
+    if (pathResolver_) {
+        flow.pathKey = pathResolver_(destinationID);
+    }
+    timeouts_++;
+}
+
+void CongestionController::removeFlow(NodeID destinationID) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flows_.erase(destinationID);
+}
+
+size_t CongestionController::getWindow(NodeID destinationID) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(flowLocked(destinationID).window);
+}
+
+size_t CongestionController::getSlowStartThreshold(NodeID destinationID) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(flowLocked(destinationID).slowStartThreshold);
+}
+
+void CongestionController::setPathResolver(std::function<NodeID(NodeID)> resolver) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pathResolver_ = resolver;
+}
+
+size_t CongestionController::getFlowCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flows_.size();
+}
+
+CongestionFlow& CongestionController::flowLocked(NodeID destinationID) {
+    auto it = flows_.find(destinationID);
+    if (it != flows_.end()) {
+        return it->second;
+    }
+    
+    CongestionFlow& flow = flows_[destinationID];
+    flow.pathKey = pathResolver_ ? pathResolver_(destinationID) : destinationID;
+    flow.roundStart = std::chrono::steady_clock::now();
+    return flow;
+}
+
+void CongestionController::decreaseLocked(CongestionFlow& flow, std::chrono::steady_clock::time_point now) {
+    // Losses from the same round trip are one congestion event
+    if (now - flow.lastDecrease < std::chrono::microseconds(flow.smoothedRttMicros)) {
+        return;
+    }
+    
+    flow.slowStartThreshold = std::max(flow.window / 2, 2.0);
+    flow.window = flow.slowStartThreshold;
+    flow.lastDecrease = now;
+}
+
+void CongestionController::adjustForDelayLocked(CongestionFlow& flow, std::chrono::steady_clock::time_point now) {
+    if (flow.roundMinRttMicros == 0 || now - flow.roundStart < std::chrono::microseconds(flow.smoothedRttMicros)) {
+        return;
+    }
+    
+    // Messages queued on the path: window * (1 - baseRTT / RTT)
+    double queued = flow.window * (1.0 - static_cast<double>(flow.baseRttMicros) / flow.roundMinRttMicros);
+    
+    if (flow.window < flow.slowStartThreshold) {
+        // Leave slow start as soon as a queue starts to form
+        if (queued > CONGESTION_DELAY_BETA) {
+            flow.slowStartThreshold = std::max(flow.window - queued, 2.0);
+            flow.window = flow.slowStartThreshold;
+        }
+    } else if (queued < CONGESTION_DELAY_ALPHA) {
+        flow.window += 1;
+    } else if (queued > CONGESTION_DELAY_BETA) {
+        flow.window -= 1;
+    }
+    
+    flow.roundStart = now;
+    flow.roundMinRttMicros = 0;
+}
+
+} // namespace P2POverlay
@@ -1,5 +1,6 @@
 #include "DataExchange.h"
 #include "MessageHandler.h"
+#include "ErasureCode.h"
 #include <iostream>
 #include <algorithm>
 #include <random>
@@ -8,21 +9,70 @@
 
 namespace P2POverlay {
 
+namespace {
+
+ChunkSource bufferSource(std::shared_ptr<const std::vector<uint8_t>> data) {
+    return [data](size_t offset, uint8_t* buffer, size_t length) {
+        size_t count = std::min(length, data->size() - std::min(offset, data->size()));
+        std::memcpy(buffer, data->data() + offset, count);
+        return count;
+    };
+}
+
+} // namespace
+
 DataExchange::DataExchange(
     std::shared_ptr<Node> node,
     std::shared_ptr<NetworkManager> networkManager,
     std::shared_ptr<MessageRouter> messageRouter)
-    : node_(node), networkManager_(networkManager), messageRouter_(messageRouter),
-      chunkSize_(4096), maxConcurrentTransfers_(5),
-      sentDataSize_(0), receivedDataSize_(0), completedTransfers_(0), failedTransfers_(0) {
+    : node_(node), networkManager_(networkManager), messageRouter_(messageRouter), scheduler_(5),
+      completionGuard_(std::make_shared<CompletionGuard>()), chunkSize_(4096),
+      chunkWindow_(DATA_CHUNK_WINDOW), chunkDigests_(true), merkleProofs_(true),
+      fecGroupChunks_(0), fecParityChunks_(0), adaptiveChunkSize_(false), sentDataSize_(0), receivedDataSize_(0), completedTransfers_(0), failedTransfers_(0),
+      rejectedChunks_(0), corruptChunks_(0), servedChunks_(0), deduplicatedBytes_(0), deltaSavedBytes_(0), resumedTransfers_(0),
+      parityChunks_(0), recoveredChunks_(0) {
 }
 
 DataExchange::~DataExchange() {
+    // Completions still queued become no-ops; one already running is waited out
+    {
+        std::unique_lock<std::mutex> lock(completionGuard_->mutex);
+        completionGuard_->alive = false;
+        completionGuard_->idle.wait(lock, [this] { return completionGuard_->running == 0; });
+    }
     cleanupCompletedTransfers(0);
 }
 
-uint64_t DataExchange::sendData(NodeID targetID, const std::vector<uint8_t>& data, const std::string& dataType) {
-    uint64_t transferID = generateTransferID();
+uint64_t DataExchange::sendData(NodeID targetID, const std::vector<uint8_t>& data, const std::string& dataType,
+                               TransferPriority priority) {
+    ChunkSource source = bufferSource(std::make_shared<const std::vector<uint8_t>>(data));
+    
+    // The bytes are at hand, so hashing them up front costs one pass
+    return startStream(targetID, source, data.size(), dataType, merkleProofs_, priority);
+}
+
+uint64_t DataExchange::sendStream(NodeID targetID, ChunkSource source, size_t totalSize, const std::string& dataType,
+                                  TransferPriority priority) {
+    // Proofs would need the whole source read before the first chunk goes out
+    return startStream(targetID, source, totalSize, dataType, false, priority);
+}
+
+uint64_t DataExchange::startStream(NodeID targetID, ChunkSource source, size_t totalSize, const std::string& dataType,
+                                   bool proofs, TransferPriority priority, uint64_t transferID) {
+    if (transferID == 0) {
+        transferID = generateTransferID();
+    }
+    
+    // The size is fixed for the transfer's lifetime; later measurements
+    // only affect transfers started after them
+    size_t chunkSize = std::max<size_t>(chunkSize_, 1);
+    if (adaptiveChunkSize_) {
+        PeerStatsSnapshot path = node_->getPeerStatsSnapshot(targetID);
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        chunkSize = chunkSizer_.chooseChunkSize(targetID, path, chunkWindow_, chunkSize);
+    }
+    // Receivers refuse a push cut into more chunks than they track
+    chunkSize = std::max<size_t>(chunkSize, (totalSize + DATA_MAX_TRANSFER_CHUNKS - 1) / DATA_MAX_TRANSFER_CHUNKS);
     
     // Create transfer record
     DataTransfer transfer;
@@ -30,36 +80,169 @@ uint64_t DataExchange::sendData(NodeID targetID, const std::vector<uint8_t>& dat
     transfer.sourceID = node_->getID();
     transfer.destinationID = targetID;
     transfer.dataType = dataType;
-    transfer.totalSize = data.size();
+    transfer.totalSize = totalSize;
     transfer.transferredSize = 0;
-    transfer.status = TransferStatus::IN_PROGRESS;
+    transfer.chunkSize = chunkSize;
+    transfer.priority = priority;
+    transfer.status = TransferStatus::PENDING;
     transfer.startTime = std::chrono::system_clock::now();
     transfer.lastUpdate = transfer.startTime;
     
+    OutgoingStream stream;
+    stream.targetID = targetID;
+    stream.source = source;
+    stream.totalSize = totalSize;
+    stream.chunkSize = chunkSize;
+    stream.totalChunks = static_cast<uint32_t>((totalSize + stream.chunkSize - 1) / stream.chunkSize);
+    stream.nextChunk = 0;
+    stream.inFlight = 0;
+    stream.completed = 0;
+    if (fecParityChunks_ > 0) {
+        stream.groupChunks = static_cast<uint32_t>(fecGroupChunks_);
+        stream.parityChunks = static_cast<uint32_t>(fecParityChunks_);
+    }
+    if (proofs && stream.totalChunks > 0) {
+        stream.tree = buildTree(source, totalSize, stream.chunkSize);
+        stream.awaitingSetup = reliableMessaging_ != nullptr;
+    }
+    
     {
         std::lock_guard<std::mutex> lock(transfersMutex_);
         outgoingTransfers_[transferID] = transfer;
+        if (stream.totalChunks > 0) {
+            outgoingStreams_[transferID] = stream;
+            scheduler_.enqueue(transferID, targetID, priority, totalSize);
+            admitTransfersLocked();
+        }
     }
     
-    // Split data into chunks
-    std::vector<DataChunk> chunks = splitData(data, transferID);
+    if (stream.totalChunks == 0) {
+        markTransferComplete(transferID, true);
+        return transferID;
+    }
     
-    // Send chunks
-    for (const DataChunk& chunk : chunks) {
-        if (!sendDataChunk(targetID, chunk)) {
-            markTransferComplete(transferID, false);
-            return 0;
+    // The root goes once, ahead of the chunks, so the receiver never has
+    // to take it from a chunk it cannot check yet
+    if (stream.tree) {
+        TransferSetup setup;
+        setup.transferID = transferID;
+        setup.totalSize = totalSize;
+        setup.chunkSize = static_cast<uint32_t>(stream.chunkSize);
+        setup.totalChunks = stream.totalChunks;
+        setup.root = stream.tree->root();
+        std::function<void(uint64_t, bool)> completion;
+        if (stream.awaitingSetup) {
+            completion = guardCompletion([this, transferID](uint64_t, bool delivered) {
+                completeSetup(transferID, delivered);
+            });
+        }
+        if (!sendControlMessage(targetID, MessageType::TRANSFER_SETUP, encodeTransferSetup(setup), completion) &&
+            stream.awaitingSetup) {
+            completeSetup(transferID, false);
+            return transferID;
         }
-        
-        updateTransferProgress(transferID, chunk.data.size());
     }
     
-    markTransferComplete(transferID, true);
+    pumpTransfers();
     return transferID;
 }
 
+uint64_t DataExchange::sendDeduplicated(NodeID targetID, const std::vector<uint8_t>& data, const std::string& dataType,
+                                       TransferPriority priority) {
+    std::shared_ptr<ChunkStore> store = chunkStore_;
+    if (!store) {
+        return sendData(targetID, data, dataType, priority);
+    }
+    
+    // The blob's chunks stay pinned until the receiver has what it wanted
+    ChunkOffer offer;
+    offer.transferID = generateTransferID();
+    offer.dataType = dataType;
+    offer.manifest = store->storeBlob(data.data(), data.size());
+    
+    DataTransfer transfer;
+    transfer.transferID = offer.transferID;
+    transfer.sourceID = node_->getID();
+    transfer.destinationID = targetID;
+    transfer.dataType = dataType;
+    transfer.totalSize = data.size();
+    transfer.priority = priority;
+    transfer.status = TransferStatus::IN_PROGRESS;
+    transfer.startTime = std::chrono::system_clock::now();
+    transfer.lastUpdate = transfer.startTime;
+    
+    // Only the wanted chunks are scheduled; the offer itself takes no slot
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        outgoingTransfers_[offer.transferID] = transfer;
+        offers_[offer.transferID] = offer.manifest;
+    }
+    
+    if (!sendControlMessage(targetID, MessageType::CHUNK_OFFER, encodeChunkOffer(offer))) {
+        markTransferComplete(offer.transferID, false);
+    }
+    return offer.transferID;
+}
+
+uint64_t DataExchange::sendDelta(NodeID targetID, const std::vector<uint8_t>& data, uint64_t basisID,
+                                const std::string& dataType, TransferPriority priority) {
+    DeltaOffer offer;
+    offer.transferID = generateTransferID();
+    offer.basisID = basisID;
+    offer.totalSize = data.size();
+    offer.dataType = dataType;
+    
+    DataTransfer transfer;
+    transfer.transferID = offer.transferID;
+    transfer.sourceID = node_->getID();
+    transfer.destinationID = targetID;
+    transfer.dataType = dataType;
+    transfer.totalSize = data.size();
+    transfer.priority = priority;
+    transfer.status = TransferStatus::IN_PROGRESS;
+    transfer.startTime = std::chrono::system_clock::now();
+    transfer.lastUpdate = transfer.startTime;
+    
+    // The script is worked out once the signatures arrive; until then the push takes no slot
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        outgoingTransfers_[offer.transferID] = transfer;
+        pendingDeltas_[offer.transferID] = PendingDelta{std::make_shared<const std::vector<uint8_t>>(data), priority};
+    }
+    
+    if (!sendControlMessage(targetID, MessageType::DELTA_OFFER, encodeDeltaOffer(offer))) {
+        markTransferComplete(offer.transferID, false);
+    }
+    return offer.transferID;
+}
+
 bool DataExchange::sendDataChunk(NodeID targetID, const DataChunk& chunk) {
-    // Create message with chunk data
+    ChunkHeader header;
+    header.transferID = chunk.chunkID;
+    header.sequence = chunk.sequenceNumber;
+    header.totalChunks = chunk.totalChunks;
+    header.flags = chunk.isLastChunk ? CHUNK_FLAG_LAST : 0;
+    header.offset = chunk.offset;
+    header.length = static_cast<uint32_t>(chunk.data.size());
+    
+    Message msg = makeChunkMessage(targetID, header);
+    uint8_t* payload = msg.payload.data() + header.encodedSize();
+    std::memcpy(payload, chunk.data.data(), chunk.data.size());
+    setChunkDigest(header, payload, (header.flags & CHUNK_FLAG_DIGEST) != 0);
+    encodeChunkHeader(header, msg.payload.data());
+    
+    sentDataSize_ += chunk.data.size();
+    
+    // Queued chunks leave as the destination's congestion window opens
+    if (reliableMessaging_) {
+        return reliableMessaging_->sendReliableMessage(targetID, msg) != 0;
+    }
+    
+    // Route message
+    return messageRouter_->routeMessage(msg, RoutingStrategy::SHORTEST_PATH);
+}
+
+Message DataExchange::makeChunkMessage(NodeID targetID, ChunkHeader& header) const {
     Message msg;
     msg.type = MessageType::DATA_CHUNK;
     msg.senderID = node_->getID();
@@ -68,82 +251,1093 @@ bool DataExchange::sendDataChunk(NodeID targetID, const DataChunk& chunk) {
         std::chrono::system_clock::now().time_since_epoch()
     ).count();
     
-    // Serialize chunk (simplified)
-    msg.payload.resize(sizeof(DataChunk) + chunk.data.size());
-    std::memcpy(msg.payload.data(), &chunk, sizeof(DataChunk));
-    std::memcpy(msg.payload.data() + sizeof(DataChunk), chunk.data.data(), chunk.data.size());
-    
-    sentDataSize_ += chunk.data.size();
-    
-    // Route message
-    return messageRouter_->routeMessage(msg, RoutingStrategy::SHORTEST_PATH);
+    // Room for header and payload; the caller fills in the payload, then
+    // writes the digest and header over the front
+    if (chunkDigests_) {
+        header.flags |= CHUNK_FLAG_DIGEST;
+    }
+    msg.payload.resize(header.encodedSize() + header.length);
+    return msg;
 }
 
 bool DataExchange::cancelTransfer(uint64_t transferID) {
-    std::lock_guard<std::mutex> lock(transfersMutex_);
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        
+        auto it = outgoingTransfers_.find(transferID);
+        if (it != outgoingTransfers_.end()) {
+            it->second.status = TransferStatus::CANCELLED;
+            releaseOfferLocked(transferID);
+            suspendedStreams_.erase(transferID);
+            pendingDeltas_.erase(transferID);
+            
+            // Chunks still in flight drain through completeChunk
+            auto streamIt = outgoingStreams_.find(transferID);
+            if (streamIt != outgoingStreams_.end() && streamIt->second.inFlight == 0) {
+                outgoingStreams_.erase(streamIt);
+            }
+            scheduler_.remove(transferID);
+            admitTransfersLocked();
+        } else {
+            // A swarm download stops requesting; chunks already asked for are dropped on arrival
+            if (!swarms_.erase(transferID)) {
+                return false;
+            }
+            auto inIt = incomingTransfers_.find(transferID);
+            if (inIt != incomingTransfers_.end()) {
+                inIt->second.status = TransferStatus::CANCELLED;
+            }
+            return true;
+        }
+    }
     
+    // The freed slot goes to the next waiting push
+    pumpTransfers();
+    return true;
+}
+
+bool DataExchange::setTransferPriority(uint64_t transferID, TransferPriority priority) {
+    std::lock_guard<std::mutex> lock(transfersMutex_);
     auto it = outgoingTransfers_.find(transferID);
-    if (it != outgoingTransfers_.end()) {
-        it->second.status = TransferStatus::CANCELLED;
-        return true;
+    if (it == outgoingTransfers_.end()) {
+        return false;
     }
     
-    return false;
+    // Takes effect at the next admission or turn; finished pushes just keep the label
+    it->second.priority = priority;
+    scheduler_.setPriority(transferID, priority);
+    return true;
+}
+
+void DataExchange::setMaxConcurrentTransfers(size_t maxTransfers) {
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        scheduler_.setMaxActive(maxTransfers);
+        admitTransfersLocked();
+    }
+    pumpTransfers();
+}
+
+size_t DataExchange::getMaxConcurrentTransfers() const {
+    std::lock_guard<std::mutex> lock(transfersMutex_);
+    return scheduler_.getMaxActive();
+}
+
+size_t DataExchange::getQueuedTransfers() const {
+    std::lock_guard<std::mutex> lock(transfersMutex_);
+    return scheduler_.getWaitingCount();
+}
+
+void DataExchange::setErasureCoding(size_t groupChunks, size_t parityChunks) {
+    // A code word is at most 256 shards
+    groupChunks = std::min<size_t>(std::max<size_t>(groupChunks, 1), 255);
+    fecGroupChunks_ = groupChunks;
+    fecParityChunks_ = std::min(parityChunks, 256 - groupChunks);
+}
+
+void DataExchange::setChunkSizeLimits(size_t minChunkSize, size_t maxChunkSize) {
+    std::lock_guard<std::mutex> lock(transfersMutex_);
+    chunkSizer_.setLimits(minChunkSize, maxChunkSize);
+}
+
+bool DataExchange::setTransferParity(uint64_t transferID, size_t parityChunks) {
+    std::lock_guard<std::mutex> lock(transfersMutex_);
+    auto it = outgoingStreams_.find(transferID);
+    if (it == outgoingStreams_.end() || it->second.groupChunks == 0) {
+        return false;
+    }
+    it->second.parityChunks = static_cast<uint32_t>(std::min<size_t>(parityChunks, 256 - it->second.groupChunks));
+    return true;
 }
 
 void DataExchange::handleDataChunk(const DataChunk& chunk, NodeID sourceID) {
-    uint64_t transferID = chunk.chunkID;
+    ChunkView view;
+    view.header.transferID = chunk.chunkID;
+    view.header.sequence = chunk.sequenceNumber;
+    view.header.totalChunks = chunk.totalChunks;
+    view.header.flags = chunk.isLastChunk ? CHUNK_FLAG_LAST : 0;
+    view.header.offset = chunk.offset;
+    view.header.length = static_cast<uint32_t>(chunk.data.size());
+    view.payload = chunk.data.data();
+    view.payloadSize = chunk.data.size();
+    storeChunk(view, sourceID);
+}
+
+bool DataExchange::handleChunkMessage(const Message& message) {
+    // The view points into the message, so the payload is copied once,
+    // into the reassembly buffer
+    ChunkView view;
+    if (message.type != MessageType::DATA_CHUNK ||
+        !decodeChunk(message.payload.data(), message.payload.size(), view)) {
+        rejectedChunks_++;
+        return false;
+    }
+    
+    storeChunk(view, message.senderID);
+    return true;
+}
+
+void DataExchange::storeChunk(const ChunkView& chunk, NodeID sourceID) {
+    const ChunkHeader& header = chunk.header;
+    uint64_t transferID = header.transferID;
+    if (header.flags & CHUNK_FLAG_PARITY) {
+        storeParity(chunk, sourceID);
+        return;
+    }
+    
+    uint64_t end = header.offset + chunk.payloadSize;
+    if (header.sequence >= header.totalChunks || header.totalChunks > DATA_MAX_TRANSFER_CHUNKS ||
+        end < header.offset || end > DATA_MAX_TRANSFER_BYTES) {
+        rejectedChunks_++;
+        return;
+    }
+    
+    // Hashing runs before any lock is taken, so chunks arriving on
+    // different threads verify in parallel
+    MerkleHash impliedRoot;
+    bool proven = false;
+    if (header.flags & CHUNK_FLAG_PROOF) {
+        proven = MerkleTree::rootFromProof(hashMerkleLeaf(chunk.payload, chunk.payloadSize, header.offset),
+                                           header.sequence, header.totalChunks, header.proof, impliedRoot);
+        if (!proven) {
+            rejectCorruptChunk(transferID, sourceID, header.sequence);
+            return;
+        }
+    }
     
+    bool deduplicated = false;
+    bool corrupt = false;
+    bool journaled = false;
+    std::vector<RecoveredChunk> recovered;
     {
         std::lock_guard<std::mutex> lock(receivedDataMutex_);
-        receivedChunks_[transferID][chunk.sequenceNumber] = chunk;
+        IncomingAssembly* opened = openAssemblyLocked(transferID, header.totalChunks, chunk.payloadSize);
+        if (!opened || opened->received[header.sequence]) {
+            return;
+        }
+        IncomingAssembly& assembly = *opened;
+        
+        // A push's root comes from its setup, so a proven chunk without
+        // one is not checked against anything and goes no further; only a
+        // swarm download started without a root takes it from its first
+        // proven chunk. Once known, every chunk must prove into the root
+        if (proven && !assembly.rootKnown) {
+            if (!assembly.rootFromFirstChunk || assembly.receivedCount > 0) {
+                rejectedChunks_++;
+                return;
+            }
+            assembly.root = impliedRoot;
+            assembly.rootKnown = true;
+        }
+        if (assembly.rootKnown && (!proven || impliedRoot != assembly.root)) {
+            corrupt = true;
+        } else {
+            // A deduplicated chunk must be the one the offer named
+            auto manifestIt = incomingManifests_.find(transferID);
+            if (manifestIt != incomingManifests_.end()) {
+                const IncomingManifest& incoming = manifestIt->second;
+                if (incoming.offsets[header.sequence] != header.offset ||
+                    incoming.manifest.sizes[header.sequence] != chunk.payloadSize ||
+                    hashChunk(chunk.payload, chunk.payloadSize) != incoming.manifest.keys[header.sequence]) {
+                    rejectedChunks_++;
+                    return;
+                }
+                deduplicated = true;
+            } else if (!fitsChunkLayoutLocked(assembly, header, chunk.payloadSize)) {
+                rejectedChunks_++;
+                return;
+            }
+            
+            // Each chunk lands at its offset; nothing is copied again on
+            // completion. A push's buffer grows with the furthest chunk in
+            if (assembly.buffer.size() < end) {
+                assembly.buffer.resize(static_cast<size_t>(end));
+            }
+            if (chunk.payloadSize > 0) {
+                std::memcpy(assembly.buffer.data() + header.offset, chunk.payload, chunk.payloadSize);
+            }
+            assembly.received[header.sequence] = true;
+            assembly.receivedCount++;
+            journaled = assembly.journaled;
+            
+            // The chunk may leave few enough of its group missing for the parity at hand
+            if (assembly.groupChunks > 0) {
+                recoverGroupLocked(assembly, header.sequence / assembly.groupChunks, recovered);
+            }
+        }
+    }
+    
+    // The swarm asks another source; a push has no second copy to fall back on
+    if (corrupt) {
+        rejectCorruptChunk(transferID, sourceID, header.sequence);
+        return;
+    }
+    
+    // Kept so the next push of similar content can skip it
+    std::shared_ptr<ChunkStore> store = chunkStore_;
+    if (deduplicated && store) {
+        store->put(chunk.payload, chunk.payloadSize);
     }
     
     // Update transfer info
+    bool swarm = false;
     {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        DataTransfer& transfer = incomingTransferLocked(transferID, sourceID);
+        transfer.transferredSize += chunk.payloadSize;
+        transfer.lastUpdate = std::chrono::system_clock::now();
+        
+        if (header.flags & CHUNK_FLAG_LAST) {
+            transfer.totalSize = static_cast<size_t>(end);
+        }
+        
+        auto swarmIt = swarms_.find(transferID);
+        if (swarmIt != swarms_.end()) {
+            swarmIt->second.scheduler.onChunkReceived(sourceID, header.sequence, chunk.payloadSize,
+                                                      std::chrono::steady_clock::now());
+            swarm = !swarmIt->second.scheduler.isComplete();
+        }
+    }
+    
+    receivedDataSize_ += chunk.payloadSize;
+    if (journaled) {
+        journalChunk(transferID, chunk);
+    }
+    if (!recovered.empty()) {
+        acceptRecovered(transferID, sourceID, recovered);
+    }
+    
+    // Check if all chunks received
+    if (reassembleData(transferID)) {
+        markTransferComplete(transferID, true);
+    } else if (swarm) {
+        // The arrival freed a slot in that source's request pipeline
+        pumpSwarm(transferID);
+    }
+    
+    // Notify progress
+    if (onTransferProgress_) {
         std::lock_guard<std::mutex> lock(transfersMutex_);
         auto it = incomingTransfers_.find(transferID);
-        if (it == incomingTransfers_.end()) {
-            DataTransfer transfer;
-            transfer.transferID = transferID;
-            transfer.sourceID = sourceID;
+        if (it != incomingTransfers_.end()) {
+            onTransferProgress_(transferID, it->second.transferredSize, it->second.totalSize);
+        }
+    }
+}
+
+void DataExchange::storeParity(const ChunkView& chunk, NodeID sourceID) {
+    const ChunkHeader& header = chunk.header;
+    uint64_t transferID = header.transferID;
+    uint64_t groupStart = static_cast<uint64_t>(header.sequence) * header.groupChunks;
+    
+    // The layout must be that of a fixed-size push: every chunk but the
+    // last is one shard long
+    if (chunk.payloadSize == 0 || header.totalSize == 0 || header.totalSize > DATA_MAX_TRANSFER_BYTES ||
+        (header.totalSize + chunk.payloadSize - 1) / chunk.payloadSize != header.totalChunks ||
+        groupStart >= header.totalChunks || header.offset != groupStart * chunk.payloadSize) {
+        rejectedChunks_++;
+        return;
+    }
+    
+    // Swarm and deduplicated transfers are never sent with parity
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        if (swarms_.count(transferID)) {
+            rejectedChunks_++;
+            return;
+        }
+    }
+    
+    std::vector<RecoveredChunk> recovered;
+    {
+        std::lock_guard<std::mutex> lock(receivedDataMutex_);
+        if (incomingManifests_.count(transferID)) {
+            rejectedChunks_++;
+            return;
+        }
+        IncomingAssembly* assembly = openAssemblyLocked(transferID, header.totalChunks, chunk.payloadSize);
+        if (!assembly) {
+            return;
+        }
+        // The shard must be one data chunk long, and the size must end
+        // where a last chunk already in does
+        if ((assembly->chunkSize != 0 && assembly->chunkSize != chunk.payloadSize) ||
+            (assembly->received.back() && assembly->buffer.size() != header.totalSize)) {
+            rejectedChunks_++;
+            return;
+        }
+        if (assembly->groupChunks == 0) {
+            assembly->groupChunks = header.groupChunks;
+            assembly->shardSize = chunk.payloadSize;
+            assembly->totalSize = header.totalSize;
+        } else if (assembly->groupChunks != header.groupChunks || assembly->shardSize != chunk.payloadSize ||
+                   assembly->totalSize != header.totalSize) {
+            rejectedChunks_++;
+            return;
+        }
+        
+        // Parity of a group that is already whole is not kept
+        uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(header.groupChunks, header.totalChunks - groupStart));
+        auto first = assembly->received.begin() + static_cast<std::ptrdiff_t>(groupStart);
+        if (std::all_of(first, first + count, [](bool received) { return received; })) {
+            return;
+        }
+        
+        std::vector<std::vector<uint8_t>>& shards = assembly->parity[header.sequence];
+        if (shards.empty()) {
+            shards.resize(header.parityChunks);
+        }
+        if (shards.size() != header.parityChunks || !shards[header.parityIndex].empty()) {
+            return;
+        }
+        shards[header.parityIndex].assign(chunk.payload, chunk.payload + chunk.payloadSize);
+        recoverGroupLocked(*assembly, header.sequence, recovered);
+    }
+    
+    if (recovered.empty()) {
+        return;
+    }
+    acceptRecovered(transferID, sourceID, recovered);
+    if (reassembleData(transferID)) {
+        markTransferComplete(transferID, true);
+    }
+}
+
+void DataExchange::acceptRecovered(uint64_t transferID, NodeID sourceID, const std::vector<RecoveredChunk>& recovered) {
+    // Rebuilt chunks are not journaled: after a restart nothing would
+    // mark them for the whole-transfer check, so they are fetched again
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        DataTransfer& transfer = incomingTransferLocked(transferID, sourceID);
+        for (const RecoveredChunk& chunk : recovered) {
+            bytes += chunk.length;
+            if (chunk.last) {
+                transfer.totalSize = static_cast<size_t>(chunk.offset + chunk.length);
+            }
+        }
+        transfer.transferredSize += bytes;
+        transfer.lastUpdate = std::chrono::system_clock::now();
+    }
+    receivedDataSize_ += bytes;
+    recoveredChunks_ += recovered.size();
+}
+
+DataExchange::IncomingAssembly* DataExchange::openAssemblyLocked(uint64_t transferID, uint32_t totalChunks,
+                                                                 size_t chunkSize) {
+    if (completedData_.count(transferID)) {
+        return nullptr; // Late duplicate of a finished transfer
+    }
+    
+    // The header is all there is to go on for a push's first chunk, so its
+    // figures are checked before they size anything
+    auto existing = assemblies_.find(transferID);
+    if ((existing == assemblies_.end() || existing->second.received.empty()) &&
+        (totalChunks == 0 || totalChunks > DATA_MAX_TRANSFER_CHUNKS || chunkSize == 0 ||
+         static_cast<uint64_t>(totalChunks - 1) * chunkSize >= DATA_MAX_TRANSFER_BYTES)) {
+        rejectedChunks_++;
+        return nullptr;
+    }
+    
+    IncomingAssembly& assembly = assemblies_[transferID];
+    if (assembly.failed) {
+        return nullptr;
+    }
+    if (assembly.received.empty()) {
+        // Only pushes get here first; swarm and deduplicated transfers
+        // set up their assembly before any chunk arrives. A delta script
+        // means nothing without the in-memory record of its basis, so it
+        // is not journaled
+        assembly.journaled = !incomingDeltas_.count(transferID) && transferJournal_ &&
+                             transferJournal_->begin(transferID);
+        if (assembly.journaled) {
+            assembly.persisted.assign(totalChunks, false);
+        }
+        assembly.received.assign(totalChunks, false);
+    }
+    return assembly.received.size() == totalChunks ? &assembly : nullptr;
+}
+
+bool DataExchange::fitsChunkLayoutLocked(IncomingAssembly& assembly, const ChunkHeader& header, size_t payloadSize) {
+    // Pushes and swarm downloads are cut into equal chunks, so each one
+    // has a single place; the length comes from the first full chunk, or
+    // is implied by where a last chunk that arrives first sits
+    bool last = header.sequence + 1 == assembly.received.size();
+    
+    // Parity already in fixes the chunk length and, for the last chunk, the end
+    if (assembly.shardSize != 0 &&
+        (header.offset != static_cast<uint64_t>(header.sequence) * assembly.shardSize ||
+         (last ? header.offset + payloadSize != assembly.totalSize : payloadSize != assembly.shardSize))) {
+        return false;
+    }
+    if (assembly.chunkSize == 0) {
+        if (last) {
+            return header.sequence == 0 ? header.offset == 0
+                                        : header.offset % header.sequence == 0 &&
+                                          payloadSize <= header.offset / header.sequence;
+        }
+        if (payloadSize == 0) {
+            return false;
+        }
+        assembly.chunkSize = payloadSize;
+    }
+    return header.offset == static_cast<uint64_t>(header.sequence) * assembly.chunkSize &&
+           (last ? payloadSize <= assembly.chunkSize : payloadSize == assembly.chunkSize);
+}
+
+void DataExchange::recoverGroupLocked(IncomingAssembly& assembly, uint32_t group,
+                                      std::vector<RecoveredChunk>& recovered) {
+    auto parityIt = assembly.parity.find(group);
+    if (parityIt == assembly.parity.end()) {
+        return;
+    }
+    std::vector<std::vector<uint8_t>>& parity = parityIt->second;
+    
+    uint32_t first = group * assembly.groupChunks;
+    uint32_t count = std::min<uint32_t>(assembly.groupChunks, static_cast<uint32_t>(assembly.received.size()) - first);
+    size_t missing = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        missing += assembly.received[first + i] ? 0 : 1;
+    }
+    size_t available = static_cast<size_t>(std::count_if(parity.begin(), parity.end(),
+        [](const std::vector<uint8_t>& shard) { return !shard.empty(); }));
+    if (missing == 0) {
+        assembly.parity.erase(parityIt);
+        return;
+    }
+    if (available < missing) {
+        return;
+    }
+    
+    // Data shards are the chunks zero-padded to the shard size; absent
+    // parity shards only need somewhere to point
+    const size_t shardSize = assembly.shardSize;
+    std::vector<std::vector<uint8_t>> data(count, std::vector<uint8_t>(shardSize, 0));
+    std::vector<uint8_t> scratch(shardSize);
+    std::vector<uint8_t*> shards;
+    std::vector<bool> present;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t offset = static_cast<uint64_t>(first + i) * shardSize;
+        // Copies never read past what has actually arrived, whatever the parity claimed
+        if (assembly.received[first + i] && offset < assembly.buffer.size()) {
+            size_t length = static_cast<size_t>(std::min<uint64_t>({shardSize, assembly.totalSize - offset,
+                                                                    assembly.buffer.size() - offset}));
+            std::memcpy(data[i].data(), assembly.buffer.data() + offset, length);
+        }
+        shards.push_back(data[i].data());
+        present.push_back(assembly.received[first + i]);
+    }
+    for (std::vector<uint8_t>& shard : parity) {
+        shards.push_back(shard.empty() ? scratch.data() : shard.data());
+        present.push_back(!shard.empty());
+    }
+    
+    ReedSolomon code(count, parity.size());
+    if (!code.reconstruct(shards, present, shardSize)) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < count; ++i) {
+        if (assembly.received[first + i]) {
+            continue;
+        }
+        uint64_t offset = static_cast<uint64_t>(first + i) * shardSize;
+        size_t length = static_cast<size_t>(std::min<uint64_t>(shardSize, assembly.totalSize - offset));
+        if (assembly.buffer.size() < offset + length) {
+            assembly.buffer.resize(static_cast<size_t>(offset + length));
+        }
+        std::memcpy(assembly.buffer.data() + offset, data[i].data(), length);
+        assembly.received[first + i] = true;
+        assembly.receivedCount++;
+        recovered.push_back(RecoveredChunk{first + i, offset, length, first + i + 1 == assembly.received.size()});
+    }
+    assembly.unproven = true;
+    assembly.parity.erase(parityIt);
+}
+
+bool DataExchange::bufferMatchesRootLocked(const IncomingAssembly& assembly) const {
+    size_t chunkSize = assembly.chunkSize != 0 ? assembly.chunkSize : assembly.shardSize;
+    if (chunkSize == 0) {
+        return false;
+    }
+    
+    std::vector<MerkleHash> leaves;
+    leaves.reserve(assembly.received.size());
+    for (uint64_t offset = 0; offset < assembly.buffer.size(); offset += chunkSize) {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(chunkSize, assembly.buffer.size() - offset));
+        leaves.push_back(hashMerkleLeaf(assembly.buffer.data() + offset, length, offset));
+    }
+    return leaves.size() == assembly.received.size() && MerkleTree(leaves).root() == assembly.root;
+}
+
+DataTransfer& DataExchange::incomingTransferLocked(uint64_t transferID, NodeID sourceID) {
+    auto it = incomingTransfers_.find(transferID);
+    if (it == incomingTransfers_.end()) {
+        DataTransfer transfer;
+        transfer.transferID = transferID;
+        transfer.sourceID = sourceID;
+        transfer.destinationID = node_->getID();
+        transfer.status = TransferStatus::IN_PROGRESS;
+        transfer.startTime = std::chrono::system_clock::now();
+        it = incomingTransfers_.emplace(transferID, transfer).first;
+    }
+    return it->second;
+}
+
+bool DataExchange::publishContent(uint64_t contentID, ChunkSource source, size_t totalSize) {
+    if (contentID == 0 || !source || totalSize == 0) {
+        return false;
+    }
+    
+    // Republishing drops trees built over the previous bytes
+    std::lock_guard<std::mutex> lock(transfersMutex_);
+    PublishedContent& content = published_[contentID];
+    content.source = source;
+    content.totalSize = totalSize;
+    content.trees.clear();
+    return true;
+}
+
+void DataExchange::unpublishContent(uint64_t contentID) {
+    std::lock_guard<std::mutex> lock(transfersMutex_);
+    published_.erase(contentID);
+}
+
+bool DataExchange::handleTransferRequest(const Message& message) {
+    ChunkRequest request;
+    if (message.type != MessageType::TRANSFER_REQUEST ||
+        !decodeChunkRequest(message.payload.data(), message.payload.size(), request)) {
+        return false;
+    }
+    if (request.chunkSize == 0) {
+        return resumePush(request, message.senderID);
+    }
+    
+    PublishedContent content;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = published_.find(request.contentID);
+        if (it == published_.end()) {
+            return false;
+        }
+        content = it->second;
+    }
+    
+    uint64_t totalChunks = (content.totalSize + request.chunkSize - 1) / request.chunkSize;
+    if (totalChunks > UINT32_MAX) {
+        return false;
+    }
+    std::shared_ptr<const MerkleTree> tree = merkleProofs_ ? contentTree(request.contentID, request.chunkSize) : nullptr;
+    
+    // Served like any other chunk: the requester places it by offset
+    for (uint32_t sequence : request.chunks) {
+        if (sequence >= totalChunks) {
+            continue;
+        }
+        
+        ChunkHeader header;
+        header.transferID = request.contentID;
+        header.sequence = sequence;
+        header.totalChunks = static_cast<uint32_t>(totalChunks);
+        header.flags = sequence == totalChunks - 1 ? CHUNK_FLAG_LAST : 0;
+        header.offset = static_cast<uint64_t>(sequence) * request.chunkSize;
+        header.length = static_cast<uint32_t>(std::min<uint64_t>(request.chunkSize, content.totalSize - header.offset));
+        if (tree) {
+            header.flags |= CHUNK_FLAG_PROOF;
+            header.root = tree->root();
+            header.proof = tree->proof(sequence);
+        }
+        
+        Message msg = makeChunkMessage(message.senderID, header);
+        uint8_t* payload = msg.payload.data() + header.encodedSize();
+        if (content.source(static_cast<size_t>(header.offset), payload, header.length) != header.length) {
+            continue;
+        }
+        setChunkDigest(header, payload, (header.flags & CHUNK_FLAG_DIGEST) != 0);
+        encodeChunkHeader(header, msg.payload.data());
+        
+        bool sent = reliableMessaging_ ? reliableMessaging_->sendReliableMessage(message.senderID, msg) != 0
+                                       : messageRouter_->routeMessage(msg, RoutingStrategy::SHORTEST_PATH);
+        if (sent) {
+            servedChunks_++;
+            sentDataSize_ += header.length;
+        }
+    }
+    return true;
+}
+
+uint64_t DataExchange::downloadContent(uint64_t contentID, size_t totalSize, const std::vector<NodeID>& sources,
+                                       const MerkleHash& expectedRoot) {
+    size_t chunkSize = chunkSize_;
+    if (contentID == 0 || totalSize == 0 || totalSize > DATA_MAX_TRANSFER_BYTES || sources.empty() ||
+        chunkSize == 0 || chunkSize > UINT32_MAX || (totalSize + chunkSize - 1) / chunkSize > DATA_MAX_TRANSFER_CHUNKS) {
+        return 0;
+    }
+    uint32_t totalChunks = static_cast<uint32_t>((totalSize + chunkSize - 1) / chunkSize);
+    
+    // The size is known up front, so the whole buffer is allocated once
+    {
+        std::lock_guard<std::mutex> lock(receivedDataMutex_);
+        if (assemblies_.count(contentID) || completedData_.count(contentID)) {
+            return 0;
+        }
+        IncomingAssembly& assembly = assemblies_[contentID];
+        assembly.received.assign(totalChunks, false);
+        assembly.buffer.resize(totalSize);
+        assembly.chunkSize = chunkSize;
+        
+        // Without a root from the publisher the first proven chunk sets it
+        assembly.root = expectedRoot;
+        assembly.rootKnown = expectedRoot != MerkleHash();
+        assembly.rootFromFirstChunk = !assembly.rootKnown;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        DataTransfer transfer;
+        transfer.transferID = contentID;
+        transfer.sourceID = sources.front();
+        transfer.destinationID = node_->getID();
+        transfer.totalSize = totalSize;
+        transfer.status = TransferStatus::IN_PROGRESS;
+        transfer.startTime = std::chrono::system_clock::now();
+        transfer.lastUpdate = transfer.startTime;
+        incomingTransfers_[contentID] = transfer;
+        
+        auto swarmIt = swarms_.emplace(contentID, SwarmDownload(totalChunks, static_cast<uint32_t>(chunkSize))).first;
+        for (NodeID sourceID : sources) {
+            swarmIt->second.scheduler.addSource(sourceID);
+        }
+    }
+    
+    pumpSwarm(contentID);
+    return contentID;
+}
+
+MerkleHash DataExchange::getContentRoot(uint64_t contentID, uint32_t chunkSize) {
+    std::shared_ptr<const MerkleTree> tree = chunkSize > 0 ? contentTree(contentID, chunkSize) : nullptr;
+    return tree ? tree->root() : MerkleHash();
+}
+
+bool DataExchange::addSwarmSource(uint64_t contentID, NodeID sourceID, const std::vector<bool>& have) {
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = swarms_.find(contentID);
+        if (it == swarms_.end()) {
+            return false;
+        }
+        it->second.scheduler.addSource(sourceID, have);
+    }
+    
+    pumpSwarm(contentID);
+    return true;
+}
+
+void DataExchange::removeSwarmSource(uint64_t contentID, NodeID sourceID) {
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = swarms_.find(contentID);
+        if (it == swarms_.end()) {
+            return;
+        }
+        it->second.scheduler.removeSource(sourceID);
+    }
+    
+    // Its outstanding chunks go to the remaining sources
+    pumpSwarm(contentID);
+}
+
+void DataExchange::retrySwarmRequests() {
+    std::vector<uint64_t> expired;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto now = std::chrono::steady_clock::now();
+        for (auto& pair : swarms_) {
+            if (pair.second.scheduler.expire(now) > 0) {
+                expired.push_back(pair.first);
+            }
+        }
+    }
+    
+    for (uint64_t contentID : expired) {
+        pumpSwarm(contentID);
+    }
+}
+
+bool DataExchange::resumeTransfer(uint64_t transferID) {
+    NodeID sourceID = 0;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = incomingTransfers_.find(transferID);
+        if (it == incomingTransfers_.end() || it->second.status != TransferStatus::IN_PROGRESS ||
+            swarms_.count(transferID)) {
+            return false;
+        }
+        sourceID = it->second.sourceID;
+        it->second.lastUpdate = std::chrono::system_clock::now();
+    }
+    
+    // Chunk size 0 asks for the sender's own chunking of the transfer
+    ChunkRequest request;
+    request.contentID = transferID;
+    request.chunkSize = 0;
+    {
+        std::lock_guard<std::mutex> lock(receivedDataMutex_);
+        auto it = assemblies_.find(transferID);
+        if (it == assemblies_.end() || it->second.failed) {
+            return false;
+        }
+        const std::vector<bool>& received = it->second.received;
+        for (uint32_t i = 0; i < received.size() && request.chunks.size() < CHUNK_REQUEST_MAX_CHUNKS; ++i) {
+            if (!received[i]) {
+                request.chunks.push_back(i);
+            }
+        }
+    }
+    
+    return !request.chunks.empty() &&
+           sendControlMessage(sourceID, MessageType::TRANSFER_REQUEST, encodeChunkRequest(request));
+}
+
+void DataExchange::resumeStalledTransfers() {
+    std::vector<uint64_t> stalled;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto now = std::chrono::system_clock::now();
+        for (const auto& pair : incomingTransfers_) {
+            if (pair.second.status == TransferStatus::IN_PROGRESS && !swarms_.count(pair.first) &&
+                now - pair.second.lastUpdate >= std::chrono::milliseconds(DATA_RESUME_STALL_MS)) {
+                stalled.push_back(pair.first);
+            }
+        }
+    }
+    
+    for (uint64_t transferID : stalled) {
+        resumeTransfer(transferID);
+    }
+}
+
+bool DataExchange::handleTransferResponse(const Message& message) {
+    TransferResume resume;
+    if (message.type != MessageType::TRANSFER_RESPONSE ||
+        !decodeTransferResume(message.payload.data(), message.payload.size(), resume)) {
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = incomingTransfers_.find(resume.transferID);
+        if (it == incomingTransfers_.end() || it->second.sourceID != message.senderID ||
+            it->second.status != TransferStatus::IN_PROGRESS) {
+            return false;
+        }
+        if (resume.accepted) {
+            it->second.totalSize = static_cast<size_t>(resume.totalSize);
+            it->second.lastUpdate = std::chrono::system_clock::now();
+        }
+    }
+    
+    // The sender no longer has the data, so what arrived cannot be completed
+    if (!resume.accepted) {
+        failIncomingPush(resume.transferID, message.senderID);
+        return true;
+    }
+    resumedTransfers_++;
+    return true;
+}
+
+bool DataExchange::enableTransferJournal(const std::string& directory) {
+    auto journal = std::make_shared<TransferJournal>(directory);
+    std::vector<JournalEntry> recovered;
+    if (!journal->open(recovered)) {
+        return false;
+    }
+    transferJournal_ = journal;
+    
+    for (JournalEntry& entry : recovered) {
+        std::vector<uint8_t> data;
+        if (!journal->readData(entry.transferID, data) || !journal->begin(entry.transferID)) {
+            continue;
+        }
+        uint32_t receivedCount = static_cast<uint32_t>(std::count(entry.received.begin(), entry.received.end(), true));
+        
+        {
+            std::lock_guard<std::mutex> lock(receivedDataMutex_);
+            if (assemblies_.count(entry.transferID) || completedData_.count(entry.transferID)) {
+                continue;
+            }
+            IncomingAssembly& assembly = assemblies_[entry.transferID];
+            assembly.buffer = std::move(data);
+            assembly.received = entry.received;
+            assembly.receivedCount = receivedCount;
+            assembly.root = entry.root;
+            assembly.rootKnown = entry.rootKnown;
+            assembly.journaled = true;
+            assembly.persisted = entry.received;
+            assembly.persistedCount = receivedCount;
+        }
+        {
+            std::lock_guard<std::mutex> lock(transfersMutex_);
+            DataTransfer& transfer = incomingTransfers_[entry.transferID];
+            transfer.transferID = entry.transferID;
+            transfer.sourceID = entry.sourceID;
             transfer.destinationID = node_->getID();
+            transfer.totalSize = static_cast<size_t>(entry.totalSize);
             transfer.status = TransferStatus::IN_PROGRESS;
             transfer.startTime = std::chrono::system_clock::now();
-            incomingTransfers_[transferID] = transfer;
+            transfer.lastUpdate = transfer.startTime;
         }
         
-        auto& transfer = incomingTransfers_[transferID];
-        transfer.transferredSize += chunk.data.size();
-        transfer.lastUpdate = std::chrono::system_clock::now();
+        // Everything may have reached the disk before the restart
+        if (reassembleData(entry.transferID)) {
+            markTransferComplete(entry.transferID, true);
+        } else {
+            resumeTransfer(entry.transferID);
+        }
+    }
+    return true;
+}
+
+bool DataExchange::handleChunkOffer(const Message& message) {
+    ChunkOffer offer;
+    if (message.type != MessageType::CHUNK_OFFER ||
+        !decodeChunkOffer(message.payload.data(), message.payload.size(), offer) ||
+        offer.manifest.totalSize > DATA_MAX_TRANSFER_BYTES) {
+        return false;
+    }
+    
+    const ChunkManifest& manifest = offer.manifest;
+    std::shared_ptr<ChunkStore> store = chunkStore_;
+    IncomingManifest incoming;
+    incoming.offsets = manifest.offsets();
+    ChunkRequest want;
+    want.contentID = offer.transferID;
+    size_t reused = 0;
+    
+    // Chunks already in the local store are copied in place; only the rest are asked for
+    {
+        std::lock_guard<std::mutex> lock(receivedDataMutex_);
+        if (assemblies_.count(offer.transferID) || completedData_.count(offer.transferID)) {
+            return false;
+        }
+        
+        IncomingAssembly& assembly = assemblies_[offer.transferID];
+        assembly.received.assign(manifest.keys.size(), false);
+        assembly.buffer.resize(static_cast<size_t>(manifest.totalSize));
+        for (uint32_t i = 0; i < manifest.keys.size(); ++i) {
+            if (store && store->read(manifest.keys[i], 0, assembly.buffer.data() + incoming.offsets[i], manifest.sizes[i])) {
+                assembly.received[i] = true;
+                assembly.receivedCount++;
+                reused += manifest.sizes[i];
+            } else {
+                want.chunks.push_back(i);
+            }
+        }
+        
+        incoming.manifest = manifest;
+        incomingManifests_[offer.transferID] = std::move(incoming);
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        DataTransfer transfer;
+        transfer.transferID = offer.transferID;
+        transfer.sourceID = message.senderID;
+        transfer.destinationID = node_->getID();
+        transfer.dataType = offer.dataType;
+        transfer.totalSize = static_cast<size_t>(manifest.totalSize);
+        transfer.transferredSize = reused;
+        transfer.status = TransferStatus::IN_PROGRESS;
+        transfer.startTime = std::chrono::system_clock::now();
+        transfer.lastUpdate = transfer.startTime;
+        incomingTransfers_[offer.transferID] = transfer;
+    }
+    
+    // An empty want list tells the sender it is done
+    sendControlMessage(message.senderID, MessageType::CHUNK_WANT, encodeChunkRequest(want));
+    if (reassembleData(offer.transferID)) {
+        markTransferComplete(offer.transferID, true);
+    }
+    return true;
+}
+
+bool DataExchange::handleChunkWant(const Message& message) {
+    ChunkRequest want;
+    if (message.type != MessageType::CHUNK_WANT ||
+        !decodeChunkRequest(message.payload.data(), message.payload.size(), want)) {
+        return false;
+    }
+    
+    uint64_t transferID = want.contentID;
+    std::shared_ptr<ChunkStore> store = chunkStore_;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto offerIt = offers_.find(transferID);
+        auto transferIt = outgoingTransfers_.find(transferID);
+        if (!store || offerIt == offers_.end() || transferIt == outgoingTransfers_.end() ||
+            transferIt->second.destinationID != message.senderID || outgoingStreams_.count(transferID)) {
+            return false;
+        }
+        
+        const ChunkManifest& manifest = offerIt->second;
+        OutgoingStream stream;
+        stream.targetID = message.senderID;
+        stream.totalSize = static_cast<size_t>(manifest.totalSize);
+        stream.chunkSize = 0;
+        stream.totalChunks = static_cast<uint32_t>(want.chunks.size());
+        stream.nextChunk = 0;
+        stream.inFlight = 0;
+        stream.completed = 0;
+        stream.sequences = want.chunks;
+        stream.offsets = manifest.offsets();
+        stream.sizes = manifest.sizes;
         
-        if (chunk.isLastChunk) {
-            transfer.totalSize = transfer.transferredSize;
+        size_t wanted = 0;
+        for (uint32_t sequence : want.chunks) {
+            if (sequence >= manifest.keys.size()) {
+                return false;
+            }
+            wanted += manifest.sizes[sequence];
+        }
+        deduplicatedBytes_ += static_cast<size_t>(manifest.totalSize) - std::min<size_t>(wanted, manifest.totalSize);
+        
+        // Pinned chunks are read back from the store as the window opens
+        auto keys = std::make_shared<const std::vector<ChunkKey>>(manifest.keys);
+        auto offsets = std::make_shared<const std::vector<uint64_t>>(stream.offsets);
+        stream.source = [store, keys, offsets](size_t offset, uint8_t* buffer, size_t length) -> size_t {
+            size_t index = static_cast<size_t>(std::upper_bound(offsets->begin(), offsets->end(), offset) - offsets->begin()) - 1;
+            return store->read((*keys)[index], offset - (*offsets)[index], buffer, length) ? length : 0;
+        };
+        
+        if (want.chunks.empty()) {
+            done = true;
+        } else {
+            outgoingStreams_[transferID] = std::move(stream);
+            transferIt->second.status = TransferStatus::PENDING;
+            scheduler_.enqueue(transferID, message.senderID, transferIt->second.priority, wanted);
+            admitTransfersLocked();
         }
     }
     
-    receivedDataSize_ += chunk.data.size();
-    
-    // Check if all chunks received
-    if (reassembleData(transferID)) {
-        markTransferComplete(transferID, true);
+    if (done) {
+        markTransferComplete(transferID, true);
+    } else {
+        pumpTransfers();
+    }
+    return true;
+}
+
+bool DataExchange::handleDeltaOffer(const Message& message) {
+    DeltaOffer offer;
+    if (message.type != MessageType::DELTA_OFFER ||
+        !decodeDeltaOffer(message.payload.data(), message.payload.size(), offer) ||
+        offer.totalSize > DATA_MAX_TRANSFER_BYTES) {
+        return false;
+    }
+    
+    // Without the basis no block matches and the script is all literals
+    std::shared_ptr<const std::vector<uint8_t>> basis;
+    DeltaSignatures signatures;
+    {
+        std::lock_guard<std::mutex> lock(receivedDataMutex_);
+        if (assemblies_.count(offer.transferID) || completedData_.count(offer.transferID) ||
+            incomingDeltas_.count(offer.transferID)) {
+            return false;
+        }
+        auto basisIt = completedData_.find(offer.basisID);
+        if (basisIt != completedData_.end()) {
+            basis = basisIt->second;
+            signatures.blockSize = chooseDeltaBlockSize(basis->size());
+        }
+        incomingDeltas_[offer.transferID] = IncomingDelta{offer.basisID, signatures.blockSize};
+    }
+    
+    // Hashing the whole basis happens without receivedDataMutex_ held
+    if (basis) {
+        signatures = computeSignatures(basis->data(), basis->size(), signatures.blockSize);
+    }
+    signatures.transferID = offer.transferID;
+    
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        DataTransfer transfer;
+        transfer.transferID = offer.transferID;
+        transfer.sourceID = message.senderID;
+        transfer.destinationID = node_->getID();
+        transfer.dataType = offer.dataType;
+        transfer.totalSize = static_cast<size_t>(offer.totalSize);
+        transfer.status = TransferStatus::IN_PROGRESS;
+        transfer.startTime = std::chrono::system_clock::now();
+        transfer.lastUpdate = transfer.startTime;
+        incomingTransfers_[offer.transferID] = transfer;
+    }
+    
+    return sendControlMessage(message.senderID, MessageType::DELTA_SIGNATURES, encodeDeltaSignatures(signatures));
+}
+
+bool DataExchange::handleDeltaSignatures(const Message& message) {
+    DeltaSignatures signatures;
+    if (message.type != MessageType::DELTA_SIGNATURES ||
+        !decodeDeltaSignatures(message.payload.data(), message.payload.size(), signatures)) {
+        return false;
     }
     
-    // Notify progress
-    if (onTransferProgress_) {
+    uint64_t transferID = signatures.transferID;
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    TransferPriority priority = TransferPriority::NORMAL;
+    std::string dataType;
+    {
         std::lock_guard<std::mutex> lock(transfersMutex_);
-        auto it = incomingTransfers_.find(transferID);
-        if (it != incomingTransfers_.end()) {
-            onTransferProgress_(transferID, it->second.transferredSize, it->second.totalSize);
+        auto it = pendingDeltas_.find(transferID);
+        auto transferIt = outgoingTransfers_.find(transferID);
+        if (it == pendingDeltas_.end() || transferIt == outgoingTransfers_.end() ||
+            transferIt->second.destinationID != message.senderID) {
+            return false;
         }
+        data = it->second.data;
+        priority = it->second.priority;
+        dataType = transferIt->second.dataType;
+        pendingDeltas_.erase(it);
+    }
+    
+    // The script goes out as an ordinary push under the offer's transfer ID
+    auto script = std::make_shared<const std::vector<uint8_t>>(encodeDelta(signatures, data->data(), data->size()));
+    deltaSavedBytes_ += data->size() - std::min(script->size(), data->size());
+    startStream(message.senderID, bufferSource(script), script->size(), dataType, merkleProofs_, priority, transferID);
+    return true;
+}
+
+bool DataExchange::handleTransferSetup(const Message& message) {
+    TransferSetup setup;
+    if (message.type != MessageType::TRANSFER_SETUP ||
+        !decodeTransferSetup(message.payload.data(), message.payload.size(), setup) || setup.totalSize == 0 ||
+        setup.totalSize > DATA_MAX_TRANSFER_BYTES || setup.chunkSize == 0 ||
+        (setup.totalSize + setup.chunkSize - 1) / setup.chunkSize != setup.totalChunks) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(receivedDataMutex_);
+    IncomingAssembly* assembly = openAssemblyLocked(setup.transferID, setup.totalChunks, setup.chunkSize);
+    if (!assembly || assembly->rootKnown || (assembly->chunkSize != 0 && assembly->chunkSize != setup.chunkSize)) {
+        return false;
     }
+    
+    // The sender holds the chunks back until this is acknowledged, so any
+    // already taken did not come from it; they are checked with the rest
+    // of the buffer once the transfer is complete
+    assembly->root = setup.root;
+    assembly->rootKnown = true;
+    assembly->chunkSize = setup.chunkSize;
+    assembly->unproven = assembly->receivedCount > 0;
+    return true;
 }
 
 std::vector<uint8_t> DataExchange::getReceivedData(uint64_t transferID) const {
     std::lock_guard<std::mutex> lock(receivedDataMutex_);
     auto it = completedData_.find(transferID);
     if (it != completedData_.end()) {
-        return it->second;
+        return *it->second;
     }
     return {};
 }
@@ -162,7 +1356,7 @@ std::vector<DataTransfer> DataExchange::getActiveTransfers() const {
     std::vector<DataTransfer> transfers;
     
     for (const auto& pair : outgoingTransfers_) {
-        if (pair.second.status == TransferStatus::IN_PROGRESS) {
+        if (pair.second.status == TransferStatus::IN_PROGRESS || pair.second.status == TransferStatus::PENDING) {
             transfers.push_back(pair.second);
         }
     }
@@ -196,6 +1390,41 @@ void DataExchange::cleanupCompletedTransfers(int timeoutSeconds) {
     std::lock_guard<std::mutex> lock(transfersMutex_);
     auto now = std::chrono::system_clock::now();
     
+    // Offers the receiver never answered give their pinned chunks back
+    for (auto offerIt = offers_.begin(); offerIt != offers_.end();) {
+        uint64_t transferID = offerIt->first;
+        ++offerIt;
+        auto transferIt = outgoingTransfers_.find(transferID);
+        if (transferIt == outgoingTransfers_.end() || outgoingStreams_.count(transferID) ||
+            transferIt->second.status != TransferStatus::IN_PROGRESS) {
+            continue;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - transferIt->second.lastUpdate);
+        if (elapsed.count() > timeoutSeconds) {
+            transferIt->second.status = TransferStatus::FAILED;
+            transferIt->second.lastUpdate = now;
+            failedTransfers_++;
+            releaseOfferLocked(transferID);
+        }
+    }
+    
+    // Likewise delta offers the receiver never sent signatures for
+    for (auto deltaIt = pendingDeltas_.begin(); deltaIt != pendingDeltas_.end();) {
+        auto transferIt = outgoingTransfers_.find(deltaIt->first);
+        if (transferIt != outgoingTransfers_.end() && transferIt->second.status == TransferStatus::IN_PROGRESS &&
+            std::chrono::duration_cast<std::chrono::seconds>(now - transferIt->second.lastUpdate).count() <=
+                timeoutSeconds) {
+            ++deltaIt;
+            continue;
+        }
+        if (transferIt != outgoingTransfers_.end() && transferIt->second.status == TransferStatus::IN_PROGRESS) {
+            transferIt->second.status = TransferStatus::FAILED;
+            transferIt->second.lastUpdate = now;
+            failedTransfers_++;
+        }
+        deltaIt = pendingDeltas_.erase(deltaIt);
+    }
+    
     // Cleanup outgoing transfers
     auto outIt = outgoingTransfers_.begin();
     while (outIt != outgoingTransfers_.end()) {
@@ -206,6 +1435,7 @@ void DataExchange::cleanupCompletedTransfers(int timeoutSeconds) {
                 now - outIt->second.lastUpdate
             );
             if (elapsed.count() > timeoutSeconds) {
+                suspendedStreams_.erase(outIt->first);
                 outIt = outgoingTransfers_.erase(outIt);
             } else {
                 ++outIt;
@@ -255,61 +1485,58 @@ uint64_t DataExchange::generateTransferID() {
     return dis(gen);
 }
 
-std::vector<DataChunk> DataExchange::splitData(const std::vector<uint8_t>& data, uint64_t transferID) {
-    std::vector<DataChunk> chunks;
-    size_t totalSize = data.size();
-    uint32_t chunkCount = static_cast<uint32_t>((totalSize + chunkSize_ - 1) / chunkSize_);
-    
-    for (uint32_t i = 0; i < chunkCount; ++i) {
-        DataChunk chunk;
-        chunk.chunkID = transferID;
-        chunk.sequenceNumber = i;
-        chunk.totalChunks = chunkCount;
-        chunk.isLastChunk = (i == chunkCount - 1);
+bool DataExchange::reassembleData(uint64_t transferID) {
+    std::shared_ptr<const std::vector<uint8_t>> reassembled;
+    bool failed = false;
+    {
+        std::lock_guard<std::mutex> lock(receivedDataMutex_);
         
-        size_t offset = i * chunkSize_;
-        size_t chunkDataSize = std::min(chunkSize_, totalSize - offset);
-        chunk.data.resize(chunkDataSize);
-        std::memcpy(chunk.data.data(), data.data() + offset, chunkDataSize);
+        auto it = assemblies_.find(transferID);
+        if (it == assemblies_.end() || it->second.receivedCount < it->second.received.size()) {
+            return false; // Not all chunks received yet
+        }
         
-        chunks.push_back(chunk);
-    }
-    
-    return chunks;
-}
-
-bool DataExchange::reassembleData(uint64_t transferID) {
-    std::lock_guard<std::mutex> lock(receivedDataMutex_);
-    
-    auto chunksIt = receivedChunks_.find(transferID);
-    if (chunksIt == receivedChunks_.end()) {
-        return false;
+        // Chunks rebuilt from parity, or taken before the root arrived, had no
+        // proof of their own
+        if (it->second.unproven && it->second.rootKnown && !bufferMatchesRootLocked(it->second)) {
+            corruptChunks_++;
+            failed = true;
+        }
+        
+        if (it->second.journaled && transferJournal_) {
+            transferJournal_->remove(transferID);
+        }
+        
+        // A delta push delivered a script; the data is rebuilt from its basis
+        auto deltaIt = incomingDeltas_.find(transferID);
+        if (deltaIt != incomingDeltas_.end() && !failed) {
+            static const std::vector<uint8_t> noBasis;
+            auto basisIt = completedData_.find(deltaIt->second.basisID);
+            const std::vector<uint8_t>& basis = basisIt != completedData_.end() ? *basisIt->second : noBasis;
+            std::vector<uint8_t> rebuilt;
+            failed = !applyDelta(basis.data(), basis.size(), deltaIt->second.blockSize, it->second.buffer.data(),
+                                 it->second.buffer.size(), rebuilt);
+            incomingDeltas_.erase(deltaIt);
+            it->second.buffer.swap(rebuilt);
+        }
+        
+        if (failed) {
+            it->second.failed = true;
+            std::vector<uint8_t>().swap(it->second.buffer);
+        } else {
+            reassembled = std::make_shared<const std::vector<uint8_t>>(std::move(it->second.buffer));
+            completedData_[transferID] = reassembled;
+            assemblies_.erase(it);
+            incomingManifests_.erase(transferID);
+        }
     }
     
-    const auto& chunks = chunksIt->second;
-    if (chunks.empty()) {
+    // Callbacks run without receivedDataMutex_ so they may call back in
+    if (failed) {
+        markTransferComplete(transferID, false);
         return false;
     }
     
-    // Check if we have all chunks
-    uint32_t expectedChunks = chunks.begin()->second.totalChunks;
-    if (chunks.size() < expectedChunks) {
-        return false; // Not all chunks received yet
-    }
-    
-    // Reassemble data
-    std::vector<uint8_t> reassembled;
-    for (uint32_t i = 0; i < expectedChunks; ++i) {
-        auto it = chunks.find(i);
-        if (it == chunks.end()) {
-            return false; // Missing chunk
-        }
-        reassembled.insert(reassembled.end(), it->second.data.begin(), it->second.data.end());
-    }
-    
-    completedData_[transferID] = reassembled;
-    
-    // Notify callback (release lock first)
     std::string dataType;
     NodeID sourceID = 0;
     {
@@ -318,11 +1545,12 @@ bool DataExchange::reassembleData(uint64_t transferID) {
         if (transferIt != incomingTransfers_.end()) {
             sourceID = transferIt->second.sourceID;
             dataType = transferIt->second.dataType;
+            transferIt->second.totalSize = reassembled->size();   // A delta's chunks added up to the script
         }
     }
     
     if (onDataReceived_ && sourceID != 0) {
-        onDataReceived_(sourceID, reassembled, dataType);
+        onDataReceived_(sourceID, *reassembled, dataType);
     }
     
     return true;
@@ -342,11 +1570,617 @@ void DataExchange::updateTransferProgress(uint64_t transferID, size_t bytesTrans
     }
 }
 
-void DataExchange::markTransferComplete(uint64_t transferID, bool success) {
+void DataExchange::admitTransfersLocked() {
+    for (uint64_t transferID : scheduler_.admit()) {
+        auto it = outgoingTransfers_.find(transferID);
+        if (it != outgoingTransfers_.end() && it->second.status == TransferStatus::PENDING) {
+            it->second.status = TransferStatus::IN_PROGRESS;
+            it->second.lastUpdate = std::chrono::system_clock::now();
+        }
+    }
+}
+
+void DataExchange::pumpTransfers() {
+    while (true) {
+        uint64_t transferID = 0;
+        ChunkHeader header;
+        NodeID targetID = 0;
+        ChunkSource source;
+        std::shared_ptr<const MerkleTree> tree;
+        uint32_t epoch = 0;
+        bool windowFilled = false;
+        bool parity = false;
+        
+        // Reserve the next chunk of whichever running push has the turn
+        {
+            std::lock_guard<std::mutex> lock(transfersMutex_);
+            
+            // A destination's window is shared by its unfinished pushes in
+            // proportion to their weights; a push keeps its share until its
+            // chunks are acknowledged, so another cannot refill the window
+            // ahead of the rest of them
+            std::map<NodeID, size_t> destinationInFlight;
+            std::map<NodeID, size_t> destinationWeight;
+            for (uint64_t id : scheduler_.getActive()) {
+                auto it = outgoingStreams_.find(id);
+                auto transferIt = outgoingTransfers_.find(id);
+                if (it != outgoingStreams_.end() && transferIt != outgoingTransfers_.end()) {
+                    destinationInFlight[it->second.targetID] += it->second.inFlight;
+                    if (it->second.nextChunk < it->second.totalChunks || it->second.inFlight > 0) {
+                        destinationWeight[it->second.targetID] += TransferScheduler::weight(transferIt->second.priority);
+                    }
+                }
+            }
+            
+            const size_t window = chunkWindow_;
+            auto shareOf = [&](const OutgoingStream& stream, const DataTransfer& transfer) {
+                return std::max<size_t>(window * TransferScheduler::weight(transfer.priority) /
+                                        std::max<size_t>(destinationWeight[stream.targetID], 1), 1);
+            };
+            transferID = scheduler_.next([&](uint64_t id) -> size_t {
+                auto it = outgoingStreams_.find(id);
+                auto transferIt = outgoingTransfers_.find(id);
+                if (it == outgoingStreams_.end() || transferIt == outgoingTransfers_.end() ||
+                    transferIt->second.status != TransferStatus::IN_PROGRESS) {
+                    return 0;
+                }
+                const OutgoingStream& stream = it->second;
+                if (stream.awaitingSetup || stream.nextChunk >= stream.totalChunks ||
+                    stream.inFlight >= shareOf(stream, transferIt->second) ||
+                    destinationInFlight[stream.targetID] >= window) {
+                    return 0;
+                }
+                uint32_t sequence = stream.sequences.empty() ? stream.nextChunk : stream.sequences[stream.nextChunk];
+                if (!stream.offsets.empty()) {
+                    return std::max<size_t>(stream.sizes[sequence], 1);
+                }
+                uint64_t offset = static_cast<uint64_t>(sequence) * stream.chunkSize;
+                return static_cast<size_t>(std::min<uint64_t>(stream.chunkSize, stream.totalSize - offset));
+            });
+            if (transferID == 0) {
+                return;
+            }
+            OutgoingStream& stream = outgoingStreams_[transferID];
+            
+            header.transferID = transferID;
+            header.sequence = stream.sequences.empty() ? stream.nextChunk : stream.sequences[stream.nextChunk];
+            if (stream.offsets.empty()) {
+                header.totalChunks = static_cast<uint32_t>((stream.totalSize + stream.chunkSize - 1) / stream.chunkSize);
+                header.offset = static_cast<uint64_t>(header.sequence) * stream.chunkSize;
+                header.length = static_cast<uint32_t>(std::min<uint64_t>(stream.chunkSize, stream.totalSize - header.offset));
+            } else {
+                header.totalChunks = static_cast<uint32_t>(stream.sizes.size());
+                header.offset = stream.offsets[header.sequence];
+                header.length = stream.sizes[header.sequence];
+            }
+            header.flags = header.sequence == header.totalChunks - 1 ? CHUNK_FLAG_LAST : 0;
+            stream.nextChunk++;
+            stream.inFlight++;
+            windowFilled = stream.inFlight >= shareOf(stream, outgoingTransfers_[transferID]) ||
+                           destinationInFlight[stream.targetID] + 1 >= window || stream.nextChunk == stream.totalChunks;
+            targetID = stream.targetID;
+            source = stream.source;
+            tree = stream.tree;
+            epoch = stream.epoch;
+            
+            // Parity groups follow the initial fixed-size plan; a resumed
+            // plan only sends what the receiver asked for
+            parity = stream.groupChunks > 0 && stream.sequences.empty() && stream.offsets.empty();
+        }
+        
+        if (tree) {
+            header.flags |= CHUNK_FLAG_PROOF;
+            header.root = tree->root();
+            header.proof = tree->proof(header.sequence);
+        }
+        
+        // The source is read outside the lock, straight into the frame
+        Message msg = makeChunkMessage(targetID, header);
+        uint8_t* payload = msg.payload.data() + header.encodedSize();
+        if (source(static_cast<size_t>(header.offset), payload, header.length) != header.length) {
+            completeChunk(transferID, epoch, 0, false);
+            continue;
+        }
+        setChunkDigest(header, payload, (header.flags & CHUNK_FLAG_DIGEST) != 0);
+        encodeChunkHeader(header, msg.payload.data());
+        
+        size_t bytes = header.length;
+        sentDataSize_ += bytes;
+        bool sent = false;
+        if (reliableMessaging_) {
+            // Nothing follows this chunk until it is acknowledged, so the
+            // receiver should not hold the ACK back
+            if (windowFilled) {
+                msg.flags |= FRAME_FLAG_ACK_NOW;
+            }
+            
+            auto completion = guardCompletion([this, transferID, epoch, bytes](uint64_t, bool delivered) {
+                completeChunk(transferID, epoch, bytes, delivered);
+                pumpTransfers();
+            });
+            sent = reliableMessaging_->sendReliableMessage(targetID, msg, std::string(), completion) != 0;
+            if (!sent) {
+                completeChunk(transferID, epoch, 0, false);
+            }
+        } else {
+            // Without acknowledgments a routed chunk counts as done once sent
+            sent = messageRouter_->routeMessage(msg, RoutingStrategy::SHORTEST_PATH);
+            completeChunk(transferID, epoch, bytes, sent);
+        }
+        
+        if (!sent) {
+            continue;
+        }
+        
+        // After the send, so a group's parity never overtakes its last chunk
+        if (parity) {
+            collectParity(transferID, epoch, header, payload);
+        }
+    }
+}
+
+void DataExchange::collectParity(uint64_t transferID, uint32_t epoch, const ChunkHeader& header,
+                                 const uint8_t* payload) {
+    std::vector<uint8_t> shards;
+    NodeID targetID = 0;
+    uint32_t count = 0;
+    uint32_t groupChunks = 0;
+    uint32_t parityChunks = 0;
+    size_t totalSize = 0;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = outgoingStreams_.find(transferID);
+        if (it == outgoingStreams_.end() || it->second.epoch != epoch || it->second.groupChunks == 0) {
+            return;
+        }
+        OutgoingStream& stream = it->second;
+        
+        uint32_t group = header.sequence / stream.groupChunks;
+        uint32_t first = group * stream.groupChunks;
+        count = std::min(stream.groupChunks, header.totalChunks - first);
+        ParityGroup& pending = stream.parityGroups[group];
+        if (pending.shards.empty()) {
+            pending.shards.assign(static_cast<size_t>(count) * stream.chunkSize, 0);
+        }
+        std::memcpy(pending.shards.data() + (header.sequence - first) * stream.chunkSize, payload, header.length);
+        if (++pending.filled < count) {
+            return;
+        }
+        
+        // The count in force when the group fills is the one it gets
+        shards = std::move(pending.shards);
+        stream.parityGroups.erase(group);
+        targetID = stream.targetID;
+        groupChunks = stream.groupChunks;
+        parityChunks = stream.parityChunks;
+        totalSize = stream.totalSize;
+    }
+    
+    if (parityChunks > 0) {
+        sendParity(transferID, targetID, header, std::move(shards), count, groupChunks, parityChunks, totalSize);
+    }
+}
+
+void DataExchange::sendParity(uint64_t transferID, NodeID targetID, const ChunkHeader& first,
+                              std::vector<uint8_t> shards, uint32_t count, uint32_t groupChunks,
+                              uint32_t parityChunks, size_t totalSize) {
+    const size_t shardSize = shards.size() / count;
+    uint32_t group = first.sequence / groupChunks;
+    
+    // Parity is encoded straight into the frames
+    std::vector<ChunkHeader> headers(parityChunks);
+    std::vector<Message> messages;
+    std::vector<uint8_t*> parity;
+    for (uint32_t i = 0; i < parityChunks; ++i) {
+        ChunkHeader& header = headers[i];
+        header.transferID = transferID;
+        header.sequence = group;
+        header.totalChunks = first.totalChunks;
+        header.flags = CHUNK_FLAG_PARITY;
+        header.offset = static_cast<uint64_t>(group) * groupChunks * shardSize;
+        header.length = static_cast<uint32_t>(shardSize);
+        header.groupChunks = static_cast<uint8_t>(groupChunks);
+        header.parityChunks = static_cast<uint8_t>(parityChunks);
+        header.parityIndex = static_cast<uint8_t>(i);
+        header.totalSize = totalSize;
+        messages.push_back(makeChunkMessage(targetID, header));
+        parity.push_back(messages.back().payload.data() + header.encodedSize());
+    }
+    
+    std::vector<const uint8_t*> data;
+    for (uint32_t i = 0; i < count; ++i) {
+        data.push_back(shards.data() + i * shardSize);
+    }
+    ReedSolomon(count, parityChunks).encode(data, parity, shardSize);
+    
+    // Parity sits outside the chunk window: losing it only costs the
+    // repair it would have allowed
+    for (uint32_t i = 0; i < parityChunks; ++i) {
+        setChunkDigest(headers[i], parity[i], (headers[i].flags & CHUNK_FLAG_DIGEST) != 0);
+        encodeChunkHeader(headers[i], messages[i].payload.data());
+        bool sent = reliableMessaging_ ? reliableMessaging_->sendReliableMessage(targetID, messages[i]) != 0
+                                       : messageRouter_->routeMessage(messages[i], RoutingStrategy::SHORTEST_PATH);
+        if (sent) {
+            parityChunks_++;
+        }
+    }
+}
+
+void DataExchange::pumpSwarm(uint64_t contentID) {
+    std::map<NodeID, ChunkRequest> requests;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = swarms_.find(contentID);
+        if (it == swarms_.end()) {
+            return;
+        }
+        
+        // One request message per source
+        for (const SwarmRequest& r : it->second.scheduler.schedule(std::chrono::steady_clock::now())) {
+            ChunkRequest& request = requests[r.sourceID];
+            request.contentID = contentID;
+            request.chunkSize = it->second.chunkSize;
+            request.chunks.push_back(r.chunk);
+        }
+    }
+    
+    // A lost request is not retried here: its deadline expires and the
+    // chunks are rescheduled, possibly on another source
+    for (const auto& pair : requests) {
+        sendControlMessage(pair.first, MessageType::TRANSFER_REQUEST, encodeChunkRequest(pair.second));
+    }
+}
+
+void DataExchange::rejectCorruptChunk(uint64_t transferID, NodeID sourceID, uint32_t sequence) {
+    corruptChunks_++;
+    rejectedChunks_++;
+    
+    bool swarm = false;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = swarms_.find(transferID);
+        if (it != swarms_.end()) {
+            it->second.scheduler.onChunkRejected(sourceID, sequence);
+            swarm = true;
+        }
+    }
+    if (swarm) {
+        pumpSwarm(transferID);
+    } else {
+        failIncomingPush(transferID, sourceID);
+    }
+}
+
+bool DataExchange::resumePush(const ChunkRequest& request, NodeID requesterID) {
+    uint64_t transferID = request.contentID;
+    TransferResume resume;
+    resume.transferID = transferID;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto transferIt = outgoingTransfers_.find(transferID);
+        OutgoingStream* stream = nullptr;
+        if (transferIt != outgoingTransfers_.end() && transferIt->second.destinationID == requesterID &&
+            (transferIt->second.status == TransferStatus::IN_PROGRESS ||
+             transferIt->second.status == TransferStatus::PENDING ||
+             transferIt->second.status == TransferStatus::FAILED)) {
+            auto it = outgoingStreams_.find(transferID);
+            auto suspendedIt = suspendedStreams_.find(transferID);
+            if (it != outgoingStreams_.end()) {
+                stream = &it->second;
+            } else if (suspendedIt != suspendedStreams_.end()) {
+                stream = &(outgoingStreams_[transferID] = std::move(suspendedIt->second));
+                suspendedStreams_.erase(suspendedIt);
+            }
+        }
+        
+        if (stream) {
+            uint64_t chunkCount = stream->offsets.empty() ? (stream->totalSize + stream->chunkSize - 1) / stream->chunkSize
+                                                          : stream->sizes.size();
+            std::vector<uint32_t> sequences;
+            for (uint32_t sequence : request.chunks) {
+                if (sequence < chunkCount) {
+                    sequences.push_back(sequence);
+                }
+            }
+            
+            // The old plan is dropped; its chunks still in flight complete
+            // under the previous epoch and are ignored
+            stream->sequences = std::move(sequences);
+            stream->parityGroups.clear();
+            stream->totalChunks = static_cast<uint32_t>(stream->sequences.size());
+            stream->nextChunk = 0;
+            stream->inFlight = 0;
+            stream->completed = 0;
+            stream->epoch++;
+            transferIt->second.lastUpdate = std::chrono::system_clock::now();
+            
+            resume.accepted = true;
+            resume.totalSize = stream->totalSize;
+            resume.chunkCount = stream->totalChunks;
+            if (stream->totalChunks == 0) {
+                transferIt->second.status = TransferStatus::IN_PROGRESS;
+                outgoingStreams_.erase(transferID);
+            } else {
+                // A failed push gave up its slot and queues for one again
+                size_t remaining = 0;
+                for (uint32_t sequence : stream->sequences) {
+                    remaining += stream->offsets.empty() ? stream->chunkSize : stream->sizes[sequence];
+                }
+                scheduler_.enqueue(transferID, requesterID, transferIt->second.priority, remaining);
+                transferIt->second.status = scheduler_.isActive(transferID) ? TransferStatus::IN_PROGRESS
+                                                                            : TransferStatus::PENDING;
+                admitTransfersLocked();
+            }
+        }
+    }
+    
+    sendControlMessage(requesterID, MessageType::TRANSFER_RESPONSE, encodeTransferResume(resume));
+    if (!resume.accepted) {
+        return false;
+    }
+    
+    resumedTransfers_++;
+    if (resume.chunkCount == 0) {
+        markTransferComplete(transferID, true);
+    } else {
+        pumpTransfers();
+    }
+    return true;
+}
+
+void DataExchange::journalChunk(uint64_t transferID, const ChunkView& chunk) {
+    std::shared_ptr<TransferJournal> journal = transferJournal_;
+    const ChunkHeader& header = chunk.header;
+    if (!journal || !journal->writeChunk(transferID, header.offset, chunk.payload, chunk.payloadSize)) {
+        return;
+    }
+    
+    // Only chunks already written may appear in a checkpointed bitmap
+    JournalEntry entry;
+    uint32_t persistedCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(receivedDataMutex_);
+        auto it = assemblies_.find(transferID);
+        if (it == assemblies_.end() || !it->second.journaled || it->second.persisted[header.sequence]) {
+            return;
+        }
+        IncomingAssembly& assembly = it->second;
+        assembly.persisted[header.sequence] = true;
+        assembly.persistedCount++;
+        if (++assembly.uncheckpointed < DATA_RESUME_CHECKPOINT_CHUNKS) {
+            return;
+        }
+        assembly.uncheckpointed = 0;
+        entry.received = assembly.persisted;
+        entry.root = assembly.root;
+        entry.rootKnown = assembly.rootKnown;
+        persistedCount = assembly.persistedCount;
+    }
+    
+    entry.transferID = transferID;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = incomingTransfers_.find(transferID);
+        if (it == incomingTransfers_.end()) {
+            return;
+        }
+        entry.sourceID = it->second.sourceID;
+        entry.totalSize = it->second.totalSize;
+    }
+    journal->checkpoint(entry, persistedCount);
+}
+
+void DataExchange::failIncomingPush(uint64_t transferID, NodeID sourceID) {
+    {
+        std::lock_guard<std::mutex> lock(receivedDataMutex_);
+        IncomingAssembly& assembly = assemblies_[transferID];
+        assembly.failed = true;
+        std::vector<uint8_t>().swap(assembly.buffer);
+        if (assembly.journaled && transferJournal_) {
+            transferJournal_->remove(transferID);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        DataTransfer& transfer = incomingTransfers_[transferID];
+        if (transfer.transferID == 0) {
+            transfer.transferID = transferID;
+            transfer.sourceID = sourceID;
+            transfer.destinationID = node_->getID();
+            transfer.startTime = std::chrono::system_clock::now();
+        }
+    }
+    markTransferComplete(transferID, false);
+}
+
+std::shared_ptr<const MerkleTree> DataExchange::buildTree(const ChunkSource& source, size_t totalSize,
+                                                          size_t chunkSize) const {
+    std::vector<MerkleHash> leaves;
+    leaves.reserve((totalSize + chunkSize - 1) / chunkSize);
+    std::vector<uint8_t> buffer(std::min(chunkSize, totalSize));
+    for (size_t offset = 0; offset < totalSize; offset += chunkSize) {
+        size_t length = std::min(chunkSize, totalSize - offset);
+        if (source(offset, buffer.data(), length) != length) {
+            return nullptr;
+        }
+        leaves.push_back(hashMerkleLeaf(buffer.data(), length, offset));
+    }
+    return std::make_shared<MerkleTree>(std::move(leaves));
+}
+
+std::shared_ptr<const MerkleTree> DataExchange::contentTree(uint64_t contentID, uint32_t chunkSize) {
+    if (!merkleProofs_) {
+        return nullptr;
+    }
+    
+    PublishedContent content;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = published_.find(contentID);
+        if (it == published_.end()) {
+            return nullptr;
+        }
+        auto treeIt = it->second.trees.find(chunkSize);
+        if (treeIt != it->second.trees.end()) {
+            return treeIt->second;
+        }
+        content = it->second;
+    }
+    
+    // Hashing the whole content happens once per chunk size, outside the lock
+    std::shared_ptr<const MerkleTree> tree = buildTree(content.source, content.totalSize, chunkSize);
+    if (!tree) {
+        return nullptr;
+    }
+    
     std::lock_guard<std::mutex> lock(transfersMutex_);
+    auto it = published_.find(contentID);
+    if (it == published_.end()) {
+        return tree;
+    }
+    return it->second.trees.emplace(chunkSize, tree).first->second;
+}
+
+bool DataExchange::sendControlMessage(NodeID targetID, MessageType type, const std::vector<uint8_t>& payload,
+                                      std::function<void(uint64_t, bool)> completion) {
+    Message msg;
+    msg.type = type;
+    msg.senderID = node_->getID();
+    msg.receiverID = targetID;
+    msg.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    msg.payload = payload;
+    
+    if (reliableMessaging_) {
+        // A sender waiting on the completion should not wait out a delayed ACK too
+        if (completion) {
+            msg.flags |= FRAME_FLAG_ACK_NOW;
+        }
+        return reliableMessaging_->sendReliableMessage(targetID, msg, std::string(), std::move(completion)) != 0;
+    }
+    return messageRouter_->routeMessage(msg, RoutingStrategy::SHORTEST_PATH);
+}
+
+void DataExchange::releaseOfferLocked(uint64_t transferID) {
+    auto it = offers_.find(transferID);
+    if (it == offers_.end()) {
+        return;
+    }
+    
+    std::shared_ptr<ChunkStore> store = chunkStore_;
+    if (store) {
+        store->releaseManifest(it->second);
+    }
+    offers_.erase(it);
+}
+
+void DataExchange::completeChunk(uint64_t transferID, uint32_t epoch, size_t bytes, bool success) {
+    bool finished = false;
+    bool failed = false;
+    
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = outgoingStreams_.find(transferID);
+        if (it == outgoingStreams_.end() || it->second.epoch != epoch) {
+            return;
+        }
+        OutgoingStream& stream = it->second;
+        stream.inFlight--;
+        
+        auto transferIt = outgoingTransfers_.find(transferID);
+        bool active = transferIt != outgoingTransfers_.end() &&
+                      transferIt->second.status == TransferStatus::IN_PROGRESS;
+        if (success) {
+            stream.completed++;
+            finished = active && stream.completed == stream.totalChunks;
+        } else {
+            failed = active;
+        }
+        
+        // Late completions of a failed or cancelled transfer only drain it;
+        // a failed push keeps its source until cleanup in case the receiver
+        // asks to resume
+        if (failed) {
+            suspendedStreams_[transferID] = std::move(stream);
+            outgoingStreams_.erase(it);
+        } else if (finished || (!active && stream.inFlight == 0)) {
+            outgoingStreams_.erase(it);
+        }
+    }
+    
+    if (success) {
+        updateTransferProgress(transferID, bytes);
+    }
+    if (finished || failed) {
+        markTransferComplete(transferID, finished);
+    }
+}
+
+std::function<void(uint64_t, bool)> DataExchange::guardCompletion(std::function<void(uint64_t, bool)> completion) {
+    std::weak_ptr<CompletionGuard> weakGuard = completionGuard_;
+    return [weakGuard, completion](uint64_t messageID, bool delivered) {
+        std::shared_ptr<CompletionGuard> guard = weakGuard.lock();
+        if (!guard) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(guard->mutex);
+            if (!guard->alive) {
+                return;
+            }
+            guard->running++;
+        }
+        
+        completion(messageID, delivered);
+        
+        std::lock_guard<std::mutex> lock(guard->mutex);
+        if (--guard->running == 0) {
+            guard->idle.notify_all();
+        }
+    };
+}
+
+void DataExchange::completeSetup(uint64_t transferID, bool delivered) {
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        auto it = outgoingStreams_.find(transferID);
+        if (it == outgoingStreams_.end() || !it->second.awaitingSetup) {
+            return;
+        }
+        
+        // A receiver that never got the root has nothing to resume from
+        it->second.awaitingSetup = false;
+        if (!delivered) {
+            outgoingStreams_.erase(it);
+        }
+    }
+    
+    if (delivered) {
+        pumpTransfers();
+    } else {
+        markTransferComplete(transferID, false);
+    }
+}
+
+void DataExchange::markTransferComplete(uint64_t transferID, bool success) {
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex_);
+        notify = markTransferCompleteLocked(transferID, success);
+    }
     
+    // Outside transfersMutex_ so the callback may start or query transfers
+    if (notify && onTransferComplete_) {
+        onTransferComplete_(transferID, success);
+    }
+}
+
+bool DataExchange::markTransferCompleteLocked(uint64_t transferID, bool success) {
+    bool outgoing = false;
     auto it = outgoingTransfers_.find(transferID);
     if (it != outgoingTransfers_.end()) {
+        outgoing = true;
         it->second.status = success ? TransferStatus::COMPLETED : TransferStatus::FAILED;
         it->second.lastUpdate = std::chrono::system_clock::now();
         
@@ -356,9 +2190,13 @@ void DataExchange::markTransferComplete(uint64_t transferID, bool success) {
             failedTransfers_++;
         }
         
-        if (onTransferComplete_) {
-            onTransferComplete_(transferID, success);
+        releaseOfferLocked(transferID);
+        pendingDeltas_.erase(transferID);
+        if (success) {
+            suspendedStreams_.erase(transferID);
         }
+        scheduler_.remove(transferID);
+        admitTransfersLocked();
     }
     
     it = incomingTransfers_.find(transferID);
@@ -366,6 +2204,8 @@ void DataExchange::markTransferComplete(uint64_t transferID, bool success) {
         it->second.status = success ? TransferStatus::COMPLETED : TransferStatus::FAILED;
         it->second.lastUpdate = std::chrono::system_clock::now();
     }
+    swarms_.erase(transferID);
+    return outgoing;
 }
 
 } // namespace P2POverlay
@@ -0,0 +1,130 @@
+#include "DedupWindow.h"
+#include <algorithm>
+
+namespace P2POverlay {
+
+DedupWindow::DedupWindow(size_t capacity)
+    : capacity_(std::max<size_t>((capacity + 63) / 64, 1) * 64), cumulative_(1), highest_(0), outOfOrder_(0) {
+    bits_.assign(capacity_ / 64, 0);
+}
+
+bool DedupWindow::insert(uint64_t sequence) {
+    if (sequence < cumulative_ || !inWindow(sequence)) {
+        return false;
+    }
+    
+    if (sequence == cumulative_) {
+        cumulative_++;
+        absorbContiguous();
+        return true;
+    }
+    
+    if (testBit(sequence)) {
+        return false;
+    }
+    
+    setBit(sequence);
+    outOfOrder_++;
+    highest_ = std::max(highest_, sequence);
+    return true;
+}
+
+bool DedupWindow::contains(uint64_t sequence) const {
+    if (sequence < cumulative_) {
+        return true;
+    }
+    return inWindow(sequence) && testBit(sequence);
+}
+
+bool DedupWindow::inWindow(uint64_t sequence) const {
+    return sequence < cumulative_ || sequence - cumulative_ < capacity_;
+}
+
+void DedupWindow::advanceTo(uint64_t sequence) {
+    if (sequence <= cumulative_) {
+        return;
+    }
+    
+    // A jump past the whole window invalidates every tracked bit
+    if (sequence - cumulative_ >= capacity_) {
+        std::fill(bits_.begin(), bits_.end(), 0);
+        outOfOrder_ = 0;
+        cumulative_ = sequence;
+        return;
+    }
+    
+    while (cumulative_ < sequence) {
+        if (testBit(cumulative_)) {
+            clearBit(cumulative_);
+            outOfOrder_--;
+        }
+        cumulative_++;
+    }
+    absorbContiguous();
+}
+
+void DedupWindow::reset() {
+    std::fill(bits_.begin(), bits_.end(), 0);
+    cumulative_ = 1;
+    highest_ = 0;
+    outOfOrder_ = 0;
+}
+
+std::vector<SackRange> DedupWindow::getRanges(size_t maxRanges) const {
+    std::vector<SackRange> ranges;
+    if (outOfOrder_ == 0) {
+        return ranges;
+    }
+    
+    // Bits can only be set between the cumulative point and highest_
+    size_t remaining = outOfOrder_;
+    for (uint64_t sequence = cumulative_ + 1; sequence <= highest_ && remaining > 0; ++sequence) {
+        uint64_t index = sequence % capacity_;
+        if ((index & 63) == 0 && bits_[index / 64] == 0) {
+            sequence += 63;
+            continue;
+        }
+        if (!testBit(sequence)) {
+            continue;
+        }
+        
+        remaining--;
+        if (!ranges.empty() && ranges.back().last + 1 == sequence) {
+            ranges.back().last = sequence;
+        } else if (ranges.size() < maxRanges) {
+            ranges.push_back({sequence, sequence});
+        } else {
+            break;
+        }
+    }
+    return ranges;
+}
+
+size_t DedupWindow::getMemoryUsage() const {
+    return sizeof(*this) + bits_.capacity() * sizeof(uint64_t);
+}
+
+bool DedupWindow::testBit(uint64_t sequence) const {
+    uint64_t index = sequence % capacity_;
+    return (bits_[index / 64] >> (index & 63)) & 1;
+}
+
+void DedupWindow::setBit(uint64_t sequence) {
+    uint64_t index = sequence % capacity_;
+    bits_[index / 64] |= uint64_t(1) << (index & 63);
+}
+
+void DedupWindow::clearBit(uint64_t sequence) {
+    uint64_t index = sequence % capacity_;
+    bits_[index / 64] &= ~(uint64_t(1) << (index & 63));
+}
+
+void DedupWindow::absorbContiguous() {
+    while (outOfOrder_ > 0 && testBit(cumulative_)) {
+        clearBit(cumulative_);
+        outOfOrder_--;
+        cumulative_++;
+    }
+}
+
+} // namespace P2POverlay
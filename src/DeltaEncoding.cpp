@@ -0,0 +1,395 @@
+#include "DeltaEncoding.h"
+#include "ChunkStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// The AVX2 and SSSE3 checksum kernels are compiled whatever the build
+// targets, and the widest one the CPU runs is picked at run time
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define P2P_HAVE_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace P2POverlay {
+
+namespace {
+
+constexpr uint8_t DELTA_OP_COPY = 1;
+constexpr uint8_t DELTA_OP_LITERAL = 2;
+
+template <typename T>
+uint8_t* writeValue(uint8_t* out, T value) {
+    std::memcpy(out, &value, sizeof(T));
+    return out + sizeof(T);
+}
+
+template <typename T>
+const uint8_t* readValue(const uint8_t* in, T& value) {
+    std::memcpy(&value, in, sizeof(T));
+    return in + sizeof(T);
+}
+
+template <typename T>
+void appendValue(std::vector<uint8_t>& out, T value) {
+    size_t size = out.size();
+    out.resize(size + sizeof(T));
+    std::memcpy(out.data() + size, &value, sizeof(T));
+}
+
+uint64_t strongHash(const uint8_t* data, size_t size) {
+    return hashChunk(data, size).high;
+}
+
+// Block sum kernels: each adds the sums of the leading bytes it handles to
+// s1 and s2 and returns how many, leaving the rest to the byte loop. Both
+// sums only matter mod 2^16, so 32-bit sums may wrap. Over a vector of n
+// bytes, s2 gains n times the s1 before it plus the bytes weighted n..1,
+// which is what the multiply-adds compute
+using BlockSumsKernel = size_t (*)(const uint8_t*, size_t, uint32_t&, uint32_t&);
+
+size_t blockSumsPortable(const uint8_t*, size_t, uint32_t&, uint32_t&) {
+    return 0;
+}
+
+#ifdef P2P_HAVE_X86_DISPATCH
+__attribute__((target("avx2")))
+size_t blockSumsAvx2(const uint8_t* data, size_t size, uint32_t& s1, uint32_t& s2) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                             16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    __m256i sum = zero;
+    __m256i prefix = zero;
+    __m256i weighted = zero;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        prefix = _mm256_add_epi32(prefix, sum);
+        sum = _mm256_add_epi32(sum, _mm256_sad_epu8(bytes, zero));
+        weighted = _mm256_add_epi32(weighted, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+    }
+    alignas(32) uint32_t lanes[3][8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[0]), sum);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[1]), prefix);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[2]), weighted);
+    for (int lane = 0; lane < 8; ++lane) {
+        s1 += lanes[0][lane];
+        s2 += 32 * lanes[1][lane] + lanes[2][lane];
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+size_t blockSumsSsse3(const uint8_t* data, size_t size, uint32_t& s1, uint32_t& s2) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i weights = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    __m128i sum = zero;
+    __m128i prefix = zero;
+    __m128i weighted = zero;
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        prefix = _mm_add_epi32(prefix, sum);
+        sum = _mm_add_epi32(sum, _mm_sad_epu8(bytes, zero));
+        weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_maddubs_epi16(bytes, weights), ones));
+    }
+    alignas(16) uint32_t lanes[3][4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[0]), sum);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[1]), prefix);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[2]), weighted);
+    for (int lane = 0; lane < 4; ++lane) {
+        s1 += lanes[0][lane];
+        s2 += 16 * lanes[1][lane] + lanes[2][lane];
+    }
+    return i;
+}
+#endif
+
+BlockSumsKernel selectBlockSums() {
+#ifdef P2P_HAVE_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return blockSumsAvx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return blockSumsSsse3;
+    }
+#endif
+    return blockSumsPortable;
+}
+
+// s1 and s2 of a block
+void blockSums(const uint8_t* data, size_t size, uint32_t& s1, uint32_t& s2) {
+    static const BlockSumsKernel kernel = selectBlockSums();
+    s1 = 0;
+    s2 = 0;
+    size_t i = kernel(data, size, s1, s2);
+    for (; i < size; ++i) {
+        s1 += data[i];
+        s2 += s1;
+    }
+}
+
+void appendLiteral(std::vector<uint8_t>& out, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        uint32_t length = static_cast<uint32_t>(std::min<size_t>(size, UINT32_MAX));
+        out.push_back(DELTA_OP_LITERAL);
+        appendValue(out, length);
+        out.insert(out.end(), data, data + length);
+        data += length;
+        size -= length;
+    }
+}
+
+} // namespace
+
+uint32_t weakChecksum(const uint8_t* data, size_t size) {
+    uint32_t s1 = 0;
+    uint32_t s2 = 0;
+    blockSums(data, size, s1, s2);
+    return (s1 & 0xFFFF) | (s2 << 16);
+}
+
+void RollingChecksum::reset(const uint8_t* data, size_t size) {
+    blockSums(data, size, s1_, s2_);
+    size_ = size;
+}
+
+std::vector<uint8_t> encodeDeltaSignatures(const DeltaSignatures& signatures) {
+    uint32_t count = static_cast<uint32_t>(signatures.blocks.size());
+    std::vector<uint8_t> data(sizeof(uint64_t) + 2 * sizeof(uint32_t) + count * (sizeof(uint32_t) + sizeof(uint64_t)));
+    uint8_t* out = data.data();
+    out = writeValue(out, signatures.transferID);
+    out = writeValue(out, signatures.blockSize);
+    out = writeValue(out, count);
+    for (const BlockSignature& block : signatures.blocks) {
+        out = writeValue(out, block.weak);
+        out = writeValue(out, block.strong);
+    }
+    return data;
+}
+
+bool decodeDeltaSignatures(const uint8_t* data, size_t size, DeltaSignatures& signatures) {
+    const size_t fixed = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    const size_t entrySize = sizeof(uint32_t) + sizeof(uint64_t);
+    if (size < fixed) {
+        return false;
+    }
+    
+    uint32_t count = 0;
+    data = readValue(data, signatures.transferID);
+    data = readValue(data, signatures.blockSize);
+    data = readValue(data, count);
+    if ((size - fixed) / entrySize != count || (size - fixed) % entrySize != 0 ||
+        (count > 0 && signatures.blockSize == 0)) {
+        return false;
+    }
+    
+    signatures.blocks.resize(count);
+    for (BlockSignature& block : signatures.blocks) {
+        data = readValue(data, block.weak);
+        data = readValue(data, block.strong);
+    }
+    return true;
+}
+
+uint32_t chooseDeltaBlockSize(uint64_t basisSize) {
+    // Larger blocks mean fewer signatures, smaller ones less resent around a change
+    uint64_t size = static_cast<uint64_t>(std::sqrt(static_cast<double>(basisSize))) & ~uint64_t(7);
+    return static_cast<uint32_t>(std::min<uint64_t>(std::max<uint64_t>(size, DELTA_MIN_BLOCK_SIZE), DELTA_MAX_BLOCK_SIZE));
+}
+
+DeltaSignatures computeSignatures(const uint8_t* basis, size_t size, uint32_t blockSize) {
+    DeltaSignatures signatures;
+    signatures.blockSize = blockSize;
+    if (blockSize == 0) {
+        return signatures;
+    }
+    signatures.blocks.resize(size / blockSize);
+    for (size_t i = 0; i < signatures.blocks.size(); ++i) {
+        const uint8_t* block = basis + i * blockSize;
+        signatures.blocks[i].weak = weakChecksum(block, blockSize);
+        signatures.blocks[i].strong = strongHash(block, blockSize);
+    }
+    return signatures;
+}
+
+std::vector<uint8_t> encodeDeltaOffer(const DeltaOffer& offer) {
+    uint16_t typeLength = static_cast<uint16_t>(std::min<size_t>(offer.dataType.size(), UINT16_MAX));
+    std::vector<uint8_t> data(3 * sizeof(uint64_t) + sizeof(uint16_t) + typeLength);
+    uint8_t* out = data.data();
+    out = writeValue(out, offer.transferID);
+    out = writeValue(out, offer.basisID);
+    out = writeValue(out, offer.totalSize);
+    out = writeValue(out, typeLength);
+    std::memcpy(out, offer.dataType.data(), typeLength);
+    return data;
+}
+
+bool decodeDeltaOffer(const uint8_t* data, size_t size, DeltaOffer& offer) {
+    const size_t fixed = 3 * sizeof(uint64_t) + sizeof(uint16_t);
+    if (size < fixed) {
+        return false;
+    }
+    
+    uint16_t typeLength = 0;
+    data = readValue(data, offer.transferID);
+    data = readValue(data, offer.basisID);
+    data = readValue(data, offer.totalSize);
+    data = readValue(data, typeLength);
+    if (size - fixed != typeLength) {
+        return false;
+    }
+    offer.dataType.assign(reinterpret_cast<const char*>(data), typeLength);
+    return true;
+}
+
+std::vector<uint8_t> encodeDelta(const DeltaSignatures& signatures, const uint8_t* data, size_t size) {
+    std::vector<uint8_t> delta;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256(data, size, digest);
+    appendValue(delta, static_cast<uint64_t>(size));
+    delta.insert(delta.end(), digest, digest + SHA256_DIGEST_SIZE);
+    
+    // Blocks by weak checksum, with a 64K-entry filter in front so most
+    // window positions cost one bit test
+    const size_t blockSize = signatures.blockSize;
+    std::vector<std::pair<uint32_t, uint32_t>> index;
+    std::vector<bool> filter(1 << 16, false);
+    index.reserve(signatures.blocks.size());
+    for (uint32_t i = 0; i < signatures.blocks.size(); ++i) {
+        index.emplace_back(signatures.blocks[i].weak, i);
+        filter[(signatures.blocks[i].weak ^ (signatures.blocks[i].weak >> 16)) & 0xFFFF] = true;
+    }
+    std::sort(index.begin(), index.end());
+    
+    size_t literalStart = 0;
+    size_t position = 0;
+    uint32_t runFirst = 0;
+    uint32_t runCount = 0;
+    auto flushRun = [&]() {
+        if (runCount > 0) {
+            delta.push_back(DELTA_OP_COPY);
+            appendValue(delta, runFirst);
+            appendValue(delta, runCount);
+            runCount = 0;
+        }
+    };
+    
+    RollingChecksum rolling;
+    if (blockSize > 0 && !index.empty() && size >= blockSize) {
+        rolling.reset(data, blockSize);
+    }
+    while (blockSize > 0 && !index.empty() && position + blockSize <= size) {
+        uint32_t weak = rolling.value();
+        int64_t match = -1;
+        if (filter[(weak ^ (weak >> 16)) & 0xFFFF]) {
+            auto range = std::equal_range(index.begin(), index.end(), std::make_pair(weak, uint32_t(0)),
+                                          [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+                                              return a.first < b.first;
+                                          });
+            if (range.first != range.second) {
+                uint64_t strong = strongHash(data + position, blockSize);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (signatures.blocks[it->second].strong != strong) {
+                        continue;
+                    }
+                    // The block after the last copied one extends the run
+                    match = it->second;
+                    if (runCount > 0 && it->second == runFirst + runCount) {
+                        break;
+                    }
+                }
+            }
+        }
+        
+        if (match >= 0) {
+            if (literalStart < position) {
+                flushRun();
+                appendLiteral(delta, data + literalStart, position - literalStart);
+            }
+            if (runCount == 0 || static_cast<uint32_t>(match) != runFirst + runCount) {
+                flushRun();
+                runFirst = static_cast<uint32_t>(match);
+            }
+            runCount++;
+            position += blockSize;
+            literalStart = position;
+            if (position + blockSize <= size) {
+                rolling.reset(data + position, blockSize);
+            }
+            continue;
+        }
+        
+        if (position + blockSize < size) {
+            rolling.roll(data[position], data[position + blockSize]);
+        }
+        position++;
+    }
+    
+    if (literalStart < size) {
+        flushRun();
+        appendLiteral(delta, data + literalStart, size - literalStart);
+    }
+    flushRun();
+    return delta;
+}
+
+bool applyDelta(const uint8_t* basis, size_t basisSize, uint32_t blockSize, const uint8_t* delta, size_t deltaSize,
+                std::vector<uint8_t>& result) {
+    const uint8_t* end = delta + deltaSize;
+    uint64_t totalSize = 0;
+    uint8_t expected[SHA256_DIGEST_SIZE];
+    if (deltaSize < sizeof(totalSize) + SHA256_DIGEST_SIZE) {
+        return false;
+    }
+    delta = readValue(delta, totalSize);
+    std::memcpy(expected, delta, SHA256_DIGEST_SIZE);
+    delta += SHA256_DIGEST_SIZE;
+    if (totalSize > DATA_MAX_TRANSFER_BYTES) {
+        return false;
+    }
+    
+    result.clear();
+    result.reserve(static_cast<size_t>(totalSize));
+    const uint64_t basisBlocks = blockSize > 0 ? basisSize / blockSize : 0;
+    while (delta < end) {
+        uint8_t op = *delta++;
+        if (op == DELTA_OP_COPY) {
+            uint32_t first = 0;
+            uint32_t count = 0;
+            if (static_cast<size_t>(end - delta) < 2 * sizeof(uint32_t)) {
+                return false;
+            }
+            delta = readValue(delta, first);
+            delta = readValue(delta, count);
+            uint64_t length = static_cast<uint64_t>(count) * blockSize;
+            if (static_cast<uint64_t>(first) + count > basisBlocks || length > totalSize - result.size()) {
+                return false;
+            }
+            const uint8_t* source = basis + static_cast<size_t>(first) * blockSize;
+            result.insert(result.end(), source, source + length);
+        } else if (op == DELTA_OP_LITERAL) {
+            uint32_t length = 0;
+            if (static_cast<size_t>(end - delta) < sizeof(length)) {
+                return false;
+            }
+            delta = readValue(delta, length);
+            if (static_cast<size_t>(end - delta) < length || length > totalSize - result.size()) {
+                return false;
+            }
+            result.insert(result.end(), delta, delta + length);
+            delta += length;
+        } else {
+            return false;
+        }
+    }
+    
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256(result.data(), result.size(), digest);
+    return result.size() == totalSize && std::memcmp(digest, expected, SHA256_DIGEST_SIZE) == 0;
+}
+
+} // namespace P2POverlay
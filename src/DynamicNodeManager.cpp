@@ -9,12 +9,32 @@
 
 namespace P2POverlay {
 
+namespace {
+
+// States whose nodes are subject to failure detection
+bool isMonitoredState(NodeState state) {
+    return state == NodeState::ACTIVE || state == NodeState::SUSPECTED;
+}
+
+} // namespace
+
 DynamicNodeManager::DynamicNodeManager(
     std::shared_ptr<Node> node,
     std::shared_ptr<NetworkManager> networkManager,
     std::shared_ptr<TopologyManager> topologyManager)
     : node_(node), networkManager_(networkManager), topologyManager_(topologyManager),
-      failureDetectionActive_(false) {
+      failureDetectionActive_(false),
+      detectionIntervalMs_(FAILURE_DETECTION_INTERVAL_SEC * 1000),
+      routingEvictionPhi_(PHI_ROUTING_EVICTION_THRESHOLD),
+      hardRemovalPhi_(PHI_HARD_REMOVAL_THRESHOLD),
+      churnWindowMs_(CHURN_COALESCE_WINDOW_MS),
+      churnBatchesApplied_(0), topologyUpdatesSent_(0) {
+    // Any frame proves liveness, but only heartbeat-spaced gaps are samples
+    failureDetector_.setMinSampleIntervalMs(FAILURE_DETECTOR_MIN_SAMPLE_INTERVAL_MS);
+    for (size_t i = 0; i < NODE_STATE_COUNT; ++i) {
+        stateHeads_[i] = nullptr;
+        stateCounts_[i] = 0;
+    }
 }
 
 DynamicNodeManager::~DynamicNodeManager() {
@@ -43,11 +63,11 @@ bool DynamicNodeManager::addNode(NodeID nodeID, const NetworkAddress& address) {
     info.failureCount = 0;
     
     // Add to registry
-    nodeRegistry_[nodeID] = info;
+    RegistryEntry& entry = insertEntry(info);
     
     // Add to topology
     if (!topologyManager_->addNode(nodeID, address)) {
-        nodeRegistry_.erase(nodeID);
+        eraseEntry(nodeRegistry_.find(nodeID));
         return false;
     }
     
@@ -58,8 +78,7 @@ bool DynamicNodeManager::addNode(NodeID nodeID, const NetworkAddress& address) {
     }
     
     // Update state
-    info.state = NodeState::ACTIVE;
-    nodeRegistry_[nodeID] = info;
+    transitionState(entry, NodeState::ACTIVE);
     
     std::cout << "Added node " << nodeID << " at " << address.toString() << std::endl;
     
@@ -68,7 +87,7 @@ bool DynamicNodeManager::addNode(NodeID nodeID, const NetworkAddress& address) {
     }
     
     // Propagate topology update
-    propagateTopologyUpdate({nodeID});
+    propagateTopologyUpdate({}, {{nodeID, address}});
     
     return true;
 }
@@ -88,15 +107,15 @@ bool DynamicNodeManager::addNodeWithValidation(NodeID nodeID, const NetworkAddre
 
 std::vector<NodeID> DynamicNodeManager::addNodesFromList(
     const std::vector<std::pair<NodeID, NetworkAddress>>& nodes) {
-    std::vector<NodeID> addedNodes;
-    
+    // Apply the whole list as one batch with a single topology update
+    std::map<NodeID, ChurnEvent> events;
     for (const auto& pair : nodes) {
-        if (addNode(pair.first, pair.second)) {
-            addedNodes.push_back(pair.first);
+        if (validateNodeAddition(pair.first, pair.second)) {
+            events[pair.first] = ChurnEvent(ChurnType::ADD, pair.second);
         }
     }
     
-    return addedNodes;
+    return applyChurnBatch(events);
 }
 
 bool DynamicNodeManager::removeNode(NodeID nodeID, bool graceful) {
@@ -108,83 +127,47 @@ bool DynamicNodeManager::removeNode(NodeID nodeID, bool graceful) {
 }
 
 bool DynamicNodeManager::removeNodeGracefully(NodeID nodeID) {
-    std::lock_guard<std::mutex> lock(nodesMutex_);
-    
-    auto it = nodeRegistry_.find(nodeID);
-    if (it == nodeRegistry_.end()) {
-        return false;
-    }
-    
-    // Update state
-    it->second.state = NodeState::LEAVING;
-    
-    // Send leave notification (would use MessageHandler)
-    // For now, we'll just remove
-    
-    // Remove from peer list
-    node_->removePeer(nodeID);
-    
-    // Disconnect
-    networkManager_->disconnectFromPeer(nodeID);
-    
-    // Remove from topology
-    topologyManager_->removeNode(nodeID);
-    
-    // Remove from registry
-    nodeRegistry_.erase(it);
-    
-    std::cout << "Gracefully removed node " << nodeID << std::endl;
-    
-    if (onNodeRemoved_) {
-        onNodeRemoved_(nodeID);
-    }
-    
-    // Repair network if needed
-    repairNetworkAfterNodeRemoval(nodeID);
-    
-    return true;
+    return !applyChurnBatch({{nodeID, ChurnEvent(ChurnType::LEAVE)}}).empty();
 }
 
 bool DynamicNodeManager::removeNodeForced(NodeID nodeID) {
-    std::lock_guard<std::mutex> lock(nodesMutex_);
-    
-    auto it = nodeRegistry_.find(nodeID);
-    if (it == nodeRegistry_.end()) {
-        return false;
+    return !applyChurnBatch({{nodeID, ChurnEvent(ChurnType::FAIL)}}).empty();
+}
+
+void DynamicNodeManager::queueNodeAddition(NodeID nodeID, const NetworkAddress& address) {
+    if (!validateNodeAddition(nodeID, address)) {
+        return;
     }
-    
-    // Mark as failed
-    it->second.state = NodeState::FAILED;
-    
-    // Remove from peer list
-    node_->removePeer(nodeID);
-    
-    // Disconnect
-    networkManager_->disconnectFromPeer(nodeID);
-    
-    // Remove from topology
-    topologyManager_->removeNode(nodeID);
-    
-    // Remove from registry
-    nodeRegistry_.erase(it);
-    
-    std::cout << "Forced removal of node " << nodeID << std::endl;
-    
-    if (onNodeFailed_) {
-        onNodeFailed_(nodeID);
+    queueChurn(nodeID, ChurnEvent(ChurnType::ADD, address));
+}
+
+void DynamicNodeManager::queueNodeRemoval(NodeID nodeID, bool graceful) {
+    queueChurn(nodeID, ChurnEvent(graceful ? ChurnType::LEAVE : ChurnType::FAIL));
+}
+
+size_t DynamicNodeManager::flushChurn() {
+    std::map<NodeID, ChurnEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(churnMutex_);
+        events.swap(pendingChurn_);
     }
     
-    // Repair network
-    repairNetworkAfterNodeRemoval(nodeID);
-    
-    return true;
+    if (events.empty()) {
+        return 0;
+    }
+    return applyChurnBatch(events).size();
+}
+
+size_t DynamicNodeManager::getPendingChurnCount() const {
+    std::lock_guard<std::mutex> lock(churnMutex_);
+    return pendingChurn_.size();
 }
 
 NodeState DynamicNodeManager::getNodeState(NodeID nodeID) const {
     std::lock_guard<std::mutex> lock(nodesMutex_);
     auto it = nodeRegistry_.find(nodeID);
     if (it != nodeRegistry_.end()) {
-        return it->second.state;
+        return it->second.info.state;
     }
     return NodeState::UNKNOWN;
 }
@@ -193,18 +176,18 @@ void DynamicNodeManager::setNodeState(NodeID nodeID, NodeState state) {
     std::lock_guard<std::mutex> lock(nodesMutex_);
     auto it = nodeRegistry_.find(nodeID);
     if (it != nodeRegistry_.end()) {
-        it->second.state = state;
+        transitionState(it->second, state);
     }
 }
 
 std::vector<NodeID> DynamicNodeManager::getNodesByState(NodeState state) const {
     std::lock_guard<std::mutex> lock(nodesMutex_);
     std::vector<NodeID> nodes;
+    nodes.reserve(stateCounts_[static_cast<size_t>(state)].load(std::memory_order_relaxed));
     
-    for (const auto& pair : nodeRegistry_) {
-        if (pair.second.state == state) {
-            nodes.push_back(pair.first);
-        }
+    // Walk only the nodes in this state
+    for (const RegistryEntry* entry = stateHeads_[static_cast<size_t>(state)]; entry; entry = entry->stateNext) {
+        nodes.push_back(entry->info.nodeID);
     }
     
     return nodes;
@@ -212,35 +195,80 @@ std::vector<NodeID> DynamicNodeManager::getNodesByState(NodeState state) const {
 
 void DynamicNodeManager::detectFailedNodes(int timeoutSeconds) {
     std::vector<NodeID> failedNodes;
+    std::vector<std::pair<NodeID, bool>> suspicionChanges;
+    double evictionPhi = routingEvictionPhi_;
+    double removalPhi = hardRemovalPhi_;
+    auto recheckInterval = std::chrono::milliseconds(detectionIntervalMs_.load());
     
     {
         std::lock_guard<std::mutex> lock(nodesMutex_);
         auto now = std::chrono::system_clock::now();
+        auto steadyNow = std::chrono::steady_clock::now();
         
-        for (auto& pair : nodeRegistry_) {
-            if (pair.second.state != NodeState::ACTIVE) {
+        // Only nodes whose deadline has passed are visited
+        while (!deadlines_.empty() && deadlines_.begin()->first <= steadyNow) {
+            auto it = nodeRegistry_.find(deadlines_.begin()->second);
+            if (it == nodeRegistry_.end()) {
+                deadlines_.erase(deadlines_.begin());
                 continue;
             }
             
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                now - pair.second.lastSeen
-            );
+            RegistryEntry& entry = it->second;
+            NodeInfo& info = entry.info;
+            unscheduleDeadline(entry);
             
-            if (elapsed.count() > timeoutSeconds) {
-                incrementFailureCount(pair.first);
-                
-                if (shouldRemoveNode(pair.first)) {
-                    failedNodes.push_back(pair.first);
-                }
+            bool evict = false;
+            bool remove = false;
+            auto nextCheck = steadyNow + recheckInterval;
+            
+            if (failureDetector_.hasHistory(info.nodeID)) {
+                double phi = failureDetector_.phi(info.nodeID);
+                evict = phi >= evictionPhi;
+                remove = phi >= removalPhi;
             } else {
-                resetFailureCount(pair.first);
+                // Too few heartbeats for a distribution yet: fixed timeout
+                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - info.lastSeen);
+                if (elapsed.count() > timeoutSeconds) {
+                    incrementFailureCount(info.nodeID);
+                    evict = true;
+                    remove = shouldRemoveNode(info.nodeID);
+                } else {
+                    resetFailureCount(info.nodeID);
+                    nextCheck = steadyNow + std::chrono::seconds(timeoutSeconds - elapsed.count() + 1);
+                }
+            }
+            
+            if (remove) {
+                // Removed with the next churn batch; a heartbeat before then cancels it
+                failedNodes.push_back(info.nodeID);
+                continue;
             }
+            
+            if (evict && info.state == NodeState::ACTIVE) {
+                transitionState(entry, NodeState::SUSPECTED);
+                suspicionChanges.emplace_back(info.nodeID, true);
+            } else if (!evict && info.state == NodeState::SUSPECTED) {
+                transitionState(entry, NodeState::ACTIVE);
+                suspicionChanges.emplace_back(info.nodeID, false);
+            }
+            scheduleDeadline(entry, nextCheck);
+        }
+    }
+    
+    if (onNodeSuspected_) {
+        for (const auto& change : suspicionChanges) {
+            onNodeSuspected_(change.first, change.second);
         }
     }
     
     // Remove failed nodes (lock is released after scope)
     for (NodeID nodeID : failedNodes) {
-        removeNodeForced(nodeID);
+        queueNodeRemoval(nodeID, false);
+    }
+    
+    // Without the detection thread nothing else flushes the batch
+    if (!failedNodes.empty() && !failureDetectionActive_) {
+        flushChurn();
     }
 }
 
@@ -252,7 +280,7 @@ bool DynamicNodeManager::recoverFromNodeFailure(NodeID failedNodeID) {
     std::cout << "Attempting to recover from failure of node " << failedNodeID << std::endl;
     
     // Find replacement connections
-    std::vector<NodeID> replacements = findReplacementConnections(failedNodeID);
+    std::vector<NodeID> replacements = findReplacementConnections({failedNodeID});
     
     if (replacements.empty()) {
         std::cout << "No replacement connections found" << std::endl;
@@ -273,15 +301,111 @@ void DynamicNodeManager::startFailureDetection(int intervalSeconds) {
         return;
     }
     
+    detectionIntervalMs_ = static_cast<int64_t>(std::max(intervalSeconds, 1)) * 1000;
     failureDetectionActive_ = true;
+    detectionThread_ = std::thread(&DynamicNodeManager::failureDetectionLoop, this);
     // Failure detection started silently
-    
-    // In a real implementation, this would run in a separate thread
 }
 
 void DynamicNodeManager::stopFailureDetection() {
-    failureDetectionActive_ = false;
-    std::cout << "Failure detection stopped" << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(detectionMutex_);
+        failureDetectionActive_ = false;
+    }
+    detectionCondition_.notify_all();
+    
+    if (detectionThread_.joinable()) {
+        detectionThread_.join();
+        std::cout << "Failure detection stopped" << std::endl;
+    }
+}
+
+void DynamicNodeManager::failureDetectionLoop() {
+    while (failureDetectionActive_) {
+        detectFailedNodes(NODE_TIMEOUT_SEC);
+        
+        // Apply the churn batch once its window has closed
+        auto now = std::chrono::steady_clock::now();
+        auto churnDeadline = now;
+        bool churnPending = false;
+        {
+            std::lock_guard<std::mutex> lock(churnMutex_);
+            churnPending = !pendingChurn_.empty();
+            churnDeadline = churnWindowStart_ + std::chrono::milliseconds(churnWindowMs_.load());
+        }
+        if (churnPending && churnDeadline <= now) {
+            flushChurn();
+            churnPending = false;
+        }
+        
+        // Sleep until the earliest deadline, bounded by the sweep interval
+        auto wakeTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(detectionIntervalMs_.load());
+        if (churnPending && churnDeadline < wakeTime) {
+            wakeTime = churnDeadline;
+        }
+        {
+            std::lock_guard<std::mutex> lock(nodesMutex_);
+            if (!deadlines_.empty() && deadlines_.begin()->first < wakeTime) {
+                wakeTime = deadlines_.begin()->first;
+            }
+        }
+        
+        std::unique_lock<std::mutex> lock(detectionMutex_);
+        detectionCondition_.wait_until(lock, wakeTime, [this]() { return !failureDetectionActive_; });
+    }
+}
+
+void DynamicNodeManager::recordHeartbeat(NodeID nodeID) {
+    bool recovered = false;
+    
+    {
+        std::lock_guard<std::mutex> lock(nodesMutex_);
+        auto it = nodeRegistry_.find(nodeID);
+        if (it == nodeRegistry_.end()) {
+            return;
+        }
+        
+        RegistryEntry& entry = it->second;
+        entry.info.lastSeen = std::chrono::system_clock::now();
+        resetFailureCount(nodeID);
+        failureDetector_.heartbeat(nodeID);
+        
+        if (entry.info.state == NodeState::SUSPECTED) {
+            transitionState(entry, NodeState::ACTIVE);
+            recovered = true;
+        }
+        
+        // Nothing can be wrong with the node before its next heartbeat is due
+        if (isMonitoredState(entry.info.state)) {
+            scheduleDeadline(entry, std::chrono::steady_clock::now() + expectedHeartbeatInterval(nodeID));
+        }
+    }
+    
+    cancelQueuedFailure(nodeID);
+    
+    if (recovered && onNodeSuspected_) {
+        onNodeSuspected_(nodeID, false);
+    }
+}
+
+double DynamicNodeManager::getSuspicionLevel(NodeID nodeID) const {
+    return failureDetector_.phi(nodeID);
+}
+
+bool DynamicNodeManager::isNodeSuspected(NodeID nodeID, FailureUse use) const {
+    return failureDetector_.phi(nodeID) >= getPhiThreshold(use);
+}
+
+void DynamicNodeManager::setPhiThreshold(FailureUse use, double threshold) {
+    if (use == FailureUse::ROUTING_EVICTION) {
+        routingEvictionPhi_ = threshold;
+    } else {
+        hardRemovalPhi_ = threshold;
+    }
+}
+
+double DynamicNodeManager::getPhiThreshold(FailureUse use) const {
+    return use == FailureUse::ROUTING_EVICTION ? routingEvictionPhi_.load() : hardRemovalPhi_.load();
 }
 
 bool DynamicNodeManager::maintainNetworkIntegrity() {
@@ -294,15 +418,24 @@ bool DynamicNodeManager::maintainNetworkIntegrity() {
         topologyManager_->repairTopology();
     }
     
-    // Detect failed nodes
+    // Detect failed nodes and apply any queued churn
     detectFailedNodes(NODE_TIMEOUT_SEC);
+    flushChurn();
     
     // Ensure connectivity
     return ensureConnectivity();
 }
 
 bool DynamicNodeManager::repairNetworkAfterNodeRemoval(NodeID removedNodeID) {
-    std::cout << "Repairing network after removal of node " << removedNodeID << std::endl;
+    return repairNetworkAfterRemovals({removedNodeID});
+}
+
+bool DynamicNodeManager::repairNetworkAfterRemovals(const std::vector<NodeID>& removedNodes) {
+    if (removedNodes.size() == 1) {
+        std::cout << "Repairing network after removal of node " << removedNodes[0] << std::endl;
+    } else {
+        std::cout << "Repairing network after removal of " << removedNodes.size() << " nodes" << std::endl;
+    }
     
     // Check if network is still connected
     if (!topologyManager_->isTopologyConnected()) {
@@ -311,7 +444,7 @@ bool DynamicNodeManager::repairNetworkAfterNodeRemoval(NodeID removedNodeID) {
     }
     
     // Find replacement connections if needed
-    std::vector<NodeID> replacements = findReplacementConnections(removedNodeID);
+    std::vector<NodeID> replacements = findReplacementConnections(removedNodes);
     if (!replacements.empty()) {
         establishReplacementConnections(replacements);
     }
@@ -349,14 +482,25 @@ bool DynamicNodeManager::ensureConnectivity() {
     return topologyManager_->isTopologyConnected();
 }
 
-void DynamicNodeManager::propagateTopologyUpdate(const std::vector<NodeID>& /*updatedNodes*/) {
-    // Broadcast topology update to all peers
-    // This would use MessageHandler in real implementation
-    std::vector<NodeID> peers = node_->getPeerIDs();
+void DynamicNodeManager::propagateTopologyUpdate(
+    const std::vector<NodeID>& removedNodes,
+    const std::vector<std::pair<NodeID, NetworkAddress>>& addedNodes) {
+    if (removedNodes.empty() && addedNodes.empty()) {
+        return;
+    }
+    
+    // One update message describes the whole batch
+    Message update;
+    update.type = MessageType::TOPOLOGY_UPDATE;
+    update.senderID = node_->getID();
+    update.receiverID = 0; // Broadcast
+    update.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    update.payload = MessageHandler::serializeTopologyChanges(removedNodes, addedNodes);
     
-    // Send topology update messages to all peers
-    // (Implementation would use MessageHandler)
-    (void)peers; // Suppress unused variable warning
+    networkManager_->broadcastMessage(update);
+    topologyUpdatesSent_++;
 }
 
 void DynamicNodeManager::handleTopologyChange(NodeID changedNodeID, bool added) {
@@ -367,12 +511,16 @@ void DynamicNodeManager::handleTopologyChange(NodeID changedNodeID, bool added)
     }
 }
 
+size_t DynamicNodeManager::getNodeCountByState(NodeState state) const {
+    return stateCounts_[static_cast<size_t>(state)].load(std::memory_order_relaxed);
+}
+
 size_t DynamicNodeManager::getActiveNodeCount() const {
-    return getNodesByState(NodeState::ACTIVE).size();
+    return getNodeCountByState(NodeState::ACTIVE);
 }
 
 size_t DynamicNodeManager::getFailedNodeCount() const {
-    return getNodesByState(NodeState::FAILED).size();
+    return getNodeCountByState(NodeState::FAILED);
 }
 
 std::vector<NodeInfo> DynamicNodeManager::getAllNodeInfo() const {
@@ -380,7 +528,7 @@ std::vector<NodeInfo> DynamicNodeManager::getAllNodeInfo() const {
     std::vector<NodeInfo> infoList;
     
     for (const auto& pair : nodeRegistry_) {
-        infoList.push_back(pair.second);
+        infoList.push_back(pair.second.info);
     }
     
     return infoList;
@@ -390,7 +538,7 @@ NodeInfo DynamicNodeManager::getNodeInfo(NodeID nodeID) const {
     std::lock_guard<std::mutex> lock(nodesMutex_);
     auto it = nodeRegistry_.find(nodeID);
     if (it != nodeRegistry_.end()) {
-        return it->second;
+        return it->second.info;
     }
     return NodeInfo();
 }
@@ -407,6 +555,10 @@ void DynamicNodeManager::setOnNodeFailedCallback(std::function<void(NodeID)> cal
     onNodeFailed_ = callback;
 }
 
+void DynamicNodeManager::setOnNodeSuspectedCallback(std::function<void(NodeID, bool)> callback) {
+    onNodeSuspected_ = callback;
+}
+
 void DynamicNodeManager::setOnNetworkRepairedCallback(std::function<void()> callback) {
     onNetworkRepaired_ = callback;
 }
@@ -427,33 +579,112 @@ void DynamicNodeManager::updateNodeLastSeen(NodeID nodeID) {
     std::lock_guard<std::mutex> lock(nodesMutex_);
     auto it = nodeRegistry_.find(nodeID);
     if (it != nodeRegistry_.end()) {
-        it->second.lastSeen = std::chrono::system_clock::now();
+        it->second.info.lastSeen = std::chrono::system_clock::now();
         resetFailureCount(nodeID);
+        failureDetector_.heartbeat(nodeID);
+        if (isMonitoredState(it->second.info.state)) {
+            scheduleDeadline(it->second, std::chrono::steady_clock::now() + expectedHeartbeatInterval(nodeID));
+        }
+    }
+}
+
+DynamicNodeManager::RegistryEntry& DynamicNodeManager::insertEntry(const NodeInfo& info) {
+    RegistryEntry& entry = nodeRegistry_[info.nodeID];
+    entry.info = info;
+    linkState(entry);
+    if (isMonitoredState(info.state)) {
+        scheduleDeadline(entry, std::chrono::steady_clock::now() + expectedHeartbeatInterval(info.nodeID));
+    }
+    return entry;
+}
+
+void DynamicNodeManager::eraseEntry(std::map<NodeID, RegistryEntry>::iterator it) {
+    unlinkState(it->second);
+    unscheduleDeadline(it->second);
+    nodeRegistry_.erase(it);
+}
+
+void DynamicNodeManager::transitionState(RegistryEntry& entry, NodeState state) {
+    if (entry.info.state == state) {
+        return;
+    }
+    
+    unlinkState(entry);
+    entry.info.state = state;
+    linkState(entry);
+    
+    if (!isMonitoredState(state)) {
+        unscheduleDeadline(entry);
+    } else if (!entry.scheduled) {
+        scheduleDeadline(entry, std::chrono::steady_clock::now() + expectedHeartbeatInterval(entry.info.nodeID));
+    }
+}
+
+void DynamicNodeManager::linkState(RegistryEntry& entry) {
+    size_t index = static_cast<size_t>(entry.info.state);
+    entry.statePrev = nullptr;
+    entry.stateNext = stateHeads_[index];
+    if (stateHeads_[index]) {
+        stateHeads_[index]->statePrev = &entry;
+    }
+    stateHeads_[index] = &entry;
+    stateCounts_[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+void DynamicNodeManager::unlinkState(RegistryEntry& entry) {
+    size_t index = static_cast<size_t>(entry.info.state);
+    if (entry.statePrev) {
+        entry.statePrev->stateNext = entry.stateNext;
+    } else {
+        stateHeads_[index] = entry.stateNext;
+    }
+    if (entry.stateNext) {
+        entry.stateNext->statePrev = entry.statePrev;
+    }
+    entry.statePrev = nullptr;
+    entry.stateNext = nullptr;
+    stateCounts_[index].fetch_sub(1, std::memory_order_relaxed);
+}
+
+void DynamicNodeManager::scheduleDeadline(RegistryEntry& entry, std::chrono::steady_clock::time_point deadline) {
+    unscheduleDeadline(entry);
+    entry.deadline = deadlines_.emplace(deadline, entry.info.nodeID).first;
+    entry.scheduled = true;
+}
+
+void DynamicNodeManager::unscheduleDeadline(RegistryEntry& entry) {
+    if (entry.scheduled) {
+        deadlines_.erase(entry.deadline);
+        entry.scheduled = false;
+    }
+}
+
+std::chrono::milliseconds DynamicNodeManager::expectedHeartbeatInterval(NodeID nodeID) const {
+    if (failureDetector_.hasHistory(nodeID)) {
+        return std::chrono::milliseconds(static_cast<int64_t>(failureDetector_.getMeanIntervalMs(nodeID)));
     }
+    return std::chrono::seconds(HEARTBEAT_INTERVAL_SEC);
 }
 
 void DynamicNodeManager::incrementFailureCount(NodeID nodeID) {
-    std::lock_guard<std::mutex> lock(nodesMutex_);
     auto it = nodeRegistry_.find(nodeID);
     if (it != nodeRegistry_.end()) {
-        it->second.failureCount++;
+        it->second.info.failureCount++;
     }
 }
 
 void DynamicNodeManager::resetFailureCount(NodeID nodeID) {
-    std::lock_guard<std::mutex> lock(nodesMutex_);
     auto it = nodeRegistry_.find(nodeID);
     if (it != nodeRegistry_.end()) {
-        it->second.failureCount = 0;
+        it->second.info.failureCount = 0;
     }
 }
 
 bool DynamicNodeManager::shouldRemoveNode(NodeID nodeID) const {
-    std::lock_guard<std::mutex> lock(nodesMutex_);
     auto it = nodeRegistry_.find(nodeID);
     if (it != nodeRegistry_.end()) {
         // Remove if failure count exceeds threshold
-        return it->second.failureCount >= 3;
+        return it->second.info.failureCount >= 3;
     }
     return false;
 }
@@ -464,15 +695,16 @@ void DynamicNodeManager::notifyNodeRemoval(NodeID nodeID) {
     }
 }
 
-std::vector<NodeID> DynamicNodeManager::findReplacementConnections(NodeID removedNodeID) const {
+std::vector<NodeID> DynamicNodeManager::findReplacementConnections(const std::vector<NodeID>& removedNodes) const {
     std::vector<NodeID> replacements;
     
-    // Get all nodes except self and removed node
+    // Get all nodes except self and removed nodes
     std::vector<NodeID> allNodes = topologyManager_->getAllNodeIDs();
     NodeID selfID = node_->getID();
     
     for (NodeID nodeID : allNodes) {
-        if (nodeID == selfID || nodeID == removedNodeID) {
+        if (nodeID == selfID ||
+            std::find(removedNodes.begin(), removedNodes.end(), nodeID) != removedNodes.end()) {
             continue;
         }
         
@@ -505,5 +737,115 @@ bool DynamicNodeManager::establishReplacementConnections(const std::vector<NodeI
     return success;
 }
 
-} // namespace P2POverlay
+void DynamicNodeManager::queueChurn(NodeID nodeID, const ChurnEvent& event) {
+    std::lock_guard<std::mutex> lock(churnMutex_);
+    if (pendingChurn_.empty()) {
+        churnWindowStart_ = std::chrono::steady_clock::now();
+    }
+    
+    // The latest event for a node wins
+    pendingChurn_[nodeID] = event;
+}
 
+void DynamicNodeManager::cancelQueuedFailure(NodeID nodeID) {
+    std::lock_guard<std::mutex> lock(churnMutex_);
+    auto it = pendingChurn_.find(nodeID);
+    if (it != pendingChurn_.end() && it->second.type == ChurnType::FAIL) {
+        pendingChurn_.erase(it);
+    }
+}
+
+std::vector<NodeID> DynamicNodeManager::applyChurnBatch(const std::map<NodeID, ChurnEvent>& events) {
+    std::vector<NodeID> applied;
+    std::vector<NodeID> removedNodes;
+    std::vector<std::pair<NodeID, NetworkAddress>> addedNodes;
+    std::vector<std::pair<NodeID, ChurnType>> notifications;
+    
+    {
+        std::lock_guard<std::mutex> lock(nodesMutex_);
+        
+        for (const auto& pair : events) {
+            NodeID nodeID = pair.first;
+            const ChurnEvent& event = pair.second;
+            auto it = nodeRegistry_.find(nodeID);
+            
+            if (event.type == ChurnType::ADD) {
+                if (it != nodeRegistry_.end() || topologyManager_->nodeExists(nodeID)) {
+                    continue;
+                }
+                
+                NodeInfo info;
+                info.nodeID = nodeID;
+                info.address = event.address;
+                info.state = NodeState::ACTIVE;
+                info.joinTime = std::chrono::system_clock::now();
+                info.lastSeen = info.joinTime;
+                insertEntry(info);
+                
+                // Add as peer if we have capacity
+                if (node_->getPeerCount() < MAX_PEERS) {
+                    node_->addPeer(nodeID, event.address);
+                    networkManager_->connectToPeer(event.address);
+                }
+                
+                addedNodes.emplace_back(nodeID, event.address);
+                std::cout << "Added node " << nodeID << " at " << event.address.toString() << std::endl;
+            } else {
+                if (it == nodeRegistry_.end()) {
+                    continue;
+                }
+                
+                // Remove from peer list and disconnect
+                node_->removePeer(nodeID);
+                networkManager_->disconnectFromPeer(nodeID);
+                
+                // Remove from registry
+                eraseEntry(it);
+                failureDetector_.remove(nodeID);
+                
+                removedNodes.push_back(nodeID);
+                if (event.type == ChurnType::LEAVE) {
+                    std::cout << "Gracefully removed node " << nodeID << std::endl;
+                } else {
+                    std::cout << "Forced removal of node " << nodeID << std::endl;
+                }
+            }
+            
+            applied.push_back(nodeID);
+            notifications.emplace_back(nodeID, event.type);
+        }
+    }
+    
+    if (applied.empty()) {
+        return applied;
+    }
+    
+    // One topology batch, one repair and one update for the whole window
+    topologyManager_->applyBatch(addedNodes, removedNodes);
+    churnBatchesApplied_++;
+    
+    for (const auto& notification : notifications) {
+        if (notification.second == ChurnType::ADD) {
+            if (onNodeAdded_) {
+                auto event = events.find(notification.first);
+                onNodeAdded_(notification.first, event->second.address);
+            }
+        } else if (notification.second == ChurnType::LEAVE) {
+            if (onNodeRemoved_) {
+                onNodeRemoved_(notification.first);
+            }
+        } else if (onNodeFailed_) {
+            onNodeFailed_(notification.first);
+        }
+    }
+    
+    if (!removedNodes.empty()) {
+        repairNetworkAfterRemovals(removedNodes);
+    }
+    
+    propagateTopologyUpdate(removedNodes, addedNodes);
+    
+    return applied;
+}
+
+} // namespace P2POverlay
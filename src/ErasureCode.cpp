@@ -0,0 +1,247 @@
+#include "ErasureCode.h"
+#include <cstring>
+#include <algorithm>
+
+// The AVX2 and SSSE3 shuffle kernels are compiled whatever the build
+// targets, and the widest one the CPU runs is picked at run time
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define P2P_HAVE_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace P2POverlay {
+
+namespace {
+
+constexpr unsigned GF_POLYNOMIAL = 0x11D;
+
+struct GaloisTables {
+    uint8_t exp[512];   // Doubled so a sum of two logs needs no reduction
+    uint8_t log[256];
+    
+    GaloisTables() {
+        unsigned value = 1;
+        for (unsigned i = 0; i < 255; ++i) {
+            exp[i] = static_cast<uint8_t>(value);
+            log[value] = static_cast<uint8_t>(i);
+            value <<= 1;
+            if (value & 0x100) {
+                value ^= GF_POLYNOMIAL;
+            }
+        }
+        for (unsigned i = 255; i < 512; ++i) {
+            exp[i] = exp[i - 255];
+        }
+        log[0] = 0;
+    }
+};
+
+const GaloisTables& galois() {
+    static const GaloisTables instance;
+    return instance;
+}
+
+// Gauss-Jordan inversion of an n x n matrix; false if it is singular
+bool invertMatrix(std::vector<uint8_t>& matrix, size_t n) {
+    std::vector<uint8_t> inverse(n * n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        inverse[i * n + i] = 1;
+    }
+    
+    for (size_t column = 0; column < n; ++column) {
+        size_t pivot = column;
+        while (pivot < n && matrix[pivot * n + column] == 0) {
+            pivot++;
+        }
+        if (pivot == n) {
+            return false;
+        }
+        if (pivot != column) {
+            std::swap_ranges(matrix.begin() + pivot * n, matrix.begin() + (pivot + 1) * n, matrix.begin() + column * n);
+            std::swap_ranges(inverse.begin() + pivot * n, inverse.begin() + (pivot + 1) * n, inverse.begin() + column * n);
+        }
+        
+        uint8_t scale = gfInverse(matrix[column * n + column]);
+        for (size_t j = 0; j < n; ++j) {
+            matrix[column * n + j] = gfMultiply(matrix[column * n + j], scale);
+            inverse[column * n + j] = gfMultiply(inverse[column * n + j], scale);
+        }
+        for (size_t row = 0; row < n; ++row) {
+            uint8_t factor = matrix[row * n + column];
+            if (row == column || factor == 0) {
+                continue;
+            }
+            for (size_t j = 0; j < n; ++j) {
+                matrix[row * n + j] ^= gfMultiply(factor, matrix[column * n + j]);
+                inverse[row * n + j] ^= gfMultiply(factor, inverse[column * n + j]);
+            }
+        }
+    }
+    
+    matrix.swap(inverse);
+    return true;
+}
+
+// Multiply-add kernels over the two nibble tables; each returns how many
+// leading bytes it handled and leaves the rest to the byte loop
+using MultiplyAddKernel = size_t (*)(uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*, size_t);
+
+size_t multiplyAddPortable(uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*, size_t) {
+    return 0;
+}
+
+#ifdef P2P_HAVE_X86_DISPATCH
+__attribute__((target("avx2")))
+size_t multiplyAddAvx2(uint8_t* dst, const uint8_t* src, const uint8_t* low, const uint8_t* high, size_t size) {
+    const __m256i lowTable = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(low)));
+    const __m256i highTable = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(high)));
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i product = _mm256_xor_si256(
+            _mm256_shuffle_epi8(lowTable, _mm256_and_si256(value, mask)),
+            _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi64(value, 4), mask)));
+        __m256i target = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(target, product));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+size_t multiplyAddSsse3(uint8_t* dst, const uint8_t* src, const uint8_t* low, const uint8_t* high, size_t size) {
+    const __m128i lowTable = _mm_load_si128(reinterpret_cast<const __m128i*>(low));
+    const __m128i highTable = _mm_load_si128(reinterpret_cast<const __m128i*>(high));
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i product = _mm_xor_si128(
+            _mm_shuffle_epi8(lowTable, _mm_and_si128(value, mask)),
+            _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi64(value, 4), mask)));
+        __m128i target = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(target, product));
+    }
+    return i;
+}
+#endif
+
+MultiplyAddKernel selectMultiplyAdd() {
+#ifdef P2P_HAVE_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return multiplyAddAvx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return multiplyAddSsse3;
+    }
+#endif
+    return multiplyAddPortable;
+}
+
+} // namespace
+
+uint8_t gfMultiply(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+    const GaloisTables& tables = galois();
+    return tables.exp[tables.log[a] + tables.log[b]];
+}
+
+uint8_t gfInverse(uint8_t a) {
+    const GaloisTables& tables = galois();
+    return a == 0 ? 0 : tables.exp[255 - tables.log[a]];
+}
+
+void gfMultiplyAdd(uint8_t* dst, const uint8_t* src, uint8_t coefficient, size_t size) {
+    if (coefficient == 0) {
+        return;
+    }
+    
+    // coefficient * x is the product with x's low nibble xor the product
+    // with its high nibble, so two 16-entry tables cover every byte
+    alignas(16) uint8_t low[16];
+    alignas(16) uint8_t high[16];
+    for (uint8_t i = 0; i < 16; ++i) {
+        low[i] = gfMultiply(coefficient, i);
+        high[i] = gfMultiply(coefficient, static_cast<uint8_t>(i << 4));
+    }
+    
+    static const MultiplyAddKernel kernel = selectMultiplyAdd();
+    size_t i = kernel(dst, src, low, high, size);
+    for (; i < size; ++i) {
+        dst[i] ^= low[src[i] & 0x0F] ^ high[src[i] >> 4];
+    }
+}
+
+ReedSolomon::ReedSolomon(size_t dataShards, size_t parityShards)
+    : dataShards_(std::max<size_t>(dataShards, 1)),
+      parityShards_(std::min(parityShards, 256 - std::min<size_t>(dataShards_, 256))) {
+    // Cauchy matrix 1 / (x_i + y_j) with x_i = dataShards + i and y_j = j:
+    // every square submatrix of [identity; parity] is invertible
+    parityMatrix_.resize(parityShards_ * dataShards_);
+    for (size_t i = 0; i < parityShards_; ++i) {
+        for (size_t j = 0; j < dataShards_; ++j) {
+            parityMatrix_[i * dataShards_ + j] = gfInverse(static_cast<uint8_t>((dataShards_ + i) ^ j));
+        }
+    }
+}
+
+void ReedSolomon::encode(const std::vector<const uint8_t*>& data, const std::vector<uint8_t*>& parity,
+                         size_t shardSize) const {
+    for (size_t i = 0; i < parityShards_ && i < parity.size(); ++i) {
+        std::memset(parity[i], 0, shardSize);
+        for (size_t j = 0; j < dataShards_ && j < data.size(); ++j) {
+            gfMultiplyAdd(parity[i], data[j], parityMatrix_[i * dataShards_ + j], shardSize);
+        }
+    }
+}
+
+bool ReedSolomon::reconstruct(const std::vector<uint8_t*>& shards, const std::vector<bool>& present,
+                              size_t shardSize) const {
+    const size_t k = dataShards_;
+    if (shards.size() < k + parityShards_ || present.size() < k + parityShards_) {
+        return false;
+    }
+    
+    std::vector<size_t> missing;
+    for (size_t j = 0; j < k; ++j) {
+        if (!present[j]) {
+            missing.push_back(j);
+        }
+    }
+    if (missing.empty()) {
+        return true;
+    }
+    
+    // Rows of the encoding matrix for the first k shards that arrived
+    std::vector<size_t> chosen;
+    std::vector<uint8_t> matrix(k * k, 0);
+    for (size_t index = 0; index < k + parityShards_ && chosen.size() < k; ++index) {
+        if (!present[index]) {
+            continue;
+        }
+        size_t row = chosen.size();
+        if (index < k) {
+            matrix[row * k + index] = 1;
+        } else {
+            std::memcpy(&matrix[row * k], &parityMatrix_[(index - k) * k], k);
+        }
+        chosen.push_back(index);
+    }
+    if (chosen.size() < k || !invertMatrix(matrix, k)) {
+        return false;
+    }
+    
+    // Each missing data shard is its row of the inverse applied to the chosen shards
+    for (size_t j : missing) {
+        std::memset(shards[j], 0, shardSize);
+        for (size_t r = 0; r < k; ++r) {
+            gfMultiplyAdd(shards[j], shards[chosen[r]], matrix[j * k + r], shardSize);
+        }
+    }
+    return true;
+}
+
+} // namespace P2POverlay
@@ -0,0 +1,143 @@
+#include "FailureDetector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace P2POverlay {
+
+PhiAccrualFailureDetector::PhiAccrualFailureDetector(
+    size_t windowSize,
+    size_t minSamples,
+    double minStdDeviationMs,
+    double acceptablePauseMs)
+    : windowSize_(std::max<size_t>(windowSize, 1)), minSamples_(std::max<size_t>(minSamples, 1)),
+      minStdDeviationMs_(minStdDeviationMs), acceptablePauseMs_(acceptablePauseMs),
+      minSampleIntervalMs_(0.0) {
+}
+
+PhiAccrualFailureDetector::~PhiAccrualFailureDetector() {
+}
+
+void PhiAccrualFailureDetector::heartbeat(NodeID nodeID) {
+    heartbeat(nodeID, std::chrono::steady_clock::now());
+}
+
+void PhiAccrualFailureDetector::heartbeat(NodeID nodeID, std::chrono::steady_clock::time_point arrival) {
+    std::lock_guard<std::mutex> lock(historiesMutex_);
+    HeartbeatHistory& history = histories_[nodeID];
+    
+    if (!history.hasHeartbeat) {
+        history.intervalsMs.resize(windowSize_, 0.0);
+        history.lastHeartbeat = arrival;
+        history.hasHeartbeat = true;
+        return;
+    }
+    
+    double intervalMs = std::chrono::duration<double, std::milli>(arrival - history.lastHeartbeat).count();
+    history.lastHeartbeat = arrival;
+    if (intervalMs <= 0.0) {
+        return; // Duplicate or reordered arrival
+    }
+    if (intervalMs < minSampleIntervalMs_) {
+        return; // Traffic on a busy link: refreshes the arrival time only
+    }
+    
+    // Evict the oldest sample once the window is full
+    if (history.sampleCount == windowSize_) {
+        double evicted = history.intervalsMs[history.nextIndex];
+        history.sum -= evicted;
+        history.sumOfSquares -= evicted * evicted;
+    } else {
+        history.sampleCount++;
+    }
+    
+    history.intervalsMs[history.nextIndex] = intervalMs;
+    history.nextIndex = (history.nextIndex + 1) % windowSize_;
+    history.sum += intervalMs;
+    history.sumOfSquares += intervalMs * intervalMs;
+}
+
+void PhiAccrualFailureDetector::remove(NodeID nodeID) {
+    std::lock_guard<std::mutex> lock(historiesMutex_);
+    histories_.erase(nodeID);
+}
+
+void PhiAccrualFailureDetector::clear() {
+    std::lock_guard<std::mutex> lock(historiesMutex_);
+    histories_.clear();
+}
+
+double PhiAccrualFailureDetector::phi(NodeID nodeID) const {
+    return phi(nodeID, std::chrono::steady_clock::now());
+}
+
+double PhiAccrualFailureDetector::phi(NodeID nodeID, std::chrono::steady_clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(historiesMutex_);
+    auto it = histories_.find(nodeID);
+    if (it == histories_.end() || it->second.sampleCount < minSamples_) {
+        return 0.0;
+    }
+    return computePhi(it->second, now);
+}
+
+bool PhiAccrualFailureDetector::isAvailable(NodeID nodeID, double threshold) const {
+    return phi(nodeID) < threshold;
+}
+
+bool PhiAccrualFailureDetector::hasHistory(NodeID nodeID) const {
+    std::lock_guard<std::mutex> lock(historiesMutex_);
+    auto it = histories_.find(nodeID);
+    return it != histories_.end() && it->second.sampleCount >= minSamples_;
+}
+
+size_t PhiAccrualFailureDetector::getSampleCount(NodeID nodeID) const {
+    std::lock_guard<std::mutex> lock(historiesMutex_);
+    auto it = histories_.find(nodeID);
+    return it != histories_.end() ? it->second.sampleCount : 0;
+}
+
+double PhiAccrualFailureDetector::getMeanIntervalMs(NodeID nodeID) const {
+    std::lock_guard<std::mutex> lock(historiesMutex_);
+    auto it = histories_.find(nodeID);
+    return it != histories_.end() ? meanOf(it->second) : 0.0;
+}
+
+double PhiAccrualFailureDetector::getStdDeviationMs(NodeID nodeID) const {
+    std::lock_guard<std::mutex> lock(historiesMutex_);
+    auto it = histories_.find(nodeID);
+    return it != histories_.end() ? stdDeviationOf(it->second) : 0.0;
+}
+
+double PhiAccrualFailureDetector::computePhi(
+    const HeartbeatHistory& history,
+    std::chrono::steady_clock::time_point now) const {
+    double elapsedMs = std::chrono::duration<double, std::milli>(now - history.lastHeartbeat).count();
+    double mean = meanOf(history) + acceptablePauseMs_;
+    double stdDeviation = std::max(stdDeviationOf(history), minStdDeviationMs_);
+    
+    // Logistic approximation of the normal CDF (error < 0.01%), evaluated
+    // on the tail side to avoid catastrophic cancellation
+    double y = (elapsedMs - mean) / stdDeviation;
+    double e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+    if (elapsedMs > mean) {
+        return -std::log10(e / (1.0 + e));
+    }
+    return -std::log10(1.0 - 1.0 / (1.0 + e));
+}
+
+double PhiAccrualFailureDetector::meanOf(const HeartbeatHistory& history) const {
+    if (history.sampleCount == 0) {
+        return 0.0;
+    }
+    return history.sum / history.sampleCount;
+}
+
+double PhiAccrualFailureDetector::stdDeviationOf(const HeartbeatHistory& history) const {
+    if (history.sampleCount == 0) {
+        return 0.0;
+    }
+    double mean = meanOf(history);
+    double variance = history.sumOfSquares / history.sampleCount - mean * mean;
+    return variance > 0.0 ? std::sqrt(variance) : 0.0;
+}
+
+} // namespace P2POverlay
@@ -0,0 +1,108 @@
+#include "MerkleTree.h"
+#include <algorithm>
+
+namespace P2POverlay {
+
+namespace {
+
+constexpr uint8_t LEAF_PREFIX = 0x00;
+constexpr uint8_t NODE_PREFIX = 0x01;
+
+} // namespace
+
+MerkleHash hashMerkleLeaf(const uint8_t* data, size_t size, uint64_t offset) {
+    uint8_t prefix[1 + sizeof(offset)];
+    prefix[0] = LEAF_PREFIX;
+    for (size_t i = 0; i < sizeof(offset); ++i) {
+        prefix[1 + i] = static_cast<uint8_t>(offset >> (8 * i));
+    }
+    
+    MerkleHash hash;
+    Sha256 sha;
+    sha.update(prefix, sizeof(prefix));
+    sha.update(data, size);
+    sha.finish(hash.data());
+    return hash;
+}
+
+MerkleHash hashMerkleNode(const MerkleHash& left, const MerkleHash& right) {
+    uint8_t input[1 + 2 * SHA256_DIGEST_SIZE];
+    input[0] = NODE_PREFIX;
+    std::copy(left.begin(), left.end(), input + 1);
+    std::copy(right.begin(), right.end(), input + 1 + SHA256_DIGEST_SIZE);
+    
+    MerkleHash hash;
+    sha256(input, sizeof(input), hash.data());
+    return hash;
+}
+
+MerkleTree::MerkleTree(std::vector<MerkleHash> leaves) {
+    if (leaves.empty()) {
+        return;
+    }
+    
+    levels_.push_back(std::move(leaves));
+    while (levels_.back().size() > 1) {
+        const std::vector<MerkleHash>& below = levels_.back();
+        std::vector<MerkleHash> level;
+        level.reserve((below.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < below.size(); i += 2) {
+            level.push_back(hashMerkleNode(below[i], below[i + 1]));
+        }
+        if (below.size() % 2 == 1) {
+            level.push_back(below.back());
+        }
+        levels_.push_back(std::move(level));
+    }
+}
+
+const MerkleHash& MerkleTree::root() const {
+    static const MerkleHash empty{};
+    return levels_.empty() ? empty : levels_.back().front();
+}
+
+std::vector<MerkleHash> MerkleTree::proof(size_t index) const {
+    std::vector<MerkleHash> siblings;
+    if (index >= leafCount()) {
+        return siblings;
+    }
+    
+    for (size_t level = 0; level + 1 < levels_.size(); ++level) {
+        size_t sibling = index ^ 1;
+        if (sibling < levels_[level].size()) {
+            siblings.push_back(levels_[level][sibling]);
+        }
+        index /= 2;
+    }
+    return siblings;
+}
+
+bool MerkleTree::rootFromProof(const MerkleHash& leaf, size_t index, size_t leafCount,
+                               const std::vector<MerkleHash>& proof, MerkleHash& root) {
+    if (index >= leafCount || proof.size() != proofLength(index, leafCount)) {
+        return false;
+    }
+    
+    root = leaf;
+    size_t used = 0;
+    for (size_t width = leafCount; width > 1; width = (width + 1) / 2, index /= 2) {
+        if ((index ^ 1) >= width) {
+            continue;    // Last node of an odd level moves up as is
+        }
+        root = index % 2 == 0 ? hashMerkleNode(root, proof[used]) : hashMerkleNode(proof[used], root);
+        used++;
+    }
+    return true;
+}
+
+size_t MerkleTree::proofLength(size_t index, size_t leafCount) {
+    size_t length = 0;
+    for (size_t width = leafCount; width > 1; width = (width + 1) / 2, index /= 2) {
+        if ((index ^ 1) < width) {
+            length++;
+        }
+    }
+    return length;
+}
+
+} // namespace P2POverlay
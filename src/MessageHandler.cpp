@@ -3,6 +3,7 @@
 #include <cstring>
 #include <iostream>
 #include <map>
+#include <algorithm>
 
 namespace P2POverlay {
 
@@ -34,6 +35,10 @@ void MessageHandler::processMessage(const Message& message) {
     }
 }
 
+void MessageHandler::registerHandler(MessageType type, std::function<void(const Message&)> handler) {
+    messageHandlers_[type] = handler;
+}
+
 void MessageHandler::handleJoinRequest(const Message& message) {
     std::cout << "Received JOIN_REQUEST from node " << message.senderID << std::endl;
     
@@ -86,14 +91,11 @@ void MessageHandler::handleLeaveNotification(const Message& message) {
     networkManager_->broadcastMessage(update, message.senderID);
 }
 
-void MessageHandler::handleHeartbeat(const Message& message) {
-    // Update last seen time for the peer
-    // This is handled at a higher level, but we acknowledge it here
+void MessageHandler::handleHeartbeat(const Message& /*message*/) {
+    // Peer liveness is taken from every received frame at a higher level.
+    // No reply: the peer's own idle timer covers the reverse direction, and
+    // answering heartbeats with heartbeats ping-pongs between the two ends.
     node_->updateLastSeen();
-    
-    // Send heartbeat response
-    Message heartbeat = createHeartbeat(message.senderID);
-    networkManager_->sendMessageToPeer(message.senderID, heartbeat);
 }
 
 void MessageHandler::handleDataMessage(const Message& message) {
@@ -107,15 +109,25 @@ void MessageHandler::handleDataMessage(const Message& message) {
 void MessageHandler::handleTopologyUpdate(const Message& message) {
     std::cout << "Received TOPOLOGY_UPDATE from node " << message.senderID << std::endl;
     
-    // Parse updated nodes from payload
-    std::vector<NodeID> updatedNodes = deserializeNodeList(message.payload);
+    // Parse removed and added nodes from payload
+    std::vector<NodeID> removedNodes;
+    std::vector<std::pair<NodeID, NetworkAddress>> addedNodes;
+    if (!deserializeTopologyChanges(message.payload, removedNodes, addedNodes)) {
+        return;
+    }
     
-    // Update local topology information
-    for (NodeID nodeID : updatedNodes) {
-        if (!topologyManager_->nodeExists(nodeID)) {
-            // Node was removed, update our view
-            node_->removePeer(nodeID);
-        }
+    NodeID selfID = node_->getID();
+    removedNodes.erase(std::remove(removedNodes.begin(), removedNodes.end(), selfID), removedNodes.end());
+    addedNodes.erase(
+        std::remove_if(addedNodes.begin(), addedNodes.end(),
+            [selfID](const std::pair<NodeID, NetworkAddress>& added) { return added.first == selfID; }),
+        addedNodes.end()
+    );
+    
+    // Apply the whole update as one batch
+    topologyManager_->applyBatch(addedNodes, removedNodes);
+    for (NodeID nodeID : removedNodes) {
+        node_->removePeer(nodeID);
     }
     
     // Validate and repair topology if needed
@@ -210,6 +222,17 @@ Message MessageHandler::createPeerDiscoveryRequest(NodeID targetNodeID, int maxP
     return msg;
 }
 
+size_t MessageHandler::sendIdleHeartbeats(uint64_t idleMicros,
+                                          const std::function<bool(NodeID, const Message&)>& send) {
+    size_t sent = 0;
+    for (NodeID peerID : node_->getIdlePeers(idleMicros)) {
+        if (send(peerID, createHeartbeat(peerID))) {
+            sent++;
+        }
+    }
+    return sent;
+}
+
 uint64_t MessageHandler::getCurrentTimestamp() const {
     return std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()
@@ -255,5 +278,88 @@ std::vector<NodeID> MessageHandler::deserializeNodeList(const std::vector<uint8_
     return nodes;
 }
 
-} // namespace P2POverlay
+std::vector<uint8_t> MessageHandler::serializeTopologyChanges(
+    const std::vector<NodeID>& removedNodes,
+    const std::vector<std::pair<NodeID, NetworkAddress>>& addedNodes) {
+    // Removed list first: a plain node list is read as removals only
+    std::vector<uint8_t> data = serializeNodeList(removedNodes);
+    if (addedNodes.empty()) {
+        return data;
+    }
+    
+    std::vector<NodeID> addedIDs;
+    for (const auto& pair : addedNodes) {
+        addedIDs.push_back(pair.first);
+    }
+    std::vector<uint8_t> addedList = serializeNodeList(addedIDs);
+    data.insert(data.end(), addedList.begin(), addedList.end());
+    
+    // Addresses of added nodes, in list order
+    for (const auto& pair : addedNodes) {
+        uint8_t hostLength = static_cast<uint8_t>(std::min<size_t>(pair.second.host.size(), 255));
+        size_t offset = data.size();
+        data.resize(offset + sizeof(Port) + sizeof(uint8_t) + hostLength);
+        std::memcpy(data.data() + offset, &pair.second.port, sizeof(Port));
+        data[offset + sizeof(Port)] = hostLength;
+        std::memcpy(data.data() + offset + sizeof(Port) + sizeof(uint8_t), pair.second.host.data(), hostLength);
+    }
+    
+    return data;
+}
 
+bool MessageHandler::deserializeTopologyChanges(
+    const std::vector<uint8_t>& data,
+    std::vector<NodeID>& removedNodes,
+    std::vector<std::pair<NodeID, NetworkAddress>>& addedNodes) {
+    removedNodes.clear();
+    addedNodes.clear();
+    
+    if (data.size() < sizeof(uint32_t)) {
+        return false;
+    }
+    
+    uint32_t removedCount = 0;
+    std::memcpy(&removedCount, data.data(), sizeof(uint32_t));
+    size_t offset = sizeof(uint32_t) + static_cast<size_t>(removedCount) * sizeof(NodeID);
+    if (data.size() < offset) {
+        return false;
+    }
+    removedNodes = deserializeNodeList(std::vector<uint8_t>(data.begin(), data.begin() + offset));
+    
+    if (data.size() == offset) {
+        return true;
+    }
+    
+    // The added list must fit before its addresses are read
+    uint32_t addedCount = 0;
+    if (data.size() - offset < sizeof(uint32_t)) {
+        return false;
+    }
+    std::memcpy(&addedCount, data.data() + offset, sizeof(uint32_t));
+    size_t addedEnd = offset + sizeof(uint32_t) + static_cast<size_t>(addedCount) * sizeof(NodeID);
+    if (data.size() < addedEnd) {
+        return false;
+    }
+    std::vector<NodeID> addedIDs = deserializeNodeList(std::vector<uint8_t>(data.begin() + offset, data.begin() + addedEnd));
+    offset = addedEnd;
+    
+    for (NodeID nodeID : addedIDs) {
+        if (offset + sizeof(Port) + sizeof(uint8_t) > data.size()) {
+            return false;
+        }
+        NetworkAddress address;
+        std::memcpy(&address.port, data.data() + offset, sizeof(Port));
+        uint8_t hostLength = data[offset + sizeof(Port)];
+        offset += sizeof(Port) + sizeof(uint8_t);
+        if (offset + hostLength > data.size()) {
+            return false;
+        }
+        address.host.assign(reinterpret_cast<const char*>(data.data() + offset), hostLength);
+        offset += hostLength;
+        addedNodes.emplace_back(nodeID, address);
+    }
+    
+    return offset == data.size();
+}
+
+} // namespace P2POverlay
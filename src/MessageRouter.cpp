@@ -10,7 +10,7 @@ MessageRouter::MessageRouter(
     std::shared_ptr<NetworkManager> networkManager,
     std::shared_ptr<TopologyManager> topologyManager)
     : node_(node), networkManager_(networkManager), topologyManager_(topologyManager),
-      routedMessageCount_(0), forwardedMessageCount_(0), totalHopCount_(0) {
+      routedMessageCount_(0), forwardedMessageCount_(0), droppedRelayCount_(0), totalHopCount_(0) {
 }
 
 MessageRouter::~MessageRouter() {
@@ -35,7 +35,7 @@ bool MessageRouter::routeMessage(const Message& message, RoutingStrategy strateg
 bool MessageRouter::routeMessageDirect(NodeID targetID, const Message& message) {
     // Check if directly connected
     if (node_->hasPeer(targetID)) {
-        return networkManager_->sendMessageToPeer(targetID, message);
+        return transmit(targetID, message);
     }
     
     // Fall back to multi-hop
@@ -52,7 +52,7 @@ bool MessageRouter::routeMessageMultiHop(NodeID targetID, const Message& message
     
     if (route.size() == 1) {
         // Direct connection
-        return networkManager_->sendMessageToPeer(targetID, message);
+        return transmit(targetID, message);
     }
     
     // Multi-hop: send to next hop
@@ -63,7 +63,7 @@ bool MessageRouter::routeMessageMultiHop(NodeID targetID, const Message& message
     Message routedMsg = message;
     // In a real implementation, we'd encode the route in the message
     
-    return networkManager_->sendMessageToPeer(nextHop, routedMsg);
+    return transmit(nextHop, routedMsg);
 }
 
 bool MessageRouter::floodMessage(const Message& message, int /*maxHops*/) {
@@ -82,7 +82,7 @@ bool MessageRouter::floodMessage(const Message& message, int /*maxHops*/) {
     
     for (NodeID peerID : peers) {
         if (peerID != message.senderID) {
-            if (!networkManager_->sendMessageToPeer(peerID, message)) {
+            if (!transmit(peerID, message)) {
                 success = false;
             }
         }
@@ -133,7 +133,7 @@ bool MessageRouter::forwardMessage(const Message& message, const RoutingInfo& ro
     NodeID nextHop = route[1];
     forwardedMessageCount_++;
     
-    return networkManager_->sendMessageToPeer(nextHop, message);
+    return transmit(nextHop, message);
 }
 
 void MessageRouter::handleIncomingRoute(const Message& message, const RoutingInfo& routingInfo) {
@@ -147,6 +147,28 @@ void MessageRouter::handleIncomingRoute(const Message& message, const RoutingInf
     forwardMessage(message, routingInfo);
 }
 
+bool MessageRouter::relayIncoming(const Message& message) {
+    if (message.receiverID == 0 || message.receiverID == node_->getID()) {
+        return false; // Broadcast or ours
+    }
+    
+    // Every relay spends a hop, so stale routes that loop cannot keep a
+    // frame alive
+    std::vector<NodeID> route = findRoute(message.receiverID);
+    if (message.hopLimit <= 1 || route.size() < 2) {
+        droppedRelayCount_++;
+        return true;
+    }
+    Message relayed = message;
+    relayed.hopLimit--;
+    if (transmit(route[1], relayed)) {
+        forwardedMessageCount_++;
+    } else {
+        droppedRelayCount_++;
+    }
+    return true;
+}
+
 void MessageRouter::updateRoutingTable() {
     std::lock_guard<std::mutex> lock(routingTableMutex_);
     
@@ -217,6 +239,13 @@ NodeID MessageRouter::getNextHop(NodeID targetID) const {
     return 0;
 }
 
+bool MessageRouter::transmit(NodeID peerID, const Message& message) {
+    if (transport_) {
+        return transport_(peerID, message);
+    }
+    return networkManager_->sendMessageToPeer(peerID, message);
+}
+
 bool MessageRouter::isMessageSeen(uint64_t messageID) const {
     std::lock_guard<std::mutex> lock(seenMessagesMutex_);
     return seenMessages_.find(messageID) != seenMessages_.end();
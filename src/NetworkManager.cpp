@@ -19,30 +19,26 @@ void PeerConnectionHandler::run() {
     try {
         Poco::Net::StreamSocket& socket = this->socket();
         
-        // Read message header (type, senderID, receiverID, timestamp, payload size)
-        char header[32];
+        // Read message header (type, senderID, receiverID, timestamp, payload size, flags, hop)
+        char header[FRAME_HEADER_SIZE];
         int received = socket.receiveBytes(header, sizeof(header));
         
         if (received > 0 && networkManager_) {
-            Message msg;
-            // Parse header
-            std::memcpy(&msg.type, header, sizeof(MessageType));
-            std::memcpy(&msg.senderID, header + sizeof(MessageType), sizeof(NodeID));
-            std::memcpy(&msg.receiverID, header + sizeof(MessageType) + sizeof(NodeID), sizeof(NodeID));
-            std::memcpy(&msg.timestamp, header + sizeof(MessageType) + 2 * sizeof(NodeID), sizeof(uint64_t));
-            
             uint32_t payloadSize = 0;
             std::memcpy(&payloadSize, header + sizeof(MessageType) + 2 * sizeof(NodeID) + sizeof(uint64_t), sizeof(uint32_t));
-            
-            // Read payload if present
-            if (payloadSize > 0) {
-                msg.payload.resize(payloadSize);
-                socket.receiveBytes(msg.payload.data(), payloadSize);
+            uint16_t piggybackSize = 0;
+            if (static_cast<uint8_t>(header[FRAME_FLAGS_OFFSET]) & FRAME_FLAG_PIGGYBACK) {
+                std::memcpy(&piggybackSize, header + FRAME_PIGGYBACK_LENGTH_OFFSET, sizeof(uint16_t));
             }
             
-            if (networkManager_->messageCallback_) {
-                networkManager_->messageCallback_(msg);
+            // Read payload and piggyback trailer behind the header
+            std::vector<uint8_t> frame(header, header + sizeof(header));
+            frame.resize(sizeof(header) + payloadSize + piggybackSize);
+            if (frame.size() > sizeof(header)) {
+                socket.receiveBytes(frame.data() + sizeof(header), static_cast<int>(frame.size() - sizeof(header)));
             }
+            
+            networkManager_->receiveFrame(frame.data(), frame.size());
         }
     } catch (Poco::Exception& e) {
         std::cerr << "Connection handler error: " << e.displayText() << std::endl;
@@ -61,7 +57,9 @@ Poco::Net::TCPServerConnection* PeerConnectionFactory::createConnection(
 
 // NetworkManager implementation
 NetworkManager::NetworkManager(std::shared_ptr<Node> node)
-    : node_(node), serverRunning_(false), sentMessageCount_(0), receivedMessageCount_(0) {
+    : node_(node), serverRunning_(false), compression_(CompressionCodec::NONE), sentMessageCount_(0),
+      receivedMessageCount_(0), piggybackedBytesSent_(0), compressedFrames_(0),
+      incompressibleFrames_(0), compressionSavedBytes_(0), compressionMicros_(0), decompressionMicros_(0) {
 }
 
 NetworkManager::~NetworkManager() {
@@ -121,6 +119,10 @@ bool NetworkManager::connectToPeer(const NetworkAddress& peerAddress) {
 }
 
 bool NetworkManager::disconnectFromPeer(NodeID peerID) {
+    {
+        std::lock_guard<std::mutex> lock(codecsMutex_);
+        peerCodecs_.erase(peerID);
+    }
     std::lock_guard<std::mutex> lock(connectionsMutex_);
     auto it = activeConnections_.find(peerID);
     if (it != activeConnections_.end()) {
@@ -132,40 +134,128 @@ bool NetworkManager::disconnectFromPeer(NodeID peerID) {
 }
 
 bool NetworkManager::sendMessageToPeer(NodeID peerID, const Message& message) {
+    PeerStats* stats = node_->getPeerStats(peerID);
+    
+    // Build the frame before taking the connections lock
+    std::vector<uint8_t> frame = encodeFrame(peerID, message);
+    uint16_t piggybackSize = 0;
+    std::memcpy(&piggybackSize, frame.data() + FRAME_PIGGYBACK_LENGTH_OFFSET, sizeof(uint16_t));
+    
     std::lock_guard<std::mutex> lock(connectionsMutex_);
     auto it = activeConnections_.find(peerID);
     if (it == activeConnections_.end()) {
+        if (stats) {
+            stats->recordSendError();
+        }
         return false;
     }
     
     try {
-        Poco::Net::StreamSocket& socket = it->second;
-        
-        // Send message header
-        char header[32];
-        std::memcpy(header, &message.type, sizeof(MessageType));
-        std::memcpy(header + sizeof(MessageType), &message.senderID, sizeof(NodeID));
-        std::memcpy(header + sizeof(MessageType) + sizeof(NodeID), &message.receiverID, sizeof(NodeID));
-        std::memcpy(header + sizeof(MessageType) + 2 * sizeof(NodeID), &message.timestamp, sizeof(uint64_t));
-        
-        uint32_t payloadSize = static_cast<uint32_t>(message.payload.size());
-        std::memcpy(header + sizeof(MessageType) + 2 * sizeof(NodeID) + sizeof(uint64_t), &payloadSize, sizeof(uint32_t));
-        
-        socket.sendBytes(header, sizeof(header));
-        
-        // Send payload if present
-        if (payloadSize > 0) {
-            socket.sendBytes(message.payload.data(), payloadSize);
-        }
-        
+        it->second.sendBytes(frame.data(), static_cast<int>(frame.size()));
+        piggybackedBytesSent_ += piggybackSize;
         sentMessageCount_++;
+        if (stats) {
+            stats->recordSent(frame.size());
+        }
         return true;
     } catch (Poco::Exception& e) {
         std::cerr << "Failed to send message: " << e.displayText() << std::endl;
+        if (stats) {
+            stats->recordSendError();
+        }
         return false;
     }
 }
 
+std::vector<uint8_t> NetworkManager::encodeFrame(NodeID peerID, const Message& message) {
+    // Collect piggybacked metadata
+    std::vector<uint8_t> piggyback;
+    if (piggybackProvider_) {
+        piggyback = piggybackProvider_(message);
+        if (piggyback.size() > MAX_PIGGYBACK_BYTES) {
+            piggyback.clear();
+        }
+    }
+    
+    // A relayed frame's trailer belonged to its previous link. Compress the
+    // payload too; the peer must have said it decodes the codec
+    uint8_t flags = (message.flags & static_cast<uint8_t>(~(FRAME_FLAG_COMPRESSED | FRAME_FLAG_PIGGYBACK))) |
+                    acceptedCodecFlags();
+    std::vector<uint8_t> compressed;
+    CompressionCodec codec = negotiateCodec(compression_, peerCodecFlags(peerID));
+    if (codec != CompressionCodec::NONE && message.payload.size() >= COMPRESSION_MIN_BYTES) {
+        auto started = std::chrono::steady_clock::now();
+        if (compressPayload(codec, message.payload.data(), message.payload.size(), compressed)) {
+            flags |= FRAME_FLAG_COMPRESSED;
+            compressedFrames_++;
+            compressionSavedBytes_ += message.payload.size() - compressed.size();
+        } else {
+            incompressibleFrames_++;
+        }
+        compressionMicros_ += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count();
+    }
+    const std::vector<uint8_t>& payload = (flags & FRAME_FLAG_COMPRESSED) ? compressed : message.payload;
+    
+    // Message header
+    std::vector<uint8_t> frame(FRAME_HEADER_SIZE, 0);
+    uint8_t* header = frame.data();
+    std::memcpy(header, &message.type, sizeof(MessageType));
+    std::memcpy(header + sizeof(MessageType), &message.senderID, sizeof(NodeID));
+    std::memcpy(header + sizeof(MessageType) + sizeof(NodeID), &message.receiverID, sizeof(NodeID));
+    std::memcpy(header + sizeof(MessageType) + 2 * sizeof(NodeID), &message.timestamp, sizeof(uint64_t));
+    
+    uint32_t payloadSize = static_cast<uint32_t>(payload.size());
+    std::memcpy(header + sizeof(MessageType) + 2 * sizeof(NodeID) + sizeof(uint64_t), &payloadSize, sizeof(uint32_t));
+    
+    uint16_t piggybackSize = static_cast<uint16_t>(piggyback.size());
+    if (piggybackSize > 0) {
+        flags |= FRAME_FLAG_PIGGYBACK;
+    }
+    header[FRAME_FLAGS_OFFSET] = flags;
+    std::memcpy(header + FRAME_PIGGYBACK_LENGTH_OFFSET, &piggybackSize, sizeof(uint16_t));
+    NodeID hopID = node_->getID();
+    std::memcpy(header + FRAME_HOP_OFFSET, &hopID, sizeof(NodeID));
+    header[FRAME_HOP_LIMIT_OFFSET] = message.hopLimit;
+    
+    // Payload, then the piggyback trailer
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    frame.insert(frame.end(), piggyback.begin(), piggyback.end());
+    return frame;
+}
+
+bool NetworkManager::receiveFrame(const uint8_t* frame, size_t size) {
+    if (size < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    
+    Message msg;
+    std::memcpy(&msg.type, frame, sizeof(MessageType));
+    std::memcpy(&msg.senderID, frame + sizeof(MessageType), sizeof(NodeID));
+    std::memcpy(&msg.receiverID, frame + sizeof(MessageType) + sizeof(NodeID), sizeof(NodeID));
+    std::memcpy(&msg.timestamp, frame + sizeof(MessageType) + 2 * sizeof(NodeID), sizeof(uint64_t));
+    
+    uint32_t payloadSize = 0;
+    std::memcpy(&payloadSize, frame + sizeof(MessageType) + 2 * sizeof(NodeID) + sizeof(uint64_t), sizeof(uint32_t));
+    msg.flags = frame[FRAME_FLAGS_OFFSET];
+    uint16_t piggybackSize = 0;
+    if (msg.flags & FRAME_FLAG_PIGGYBACK) {
+        std::memcpy(&piggybackSize, frame + FRAME_PIGGYBACK_LENGTH_OFFSET, sizeof(uint16_t));
+    }
+    NodeID hopID = 0;
+    std::memcpy(&hopID, frame + FRAME_HOP_OFFSET, sizeof(NodeID));
+    msg.hopLimit = frame[FRAME_HOP_LIMIT_OFFSET];
+    if (size != FRAME_HEADER_SIZE + static_cast<size_t>(payloadSize) + piggybackSize) {
+        return false;
+    }
+    
+    const uint8_t* payload = frame + FRAME_HEADER_SIZE;
+    msg.payload.assign(payload, payload + payloadSize);
+    std::vector<uint8_t> piggyback(payload + payloadSize, payload + payloadSize + piggybackSize);
+    deliverFrame(hopID, msg, piggyback, size);
+    return true;
+}
+
 bool NetworkManager::broadcastMessage(const Message& message, NodeID excludeID) {
     std::vector<NodeID> peerIDs = node_->getPeerIDs();
     bool success = true;
@@ -185,6 +275,77 @@ void NetworkManager::setMessageCallback(std::function<void(const Message&)> call
     messageCallback_ = callback;
 }
 
+void NetworkManager::setPiggybackProvider(std::function<std::vector<uint8_t>(const Message&)> provider) {
+    piggybackProvider_ = provider;
+}
+
+void NetworkManager::setFrameReceivedCallback(std::function<void(NodeID)> callback) {
+    frameReceivedCallback_ = callback;
+}
+
+void NetworkManager::setPiggybackHandler(std::function<void(NodeID, const std::vector<uint8_t>&)> handler) {
+    piggybackHandler_ = handler;
+}
+
+void NetworkManager::deliverFrame(NodeID hopID, Message& message, const std::vector<uint8_t>& piggyback,
+                                  size_t frameBytes) {
+    // Note what the neighbour decodes, then undo its compression. The
+    // flags were set by the last hop, which is also who our frames to it
+    // reach; a relayed frame's origin says nothing about that link
+    bool fromPeer = node_->hasPeer(hopID);
+    if (fromPeer) {
+        std::lock_guard<std::mutex> lock(codecsMutex_);
+        peerCodecs_[hopID] = message.flags & (FRAME_FLAG_ACCEPTS_LZ4 | FRAME_FLAG_ACCEPTS_ZSTD);
+    }
+    message.flags &= static_cast<uint8_t>(~(FRAME_FLAG_ACCEPTS_LZ4 | FRAME_FLAG_ACCEPTS_ZSTD));
+    if (message.flags & FRAME_FLAG_COMPRESSED) {
+        auto started = std::chrono::steady_clock::now();
+        bool decoded = decompressFrame(message);
+        decompressionMicros_ += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count();
+        if (!decoded) {
+            std::cerr << "Dropped undecodable compressed frame from node " << message.senderID << std::endl;
+            return;
+        }
+    }
+    
+    // Link counters belong to the neighbour that sent the frame, and only
+    // to one in the peer set: a relayed frame's sender may be many hops
+    // away, and strangers must not use up the stats table
+    receivedMessageCount_++;
+    PeerStats* stats = fromPeer ? node_->getPeerStats(hopID) : nullptr;
+    if (stats) {
+        stats->recordReceived(frameBytes);
+    }
+    
+    // The trailer was attached by the last hop too
+    if (!piggyback.empty() && piggybackHandler_) {
+        piggybackHandler_(hopID, piggyback);
+    }
+    
+    if (frameReceivedCallback_) {
+        frameReceivedCallback_(hopID);
+    }
+    if (messageCallback_) {
+        messageCallback_(message);
+    }
+}
+
+void NetworkManager::setCompression(CompressionCodec codec) {
+    compression_ = isCodecAvailable(codec) ? codec : CompressionCodec::LZ4;
+}
+
+CompressionCodec NetworkManager::getPeerCodec(NodeID peerID) const {
+    return negotiateCodec(compression_, peerCodecFlags(peerID));
+}
+
+uint8_t NetworkManager::peerCodecFlags(NodeID peerID) const {
+    // Until a peer's first frame arrives it gets nothing compressed
+    std::lock_guard<std::mutex> lock(codecsMutex_);
+    auto it = peerCodecs_.find(peerID);
+    return it != peerCodecs_.end() ? it->second : 0;
+}
+
 std::vector<NodeID> NetworkManager::getConnectedPeers() const {
     std::lock_guard<std::mutex> lock(connectionsMutex_);
     std::vector<NodeID> peers;
@@ -4,8 +4,119 @@
 
 namespace P2POverlay {
 
+// PeerStats implementation
+uint64_t PeerStats::nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+void PeerStats::record(DirectionCounters& counters, size_t bytes) {
+    uint64_t now = nowMicros();
+    counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    counters.messages.fetch_add(1, std::memory_order_relaxed);
+    counters.lastMicros.store(now, std::memory_order_relaxed);
+    counters.windowBytes.fetch_add(bytes, std::memory_order_relaxed);
+    
+    // Close the throughput window; only the thread that wins the CAS folds
+    // the window into the smoothed rate
+    uint64_t windowStart = counters.windowStartMicros.load(std::memory_order_relaxed);
+    if (windowStart == 0) {
+        counters.windowStartMicros.compare_exchange_strong(windowStart, now, std::memory_order_relaxed);
+        return;
+    }
+    
+    uint64_t elapsed = now - windowStart;
+    if (elapsed >= THROUGHPUT_WINDOW_US &&
+        counters.windowStartMicros.compare_exchange_strong(windowStart, now, std::memory_order_relaxed)) {
+        uint64_t windowBytes = counters.windowBytes.exchange(0, std::memory_order_relaxed);
+        uint64_t instantRate = windowBytes * 1000000 / elapsed;
+        uint64_t previousRate = counters.rateBytesPerSec.load(std::memory_order_relaxed);
+        uint64_t smoothedRate = previousRate == 0 ? instantRate : (previousRate * 3 + instantRate) / 4;
+        counters.rateBytesPerSec.store(smoothedRate, std::memory_order_relaxed);
+    }
+}
+
+void PeerStats::recordSent(size_t bytes) {
+    record(send_, bytes);
+}
+
+void PeerStats::recordSendError() {
+    send_.errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PeerStats::recordRetransmission() {
+    send_.retransmissions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PeerStats::recordReceived(size_t bytes) {
+    record(receive_, bytes);
+}
+
+void PeerStats::recordRttSample(uint64_t rttMicros) {
+    // Jacobson/Karels estimator (RFC 6298). Concurrent samples may lose an
+    // update, which only delays convergence by one sample.
+    uint64_t samples = rtt_.samples.fetch_add(1, std::memory_order_relaxed);
+    if (samples == 0) {
+        rtt_.smoothed.store(rttMicros, std::memory_order_relaxed);
+        rtt_.variance.store(rttMicros / 2, std::memory_order_relaxed);
+        return;
+    }
+    
+    uint64_t smoothed = rtt_.smoothed.load(std::memory_order_relaxed);
+    uint64_t variance = rtt_.variance.load(std::memory_order_relaxed);
+    uint64_t deviation = smoothed > rttMicros ? smoothed - rttMicros : rttMicros - smoothed;
+    rtt_.variance.store((variance * 3 + deviation) / 4, std::memory_order_relaxed);
+    rtt_.smoothed.store((smoothed * 7 + rttMicros) / 8, std::memory_order_relaxed);
+}
+
+void PeerStats::reset() {
+    for (DirectionCounters* counters : {&send_, &receive_}) {
+        counters->bytes.store(0, std::memory_order_relaxed);
+        counters->messages.store(0, std::memory_order_relaxed);
+        counters->errors.store(0, std::memory_order_relaxed);
+        counters->retransmissions.store(0, std::memory_order_relaxed);
+        counters->lastMicros.store(0, std::memory_order_relaxed);
+        counters->windowStartMicros.store(0, std::memory_order_relaxed);
+        counters->windowBytes.store(0, std::memory_order_relaxed);
+        counters->rateBytesPerSec.store(0, std::memory_order_relaxed);
+    }
+    rtt_.smoothed.store(0, std::memory_order_relaxed);
+    rtt_.variance.store(0, std::memory_order_relaxed);
+    rtt_.samples.store(0, std::memory_order_relaxed);
+}
+
+PeerStatsSnapshot PeerStats::snapshot(NodeID peerID) const {
+    PeerStatsSnapshot snap;
+    snap.peerID = peerID;
+    snap.bytesSent = send_.bytes.load(std::memory_order_relaxed);
+    snap.bytesReceived = receive_.bytes.load(std::memory_order_relaxed);
+    snap.messagesSent = send_.messages.load(std::memory_order_relaxed);
+    snap.messagesReceived = receive_.messages.load(std::memory_order_relaxed);
+    snap.sendErrors = send_.errors.load(std::memory_order_relaxed);
+    snap.retransmissions = send_.retransmissions.load(std::memory_order_relaxed);
+    snap.lastSendMicros = send_.lastMicros.load(std::memory_order_relaxed);
+    snap.lastReceiveMicros = receive_.lastMicros.load(std::memory_order_relaxed);
+    snap.rttSamples = rtt_.samples.load(std::memory_order_relaxed);
+    snap.smoothedRttMs = rtt_.smoothed.load(std::memory_order_relaxed) / 1000.0;
+    snap.rttVarianceMs = rtt_.variance.load(std::memory_order_relaxed) / 1000.0;
+    snap.sendThroughputBps = static_cast<double>(send_.rateBytesPerSec.load(std::memory_order_relaxed));
+    snap.receiveThroughputBps = static_cast<double>(receive_.rateBytesPerSec.load(std::memory_order_relaxed));
+    
+    uint64_t attempts = snap.messagesSent + snap.sendErrors;
+    snap.errorRate = attempts > 0 ? static_cast<double>(snap.sendErrors) / attempts : 0.0;
+    return snap;
+}
+
+// Node implementation
+namespace {
+constexpr NodeID EMPTY_STATS_SLOT = 0;
+constexpr NodeID RELEASED_STATS_SLOT = ~NodeID(0);
+}
+
 Node::Node(NodeID id, const NetworkAddress& address)
-    : nodeID_(id), address_(address), isActive_(true) {
+    : nodeID_(id), address_(address), isActive_(true),
+      peerStatsSlots_(new PeerStatsSlot[PEER_STATS_CAPACITY]) {
     lastSeen_ = std::chrono::system_clock::now();
 }
 
@@ -29,6 +140,7 @@ bool Node::addPeer(NodeID peerID, const NetworkAddress& peerAddress) {
     
     peerIDs_.push_back(peerID);
     peerAddresses_.push_back(peerAddress);
+    trackPeerStats(peerID);
     return true;
 }
 
@@ -43,6 +155,7 @@ bool Node::removePeer(NodeID peerID) {
     size_t index = std::distance(peerIDs_.begin(), it);
     peerIDs_.erase(it);
     peerAddresses_.erase(peerAddresses_.begin() + index);
+    untrackPeerStats(peerID);
     return true;
 }
 
@@ -83,6 +196,124 @@ bool Node::isAlive(int timeoutSeconds) const {
     return elapsed.count() < timeoutSeconds;
 }
 
+const Node::PeerStatsSlot* Node::findPeerStatsSlot(NodeID peerID) const {
+    if (peerID == EMPTY_STATS_SLOT || peerID == RELEASED_STATS_SLOT) {
+        return nullptr;
+    }
+    
+    size_t mask = PEER_STATS_CAPACITY - 1;
+    size_t index = static_cast<size_t>(peerID * 0x9E3779B97F4A7C15ULL) & mask;
+    for (size_t probe = 0; probe < PEER_STATS_CAPACITY; ++probe) {
+        const PeerStatsSlot& slot = peerStatsSlots_[(index + probe) & mask];
+        NodeID key = slot.peerID.load(std::memory_order_acquire);
+        if (key == peerID) {
+            return &slot;
+        }
+        if (key == EMPTY_STATS_SLOT) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+PeerStats* Node::trackPeerStats(NodeID peerID) {
+    const PeerStatsSlot* existing = findPeerStatsSlot(peerID);
+    if (existing) {
+        return const_cast<PeerStats*>(&existing->stats);
+    }
+    
+    if (peerID == EMPTY_STATS_SLOT || peerID == RELEASED_STATS_SLOT) {
+        return nullptr;
+    }
+    
+    std::lock_guard<std::mutex> lock(peerStatsMutex_);
+    
+    // Re-check under the lock, then claim the first free slot in the chain
+    size_t mask = PEER_STATS_CAPACITY - 1;
+    size_t index = static_cast<size_t>(peerID * 0x9E3779B97F4A7C15ULL) & mask;
+    PeerStatsSlot* freeSlot = nullptr;
+    for (size_t probe = 0; probe < PEER_STATS_CAPACITY; ++probe) {
+        PeerStatsSlot& slot = peerStatsSlots_[(index + probe) & mask];
+        NodeID key = slot.peerID.load(std::memory_order_relaxed);
+        if (key == peerID) {
+            return &slot.stats;
+        }
+        if (key == RELEASED_STATS_SLOT && !freeSlot) {
+            freeSlot = &slot;
+        }
+        if (key == EMPTY_STATS_SLOT) {
+            if (!freeSlot) {
+                freeSlot = &slot;
+            }
+            break;
+        }
+    }
+    
+    if (!freeSlot) {
+        return nullptr; // Table full
+    }
+    
+    freeSlot->stats.reset();
+    freeSlot->peerID.store(peerID, std::memory_order_release);
+    return &freeSlot->stats;
+}
+
+PeerStats* Node::getPeerStats(NodeID peerID) {
+    const PeerStatsSlot* slot = findPeerStatsSlot(peerID);
+    return slot ? const_cast<PeerStats*>(&slot->stats) : nullptr;
+}
+
+const PeerStats* Node::getPeerStats(NodeID peerID) const {
+    const PeerStatsSlot* slot = findPeerStatsSlot(peerID);
+    return slot ? &slot->stats : nullptr;
+}
+
+PeerStatsSnapshot Node::getPeerStatsSnapshot(NodeID peerID) const {
+    const PeerStatsSlot* slot = findPeerStatsSlot(peerID);
+    if (slot) {
+        return slot->stats.snapshot(peerID);
+    }
+    return PeerStatsSnapshot();
+}
+
+std::vector<PeerStatsSnapshot> Node::getAllPeerStats() const {
+    std::vector<PeerStatsSnapshot> snapshots;
+    for (size_t i = 0; i < PEER_STATS_CAPACITY; ++i) {
+        NodeID key = peerStatsSlots_[i].peerID.load(std::memory_order_acquire);
+        if (key != EMPTY_STATS_SLOT && key != RELEASED_STATS_SLOT) {
+            snapshots.push_back(peerStatsSlots_[i].stats.snapshot(key));
+        }
+    }
+    return snapshots;
+}
+
+std::vector<NodeID> Node::getIdlePeers(uint64_t idleMicros) const {
+    std::vector<NodeID> peers = getPeerIDs();
+    std::vector<NodeID> idle;
+    uint64_t now = PeerStats::nowMicros();
+    
+    // A peer is idle when nothing has been sent to it for idleMicros
+    for (NodeID peerID : peers) {
+        const PeerStats* stats = getPeerStats(peerID);
+        uint64_t lastSend = stats ? stats->getLastSendMicros() : 0;
+        if (lastSend == 0 || now - lastSend >= idleMicros) {
+            idle.push_back(peerID);
+        }
+    }
+    
+    return idle;
+}
+
+void Node::untrackPeerStats(NodeID peerID) {
+    std::lock_guard<std::mutex> lock(peerStatsMutex_);
+    PeerStatsSlot* slot = const_cast<PeerStatsSlot*>(findPeerStatsSlot(peerID));
+    if (slot) {
+        // Keep the slot in the probe chain; a later claim may reuse and
+        // reset it for another peer, so pointers must not outlive the peer
+        slot->peerID.store(RELEASED_STATS_SLOT, std::memory_order_release);
+    }
+}
+
 bool Node::sendMessage(const Message& /*message*/) {
     // Message sending is handled by NetworkManager
     return true;
@@ -11,7 +11,7 @@ namespace P2POverlay {
 
 // SimulatedNode implementation
 SimulatedNode::SimulatedNode(NodeID id, Port port)
-    : nodeID_(id), running_(false) {
+    : nodeID_(id), running_(false), membershipMode_(MembershipMode::HEARTBEAT) {
     std::string hostname = "localhost";
     try {
         hostname = Poco::Net::DNS::hostName();
@@ -31,6 +31,43 @@ SimulatedNode::SimulatedNode(NodeID id, Port port)
     nodeDiscovery_ = std::make_shared<NodeDiscovery>(node_, networkManager_, topologyManager_);
     nodeRegistration_ = std::make_shared<NodeRegistration>(node_, networkManager_, topologyManager_);
     dynamicNodeManager_ = std::make_shared<DynamicNodeManager>(node_, networkManager_, topologyManager_);
+    swimMembership_ = std::make_shared<SwimMembership>(node_, networkManager_, topologyManager_);
+    
+    // SWIM probes are always answered, whichever mode this node runs
+    auto swimHandler = [this](const Message& msg) { swimMembership_->handleMessage(msg); };
+    messageHandler_->registerHandler(MessageType::SWIM_PING, swimHandler);
+    messageHandler_->registerHandler(MessageType::SWIM_PING_REQ, swimHandler);
+    messageHandler_->registerHandler(MessageType::SWIM_ACK, swimHandler);
+    
+    swimMembership_->setOnMemberJoinedCallback([this](NodeID nodeID, const NetworkAddress& address) {
+        dynamicNodeManager_->addNode(nodeID, address);
+    });
+    dynamicNodeManager_->setOnNodeAddedCallback([this](NodeID nodeID, const NetworkAddress& address) {
+        if (membershipMode_ == MembershipMode::SWIM) {
+            swimMembership_->addMember(nodeID, address);
+        }
+    });
+    networkManager_->setPiggybackProvider([this](const Message& msg) {
+        if (msg.type == MessageType::SWIM_PING || msg.type == MessageType::SWIM_PING_REQ ||
+            msg.type == MessageType::SWIM_ACK) {
+            return std::vector<uint8_t>(); // Probes carry their own updates
+        }
+        return swimMembership_->collectPiggyback();
+    });
+    networkManager_->setPiggybackHandler([this](NodeID senderID, const std::vector<uint8_t>& data) {
+        swimMembership_->applyPiggyback(senderID, data);
+    });
+    swimMembership_->setOnMemberFailedCallback([this](NodeID nodeID) {
+        if (!dynamicNodeManager_->removeNodeForced(nodeID)) {
+            node_->removePeer(nodeID);
+        }
+    });
+    
+    // Any frame proves the neighbour that sent it is alive; a relayed
+    // frame says nothing about its origin
+    networkManager_->setFrameReceivedCallback([this](NodeID hopID) {
+        dynamicNodeManager_->recordHeartbeat(hopID);
+    });
     
     // Set up message callback
     networkManager_->setMessageCallback([this](const Message& msg) {
@@ -109,6 +146,17 @@ void SimulatedNode::leaveNetwork() {
     dynamicNodeManager_->removeNode(nodeID_, true);
 }
 
+void SimulatedNode::setMembershipMode(MembershipMode mode) {
+    // Peers that joined before the switch are added once here; later ones
+    // arrive through the node-added callback
+    if (mode == MembershipMode::SWIM && membershipMode_.exchange(mode) != MembershipMode::SWIM) {
+        for (NodeID peerID : node_->getPeerIDs()) {
+            swimMembership_->addMember(peerID, topologyManager_->getNodeAddress(peerID));
+        }
+    }
+    membershipMode_ = mode;
+}
+
 NodeID SimulatedNode::getID() const {
     return nodeID_;
 }
@@ -118,20 +166,22 @@ NetworkAddress SimulatedNode::getAddress() const {
 }
 
 void SimulatedNode::nodeThreadFunction() {
-    auto lastHeartbeat = std::chrono::steady_clock::now();
+    auto lastHeartbeatCheck = std::chrono::steady_clock::now();
     auto lastMaintenance = std::chrono::steady_clock::now();
     
     while (running_) {
         auto now = std::chrono::steady_clock::now();
         
-        // Send heartbeats
-        if (std::chrono::duration_cast<std::chrono::seconds>(now - lastHeartbeat).count() >= HEARTBEAT_INTERVAL_SEC) {
-            std::vector<NodeID> peers = node_->getPeerIDs();
-            for (NodeID peerID : peers) {
-                Message heartbeat = messageHandler_->createHeartbeat(peerID);
-                networkManager_->sendMessageToPeer(peerID, heartbeat);
-            }
-            lastHeartbeat = now;
+        if (membershipMode_ == MembershipMode::SWIM) {
+            // One probe per protocol period instead of all-to-all heartbeats
+            swimMembership_->tick();
+        } else if (std::chrono::duration_cast<std::chrono::seconds>(now - lastHeartbeatCheck).count() >= 1) {
+            // Heartbeat only links with no outgoing traffic for a full interval
+            messageHandler_->sendIdleHeartbeats(HEARTBEAT_INTERVAL_SEC * 1000000ULL,
+                [this](NodeID peerID, const Message& heartbeat) {
+                    return networkManager_->sendMessageToPeer(peerID, heartbeat);
+                });
+            lastHeartbeatCheck = now;
         }
         
         // Network maintenance
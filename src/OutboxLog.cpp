@@ -0,0 +1,597 @@
+#include "OutboxLog.h"
+#include "Checksum.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace P2POverlay {
+
+namespace {
+
+// A FORWARD is an APPEND copied out of an old segment, prefixed with the
+// segment and offset the original was logged at
+enum class RecordType : uint8_t {
+    APPEND = 1,
+    RESOLVE = 2,
+    FORWARD = 3
+};
+
+// Record header: body length and CRC-32C of the body
+constexpr size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+constexpr size_t FORWARD_POSITION_SIZE = 2 * sizeof(uint64_t);
+
+const char* const SEGMENT_PREFIX = "outbox-";
+const char* const SEGMENT_SUFFIX = ".log";
+
+void appendBytes(std::vector<uint8_t>& buffer, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+bool readBytes(const uint8_t* data, size_t size, size_t& offset, void* out, size_t length) {
+    if (offset + length > size) {
+        return false;
+    }
+    std::memcpy(out, data + offset, length);
+    offset += length;
+    return true;
+}
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Frames a record body with its length and checksum
+std::vector<uint8_t> makeRecord(const std::vector<uint8_t>& body) {
+    std::vector<uint8_t> record;
+    record.reserve(RECORD_HEADER_SIZE + body.size());
+    uint32_t length = static_cast<uint32_t>(body.size());
+    uint32_t crc = crc32c(body.data(), body.size());
+    appendBytes(record, &length, sizeof(length));
+    appendBytes(record, &crc, sizeof(crc));
+    record.insert(record.end(), body.begin(), body.end());
+    return record;
+}
+
+// Visits each intact record with its offset and body; returns the offset
+// of the first torn record, or the size if there is none
+size_t scanRecords(const std::vector<uint8_t>& data,
+                   const std::function<void(size_t, const uint8_t*, uint32_t)>& visit) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        uint32_t length = 0;
+        uint32_t crc = 0;
+        size_t recordStart = offset;
+        if (!readBytes(data.data(), data.size(), offset, &length, sizeof(length)) ||
+            !readBytes(data.data(), data.size(), offset, &crc, sizeof(crc)) ||
+            offset + length > data.size() || length == 0 ||
+            crc32c(data.data() + offset, length) != crc) {
+            return recordStart;
+        }
+        visit(recordStart, data.data() + offset, length);
+        offset += length;
+    }
+    return data.size();
+}
+
+// Bytes of an APPEND or FORWARD body that follow the type and, for a
+// FORWARD, the original position; 0 for other records
+size_t appendBodyStart(const uint8_t* body, uint32_t length) {
+    if (body[0] == static_cast<uint8_t>(RecordType::APPEND)) {
+        return 1;
+    }
+    if (body[0] == static_cast<uint8_t>(RecordType::FORWARD) && length > 1 + FORWARD_POSITION_SIZE) {
+        return 1 + FORWARD_POSITION_SIZE;
+    }
+    return 0;
+}
+
+bool decodeAppend(const uint8_t* data, size_t size, OutboxEntry& entry) {
+    size_t offset = 0;
+    uint8_t type = 0;
+    uint32_t payloadSize = 0;
+    Message& msg = entry.message;
+    if (!readBytes(data, size, offset, &entry.messageID, sizeof(entry.messageID)) ||
+        !readBytes(data, size, offset, &entry.destinationID, sizeof(entry.destinationID)) ||
+        !readBytes(data, size, offset, &type, sizeof(type)) ||
+        !readBytes(data, size, offset, &msg.senderID, sizeof(msg.senderID)) ||
+        !readBytes(data, size, offset, &msg.receiverID, sizeof(msg.receiverID)) ||
+        !readBytes(data, size, offset, &msg.timestamp, sizeof(msg.timestamp)) ||
+        !readBytes(data, size, offset, &msg.flags, sizeof(msg.flags)) ||
+        !readBytes(data, size, offset, &entry.orderedChannel, sizeof(entry.orderedChannel)) ||
+        !readBytes(data, size, offset, &payloadSize, sizeof(payloadSize)) ||
+        offset + payloadSize != size) {
+        return false;
+    }
+    msg.type = static_cast<MessageType>(type);
+    msg.payload.assign(data + offset, data + size);
+    return true;
+}
+
+} // namespace
+
+OutboxLog::OutboxLog(const std::string& directory, size_t segmentBytes)
+    : directory_(directory), segmentBytes_(std::max<size_t>(segmentBytes, 1)),
+      bufferedBytes_(0), activeSegment_(1), activeSegmentBytes_(0), nextLsn_(0),
+      durableLsn_(0), running_(false), failed_(false),
+      groupCommitDelayUs_(OUTBOX_GROUP_COMMIT_US), fd_(-1), fdSegment_(0),
+      syncCount_(0), recordsWritten_(0), segmentsDeleted_(0), recordsForwarded_(0) {
+}
+
+OutboxLog::~OutboxLog() {
+    close();
+}
+
+bool OutboxLog::open(std::vector<OutboxEntry>& recovered) {
+    if (running_) {
+        return false;
+    }
+    
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        std::cerr << "Cannot create outbox directory " << directory_ << ": " << error.message() << std::endl;
+        return false;
+    }
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    liveMessages_.clear();
+    segments_.clear();
+    
+    // Replay every segment in order; later resolutions cancel earlier appends
+    std::map<uint64_t, OutboxEntry> live;
+    std::map<uint64_t, LogPosition> order;
+    std::vector<uint64_t> segments = listSegments();
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (!replaySegment(segments[i], i + 1 == segments.size(), live, order)) {
+            return false;
+        }
+    }
+    for (const auto& pair : liveMessages_) {
+        SegmentUsage& usage = segments_[pair.second.segment];
+        usage.liveCount++;
+        usage.liveBytes += pair.second.bytes;
+    }
+    
+    // Hand back the survivors in the order they were first logged
+    std::map<LogPosition, uint64_t> byPosition;
+    for (const auto& pair : order) {
+        byPosition[pair.second] = pair.first;
+    }
+    recovered.clear();
+    for (const auto& pair : byPosition) {
+        recovered.push_back(live[pair.second]);
+    }
+    
+    // New records never go into a segment that may end in a torn write
+    activeSegment_ = segments.empty() ? 1 : segments.back() + 1;
+    activeSegmentBytes_ = 0;
+    segments_[activeSegment_] = SegmentUsage();
+    bufferedBytes_ = 0;
+    buffer_.clear();
+    failed_ = false;
+    truncateResolvedSegments(lock);
+    
+    running_ = true;
+    flusherThread_ = std::thread(&OutboxLog::flusherLoop, this);
+    return true;
+}
+
+void OutboxLog::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    flushCondition_.notify_all();
+    
+    if (flusherThread_.joinable()) {
+        flusherThread_.join();
+    }
+    closeSegmentFile();
+    durableCondition_.notify_all();
+}
+
+uint64_t OutboxLog::append(uint64_t messageID, NodeID destinationID, const Message& message,
+                           uint32_t orderedChannel) {
+    std::vector<uint8_t> body;
+    body.reserve(64 + message.payload.size());
+    uint8_t recordType = static_cast<uint8_t>(RecordType::APPEND);
+    uint8_t type = static_cast<uint8_t>(message.type);
+    uint32_t payloadSize = static_cast<uint32_t>(message.payload.size());
+    appendBytes(body, &recordType, sizeof(recordType));
+    appendBytes(body, &messageID, sizeof(messageID));
+    appendBytes(body, &destinationID, sizeof(destinationID));
+    appendBytes(body, &type, sizeof(type));
+    appendBytes(body, &message.senderID, sizeof(message.senderID));
+    appendBytes(body, &message.receiverID, sizeof(message.receiverID));
+    appendBytes(body, &message.timestamp, sizeof(message.timestamp));
+    appendBytes(body, &message.flags, sizeof(message.flags));
+    appendBytes(body, &orderedChannel, sizeof(orderedChannel));
+    appendBytes(body, &payloadSize, sizeof(payloadSize));
+    body.insert(body.end(), message.payload.begin(), message.payload.end());
+    
+    std::vector<uint8_t> record = makeRecord(body);
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        return 0;
+    }
+    
+    // A message logged again is live only in its latest append
+    auto previous = liveMessages_.find(messageID);
+    if (previous != liveMessages_.end()) {
+        SegmentUsage& old = segments_[previous->second.segment];
+        old.liveCount--;
+        old.liveBytes -= previous->second.bytes;
+    }
+    
+    size_t bytes = record.size();
+    uint64_t lsn = enqueueRecord(std::move(record));
+    liveMessages_[messageID] = {activeSegment_, bytes};
+    SegmentUsage& usage = segments_[activeSegment_];
+    usage.liveCount++;
+    usage.liveBytes += bytes;
+    return lsn;
+}
+
+uint64_t OutboxLog::resolve(uint64_t messageID) {
+    std::vector<uint8_t> body;
+    uint8_t recordType = static_cast<uint8_t>(RecordType::RESOLVE);
+    appendBytes(body, &recordType, sizeof(recordType));
+    appendBytes(body, &messageID, sizeof(messageID));
+    std::vector<uint8_t> record = makeRecord(body);
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        return 0;
+    }
+    
+    auto it = liveMessages_.find(messageID);
+    if (it == liveMessages_.end()) {
+        return 0;
+    }
+    SegmentUsage& usage = segments_[it->second.segment];
+    usage.liveCount--;
+    usage.liveBytes -= it->second.bytes;
+    liveMessages_.erase(it);
+    
+    return enqueueRecord(std::move(record));
+}
+
+bool OutboxLog::waitDurable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    durableCondition_.wait(lock, [this, lsn] {
+        return durableLsn_ >= lsn || failed_ || !running_;
+    });
+    return durableLsn_ >= lsn;
+}
+
+bool OutboxLog::sync() {
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lsn = nextLsn_;
+    }
+    return waitDurable(lsn);
+}
+
+size_t OutboxLog::getLiveMessageCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return liveMessages_.size();
+}
+
+size_t OutboxLog::getSegmentCount() const {
+    return listSegments().size();
+}
+
+std::string OutboxLog::segmentPath(uint64_t segment) const {
+    std::string number = std::to_string(segment);
+    if (number.size() < 10) {
+        number.insert(0, 10 - number.size(), '0');
+    }
+    return directory_ + "/" + SEGMENT_PREFIX + number + SEGMENT_SUFFIX;
+}
+
+std::vector<uint64_t> OutboxLog::listSegments() const {
+    std::vector<uint64_t> segments;
+    std::error_code error;
+    std::string prefix = SEGMENT_PREFIX;
+    std::string suffix = SEGMENT_SUFFIX;
+    
+    for (const auto& item : std::filesystem::directory_iterator(directory_, error)) {
+        std::string name = item.path().filename().string();
+        if (name.size() <= prefix.size() + suffix.size() ||
+            name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        
+        std::string number = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+        if (!number.empty() && std::all_of(number.begin(), number.end(), ::isdigit)) {
+            segments.push_back(std::stoull(number));
+        }
+    }
+    
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+bool OutboxLog::replaySegment(uint64_t segment, bool isLast, std::map<uint64_t, OutboxEntry>& live,
+                              std::map<uint64_t, LogPosition>& order) {
+    std::string path = segmentPath(segment);
+    std::vector<uint8_t> data;
+    if (!readFile(path, data)) {
+        std::cerr << "Cannot read outbox segment " << path << std::endl;
+        return false;
+    }
+    
+    size_t end = scanRecords(data, [&](size_t recordStart, const uint8_t* body, uint32_t length) {
+        size_t start = appendBodyStart(body, length);
+        if (start > 0) {
+            LogPosition position(segment, recordStart);
+            if (start > 1) {
+                std::memcpy(&position.first, body + 1, sizeof(uint64_t));
+                std::memcpy(&position.second, body + 1 + sizeof(uint64_t), sizeof(uint64_t));
+            }
+            OutboxEntry entry;
+            if (decodeAppend(body + start, length - start, entry)) {
+                live[entry.messageID] = entry;
+                order[entry.messageID] = position;
+                liveMessages_[entry.messageID] = {segment, RECORD_HEADER_SIZE + length};
+            }
+        } else if (body[0] == static_cast<uint8_t>(RecordType::RESOLVE) && length == 1 + sizeof(uint64_t)) {
+            uint64_t messageID = 0;
+            std::memcpy(&messageID, body + 1, sizeof(messageID));
+            live.erase(messageID);
+            order.erase(messageID);
+            liveMessages_.erase(messageID);
+        }
+    });
+    
+    if (end < data.size()) {
+        // Torn tail of the last write: cut it off so appends stay parseable
+        if (isLast) {
+            std::error_code error;
+            std::filesystem::resize_file(path, end, error);
+        } else {
+            std::cerr << "Outbox segment " << path << " is corrupt at offset " << end << std::endl;
+        }
+    }
+    segments_[segment].totalBytes = end;
+    return true;
+}
+
+void OutboxLog::flusherLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    
+    while (true) {
+        flushCondition_.wait(lock, [this] { return !running_ || !buffer_.empty(); });
+        if (buffer_.empty()) {
+            break; // Stopped with nothing left to write
+        }
+        
+        // Linger so concurrent writers share this fsync
+        if (running_ && groupCommitDelayUs_ > 0 && bufferedBytes_ < OUTBOX_GROUP_COMMIT_BYTES) {
+            flushCondition_.wait_for(lock, std::chrono::microseconds(groupCommitDelayUs_.load()), [this] {
+                return !running_ || bufferedBytes_ >= OUTBOX_GROUP_COMMIT_BYTES;
+            });
+        }
+        
+        std::vector<PendingChunk> batch;
+        batch.swap(buffer_);
+        bufferedBytes_ = 0;
+        uint64_t batchLsn = nextLsn_;
+        
+        lock.unlock();
+        bool written = writeBatch(batch);
+        lock.lock();
+        
+        if (written) {
+            durableLsn_ = batchLsn;
+            truncateResolvedSegments(lock);
+        } else {
+            failed_ = true;
+        }
+        durableCondition_.notify_all();
+    }
+}
+
+bool OutboxLog::writeBatch(const std::vector<PendingChunk>& batch) {
+    for (const auto& chunk : batch) {
+        if (chunk.segment != fdSegment_ || fd_ < 0) {
+            if (!openSegmentFile(chunk.segment)) {
+                return false;
+            }
+        }
+        
+        size_t written = 0;
+        while (written < chunk.bytes.size()) {
+            ssize_t result = ::write(fd_, chunk.bytes.data() + written, chunk.bytes.size() - written);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "Outbox write failed: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+    }
+    
+    // One fsync makes the whole batch durable
+    if (fd_ >= 0 && ::fsync(fd_) != 0) {
+        std::cerr << "Outbox fsync failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    syncCount_++;
+    return true;
+}
+
+bool OutboxLog::openSegmentFile(uint64_t segment) {
+    // The previous segment must be complete on disk before moving on
+    if (fd_ >= 0) {
+        ::fsync(fd_);
+    }
+    closeSegmentFile();
+    
+    std::string path = segmentPath(segment);
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Cannot open outbox segment " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    fdSegment_ = segment;
+    
+    // Persist the directory entry of a newly created segment
+    int dirFd = ::open(directory_.c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
+
+void OutboxLog::closeSegmentFile() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+uint64_t OutboxLog::enqueueRecord(std::vector<uint8_t>&& record) {
+    if (activeSegmentBytes_ >= segmentBytes_) {
+        activeSegment_++;
+        activeSegmentBytes_ = 0;
+        segments_[activeSegment_] = SegmentUsage();
+    }
+    
+    activeSegmentBytes_ += record.size();
+    segments_[activeSegment_].totalBytes += record.size();
+    bufferedBytes_ += record.size();
+    if (!buffer_.empty() && buffer_.back().segment == activeSegment_) {
+        buffer_.back().bytes.insert(buffer_.back().bytes.end(), record.begin(), record.end());
+    } else {
+        buffer_.push_back({activeSegment_, std::move(record)});
+    }
+    
+    recordsWritten_++;
+    flushCondition_.notify_one();
+    return ++nextLsn_;
+}
+
+void OutboxLog::truncateResolvedSegments(std::unique_lock<std::mutex>& lock) {
+    // Only a prefix may go: a later segment can hold the resolutions of
+    // appends in an earlier one
+    std::vector<uint64_t> removable;
+    uint64_t forwarding = 0;
+    while (!segments_.empty()) {
+        auto oldest = segments_.begin();
+        const SegmentUsage& usage = oldest->second;
+        if (oldest->first >= activeSegment_ || oldest->first == fdSegment_) {
+            break;
+        }
+        
+        // A mostly resolved segment hands its few live appends on; it goes
+        // once the copies are durable
+        if (usage.liveCount > 0) {
+            if (usage.liveBytes <= usage.totalBytes * OUTBOX_FORWARD_LIVE_FRACTION) {
+                forwarding = oldest->first;
+            }
+            break;
+        }
+        if (durableLsn_ < usage.forwardLsn) {
+            break;
+        }
+        removable.push_back(oldest->first);
+        segments_.erase(oldest);
+    }
+    if (removable.empty() && forwarding == 0) {
+        return;
+    }
+    
+    // Segments behind the active one are never written again, so they are
+    // read and removed without holding up appends
+    lock.unlock();
+    for (uint64_t segment : removable) {
+        std::error_code error;
+        std::filesystem::remove(segmentPath(segment), error);
+        segmentsDeleted_++;
+    }
+    std::vector<uint8_t> data;
+    bool readable = forwarding != 0 && readFile(segmentPath(forwarding), data);
+    lock.lock();
+    
+    if (readable) {
+        forwardLiveRecords(forwarding, data);
+    }
+}
+
+bool OutboxLog::forwardLiveRecords(uint64_t segment, const std::vector<uint8_t>& data) {
+    // Appends and resolutions may have moved on while the file was read
+    auto usageIt = segments_.find(segment);
+    if (usageIt == segments_.end() || usageIt->second.liveCount == 0) {
+        return false;
+    }
+    SegmentUsage& usage = usageIt->second;
+    
+    // Copies keep the original position, however often they move; a
+    // message logged twice in the segment is copied from its latest append
+    std::map<uint64_t, std::vector<uint8_t>> copies;
+    scanRecords(data, [&](size_t recordStart, const uint8_t* body, uint32_t length) {
+        size_t start = appendBodyStart(body, length);
+        uint64_t messageID = 0;
+        if (start == 0 || length < start + sizeof(messageID)) {
+            return;
+        }
+        std::memcpy(&messageID, body + start, sizeof(messageID));
+        auto it = liveMessages_.find(messageID);
+        if (it == liveMessages_.end() || it->second.segment != segment) {
+            return;
+        }
+        
+        std::vector<uint8_t> forward;
+        uint8_t recordType = static_cast<uint8_t>(RecordType::FORWARD);
+        uint64_t position[2] = {segment, recordStart};
+        if (start > 1) {
+            std::memcpy(position, body + 1, FORWARD_POSITION_SIZE);
+        }
+        appendBytes(forward, &recordType, sizeof(recordType));
+        appendBytes(forward, position, FORWARD_POSITION_SIZE);
+        forward.insert(forward.end(), body + start, body + length);
+        copies[messageID] = makeRecord(forward);
+    });
+    if (copies.size() != usage.liveCount) {
+        return false;
+    }
+    
+    for (auto& copy : copies) {
+        size_t bytes = copy.second.size();
+        usage.forwardLsn = enqueueRecord(std::move(copy.second));
+        liveMessages_[copy.first] = {activeSegment_, bytes};
+        SegmentUsage& active = segments_[activeSegment_];
+        active.liveCount++;
+        active.liveBytes += bytes;
+        recordsForwarded_++;
+    }
+    usage.liveCount = 0;
+    usage.liveBytes = 0;
+    return true;
+}
+
+} // namespace P2POverlay
@@ -3,67 +3,378 @@
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <algorithm>
+#include <cstring>
 
 namespace P2POverlay {
 
+namespace {
+
+// Envelope in front of every reliable payload: sender epoch, sequence,
+// message ID and the sender's lowest unacknowledged sequence
+constexpr size_t ENVELOPE_SIZE = sizeof(uint32_t) + 3 * sizeof(uint64_t);
+
+// Ordered-channel header after the envelope: channel ID, position in the
+// channel and the sender's lowest unresolved position in it
+constexpr size_t ORDERED_HEADER_SIZE = sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+// ACK payload: echoed epoch, cumulative sequence and SACK range count
+constexpr size_t ACK_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint8_t);
+
+void appendBytes(std::vector<uint8_t>& buffer, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+bool readBytes(const uint8_t* data, size_t size, size_t& offset, void* out, size_t length) {
+    if (offset + length > size) {
+        return false;
+    }
+    std::memcpy(out, data + offset, length);
+    offset += length;
+    return true;
+}
+
+// Size of the ACK block at data, or 0 if it is truncated
+size_t ackBlockSize(const uint8_t* data, size_t size) {
+    if (size < ACK_HEADER_SIZE) {
+        return 0;
+    }
+    size_t rangeCount = data[ACK_HEADER_SIZE - 1];
+    size_t total = ACK_HEADER_SIZE + rangeCount * 2 * sizeof(uint64_t);
+    return total <= size ? total : 0;
+}
+
+uint64_t currentTimestamp() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+} // namespace
+
 ReliableMessaging::ReliableMessaging(
     std::shared_ptr<Node> node,
     std::shared_ptr<NetworkManager> networkManager)
-    : node_(node), networkManager_(networkManager),
-      retryTimeout_(30), maxRetries_(3),
-      sentMessages_(0), acknowledgedMessages_(0), failedMessages_(0) {
+    : node_(node), networkManager_(networkManager), epoch_(0), random_(std::random_device{}()),
+      minRtoMs_(RELIABLE_MIN_RTO_MS), maxRtoMs_(RELIABLE_MAX_RTO_MS),
+      maxRetries_(RELIABLE_MAX_RETRIES), sendWindow_(RELIABLE_SEND_WINDOW),
+      ackEvery_(RELIABLE_ACK_EVERY), ackDelayUs_(RELIABLE_ACK_DELAY_US),
+      reorderBufferLimit_(ORDERED_REORDER_BUFFER_BYTES), timersRunning_(false),
+      synchronousOutbox_(false),
+      sentMessages_(0), acknowledgedMessages_(0), failedMessages_(0),
+      retransmissions_(0), fastRetransmits_(0), duplicatesReceived_(0),
+      acksSent_(0), acksPiggybacked_(0), reorderBufferBytes_(0), reorderRejections_(0) {
+    // A restarted node must not be mistaken for the old sequence space
+    while (epoch_ == 0) {
+        epoch_ = random_();
+    }
 }
 
 ReliableMessaging::~ReliableMessaging() {
+    stopTimers();
+    if (outbox_) {
+        outbox_->close();
+    }
     cleanupAcknowledgedMessages(0);
 }
 
 uint64_t ReliableMessaging::sendReliableMessage(NodeID targetID, const Message& message) {
+    return sendReliableMessage(targetID, message, std::string());
+}
+
+uint64_t ReliableMessaging::sendReliableMessage(NodeID targetID, const Message& message, const std::string& channel) {
+    return sendReliableMessage(targetID, message, channel, nullptr);
+}
+
+uint64_t ReliableMessaging::sendReliableMessage(NodeID targetID, const Message& message, const std::string& channel,
+                                                std::function<void(uint64_t, bool)> completion) {
     uint64_t messageID = generateMessageID();
+    uint32_t orderedChannel = channel.empty() ? 0 : channelID(channel);
+    std::vector<Message> frames;
     
-    ReliableMessage reliableMsg;
-    reliableMsg.messageID = messageID;
-    reliableMsg.message = message;
-    reliableMsg.destinationID = targetID;
-    reliableMsg.ackStatus = AckStatus::PENDING;
-    reliableMsg.retryCount = 0;
-    reliableMsg.sendTime = std::chrono::system_clock::now();
-    reliableMsg.lastRetry = reliableMsg.sendTime;
+    // The message is logged before it can reach the wire
+    if (outbox_) {
+        uint64_t lsn = outbox_->append(messageID, targetID, message, orderedChannel);
+        if (synchronousOutbox_ && lsn > 0) {
+            outbox_->waitDurable(lsn);
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+        queueLocked(messageID, targetID, message, orderedChannel, frames);
+        pendingMessages_[messageID].completion = std::move(completion);
+    }
+    
+    // A failed transmission is treated as a loss and retried later
+    for (const auto& frame : frames) {
+        if (transmit(targetID, frame)) {
+            sentMessages_++;
+        }
+    }
     
-    // Add message ID to payload (in real implementation)
-    // For now, we'll track it separately
+    return messageID;
+}
+
+bool ReliableMessaging::enableDurableOutbox(const std::string& directory, bool synchronous) {
+    if (outbox_) {
+        return false;
+    }
+    
+    auto outbox = std::make_shared<OutboxLog>(directory);
+    std::vector<OutboxEntry> recovered;
+    if (!outbox->open(recovered)) {
+        return false;
+    }
     
+    synchronousOutbox_ = synchronous;
+    outbox_ = outbox;
+    
+    // Messages unacknowledged at the last shutdown or crash are sent again
+    // under their original IDs
+    std::map<NodeID, std::vector<Message>> frames;
     {
         std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
-        pendingMessages_[messageID] = reliableMsg;
+        for (const auto& entry : recovered) {
+            queueLocked(entry.messageID, entry.destinationID, entry.message, entry.orderedChannel,
+                        frames[entry.destinationID]);
+        }
     }
     
-    // Send message
-    if (networkManager_->sendMessageToPeer(targetID, message)) {
-        sentMessages_++;
-        return messageID;
-    } else {
-        markMessageFailed(messageID);
-        return 0;
+    for (const auto& pair : frames) {
+        for (const auto& frame : pair.second) {
+            if (transmit(pair.first, frame)) {
+                sentMessages_++;
+            }
+        }
+    }
+    
+    if (!recovered.empty()) {
+        std::cout << "Recovered " << recovered.size() << " pending reliable messages from " << directory << std::endl;
+    }
+    return true;
+}
+
+uint32_t ReliableMessaging::channelID(const std::string& channel) {
+    // FNV-1a; 0 is reserved for unordered messages
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : channel) {
+        hash ^= c;
+        hash *= 16777619u;
     }
+    return hash != 0 ? hash : 1;
+}
+
+bool ReliableMessaging::flushOutbox() {
+    return outbox_ ? outbox_->sync() : true;
 }
 
 bool ReliableMessaging::acknowledgeMessage(uint64_t messageID, NodeID senderID) {
-    std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+    std::vector<MessageOutcome> outcomes;
+    std::vector<Message> frames;
+    NodeID destinationID = 0;
     
-    auto it = pendingMessages_.find(messageID);
-    if (it != pendingMessages_.end()) {
-        it->second.ackStatus = AckStatus::ACKNOWLEDGED;
-        acknowledgedMessages_++;
+    {
+        std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+        
+        auto it = pendingMessages_.find(messageID);
+        if (it == pendingMessages_.end()) {
+            return false;
+        }
         
-        if (onMessageDelivered_) {
-            onMessageDelivered_(messageID, senderID);
+        destinationID = it->second.destinationID;
+        auto channelIt = sendChannels_.find(destinationID);
+        if (channelIt != sendChannels_.end()) {
+            channelIt->second.unacked.erase(it->second.sequence);
         }
         
+        acknowledgeLocked(messageID, outcomes);
+        
+        if (channelIt != sendChannels_.end()) {
+            fillSendWindow(destinationID, channelIt->second, frames);
+        }
+    }
+    
+    for (auto& outcome : outcomes) {
+        outcome.peerID = senderID;
+    }
+    notifyOutcomes(outcomes);
+    
+    for (const auto& frame : frames) {
+        if (transmit(destinationID, frame)) {
+            sentMessages_++;
+        }
+    }
+    
+    return true;
+}
+
+bool ReliableMessaging::handleIncomingMessage(const Message& frame, std::vector<Message>& delivered) {
+    if (!(frame.flags & FRAME_FLAG_RELIABLE)) {
+        delivered.push_back(frame);
         return true;
     }
     
-    return false;
+    uint32_t epoch = 0;
+    uint64_t sequence = 0;
+    uint64_t messageID = 0;
+    uint64_t base = 0;
+    size_t offset = 0;
+    const uint8_t* data = frame.payload.data();
+    size_t size = frame.payload.size();
+    if (!readBytes(data, size, offset, &epoch, sizeof(epoch)) ||
+        !readBytes(data, size, offset, &sequence, sizeof(sequence)) ||
+        !readBytes(data, size, offset, &messageID, sizeof(messageID)) ||
+        !readBytes(data, size, offset, &base, sizeof(base))) {
+        return false;
+    }
+    
+    uint32_t orderedChannel = 0;
+    uint64_t orderedSequence = 0;
+    uint64_t orderedBase = 0;
+    if ((frame.flags & FRAME_FLAG_ORDERED) &&
+        (!readBytes(data, size, offset, &orderedChannel, sizeof(orderedChannel)) ||
+         !readBytes(data, size, offset, &orderedSequence, sizeof(orderedSequence)) ||
+         !readBytes(data, size, offset, &orderedBase, sizeof(orderedBase)))) {
+        return false;
+    }
+    
+    size_t ackOffset = offset;
+    size_t ackSize = 0;
+    if (frame.flags & FRAME_FLAG_ACK) {
+        ackSize = ackBlockSize(data + offset, size - offset);
+        if (ackSize == 0) {
+            return false;
+        }
+    }
+    
+    Message inner = frame;
+    inner.flags &= static_cast<uint8_t>(~(FRAME_FLAG_RELIABLE | FRAME_FLAG_ACK | FRAME_FLAG_ACK_NOW |
+                                          FRAME_FLAG_ORDERED));
+    inner.payload.assign(frame.payload.begin() + ackOffset + ackSize, frame.payload.end());
+    
+    bool isNew = false;
+    bool inWindow = true;
+    bool admitted = true;
+    bool sendAck = false;
+    Message ack;
+    size_t deliveredBefore = delivered.size();
+    
+    {
+        std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+        ReceiveChannel& channel = receiveChannels_[frame.senderID];
+        
+        // New epoch: the sender restarted and numbers from scratch
+        if (channel.epoch != epoch) {
+            reorderBufferBytes_ -= channel.reorderBytes();
+            channel = ReceiveChannel();
+            channel.epoch = epoch;
+        }
+        
+        // The sender gave up on everything below its send base
+        channel.window.advanceTo(base);
+        
+        // A message that would overflow its reorder buffer is refused before
+        // it is acknowledged, so the sender keeps it and retries later
+        if (orderedChannel != 0 && !channel.window.contains(sequence) && channel.window.inWindow(sequence)) {
+            OrderedStream& stream = channel.ordered[orderedChannel];
+            admitted = orderedSequence <= std::max(stream.nextDeliver, orderedBase) ||
+                       stream.bufferedBytes + inner.payload.size() <= reorderBufferLimit_;
+        }
+        
+        if (admitted) {
+            uint64_t expected = channel.window.getCumulative();
+            inWindow = channel.window.inWindow(sequence);
+            isNew = channel.window.insert(sequence);
+            
+            // Duplicates (a lost ACK), gaps, filled gaps and a full sender window
+            // are acknowledged at once; in-order arrivals are batched
+            bool immediate = !isNew || sequence != expected || channel.window.hasGaps() ||
+                             channel.window.getCumulative() > sequence + 1 || (frame.flags & FRAME_FLAG_ACK_NOW) ||
+                             ++channel.unacknowledged >= ackEvery_;
+            if (immediate) {
+                ack = buildAck(frame.senderID, channel);
+                sendAck = true;
+            } else if (!channel.ackPending) {
+                channel.ackPending = true;
+                channel.ackDeadline = std::chrono::steady_clock::now() +
+                                      std::chrono::microseconds(ackDelayUs_.load());
+            }
+            
+            if (isNew && orderedChannel == 0) {
+                delivered.push_back(inner);
+            } else if (isNew) {
+                OrderedStream& stream = channel.ordered[orderedChannel];
+                if (orderedSequence >= stream.nextDeliver) {
+                    stream.bufferedBytes += inner.payload.size();
+                    reorderBufferBytes_ += inner.payload.size();
+                    stream.pending[orderedSequence] = std::move(inner);
+                }
+                releaseOrdered(stream, orderedBase, delivered);
+            }
+        }
+    }
+    
+    if (ackSize > 0) {
+        applyAck(frame.senderID, data + ackOffset, ackSize);
+    }
+    
+    if (sendAck && transmit(frame.senderID, ack)) {
+        acksSent_++;
+    }
+    
+    if (!admitted) {
+        reorderRejections_++;
+    } else if (!isNew && inWindow) {
+        duplicatesReceived_++;
+    }
+    return delivered.size() > deliveredBefore;
+}
+
+void ReliableMessaging::handleAck(const Message& ack) {
+    applyAck(ack.senderID, ack.payload.data(), ack.payload.size());
+}
+
+void ReliableMessaging::flushDelayedAcks() {
+    std::vector<Message> acks;
+    
+    {
+        std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+        auto now = std::chrono::steady_clock::now();
+        for (auto& pair : receiveChannels_) {
+            if (pair.second.ackPending && pair.second.ackDeadline <= now) {
+                acks.push_back(buildAck(pair.first, pair.second));
+            }
+        }
+    }
+    
+    for (const auto& ack : acks) {
+        if (transmit(ack.receiverID, ack)) {
+            acksSent_++;
+        }
+    }
+}
+
+void ReliableMessaging::startTimers() {
+    if (timersRunning_) {
+        return;
+    }
+    
+    timersRunning_ = true;
+    timerThread_ = std::thread(&ReliableMessaging::timerLoop, this);
+}
+
+void ReliableMessaging::stopTimers() {
+    {
+        std::lock_guard<std::mutex> lock(timerMutex_);
+        timersRunning_ = false;
+    }
+    timerCondition_.notify_all();
+    
+    if (timerThread_.joinable()) {
+        timerThread_.join();
+    }
 }
 
 bool ReliableMessaging::isMessageAcknowledged(uint64_t messageID) const {
@@ -75,54 +386,114 @@ bool ReliableMessaging::isMessageAcknowledged(uint64_t messageID) const {
     return false;
 }
 
-void ReliableMessaging::retryPendingMessages(int timeoutSeconds, int maxRetries) {
-    std::vector<uint64_t> toRetry;
-    std::vector<uint64_t> toFail;
+size_t ReliableMessaging::getInFlightCount(NodeID peerID) const {
+    std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+    auto it = sendChannels_.find(peerID);
+    if (it == sendChannels_.end()) {
+        return 0;
+    }
+    
+    const SendChannel& channel = it->second;
+    return std::distance(channel.unacked.begin(), channel.unacked.lower_bound(channel.nextTransmit));
+}
+
+size_t ReliableMessaging::getBufferedPayloadBytes() const {
+    std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+    size_t bytes = 0;
+    for (const auto& pair : pendingMessages_) {
+        bytes += pair.second.message.payload.size();
+    }
+    return bytes;
+}
+
+void ReliableMessaging::retryPendingMessages() {
+    std::map<NodeID, std::vector<Message>> retransmits;
+    std::map<NodeID, std::vector<Message>> frames;
+    std::vector<MessageOutcome> failed;
     
     {
         std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
         auto now = std::chrono::system_clock::now();
         
-        for (auto& pair : pendingMessages_) {
-            ReliableMessage& msg = pair.second;
+        // Only due channels and, within them, due deadlines are visited;
+        // idle peers and messages waiting for window space or an ACK within
+        // their RTO are never touched
+        while (!dueChannels_.empty() && dueChannels_.top().deadline <= now) {
+            ChannelDeadline dueChannel = dueChannels_.top();
+            dueChannels_.pop();
             
-            if (msg.ackStatus == AckStatus::ACKNOWLEDGED) {
+            auto channelIt = sendChannels_.find(dueChannel.peerID);
+            if (channelIt == sendChannels_.end() || channelIt->second.dueAt != dueChannel.deadline) {
                 continue;
             }
+            NodeID peerID = channelIt->first;
+            SendChannel& channel = channelIt->second;
+            channel.dueAt = std::chrono::system_clock::time_point::max();
+            bool timedOut = false;
             
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - msg.lastRetry);
-            
-            if (elapsed.count() >= timeoutSeconds) {
-                if (msg.retryCount < maxRetries) {
-                    toRetry.push_back(pair.first);
+            while (!channel.deadlines.empty() && channel.deadlines.top().deadline <= now) {
+                RetryDeadline due = channel.deadlines.top();
+                channel.deadlines.pop();
+                
+                auto seqIt = channel.unacked.find(due.sequence);
+                if (seqIt == channel.unacked.end()) {
+                    continue;
+                }
+                auto it = pendingMessages_.find(seqIt->second);
+                if (it == pendingMessages_.end() || it->second.ackStatus != AckStatus::PENDING ||
+                    it->second.lastRetry + it->second.retransmitTimeout != due.deadline) {
+                    continue;
+                }
+                
+                ReliableMessage& msg = it->second;
+                if (msg.retryCount < maxRetries_) {
+                    msg.retryCount++;
+                    msg.lastRetry = now;
+                    msg.retransmitTimeout = backOff(msg.retransmitTimeout);
+                    retransmits[peerID].push_back(buildFrame(msg, sendBase(channel)));
+                    scheduleRetryLocked(channel, msg);
+                    retransmissions_++;
+                    PeerStats* stats = node_->getPeerStats(peerID);
+                    if (stats) {
+                        stats->recordRetransmission();
+                    }
+                    timedOut = true;
                 } else {
-                    toFail.push_back(pair.first);
+                    failLocked(msg.messageID, frames[peerID], failed);
                 }
             }
+            
+            if (channel.unacked.empty()) {
+                channel.deadlines = decltype(channel.deadlines)();
+            } else if (!channel.deadlines.empty() && channel.deadlines.top().deadline < channel.dueAt) {
+                channel.dueAt = channel.deadlines.top().deadline;
+                dueChannels_.push({channel.dueAt, peerID});
+            }
+            
+            // One timeout event per peer and pass, however many messages
+            // expired: a loss burst doubles the RTO once, not once per message
+            if (timedOut) {
+                channel.backoffShift = std::min(channel.backoffShift + 1, 16);
+                congestion_.onTimeout(peerID);
+            }
         }
     }
     
-    // Retry messages
-    for (uint64_t msgID : toRetry) {
-        ReliableMessage msg;
-        {
-            std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
-            auto it = pendingMessages_.find(msgID);
-            if (it != pendingMessages_.end()) {
-                msg = it->second;
-                it->second.retryCount++;
-                it->second.lastRetry = std::chrono::system_clock::now();
-            } else {
-                continue;
-            }
+    notifyOutcomes(failed);
+    
+    // Each peer's retransmissions and the messages that took the place of
+    // failed ones go out together
+    for (const auto& pair : retransmits) {
+        for (const auto& frame : pair.second) {
+            transmit(pair.first, frame);
         }
-        
-        sendWithRetry(msg);
     }
-    
-    // Mark failed messages
-    for (uint64_t msgID : toFail) {
-        markMessageFailed(msgID);
+    for (const auto& pair : frames) {
+        for (const auto& frame : pair.second) {
+            if (transmit(pair.first, frame)) {
+                sentMessages_++;
+            }
+        }
     }
 }
 
@@ -148,6 +519,35 @@ void ReliableMessaging::cleanupAcknowledgedMessages(int timeoutSeconds) {
     }
 }
 
+void ReliableMessaging::setRtoBounds(int minRtoMs, int maxRtoMs) {
+    minRtoMs_ = std::max(minRtoMs, 1);
+    maxRtoMs_ = std::max(maxRtoMs, minRtoMs_.load());
+}
+
+int ReliableMessaging::getRetransmitTimeoutMs(NodeID peerID) const {
+    std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+    auto it = sendChannels_.find(peerID);
+    return static_cast<int>(currentRto(it != sendChannels_.end() ? it->second : SendChannel()).count());
+}
+
+size_t ReliableMessaging::getDedupMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+    size_t total = 0;
+    for (const auto& pair : receiveChannels_) {
+        total += pair.second.window.getMemoryUsage();
+    }
+    return total;
+}
+
+void ReliableMessaging::setAckPolicy(size_t everyMessages, int delayMicros) {
+    ackEvery_ = std::max<size_t>(everyMessages, 1);
+    ackDelayUs_ = std::max(delayMicros, 0);
+}
+
+void ReliableMessaging::setTransport(std::function<bool(NodeID, const Message&)> transport) {
+    transport_ = transport;
+}
+
 void ReliableMessaging::setOnMessageDeliveredCallback(std::function<void(uint64_t, NodeID)> callback) {
     onMessageDelivered_ = callback;
 }
@@ -170,29 +570,449 @@ uint64_t ReliableMessaging::generateMessageID() {
     return dis(gen);
 }
 
-bool ReliableMessaging::sendWithRetry(const ReliableMessage& reliableMsg) {
-    return networkManager_->sendMessageToPeer(reliableMsg.destinationID, reliableMsg.message);
-}
-
 void ReliableMessaging::markMessageAcknowledged(uint64_t messageID) {
     acknowledgeMessage(messageID, 0);
 }
 
 void ReliableMessaging::markMessageFailed(uint64_t messageID) {
-    std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+    NodeID destinationID = 0;
+    std::vector<Message> frames;
+    std::vector<MessageOutcome> outcomes;
     
+    {
+        std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+        
+        auto it = pendingMessages_.find(messageID);
+        if (it == pendingMessages_.end()) {
+            return;
+        }
+        destinationID = it->second.destinationID;
+        failLocked(messageID, frames, outcomes);
+    }
+    
+    notifyOutcomes(outcomes);
+    
+    for (const auto& frame : frames) {
+        if (transmit(destinationID, frame)) {
+            sentMessages_++;
+        }
+    }
+}
+
+bool ReliableMessaging::failLocked(uint64_t messageID, std::vector<Message>& frames,
+                                   std::vector<MessageOutcome>& outcomes) {
     auto it = pendingMessages_.find(messageID);
-    if (it != pendingMessages_.end()) {
-        it->second.ackStatus = AckStatus::FAILED;
-        failedMessages_++;
+    if (it == pendingMessages_.end()) {
+        return false;
+    }
+    
+    it->second.ackStatus = AckStatus::FAILED;
+    failedMessages_++;
+    NodeID destinationID = it->second.destinationID;
+    if (outbox_) {
+        outbox_->resolve(messageID);
+    }
+    
+    // Giving up slides the window; the receiver skips the hole once it
+    // sees the new send base
+    auto channelIt = sendChannels_.find(destinationID);
+    if (channelIt != sendChannels_.end()) {
+        channelIt->second.unacked.erase(it->second.sequence);
+        fillSendWindow(destinationID, channelIt->second, frames);
+    }
+    releaseOrderedLocked(it->second);
+    outcomes.push_back({messageID, destinationID, false, std::move(it->second.completion)});
+    
+    pendingMessages_.erase(it);
+    return true;
+}
+
+void ReliableMessaging::scheduleRetryLocked(SendChannel& channel, const ReliableMessage& reliableMsg) {
+    auto deadline = reliableMsg.lastRetry + reliableMsg.retransmitTimeout;
+    channel.deadlines.push({deadline, reliableMsg.sequence});
+    
+    // The channel moves up the due-channel heap only when its earliest deadline does
+    if (deadline < channel.dueAt) {
+        channel.dueAt = deadline;
+        dueChannels_.push({deadline, reliableMsg.destinationID});
+    }
+}
+
+void ReliableMessaging::queueLocked(uint64_t messageID, NodeID targetID, const Message& message,
+                                    uint32_t orderedChannel, std::vector<Message>& frames) {
+    SendChannel& channel = sendChannels_[targetID];
+    
+    ReliableMessage reliableMsg;
+    reliableMsg.messageID = messageID;
+    reliableMsg.message = message;
+    reliableMsg.destinationID = targetID;
+    reliableMsg.ackStatus = AckStatus::PENDING;
+    reliableMsg.retryCount = 0;
+    reliableMsg.sequence = channel.nextSequence++;
+    reliableMsg.orderedChannel = orderedChannel;
+    if (orderedChannel != 0) {
+        SendChannel::OrderedState& ordered = channel.ordered[orderedChannel];
+        reliableMsg.orderedSequence = ordered.nextSequence++;
+        ordered.unacked.insert(reliableMsg.orderedSequence);
+    }
+    reliableMsg.sendTime = std::chrono::system_clock::now();
+    reliableMsg.lastRetry = reliableMsg.sendTime;
+    
+    pendingMessages_[messageID] = reliableMsg;
+    channel.unacked[reliableMsg.sequence] = messageID;
+    
+    // Messages beyond the window wait for ACKs to open it
+    fillSendWindow(targetID, channel, frames);
+}
+
+void ReliableMessaging::releaseOrderedLocked(const ReliableMessage& reliableMsg) {
+    if (reliableMsg.orderedChannel == 0) {
+        return;
+    }
+    
+    auto channelIt = sendChannels_.find(reliableMsg.destinationID);
+    if (channelIt == sendChannels_.end()) {
+        return;
+    }
+    auto orderedIt = channelIt->second.ordered.find(reliableMsg.orderedChannel);
+    if (orderedIt != channelIt->second.ordered.end()) {
+        orderedIt->second.unacked.erase(reliableMsg.orderedSequence);
+    }
+}
+
+void ReliableMessaging::releaseOrdered(OrderedStream& stream, uint64_t senderBase, std::vector<Message>& delivered) {
+    // Everything below the sender's base is resolved: what arrived is
+    // delivered, the rest was abandoned and is skipped
+    auto it = stream.pending.begin();
+    while (it != stream.pending.end() && it->first < senderBase) {
+        stream.bufferedBytes -= it->second.payload.size();
+        reorderBufferBytes_ -= it->second.payload.size();
+        delivered.push_back(std::move(it->second));
+        it = stream.pending.erase(it);
+    }
+    stream.nextDeliver = std::max(stream.nextDeliver, senderBase);
+    
+    while (it != stream.pending.end() && it->first == stream.nextDeliver) {
+        stream.bufferedBytes -= it->second.payload.size();
+        reorderBufferBytes_ -= it->second.payload.size();
+        delivered.push_back(std::move(it->second));
+        it = stream.pending.erase(it);
+        stream.nextDeliver++;
+    }
+}
+
+bool ReliableMessaging::acknowledgeLocked(uint64_t messageID, std::vector<MessageOutcome>& outcomes) {
+    auto it = pendingMessages_.find(messageID);
+    if (it == pendingMessages_.end() || it->second.ackStatus != AckStatus::PENDING) {
+        return false;
+    }
+    
+    it->second.ackStatus = AckStatus::ACKNOWLEDGED;
+    acknowledgedMessages_++;
+    releaseOrderedLocked(it->second);
+    if (outbox_) {
+        outbox_->resolve(messageID);
+    }
+    
+    // Only unretransmitted messages give an unambiguous RTT sample
+    uint64_t rttMicros = 0;
+    if (it->second.retryCount == 0 && it->second.transmitted) {
+        auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now() - it->second.sendTime
+        );
+        rttMicros = static_cast<uint64_t>(std::max<int64_t>(rtt.count(), 1));
+        PeerStats* stats = node_->getPeerStats(it->second.destinationID);
+        if (stats) {
+            stats->recordRttSample(rttMicros);
+        }
+        
+        // A clean sample ends the backoff kept since the last timeout
+        auto channelIt = sendChannels_.find(it->second.destinationID);
+        if (channelIt != sendChannels_.end()) {
+            recordRttLocked(channelIt->second, rttMicros);
+            channelIt->second.backoffShift = 0;
+        }
+    }
+    congestion_.onAck(it->second.destinationID, 1, rttMicros);
+    
+    // The completion fires once; the acknowledged record is kept only for
+    // lookups, so it gives up its copy of the message straight away
+    outcomes.push_back({messageID, it->second.destinationID, true, std::move(it->second.completion)});
+    it->second.completion = nullptr;
+    std::vector<uint8_t>().swap(it->second.message.payload);
+    return true;
+}
+
+void ReliableMessaging::fillSendWindow(NodeID peerID, SendChannel& channel, std::vector<Message>& frames) {
+    auto now = std::chrono::system_clock::now();
+    uint64_t base = sendBase(channel);
+    size_t firstFrame = frames.size();
+    
+    // The congestion window caps messages in flight, the send window the
+    // sequence span the receiver must buffer
+    size_t congestionWindow = congestion_.getWindow(peerID);
+    size_t inFlight = std::distance(channel.unacked.begin(), channel.unacked.lower_bound(channel.nextTransmit));
+    
+    while (channel.nextTransmit < channel.nextSequence && channel.nextTransmit < base + sendWindow_ &&
+           inFlight < congestionWindow) {
+        auto seqIt = channel.unacked.find(channel.nextTransmit++);
+        if (seqIt == channel.unacked.end()) {
+            continue;
+        }
         
-        if (onMessageFailed_) {
-            onMessageFailed_(messageID, it->second.destinationID);
+        auto it = pendingMessages_.find(seqIt->second);
+        if (it == pendingMessages_.end()) {
+            continue;
         }
         
-        pendingMessages_.erase(it);
+        it->second.transmitted = true;
+        it->second.sendTime = now;
+        it->second.lastRetry = now;
+        it->second.retransmitTimeout = currentRto(channel);
+        scheduleRetryLocked(channel, it->second);
+        frames.push_back(buildFrame(it->second, base));
+        inFlight++;
+    }
+    
+    // Nothing more can be sent until this burst is acknowledged
+    bool congestionLimited = inFlight >= congestionWindow && channel.nextTransmit < channel.nextSequence;
+    if (frames.size() > firstFrame && (channel.nextTransmit >= base + sendWindow_ || congestionLimited)) {
+        frames.back().flags |= FRAME_FLAG_ACK_NOW;
     }
 }
 
-} // namespace P2POverlay
+Message ReliableMessaging::buildFrame(const ReliableMessage& reliableMsg, uint64_t base) {
+    Message frame = reliableMsg.message;
+    frame.receiverID = reliableMsg.destinationID;
+    frame.flags |= FRAME_FLAG_RELIABLE;
+    
+    frame.payload.clear();
+    frame.payload.reserve(ENVELOPE_SIZE + ORDERED_HEADER_SIZE + reliableMsg.message.payload.size());
+    appendBytes(frame.payload, &epoch_, sizeof(epoch_));
+    appendBytes(frame.payload, &reliableMsg.sequence, sizeof(reliableMsg.sequence));
+    appendBytes(frame.payload, &reliableMsg.messageID, sizeof(reliableMsg.messageID));
+    appendBytes(frame.payload, &base, sizeof(base));
+    
+    if (reliableMsg.orderedChannel != 0) {
+        uint64_t orderedBase = reliableMsg.orderedSequence;
+        auto sendIt = sendChannels_.find(reliableMsg.destinationID);
+        if (sendIt != sendChannels_.end()) {
+            auto orderedIt = sendIt->second.ordered.find(reliableMsg.orderedChannel);
+            if (orderedIt != sendIt->second.ordered.end()) {
+                const auto& unacked = orderedIt->second.unacked;
+                orderedBase = unacked.empty() ? orderedIt->second.nextSequence : *unacked.begin();
+            }
+        }
+        frame.flags |= FRAME_FLAG_ORDERED;
+        appendBytes(frame.payload, &reliableMsg.orderedChannel, sizeof(reliableMsg.orderedChannel));
+        appendBytes(frame.payload, &reliableMsg.orderedSequence, sizeof(reliableMsg.orderedSequence));
+        appendBytes(frame.payload, &orderedBase, sizeof(orderedBase));
+    }
+    
+    // A held-back ACK for the reverse direction rides along for free
+    auto channelIt = receiveChannels_.find(reliableMsg.destinationID);
+    if (channelIt != receiveChannels_.end() && channelIt->second.ackPending) {
+        frame.flags |= FRAME_FLAG_ACK;
+        appendAckBlock(frame.payload, channelIt->second);
+        acksPiggybacked_++;
+    }
+    
+    frame.payload.insert(frame.payload.end(), reliableMsg.message.payload.begin(),
+                         reliableMsg.message.payload.end());
+    return frame;
+}
 
+Message ReliableMessaging::buildAck(NodeID peerID, ReceiveChannel& channel) {
+    Message ack;
+    ack.type = MessageType::MESSAGE_ACK;
+    ack.senderID = node_->getID();
+    ack.receiverID = peerID;
+    ack.timestamp = currentTimestamp();
+    appendAckBlock(ack.payload, channel);
+    return ack;
+}
+
+void ReliableMessaging::appendAckBlock(std::vector<uint8_t>& buffer, ReceiveChannel& channel) {
+    // Out-of-order arrivals are reported as the lowest few ranges
+    std::vector<SackRange> ranges = channel.window.getRanges(MAX_SACK_RANGES);
+    uint64_t cumulative = channel.window.getCumulative();
+    
+    uint8_t rangeCount = static_cast<uint8_t>(ranges.size());
+    buffer.reserve(buffer.size() + ACK_HEADER_SIZE + ranges.size() * 2 * sizeof(uint64_t));
+    appendBytes(buffer, &channel.epoch, sizeof(channel.epoch));
+    appendBytes(buffer, &cumulative, sizeof(cumulative));
+    appendBytes(buffer, &rangeCount, sizeof(rangeCount));
+    for (const auto& range : ranges) {
+        appendBytes(buffer, &range.first, sizeof(range.first));
+        appendBytes(buffer, &range.last, sizeof(range.last));
+    }
+    
+    channel.unacknowledged = 0;
+    channel.ackPending = false;
+}
+
+uint64_t ReliableMessaging::sendBase(const SendChannel& channel) const {
+    return channel.unacked.empty() ? channel.nextSequence : channel.unacked.begin()->first;
+}
+
+void ReliableMessaging::recordRttLocked(SendChannel& channel, uint64_t rttMicros) {
+    // RFC 6298 smoothing over the end-to-end path, which may span relays
+    if (channel.rttSamples == 0) {
+        channel.smoothedRttMicros = rttMicros;
+        channel.rttVarianceMicros = rttMicros / 2;
+    } else {
+        uint64_t delta = channel.smoothedRttMicros > rttMicros ? channel.smoothedRttMicros - rttMicros
+                                                               : rttMicros - channel.smoothedRttMicros;
+        channel.rttVarianceMicros = (3 * channel.rttVarianceMicros + delta) / 4;
+        channel.smoothedRttMicros = (7 * channel.smoothedRttMicros + rttMicros) / 8;
+    }
+    channel.rttSamples++;
+}
+
+std::chrono::milliseconds ReliableMessaging::currentRto(const SendChannel& channel) const {
+    int64_t rtoMs = RELIABLE_INITIAL_RTO_MS;
+    
+    // RTO = SRTT + max(G, 4 * RTTVAR) with a clock granularity G of 1 ms
+    if (channel.rttSamples > 0) {
+        uint64_t rtoMicros = channel.smoothedRttMicros +
+                             std::max<uint64_t>(1000, 4 * channel.rttVarianceMicros);
+        rtoMs = static_cast<int64_t>((rtoMicros + 999) / 1000);
+    }
+    
+    rtoMs = std::max<int64_t>(rtoMs, minRtoMs_);
+    rtoMs <<= channel.backoffShift;
+    return std::chrono::milliseconds(std::min<int64_t>(rtoMs, maxRtoMs_));
+}
+
+std::chrono::milliseconds ReliableMessaging::backOff(std::chrono::milliseconds timeout) {
+    // Jitter keeps peers that lost packets together from retrying in lockstep
+    int64_t doubled = std::min<int64_t>(timeout.count() * 2, maxRtoMs_);
+    std::uniform_real_distribution<double> jitter(0.0, RELIABLE_RTO_JITTER);
+    int64_t extended = doubled + static_cast<int64_t>(doubled * jitter(random_));
+    return std::chrono::milliseconds(std::min<int64_t>(extended, maxRtoMs_));
+}
+
+bool ReliableMessaging::transmit(NodeID peerID, const Message& frame) {
+    if (transport_) {
+        return transport_(peerID, frame);
+    }
+    return networkManager_->sendMessageToPeer(peerID, frame);
+}
+
+void ReliableMessaging::applyAck(NodeID peerID, const uint8_t* data, size_t size) {
+    uint32_t epoch = 0;
+    uint64_t cumulative = 0;
+    uint8_t rangeCount = 0;
+    size_t offset = 0;
+    if (!readBytes(data, size, offset, &epoch, sizeof(epoch)) ||
+        !readBytes(data, size, offset, &cumulative, sizeof(cumulative)) ||
+        !readBytes(data, size, offset, &rangeCount, sizeof(rangeCount))) {
+        return;
+    }
+    
+    // ACKs for a previous instance of this node refer to another sequence space
+    if (epoch != epoch_) {
+        return;
+    }
+    
+    std::vector<SackRange> ranges;
+    for (uint8_t i = 0; i < rangeCount; ++i) {
+        SackRange range;
+        if (!readBytes(data, size, offset, &range.first, sizeof(range.first)) ||
+            !readBytes(data, size, offset, &range.last, sizeof(range.last))) {
+            return;
+        }
+        ranges.push_back(range);
+    }
+    
+    std::vector<MessageOutcome> outcomes;
+    std::vector<Message> retransmits;
+    std::vector<Message> frames;
+    
+    {
+        std::lock_guard<std::mutex> lock(pendingMessagesMutex_);
+        auto channelIt = sendChannels_.find(peerID);
+        if (channelIt == sendChannels_.end()) {
+            return;
+        }
+        SendChannel& channel = channelIt->second;
+        
+        // Cumulative part
+        while (!channel.unacked.empty() && channel.unacked.begin()->first < cumulative) {
+            acknowledgeLocked(channel.unacked.begin()->second, outcomes);
+            channel.unacked.erase(channel.unacked.begin());
+        }
+        
+        // Selective part
+        for (const auto& range : ranges) {
+            auto it = channel.unacked.lower_bound(range.first);
+            while (it != channel.unacked.end() && it->first <= range.last) {
+                acknowledgeLocked(it->second, outcomes);
+                it = channel.unacked.erase(it);
+            }
+        }
+        
+        if (cumulative > channel.lastCumulativeAck) {
+            channel.lastCumulativeAck = cumulative;
+            channel.duplicateAcks = 0;
+        } else if (!channel.unacked.empty() && channel.unacked.begin()->first == cumulative &&
+                   cumulative < channel.nextTransmit) {
+            // Later messages arrived but the first hole did not: resend it now
+            if (++channel.duplicateAcks == FAST_RETRANSMIT_DUP_ACKS) {
+                auto it = pendingMessages_.find(channel.unacked.begin()->second);
+                if (it != pendingMessages_.end()) {
+                    it->second.retryCount++;
+                    it->second.lastRetry = std::chrono::system_clock::now();
+                    scheduleRetryLocked(channel, it->second);
+                    retransmits.push_back(buildFrame(it->second, sendBase(channel)));
+                    retransmissions_++;
+                    fastRetransmits_++;
+                    PeerStats* stats = node_->getPeerStats(peerID);
+                    if (stats) {
+                        stats->recordRetransmission();
+                    }
+                    congestion_.onLoss(peerID);
+                }
+            }
+        }
+        
+        fillSendWindow(peerID, channel, frames);
+    }
+    
+    notifyOutcomes(outcomes);
+    
+    for (const auto& frame : retransmits) {
+        transmit(peerID, frame);
+    }
+    for (const auto& frame : frames) {
+        if (transmit(peerID, frame)) {
+            sentMessages_++;
+        }
+    }
+}
+
+void ReliableMessaging::notifyOutcomes(std::vector<MessageOutcome>& outcomes) {
+    for (auto& outcome : outcomes) {
+        if (outcome.delivered && onMessageDelivered_) {
+            onMessageDelivered_(outcome.messageID, outcome.peerID);
+        } else if (!outcome.delivered && onMessageFailed_) {
+            onMessageFailed_(outcome.messageID, outcome.peerID);
+        }
+        if (outcome.completion) {
+            outcome.completion(outcome.messageID, outcome.delivered);
+        }
+    }
+}
+
+void ReliableMessaging::timerLoop() {
+    while (timersRunning_) {
+        flushDelayedAcks();
+        retryPendingMessages();
+        
+        std::unique_lock<std::mutex> lock(timerMutex_);
+        timerCondition_.wait_for(lock, std::chrono::milliseconds(RELIABLE_TIMER_INTERVAL_MS),
+                                 [this] { return !timersRunning_; });
+    }
+}
+
+} // namespace P2POverlay
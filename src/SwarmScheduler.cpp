@@ -0,0 +1,347 @@
+#include "SwarmScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace P2POverlay {
+
+SwarmScheduler::SwarmScheduler(uint32_t totalChunks, size_t chunkSize)
+    : totalChunks_(totalChunks), chunkSize_(std::max<size_t>(chunkSize, 1)),
+      receivedCount_(0), reassignments_(0),
+      received_(totalChunks, false), availability_(totalChunks, 0) {
+    std::set<uint32_t>& missing = unrequested_[0];
+    for (uint32_t chunk = 0; chunk < totalChunks; ++chunk) {
+        missing.insert(missing.end(), chunk);
+    }
+}
+
+void SwarmScheduler::addSource(NodeID sourceID, const std::vector<bool>& have) {
+    if (sources_.count(sourceID)) {
+        return;
+    }
+    
+    Source& source = sources_[sourceID];
+    if (!have.empty()) {
+        source.have.assign(totalChunks_, false);
+    }
+    for (uint32_t chunk = 0; chunk < totalChunks_; ++chunk) {
+        if (have.empty() || (chunk < have.size() && have[chunk])) {
+            if (!source.have.empty()) {
+                source.have[chunk] = true;
+            }
+            setAvailability(chunk, availability_[chunk] + 1);
+        }
+    }
+}
+
+void SwarmScheduler::removeSource(NodeID sourceID) {
+    auto sourceIt = sources_.find(sourceID);
+    if (sourceIt == sources_.end()) {
+        return;
+    }
+    
+    // Its requests go back to the pool
+    for (auto it = outstanding_.begin(); it != outstanding_.end();) {
+        uint32_t chunk = it->first;
+        auto next = std::next(it);
+        auto& requests = it->second;
+        auto request = std::find_if(requests.begin(), requests.end(),
+                                    [sourceID](const Outstanding& o) { return o.sourceID == sourceID; });
+        if (request != requests.end()) {
+            dropRequest(chunk, request);
+        }
+        it = next;
+    }
+    
+    for (uint32_t chunk = 0; chunk < totalChunks_; ++chunk) {
+        if (hasChunk(sourceIt->second, chunk)) {
+            setAvailability(chunk, availability_[chunk] - 1);
+        }
+    }
+    sources_.erase(sourceIt);
+}
+
+void SwarmScheduler::onHave(NodeID sourceID, uint32_t chunk) {
+    auto it = sources_.find(sourceID);
+    if (it == sources_.end() || chunk >= totalChunks_ || hasChunk(it->second, chunk)) {
+        return;
+    }
+    
+    it->second.have[chunk] = true;
+    setAvailability(chunk, availability_[chunk] + 1);
+}
+
+std::vector<SwarmRequest> SwarmScheduler::schedule(Clock::time_point now) {
+    std::vector<SwarmRequest> requests;
+    if (isComplete()) {
+        return requests;
+    }
+    
+    // Fastest sources pick first, so the rarest chunks go where they arrive soonest
+    std::vector<std::pair<NodeID, Source*>> order;
+    for (auto& pair : sources_) {
+        order.emplace_back(pair.first, &pair.second);
+    }
+    std::stable_sort(order.begin(), order.end(), [](const std::pair<NodeID, Source*>& a,
+                                                    const std::pair<NodeID, Source*>& b) {
+        return a.second->bytesPerSecond > b.second->bytesPerSecond;
+    });
+    
+    for (auto& entry : order) {
+        NodeID sourceID = entry.first;
+        Source& source = *entry.second;
+        size_t depth = getPipelineDepth(sourceID);
+        
+        // Rarest first among the chunks nobody has been asked for
+        for (auto bucket = unrequested_.begin(); bucket != unrequested_.end() && source.outstanding < depth;) {
+            auto next = std::next(bucket);
+            std::vector<uint32_t> picked;
+            for (uint32_t chunk : bucket->second) {
+                if (source.outstanding + picked.size() >= depth) {
+                    break;
+                }
+                if (hasChunk(source, chunk)) {
+                    picked.push_back(chunk);
+                }
+            }
+            for (uint32_t chunk : picked) {
+                request(sourceID, source, chunk, now, requests);
+            }
+            bucket = next;
+        }
+        
+        // Endgame: every missing chunk is already requested somewhere, so
+        // spare capacity duplicates the longest-waiting single requests
+        while (source.outstanding < depth && unrequested_.empty()) {
+            uint32_t best = totalChunks_;
+            Clock::time_point oldest = now;
+            for (const auto& pair : outstanding_) {
+                const Outstanding& only = pair.second.front();
+                if (pair.second.size() == 1 && only.sourceID != sourceID &&
+                    only.requested <= oldest && hasChunk(source, pair.first)) {
+                    best = pair.first;
+                    oldest = only.requested;
+                }
+            }
+            if (best == totalChunks_) {
+                break;
+            }
+            request(sourceID, source, best, now, requests);
+        }
+    }
+    
+    return requests;
+}
+
+bool SwarmScheduler::onChunkReceived(NodeID sourceID, uint32_t chunk, size_t bytes, Clock::time_point now) {
+    if (chunk >= totalChunks_) {
+        return false;
+    }
+    
+    auto sourceIt = sources_.find(sourceID);
+    auto pending = outstanding_.find(chunk);
+    Clock::time_point requested = now;
+    if (pending != outstanding_.end()) {
+        for (const auto& o : pending->second) {
+            if (o.sourceID == sourceID) {
+                requested = o.requested;
+            }
+        }
+    }
+    
+    // Delivery rate: bytes over the time this source spent on the chunk
+    if (sourceIt != sources_.end() && requested < now) {
+        Source& source = sourceIt->second;
+        Clock::time_point began = std::max(requested, source.lastDelivery);
+        double seconds = std::chrono::duration<double>(now - began).count();
+        if (seconds > 0) {
+            double sample = bytes / seconds;
+            source.bytesPerSecond = source.bytesPerSecond == 0 ? sample
+                                    : 0.75 * source.bytesPerSecond + 0.25 * sample;
+        }
+        source.lastDelivery = now;
+        source.delivered++;
+    }
+    
+    if (received_[chunk]) {
+        // Losing copy of an endgame duplicate
+        if (pending != outstanding_.end()) {
+            auto it = std::find_if(pending->second.begin(), pending->second.end(),
+                                   [sourceID](const Outstanding& o) { return o.sourceID == sourceID; });
+            if (it != pending->second.end()) {
+                dropRequest(chunk, it);
+            }
+        }
+        return false;
+    }
+    
+    received_[chunk] = true;
+    receivedCount_++;
+    if (pending == outstanding_.end()) {
+        // Unsolicited: it was still waiting in its rarity bucket
+        auto bucket = unrequested_.find(availability_[chunk]);
+        if (bucket != unrequested_.end()) {
+            bucket->second.erase(chunk);
+            if (bucket->second.empty()) {
+                unrequested_.erase(bucket);
+            }
+        }
+        return true;
+    }
+    
+    // Any other copy still on its way is no longer needed
+    for (const auto& o : pending->second) {
+        auto it = sources_.find(o.sourceID);
+        if (it != sources_.end() && it->second.outstanding > 0) {
+            it->second.outstanding--;
+        }
+    }
+    outstanding_.erase(pending);
+    return true;
+}
+
+void SwarmScheduler::onChunkRejected(NodeID sourceID, uint32_t chunk) {
+    auto sourceIt = sources_.find(sourceID);
+    if (sourceIt == sources_.end() || chunk >= totalChunks_) {
+        return;
+    }
+    Source& source = sourceIt->second;
+    source.rejected++;
+    source.bytesPerSecond /= 2;
+    
+    // The source no longer counts as a holder of this chunk
+    auto pending = outstanding_.find(chunk);
+    if (pending != outstanding_.end()) {
+        auto it = std::find_if(pending->second.begin(), pending->second.end(),
+                               [sourceID](const Outstanding& o) { return o.sourceID == sourceID; });
+        if (it != pending->second.end()) {
+            dropRequest(chunk, it);
+        }
+    }
+    if (hasChunk(source, chunk)) {
+        if (source.have.empty()) {
+            source.have.assign(totalChunks_, true);
+        }
+        source.have[chunk] = false;
+        setAvailability(chunk, availability_[chunk] - 1);
+    }
+}
+
+size_t SwarmScheduler::expire(Clock::time_point now) {
+    size_t expired = 0;
+    for (auto it = outstanding_.begin(); it != outstanding_.end();) {
+        uint32_t chunk = it->first;
+        auto next = std::next(it);
+        auto& requests = it->second;
+        for (size_t i = requests.size(); i-- > 0;) {
+            if (requests[i].deadline > now) {
+                continue;
+            }
+            
+            // A slow source gets a shorter pipeline from here on
+            auto sourceIt = sources_.find(requests[i].sourceID);
+            if (sourceIt != sources_.end()) {
+                sourceIt->second.bytesPerSecond /= 2;
+                sourceIt->second.timeouts++;
+            }
+            bool last = requests.size() == 1;
+            dropRequest(chunk, requests.begin() + i);
+            expired++;
+            reassignments_++;
+            if (last) {
+                break;
+            }
+        }
+        it = next;
+    }
+    return expired;
+}
+
+size_t SwarmScheduler::getOutstanding(NodeID sourceID) const {
+    auto it = sources_.find(sourceID);
+    return it != sources_.end() ? it->second.outstanding : 0;
+}
+
+size_t SwarmScheduler::getPipelineDepth(NodeID sourceID) const {
+    auto it = sources_.find(sourceID);
+    if (it == sources_.end()) {
+        return 0;
+    }
+    if (it->second.bytesPerSecond == 0) {
+        return SWARM_INITIAL_PIPELINE;
+    }
+    
+    // Enough requests to cover SWARM_PIPELINE_MS of this source's throughput
+    double chunks = it->second.bytesPerSecond * SWARM_PIPELINE_MS / 1000.0 / chunkSize_;
+    return std::min<size_t>(std::max<size_t>(static_cast<size_t>(std::ceil(chunks)), 1), SWARM_MAX_PIPELINE);
+}
+
+double SwarmScheduler::getSourceRate(NodeID sourceID) const {
+    auto it = sources_.find(sourceID);
+    return it != sources_.end() ? it->second.bytesPerSecond : 0;
+}
+
+bool SwarmScheduler::hasChunk(const Source& source, uint32_t chunk) const {
+    return source.have.empty() || source.have[chunk];
+}
+
+void SwarmScheduler::setAvailability(uint32_t chunk, uint32_t availability) {
+    // Only missing chunks nobody was asked for sit in a bucket
+    bool bucketed = !received_[chunk] && !outstanding_.count(chunk);
+    if (bucketed) {
+        auto bucket = unrequested_.find(availability_[chunk]);
+        bucket->second.erase(chunk);
+        if (bucket->second.empty()) {
+            unrequested_.erase(bucket);
+        }
+    }
+    
+    availability_[chunk] = availability;
+    if (bucketed) {
+        unrequested_[availability].insert(chunk);
+    }
+}
+
+void SwarmScheduler::request(NodeID sourceID, Source& source, uint32_t chunk, Clock::time_point now,
+                             std::vector<SwarmRequest>& requests) {
+    auto& pending = outstanding_[chunk];
+    if (pending.empty()) {
+        auto bucket = unrequested_.find(availability_[chunk]);
+        bucket->second.erase(chunk);
+        if (bucket->second.empty()) {
+            unrequested_.erase(bucket);
+        }
+    }
+    
+    // Deadline: a few times how long this source should need to reach the chunk
+    source.outstanding++;
+    Clock::duration expected = Clock::duration::zero();
+    if (source.bytesPerSecond > 0) {
+        expected = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+            3.0 * source.outstanding * chunkSize_ / source.bytesPerSecond));
+    }
+    
+    Outstanding o;
+    o.sourceID = sourceID;
+    o.requested = now;
+    o.deadline = now + std::max<Clock::duration>(expected, std::chrono::milliseconds(SWARM_REQUEST_TIMEOUT_MS));
+    pending.push_back(o);
+    requests.push_back(SwarmRequest{sourceID, chunk});
+}
+
+void SwarmScheduler::dropRequest(uint32_t chunk, std::vector<Outstanding>::iterator it) {
+    auto pending = outstanding_.find(chunk);
+    auto sourceIt = sources_.find(it->sourceID);
+    if (sourceIt != sources_.end() && sourceIt->second.outstanding > 0) {
+        sourceIt->second.outstanding--;
+    }
+    pending->second.erase(it);
+    
+    if (pending->second.empty()) {
+        outstanding_.erase(pending);
+        if (!received_[chunk]) {
+            unrequested_[availability_[chunk]].insert(chunk);
+        }
+    }
+}
+
+} // namespace P2POverlay
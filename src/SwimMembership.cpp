@@ -0,0 +1,705 @@
+#include "SwimMembership.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace P2POverlay {
+
+namespace {
+
+// Probe payload: sequence, probed node, node that originated the probe
+constexpr size_t PROBE_HEADER_SIZE = sizeof(uint64_t) + 2 * sizeof(NodeID);
+
+void appendBytes(std::vector<uint8_t>& buffer, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+bool readBytes(const uint8_t* data, size_t size, size_t& offset, void* out, size_t length) {
+    if (offset + length > size) {
+        return false;
+    }
+    std::memcpy(out, data + offset, length);
+    offset += length;
+    return true;
+}
+
+} // namespace
+
+SwimMembership::SwimMembership(
+    std::shared_ptr<Node> node,
+    std::shared_ptr<NetworkManager> networkManager,
+    std::shared_ptr<TopologyManager> topologyManager)
+    : node_(node), networkManager_(networkManager), topologyManager_(topologyManager),
+      probeIndex_(0), incarnation_(0), random_(std::random_device{}()), nextSequence_(1),
+      protocolPeriodMs_(SWIM_PROTOCOL_PERIOD_MS), pingTimeoutMs_(SWIM_PING_TIMEOUT_MS),
+      indirectProbeCount_(SWIM_INDIRECT_PROBES), suspicionMultiplier_(SWIM_SUSPICION_MULTIPLIER),
+      probesSent_(0), indirectProbesSent_(0), failedProbes_(0) {
+}
+
+SwimMembership::~SwimMembership() {
+}
+
+bool SwimMembership::addMember(NodeID nodeID, const NetworkAddress& address) {
+    if (nodeID == 0 || nodeID == node_->getID()) {
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(membersMutex_);
+        auto it = members_.find(nodeID);
+        if (it != members_.end() && it->second.status != MemberStatus::DEAD) {
+            return false;
+        }
+        
+        SwimMember member;
+        member.nodeID = nodeID;
+        member.address = address;
+        member.status = MemberStatus::ALIVE;
+        // A dead member comes back at the incarnation it died with; only the
+        // node itself may raise it, by refuting the suspicion
+        member.incarnation = it != members_.end() ? it->second.incarnation : 0;
+        member.stateChangeTime = std::chrono::steady_clock::now();
+        members_[nodeID] = member;
+        insertIntoProbeOrder(nodeID);
+        
+        // Announce ourselves so the new member learns our address
+        MembershipUpdate self;
+        self.nodeID = node_->getID();
+        self.address = node_->getAddress();
+        self.status = MemberStatus::ALIVE;
+        self.incarnation = incarnation_;
+        queueUpdate(self);
+        
+        MembershipUpdate update;
+        update.nodeID = nodeID;
+        update.address = address;
+        update.status = MemberStatus::ALIVE;
+        update.incarnation = member.incarnation;
+        queueUpdate(update);
+    }
+    
+    return true;
+}
+
+bool SwimMembership::removeMember(NodeID nodeID) {
+    std::lock_guard<std::mutex> lock(membersMutex_);
+    suspects_.erase(nodeID);
+    pendingUpdates_.erase(nodeID);
+    return members_.erase(nodeID) > 0;
+}
+
+std::vector<SwimMember> SwimMembership::getMembers() const {
+    std::lock_guard<std::mutex> lock(membersMutex_);
+    std::vector<SwimMember> members;
+    for (const auto& pair : members_) {
+        members.push_back(pair.second);
+    }
+    return members;
+}
+
+MemberStatus SwimMembership::getMemberStatus(NodeID nodeID) const {
+    std::lock_guard<std::mutex> lock(membersMutex_);
+    auto it = members_.find(nodeID);
+    if (it != members_.end()) {
+        return it->second.status;
+    }
+    return MemberStatus::DEAD;
+}
+
+size_t SwimMembership::getAliveMemberCount() const {
+    std::lock_guard<std::mutex> lock(membersMutex_);
+    size_t count = 0;
+    for (const auto& pair : members_) {
+        if (pair.second.status != MemberStatus::DEAD) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint32_t SwimMembership::getIncarnation() const {
+    std::lock_guard<std::mutex> lock(membersMutex_);
+    return incarnation_;
+}
+
+void SwimMembership::tick() {
+    std::vector<Message> outgoing;
+    std::vector<NodeID> joined;
+    std::vector<NodeID> suspected;
+    std::vector<NodeID> failed;
+    
+    {
+        std::lock_guard<std::mutex> lock(membersMutex_);
+        auto now = std::chrono::steady_clock::now();
+        NodeID selfID = node_->getID();
+        
+        if (probe_.active) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - probe_.periodStart);
+            
+            // Direct probe timed out or never left: ask k members to probe on our behalf
+            if (!probe_.acknowledged && !probe_.indirectSent &&
+                (probe_.unsent || elapsed.count() >= pingTimeoutMs_)) {
+                std::vector<NodeID> helpers = selectIndirectHelpers(probe_.target, indirectProbeCount_);
+                for (NodeID helper : helpers) {
+                    outgoing.push_back(createProbeMessage(
+                        MessageType::SWIM_PING_REQ, helper, probe_.sequence, probe_.target, selfID));
+                }
+                probe_.indirectSent = true;
+            }
+            
+            // End of the protocol period
+            if (elapsed.count() >= protocolPeriodMs_) {
+                if (!probe_.acknowledged) {
+                    failedProbes_++;
+                    markSuspect(probe_.target, suspected);
+                }
+                probe_.active = false;
+            }
+        }
+        
+        expireSuspects(now, failed);
+        
+        if (!probe_.active) {
+            NodeID target = selectProbeTarget();
+            if (target != 0) {
+                probe_.active = true;
+                probe_.target = target;
+                probe_.sequence = nextSequence_++;
+                probe_.indirectSent = false;
+                probe_.acknowledged = false;
+                probe_.unsent = false;
+                probe_.periodStart = now;
+                outgoing.push_back(createProbeMessage(
+                    MessageType::SWIM_PING, target, probe_.sequence, target, selfID));
+                probesSent_++;
+            }
+        }
+    }
+    
+    // Only ping-reqs that left count as indirect probes; a direct probe
+    // with no way to its target falls back to them on the next tick
+    uint64_t unsentSequence = 0;
+    for (const Message& msg : outgoing) {
+        bool sent = transmit(msg);
+        if (msg.type == MessageType::SWIM_PING_REQ && sent) {
+            indirectProbesSent_++;
+        } else if (msg.type == MessageType::SWIM_PING && !sent) {
+            std::memcpy(&unsentSequence, msg.payload.data(), sizeof(unsentSequence));
+        }
+    }
+    if (unsentSequence != 0) {
+        std::lock_guard<std::mutex> lock(membersMutex_);
+        if (probe_.active && probe_.sequence == unsentSequence) {
+            probe_.unsent = true;
+        }
+    }
+    
+    notifyChanges(joined, suspected, failed);
+}
+
+void SwimMembership::handleMessage(const Message& message) {
+    // Any probe traffic from an unknown node introduces it
+    if (message.senderID != 0 && message.senderID != node_->getID()) {
+        bool known = false;
+        {
+            std::lock_guard<std::mutex> lock(membersMutex_);
+            known = members_.find(message.senderID) != members_.end();
+        }
+        if (!known) {
+            NetworkAddress address = topologyManager_->getNodeAddress(message.senderID);
+            if (address.port != 0 && addMember(message.senderID, address)) {
+                notifyChanges({message.senderID}, {}, {});
+            }
+        }
+    }
+    
+    switch (message.type) {
+        case MessageType::SWIM_PING:
+            handlePing(message);
+            break;
+        case MessageType::SWIM_PING_REQ:
+            handlePingRequest(message);
+            break;
+        case MessageType::SWIM_ACK:
+            handleAck(message);
+            break;
+        default:
+            break;
+    }
+}
+
+void SwimMembership::handlePing(const Message& message) {
+    if (message.payload.size() < PROBE_HEADER_SIZE) {
+        return;
+    }
+    
+    size_t offset = 0;
+    uint64_t sequence = 0;
+    NodeID target = 0;
+    NodeID requester = 0;
+    readBytes(message.payload.data(), message.payload.size(), offset, &sequence, sizeof(sequence));
+    readBytes(message.payload.data(), message.payload.size(), offset, &target, sizeof(target));
+    readBytes(message.payload.data(), message.payload.size(), offset, &requester, sizeof(requester));
+    processPiggyback(message.payload.data() + offset, message.payload.size() - offset);
+    
+    Message ack;
+    {
+        std::lock_guard<std::mutex> lock(membersMutex_);
+        ack = createProbeMessage(MessageType::SWIM_ACK, message.senderID, sequence, node_->getID(), requester);
+    }
+    transmit(ack);
+}
+
+void SwimMembership::handlePingRequest(const Message& message) {
+    if (message.payload.size() < PROBE_HEADER_SIZE) {
+        return;
+    }
+    
+    size_t offset = 0;
+    uint64_t sequence = 0;
+    NodeID target = 0;
+    NodeID requester = 0;
+    readBytes(message.payload.data(), message.payload.size(), offset, &sequence, sizeof(sequence));
+    readBytes(message.payload.data(), message.payload.size(), offset, &target, sizeof(target));
+    readBytes(message.payload.data(), message.payload.size(), offset, &requester, sizeof(requester));
+    processPiggyback(message.payload.data() + offset, message.payload.size() - offset);
+    
+    if (target == 0 || target == node_->getID()) {
+        return;
+    }
+    
+    // Probe the target, keeping the requester's sequence so the ack can be
+    // relayed back without per-request state
+    Message ping;
+    {
+        std::lock_guard<std::mutex> lock(membersMutex_);
+        ping = createProbeMessage(MessageType::SWIM_PING, target, sequence, target, requester);
+    }
+    transmit(ping);
+}
+
+void SwimMembership::handleAck(const Message& message) {
+    if (message.payload.size() < PROBE_HEADER_SIZE) {
+        return;
+    }
+    
+    size_t offset = 0;
+    uint64_t sequence = 0;
+    NodeID target = 0;
+    NodeID requester = 0;
+    readBytes(message.payload.data(), message.payload.size(), offset, &sequence, sizeof(sequence));
+    readBytes(message.payload.data(), message.payload.size(), offset, &target, sizeof(target));
+    readBytes(message.payload.data(), message.payload.size(), offset, &requester, sizeof(requester));
+    processPiggyback(message.payload.data() + offset, message.payload.size() - offset);
+    
+    if (requester == node_->getID()) {
+        std::lock_guard<std::mutex> lock(membersMutex_);
+        if (probe_.active && probe_.sequence == sequence && probe_.target == target) {
+            probe_.acknowledged = true;
+        }
+        return;
+    }
+    
+    // We probed on someone else's behalf: relay the ack
+    if (requester != 0) {
+        Message relay;
+        {
+            std::lock_guard<std::mutex> lock(membersMutex_);
+            relay = createProbeMessage(MessageType::SWIM_ACK, requester, sequence, target, requester);
+        }
+        transmit(relay);
+    }
+}
+
+std::vector<uint8_t> SwimMembership::collectPiggyback(size_t maxUpdates) {
+    std::lock_guard<std::mutex> lock(membersMutex_);
+    std::vector<uint8_t> buffer;
+    if (!pendingUpdates_.empty()) {
+        appendPiggyback(buffer, maxUpdates);
+    }
+    return buffer;
+}
+
+void SwimMembership::applyPiggyback(NodeID /*senderID*/, const std::vector<uint8_t>& data) {
+    processPiggyback(data.data(), data.size());
+}
+
+void SwimMembership::setTransport(std::function<bool(NodeID, const Message&)> transport) {
+    transport_ = transport;
+}
+
+void SwimMembership::setOnMemberJoinedCallback(std::function<void(NodeID, const NetworkAddress&)> callback) {
+    onMemberJoined_ = callback;
+}
+
+void SwimMembership::setOnMemberSuspectedCallback(std::function<void(NodeID)> callback) {
+    onMemberSuspected_ = callback;
+}
+
+void SwimMembership::setOnMemberFailedCallback(std::function<void(NodeID)> callback) {
+    onMemberFailed_ = callback;
+}
+
+NodeID SwimMembership::selectProbeTarget() {
+    // Randomized round-robin: every member is probed once per pass
+    for (size_t attempts = 0; attempts <= probeOrder_.size(); ++attempts) {
+        if (probeIndex_ >= probeOrder_.size()) {
+            probeOrder_.erase(
+                std::remove_if(probeOrder_.begin(), probeOrder_.end(), [this](NodeID id) {
+                    auto it = members_.find(id);
+                    return it == members_.end() || it->second.status == MemberStatus::DEAD;
+                }),
+                probeOrder_.end()
+            );
+            std::shuffle(probeOrder_.begin(), probeOrder_.end(), random_);
+            probeIndex_ = 0;
+            if (probeOrder_.empty()) {
+                return 0;
+            }
+        }
+        
+        NodeID candidate = probeOrder_[probeIndex_++];
+        auto it = members_.find(candidate);
+        if (it != members_.end() && it->second.status != MemberStatus::DEAD) {
+            return candidate;
+        }
+    }
+    return 0;
+}
+
+std::vector<NodeID> SwimMembership::selectIndirectHelpers(NodeID target, size_t count) {
+    std::vector<NodeID> candidates;
+    for (const auto& pair : members_) {
+        if (pair.first != target && pair.second.status == MemberStatus::ALIVE) {
+            candidates.push_back(pair.first);
+        }
+    }
+    
+    // Partial Fisher-Yates: only the first `count` positions are needed
+    size_t selected = std::min(count, candidates.size());
+    for (size_t i = 0; i < selected; ++i) {
+        std::uniform_int_distribution<size_t> dis(i, candidates.size() - 1);
+        std::swap(candidates[i], candidates[dis(random_)]);
+    }
+    candidates.resize(selected);
+    return candidates;
+}
+
+void SwimMembership::markSuspect(NodeID nodeID, std::vector<NodeID>& suspected) {
+    auto it = members_.find(nodeID);
+    if (it == members_.end() || it->second.status != MemberStatus::ALIVE) {
+        return;
+    }
+    
+    it->second.status = MemberStatus::SUSPECT;
+    it->second.stateChangeTime = std::chrono::steady_clock::now();
+    suspects_.insert(nodeID);
+    suspected.push_back(nodeID);
+    
+    MembershipUpdate update;
+    update.nodeID = nodeID;
+    update.address = it->second.address;
+    update.status = MemberStatus::SUSPECT;
+    update.incarnation = it->second.incarnation;
+    queueUpdate(update);
+}
+
+void SwimMembership::expireSuspects(std::chrono::steady_clock::time_point now, std::vector<NodeID>& failed) {
+    auto timeout = suspicionTimeout();
+    
+    auto suspectIt = suspects_.begin();
+    while (suspectIt != suspects_.end()) {
+        auto it = members_.find(*suspectIt);
+        if (it == members_.end() || it->second.status != MemberStatus::SUSPECT) {
+            suspectIt = suspects_.erase(suspectIt);
+            continue;
+        }
+        
+        if (now - it->second.stateChangeTime >= timeout) {
+            it->second.status = MemberStatus::DEAD;
+            it->second.stateChangeTime = now;
+            failed.push_back(it->first);
+            
+            MembershipUpdate update;
+            update.nodeID = it->first;
+            update.address = it->second.address;
+            update.status = MemberStatus::DEAD;
+            update.incarnation = it->second.incarnation;
+            queueUpdate(update);
+            
+            suspectIt = suspects_.erase(suspectIt);
+        } else {
+            ++suspectIt;
+        }
+    }
+}
+
+bool SwimMembership::applyUpdate(const MembershipUpdate& update, std::vector<NodeID>& joined,
+                                 std::vector<NodeID>& suspected, std::vector<NodeID>& failed) {
+    // Refute suspicion about ourselves with a higher incarnation
+    if (update.nodeID == node_->getID()) {
+        if (update.status != MemberStatus::ALIVE && update.incarnation >= incarnation_) {
+            incarnation_ = update.incarnation + 1;
+            
+            MembershipUpdate refutation;
+            refutation.nodeID = node_->getID();
+            refutation.address = node_->getAddress();
+            refutation.status = MemberStatus::ALIVE;
+            refutation.incarnation = incarnation_;
+            queueUpdate(refutation);
+        }
+        return false;
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    auto it = members_.find(update.nodeID);
+    
+    if (it == members_.end()) {
+        if (update.status == MemberStatus::DEAD || update.address.port == 0) {
+            return false;
+        }
+        
+        SwimMember member;
+        member.nodeID = update.nodeID;
+        member.address = update.address;
+        member.status = update.status;
+        member.incarnation = update.incarnation;
+        member.stateChangeTime = now;
+        members_[update.nodeID] = member;
+        insertIntoProbeOrder(update.nodeID);
+        joined.push_back(update.nodeID);
+        if (update.status == MemberStatus::SUSPECT) {
+            suspects_.insert(update.nodeID);
+            suspected.push_back(update.nodeID);
+        }
+        queueUpdate(update);
+        return true;
+    }
+    
+    SwimMember& member = it->second;
+    bool changed = false;
+    
+    switch (update.status) {
+        case MemberStatus::ALIVE:
+            if (update.incarnation > member.incarnation) {
+                if (member.status == MemberStatus::DEAD) {
+                    joined.push_back(update.nodeID);
+                    insertIntoProbeOrder(update.nodeID);
+                }
+                if (member.status != MemberStatus::ALIVE) {
+                    member.stateChangeTime = now;
+                }
+                member.status = MemberStatus::ALIVE;
+                member.incarnation = update.incarnation;
+                suspects_.erase(update.nodeID);
+                changed = true;
+            }
+            break;
+        case MemberStatus::SUSPECT:
+            if ((member.status == MemberStatus::ALIVE && update.incarnation >= member.incarnation) ||
+                (member.status == MemberStatus::SUSPECT && update.incarnation > member.incarnation)) {
+                if (member.status == MemberStatus::ALIVE) {
+                    member.stateChangeTime = now;
+                    suspected.push_back(update.nodeID);
+                }
+                member.status = MemberStatus::SUSPECT;
+                member.incarnation = update.incarnation;
+                suspects_.insert(update.nodeID);
+                changed = true;
+            }
+            break;
+        case MemberStatus::DEAD:
+            if (member.status != MemberStatus::DEAD) {
+                member.status = MemberStatus::DEAD;
+                member.stateChangeTime = now;
+                suspects_.erase(update.nodeID);
+                failed.push_back(update.nodeID);
+                changed = true;
+            }
+            break;
+    }
+    
+    if (changed) {
+        MembershipUpdate forwarded = update;
+        forwarded.address = member.address;
+        queueUpdate(forwarded);
+    }
+    return changed;
+}
+
+void SwimMembership::queueUpdate(const MembershipUpdate& update) {
+    PendingUpdate pending;
+    pending.update = update;
+    pending.transmissions = 0;
+    pendingUpdates_[update.nodeID] = pending;
+}
+
+void SwimMembership::insertIntoProbeOrder(NodeID nodeID) {
+    if (std::find(probeOrder_.begin(), probeOrder_.end(), nodeID) != probeOrder_.end()) {
+        return;
+    }
+    
+    // Insert at a random position so new members are not probed in bursts
+    std::uniform_int_distribution<size_t> dis(0, probeOrder_.size());
+    size_t position = dis(random_);
+    probeOrder_.insert(probeOrder_.begin() + position, nodeID);
+    if (position < probeIndex_) {
+        probeIndex_++;
+    }
+}
+
+int SwimMembership::maxTransmissions() const {
+    double clusterSize = static_cast<double>(members_.size() + 1);
+    return SWIM_DISSEMINATION_FACTOR * static_cast<int>(std::ceil(std::log2(clusterSize + 1.0)));
+}
+
+std::chrono::milliseconds SwimMembership::suspicionTimeout() const {
+    double clusterSize = static_cast<double>(members_.size() + 1);
+    double scale = std::max(1.0, std::log10(clusterSize));
+    return std::chrono::milliseconds(
+        static_cast<int64_t>(suspicionMultiplier_ * scale * protocolPeriodMs_)
+    );
+}
+
+void SwimMembership::appendPiggyback(std::vector<uint8_t>& buffer, size_t maxUpdates) {
+    // Prefer the least-disseminated updates
+    std::vector<PendingUpdate*> candidates;
+    for (auto& pair : pendingUpdates_) {
+        candidates.push_back(&pair.second);
+    }
+    size_t selected = std::min(maxUpdates, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + selected, candidates.end(),
+        [](const PendingUpdate* a, const PendingUpdate* b) {
+            return a->transmissions < b->transmissions;
+        });
+    
+    uint8_t count = static_cast<uint8_t>(std::min<size_t>(selected, 255));
+    buffer.push_back(count);
+    
+    int limit = maxTransmissions();
+    std::vector<NodeID> exhausted;
+    for (size_t i = 0; i < count; ++i) {
+        const MembershipUpdate& update = candidates[i]->update;
+        uint8_t status = static_cast<uint8_t>(update.status);
+        uint8_t hostLength = static_cast<uint8_t>(std::min<size_t>(update.address.host.size(), 255));
+        
+        appendBytes(buffer, &update.nodeID, sizeof(NodeID));
+        appendBytes(buffer, &update.incarnation, sizeof(uint32_t));
+        appendBytes(buffer, &status, sizeof(uint8_t));
+        appendBytes(buffer, &update.address.port, sizeof(Port));
+        appendBytes(buffer, &hostLength, sizeof(uint8_t));
+        appendBytes(buffer, update.address.host.data(), hostLength);
+        
+        if (++candidates[i]->transmissions >= limit) {
+            exhausted.push_back(update.nodeID);
+        }
+    }
+    
+    for (NodeID nodeID : exhausted) {
+        pendingUpdates_.erase(nodeID);
+    }
+}
+
+Message SwimMembership::createProbeMessage(MessageType type, NodeID receiverID, uint64_t sequence,
+                                           NodeID target, NodeID requester) {
+    Message msg;
+    msg.type = type;
+    msg.senderID = node_->getID();
+    msg.receiverID = receiverID;
+    msg.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    
+    msg.payload.reserve(PROBE_HEADER_SIZE + 1);
+    appendBytes(msg.payload, &sequence, sizeof(sequence));
+    appendBytes(msg.payload, &target, sizeof(target));
+    appendBytes(msg.payload, &requester, sizeof(requester));
+    appendPiggyback(msg.payload, SWIM_MAX_PIGGYBACK_UPDATES);
+    return msg;
+}
+
+bool SwimMembership::transmit(const Message& message) {
+    if (transport_) {
+        return transport_(message.receiverID, message);
+    }
+    return networkManager_->sendMessageToPeer(message.receiverID, message);
+}
+
+void SwimMembership::processPiggyback(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    
+    std::vector<NodeID> joined;
+    std::vector<NodeID> suspected;
+    std::vector<NodeID> failed;
+    
+    {
+        std::lock_guard<std::mutex> lock(membersMutex_);
+        size_t offset = 0;
+        uint8_t count = 0;
+        if (!readBytes(data, size, offset, &count, sizeof(count))) {
+            return;
+        }
+        
+        for (uint8_t i = 0; i < count; ++i) {
+            MembershipUpdate update;
+            uint8_t status = 0;
+            uint8_t hostLength = 0;
+            if (!readBytes(data, size, offset, &update.nodeID, sizeof(NodeID)) ||
+                !readBytes(data, size, offset, &update.incarnation, sizeof(uint32_t)) ||
+                !readBytes(data, size, offset, &status, sizeof(uint8_t)) ||
+                !readBytes(data, size, offset, &update.address.port, sizeof(Port)) ||
+                !readBytes(data, size, offset, &hostLength, sizeof(uint8_t)) ||
+                offset + hostLength > size) {
+                break; // Truncated update
+            }
+            if (status > static_cast<uint8_t>(MemberStatus::DEAD)) {
+                break;
+            }
+            update.status = static_cast<MemberStatus>(status);
+            update.address.host.assign(reinterpret_cast<const char*>(data + offset), hostLength);
+            offset += hostLength;
+            
+            applyUpdate(update, joined, suspected, failed);
+        }
+    }
+    
+    notifyChanges(joined, suspected, failed);
+}
+
+void SwimMembership::notifyChanges(const std::vector<NodeID>& joined, const std::vector<NodeID>& suspected,
+                                   const std::vector<NodeID>& failed) {
+    if (onMemberJoined_) {
+        for (NodeID nodeID : joined) {
+            NetworkAddress address;
+            {
+                std::lock_guard<std::mutex> lock(membersMutex_);
+                auto it = members_.find(nodeID);
+                if (it != members_.end()) {
+                    address = it->second.address;
+                }
+            }
+            onMemberJoined_(nodeID, address);
+        }
+    }
+    
+    if (onMemberSuspected_) {
+        for (NodeID nodeID : suspected) {
+            onMemberSuspected_(nodeID);
+        }
+    }
+    
+    if (!failed.empty()) {
+        for (NodeID nodeID : failed) {
+            std::cout << "SWIM: member " << nodeID << " confirmed failed" << std::endl;
+            if (onMemberFailed_) {
+                onMemberFailed_(nodeID);
+            }
+        }
+    }
+}
+
+} // namespace P2POverlay
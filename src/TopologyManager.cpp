@@ -15,7 +15,10 @@ TopologyManager::~TopologyManager() {
 
 bool TopologyManager::addNode(NodeID nodeID, const NetworkAddress& address) {
     std::lock_guard<std::mutex> lock(topologyMutex_);
-    
+    return addNodeLocked(nodeID, address);
+}
+
+bool TopologyManager::addNodeLocked(NodeID nodeID, const NetworkAddress& address) {
     if (nodeRegistry_.find(nodeID) != nodeRegistry_.end()) {
         return false; // Node already exists
     }
@@ -49,6 +52,28 @@ bool TopologyManager::updateNodeAddress(NodeID nodeID, const NetworkAddress& new
     return true;
 }
 
+size_t TopologyManager::applyBatch(const std::vector<std::pair<NodeID, NetworkAddress>>& addedNodes,
+                                   const std::vector<NodeID>& removedNodes) {
+    std::lock_guard<std::mutex> lock(topologyMutex_);
+    size_t applied = 0;
+    
+    // Removals first so a node that left and rejoined ends up present
+    for (NodeID nodeID : removedNodes) {
+        if (nodeRegistry_.find(nodeID) != nodeRegistry_.end()) {
+            removeNodeFromGraph(nodeID);
+            applied++;
+        }
+    }
+    
+    for (const auto& pair : addedNodes) {
+        if (addNodeLocked(pair.first, pair.second)) {
+            applied++;
+        }
+    }
+    
+    return applied;
+}
+
 std::vector<NodeID> TopologyManager::discoverPeers(NodeID requestingNodeID, int maxPeers) {
     std::lock_guard<std::mutex> lock(topologyMutex_);
     
@@ -165,18 +190,27 @@ void TopologyManager::updateTopology() {
 
 void TopologyManager::validateTopology() {
     std::lock_guard<std::mutex> lock(topologyMutex_);
+    validateTopologyLocked();
+}
+
+bool TopologyManager::isTopologyConnected() const {
+    std::lock_guard<std::mutex> lock(topologyMutex_);
+    return isTopologyConnectedLocked();
+}
+
+void TopologyManager::validateTopologyLocked() {
     // Validate that all nodes in adjacency list exist in registry
-    for (const auto& pair : adjacencyList_) {
-        if (nodeRegistry_.find(pair.first) == nodeRegistry_.end()) {
+    for (auto it = adjacencyList_.begin(); it != adjacencyList_.end();) {
+        if (nodeRegistry_.find(it->first) == nodeRegistry_.end()) {
             // Remove orphaned adjacency entries
-            adjacencyList_.erase(pair.first);
+            it = adjacencyList_.erase(it);
+        } else {
+            ++it;
         }
     }
 }
 
-bool TopologyManager::isTopologyConnected() const {
-    std::lock_guard<std::mutex> lock(topologyMutex_);
-    
+bool TopologyManager::isTopologyConnectedLocked() const {
     if (nodeRegistry_.empty()) {
         return true; // Empty graph is considered connected
     }
@@ -202,12 +236,15 @@ void TopologyManager::repairTopology() {
     std::lock_guard<std::mutex> lock(topologyMutex_);
     
     // Remove nodes that are no longer in registry from adjacency list
-    validateTopology();
+    validateTopologyLocked();
     
     // If topology is disconnected, try to reconnect
-    if (!isTopologyConnected()) {
+    if (!isTopologyConnectedLocked()) {
         // Simple repair: connect all nodes in a ring
-        std::vector<NodeID> nodeIDs = getAllNodeIDs();
+        std::vector<NodeID> nodeIDs;
+        for (const auto& pair : nodeRegistry_) {
+            nodeIDs.push_back(pair.first);
+        }
         if (nodeIDs.size() > 1) {
             for (size_t i = 0; i < nodeIDs.size(); ++i) {
                 NodeID current = nodeIDs[i];
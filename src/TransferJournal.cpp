@@ -0,0 +1,287 @@
+#include "TransferJournal.h"
+#include "Checksum.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <set>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace P2POverlay {
+
+namespace {
+
+constexpr uint32_t BITMAP_MAGIC = 0x4A523250;   // "P2RJ"
+
+const char* const FILE_PREFIX = "transfer-";
+const char* const DATA_SUFFIX = ".part";
+const char* const BITMAP_SUFFIX = ".map";
+const char* const TEMP_SUFFIX = ".tmp";
+
+void appendBytes(std::vector<uint8_t>& buffer, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+bool readBytes(const uint8_t* data, size_t size, size_t& offset, void* out, size_t length) {
+    if (offset + length > size) {
+        return false;
+    }
+    std::memcpy(out, data + offset, length);
+    offset += length;
+    return true;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t result = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += result;
+        size -= static_cast<size_t>(result);
+        offset += static_cast<uint64_t>(result);
+    }
+    return true;
+}
+
+} // namespace
+
+TransferJournal::TransferJournal(const std::string& directory)
+    : directory_(directory), checkpoints_(0) {
+}
+
+TransferJournal::~TransferJournal() {
+    close();
+}
+
+bool TransferJournal::open(std::vector<JournalEntry>& recovered) {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        std::cerr << "Cannot create transfer journal directory " << directory_ << ": " << error.message() << std::endl;
+        return false;
+    }
+    
+    recovered.clear();
+    std::string prefix = FILE_PREFIX;
+    std::string suffix = BITMAP_SUFFIX;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, error)) {
+        std::string name = item.path().filename().string();
+        
+        // A checkpoint interrupted before its rename
+        if (name.size() > std::strlen(TEMP_SUFFIX) &&
+            name.compare(name.size() - std::strlen(TEMP_SUFFIX), std::string::npos, TEMP_SUFFIX) == 0) {
+            std::filesystem::remove(item.path(), error);
+            continue;
+        }
+        if (name.size() <= prefix.size() + suffix.size() ||
+            name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        
+        JournalEntry entry;
+        if (loadBitmap(item.path().string(), entry) && std::filesystem::exists(dataPath(entry.transferID))) {
+            recovered.push_back(std::move(entry));
+        } else {
+            std::cerr << "Discarding unreadable transfer journal " << name << std::endl;
+            std::filesystem::remove(item.path(), error);
+        }
+    }
+    
+    // Partial files of transfers that never reached a checkpoint
+    std::set<std::string> keep;
+    for (const JournalEntry& entry : recovered) {
+        keep.insert(dataPath(entry.transferID));
+    }
+    std::vector<std::filesystem::path> orphans;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, error)) {
+        std::string name = item.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > std::strlen(DATA_SUFFIX) &&
+            name.compare(name.size() - std::strlen(DATA_SUFFIX), std::string::npos, DATA_SUFFIX) == 0 &&
+            !keep.count(directory_ + "/" + name)) {
+            orphans.push_back(item.path());
+        }
+    }
+    for (const auto& path : orphans) {
+        std::filesystem::remove(path, error);
+    }
+    return true;
+}
+
+void TransferJournal::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& pair : open_) {
+        ::close(pair.second.fd);
+    }
+    open_.clear();
+}
+
+bool TransferJournal::begin(uint64_t transferID) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_.count(transferID)) {
+        return true;
+    }
+    
+    // Recovered data stays: the file is not truncated
+    std::string path = dataPath(transferID);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Cannot open transfer journal " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    open_[transferID] = OpenTransfer{fd, 0};
+    return true;
+}
+
+bool TransferJournal::writeChunk(uint64_t transferID, uint64_t offset, const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = open_.find(transferID);
+    return it != open_.end() && writeAll(it->second.fd, data, size, offset);
+}
+
+bool TransferJournal::checkpoint(const JournalEntry& entry, uint32_t receivedCount) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = open_.find(entry.transferID);
+    if (it == open_.end()) {
+        return false;
+    }
+    
+    // Checkpoints taken on different threads may arrive out of order
+    if (receivedCount < it->second.checkpointed) {
+        return true;
+    }
+    
+    // Chunks first, so the bitmap never gets ahead of them
+    if (::fdatasync(it->second.fd) != 0) {
+        std::cerr << "Transfer journal sync failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    std::vector<uint8_t> body;
+    uint32_t chunkCount = static_cast<uint32_t>(entry.received.size());
+    uint8_t rootKnown = entry.rootKnown ? 1 : 0;
+    appendBytes(body, &BITMAP_MAGIC, sizeof(BITMAP_MAGIC));
+    appendBytes(body, &entry.transferID, sizeof(entry.transferID));
+    appendBytes(body, &entry.sourceID, sizeof(entry.sourceID));
+    appendBytes(body, &entry.totalSize, sizeof(entry.totalSize));
+    appendBytes(body, &chunkCount, sizeof(chunkCount));
+    appendBytes(body, &rootKnown, sizeof(rootKnown));
+    appendBytes(body, entry.root.data(), entry.root.size());
+    size_t bitmapStart = body.size();
+    body.resize(bitmapStart + (chunkCount + 7) / 8, 0);
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        if (entry.received[i]) {
+            body[bitmapStart + i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+        }
+    }
+    uint32_t crc = crc32c(body.data(), body.size());
+    appendBytes(body, &crc, sizeof(crc));
+    
+    std::string path = bitmapPath(entry.transferID);
+    std::string tempPath = path + TEMP_SUFFIX;
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool written = fd >= 0 && writeAll(fd, body.data(), body.size(), 0) && ::fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!written || ::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Cannot write transfer journal " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // The rename itself survives a crash once the directory is synced
+    int dirFd = ::open(directory_.c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+    
+    it->second.checkpointed = receivedCount;
+    checkpoints_++;
+    return true;
+}
+
+bool TransferJournal::readData(uint64_t transferID, std::vector<uint8_t>& data) const {
+    std::ifstream file(dataPath(transferID), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+void TransferJournal::remove(uint64_t transferID) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = open_.find(transferID);
+    if (it != open_.end()) {
+        ::close(it->second.fd);
+        open_.erase(it);
+    }
+    
+    std::error_code error;
+    std::filesystem::remove(bitmapPath(transferID), error);
+    std::filesystem::remove(dataPath(transferID), error);
+}
+
+size_t TransferJournal::getOpenTransferCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_.size();
+}
+
+std::string TransferJournal::dataPath(uint64_t transferID) const {
+    return directory_ + "/" + FILE_PREFIX + std::to_string(transferID) + DATA_SUFFIX;
+}
+
+std::string TransferJournal::bitmapPath(uint64_t transferID) const {
+    return directory_ + "/" + FILE_PREFIX + std::to_string(transferID) + BITMAP_SUFFIX;
+}
+
+bool TransferJournal::loadBitmap(const std::string& path, JournalEntry& entry) const {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    
+    uint32_t crc = 0;
+    if (data.size() < sizeof(crc)) {
+        return false;
+    }
+    size_t bodySize = data.size() - sizeof(crc);
+    std::memcpy(&crc, data.data() + bodySize, sizeof(crc));
+    if (crc32c(data.data(), bodySize) != crc) {
+        return false;
+    }
+    
+    size_t offset = 0;
+    uint32_t magic = 0;
+    uint32_t chunkCount = 0;
+    uint8_t rootKnown = 0;
+    if (!readBytes(data.data(), bodySize, offset, &magic, sizeof(magic)) || magic != BITMAP_MAGIC ||
+        !readBytes(data.data(), bodySize, offset, &entry.transferID, sizeof(entry.transferID)) ||
+        !readBytes(data.data(), bodySize, offset, &entry.sourceID, sizeof(entry.sourceID)) ||
+        !readBytes(data.data(), bodySize, offset, &entry.totalSize, sizeof(entry.totalSize)) ||
+        !readBytes(data.data(), bodySize, offset, &chunkCount, sizeof(chunkCount)) ||
+        !readBytes(data.data(), bodySize, offset, &rootKnown, sizeof(rootKnown)) ||
+        !readBytes(data.data(), bodySize, offset, entry.root.data(), entry.root.size()) ||
+        bodySize - offset != (static_cast<size_t>(chunkCount) + 7) / 8 || chunkCount == 0) {
+        return false;
+    }
+    
+    entry.rootKnown = rootKnown != 0;
+    entry.received.resize(chunkCount);
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        entry.received[i] = (data[offset + i / 8] >> (i % 8)) & 1;
+    }
+    return true;
+}
+
+} // namespace P2POverlay
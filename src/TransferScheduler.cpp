@@ -0,0 +1,211 @@
+#include "TransferScheduler.h"
+
+namespace P2POverlay {
+
+TransferScheduler::TransferScheduler(size_t maxActive)
+    : maxActive_(std::max<size_t>(maxActive, 1)), arrivals_(0), cursor_(0) {
+}
+
+size_t TransferScheduler::weight(TransferPriority priority) {
+    switch (priority) {
+        case TransferPriority::BACKGROUND:
+            return 1;
+        case TransferPriority::INTERACTIVE:
+            return 16;
+        case TransferPriority::NORMAL:
+        default:
+            return 4;
+    }
+}
+
+void TransferScheduler::enqueue(uint64_t transferID, NodeID destinationID, TransferPriority priority,
+                                size_t totalSize) {
+    if (queued_.count(transferID)) {
+        return;
+    }
+    queued_[transferID] = Entry{destinationID, priority};
+    waiting_[priority][destinationID].push_back(Waiting{transferID, totalSize, arrivals_++, 0});
+}
+
+std::vector<uint64_t> TransferScheduler::admit() {
+    std::vector<uint64_t> admitted;
+    while (active_.size() < maxActive_ && admitOne()) {
+        admitted.push_back(active_.back().transferID);
+    }
+    return admitted;
+}
+
+bool TransferScheduler::admitOne() {
+    // Highest class first
+    auto classIt = waiting_.rbegin();
+    if (classIt == waiting_.rend()) {
+        return false;
+    }
+    TransferPriority priority = classIt->first;
+    std::map<NodeID, std::vector<Waiting>>& destinations = classIt->second;
+    
+    // Destinations take turns within the class
+    auto lastIt = lastDestination_.find(priority);
+    auto destinationIt = lastIt == lastDestination_.end() ? destinations.begin()
+                                                          : destinations.upper_bound(lastIt->second);
+    if (destinationIt == destinations.end()) {
+        destinationIt = destinations.begin();
+    }
+    std::vector<Waiting>& queue = destinationIt->second;
+    
+    // Smallest first, unless a transfer has been passed over often enough;
+    // among equals, the oldest
+    auto chosen = queue.begin();
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        bool starved = it->bypassed >= DATA_SCHEDULER_MAX_BYPASS;
+        bool chosenStarved = chosen->bypassed >= DATA_SCHEDULER_MAX_BYPASS;
+        if (starved != chosenStarved ? starved
+                                     : starved ? it->arrival < chosen->arrival
+                                               : (it->totalSize < chosen->totalSize ||
+                                                  (it->totalSize == chosen->totalSize && it->arrival < chosen->arrival))) {
+            chosen = it;
+        }
+    }
+    for (Waiting& other : queue) {
+        if (other.arrival < chosen->arrival) {
+            other.bypassed++;
+        }
+    }
+    
+    active_.push_back(Running{chosen->transferID, priority, 0});
+    lastDestination_[priority] = destinationIt->first;
+    queue.erase(chosen);
+    if (queue.empty()) {
+        destinations.erase(destinationIt);
+        if (destinations.empty()) {
+            waiting_.erase(priority);
+            lastDestination_.erase(priority);
+        }
+    }
+    return true;
+}
+
+bool TransferScheduler::setPriority(uint64_t transferID, TransferPriority priority) {
+    auto it = queued_.find(transferID);
+    if (it == queued_.end()) {
+        return false;
+    }
+    if (it->second.priority == priority) {
+        return true;
+    }
+    
+    for (Running& running : active_) {
+        if (running.transferID == transferID) {
+            running.priority = priority;
+            it->second.priority = priority;
+            return true;
+        }
+    }
+    
+    // A waiting transfer moves to the other class's queue, keeping its place in time
+    std::vector<Waiting>& queue = waiting_[it->second.priority][it->second.destinationID];
+    auto waitingIt = std::find_if(queue.begin(), queue.end(),
+                                  [transferID](const Waiting& waiting) { return waiting.transferID == transferID; });
+    if (waitingIt == queue.end()) {
+        return false;
+    }
+    Waiting moved = *waitingIt;
+    removeWaiting(transferID, it->second);
+    it->second.priority = priority;
+    std::vector<Waiting>& target = waiting_[priority][it->second.destinationID];
+    target.insert(std::upper_bound(target.begin(), target.end(), moved,
+                                   [](const Waiting& a, const Waiting& b) { return a.arrival < b.arrival; }),
+                  moved);
+    return true;
+}
+
+void TransferScheduler::remove(uint64_t transferID) {
+    auto it = queued_.find(transferID);
+    if (it == queued_.end()) {
+        return;
+    }
+    
+    for (size_t i = 0; i < active_.size(); ++i) {
+        if (active_[i].transferID == transferID) {
+            active_.erase(active_.begin() + static_cast<std::ptrdiff_t>(i));
+            // The turn stays with the transfer that followed
+            if (cursor_ > i) {
+                cursor_--;
+            }
+            if (cursor_ >= active_.size()) {
+                cursor_ = 0;
+            }
+            queued_.erase(it);
+            return;
+        }
+    }
+    removeWaiting(transferID, it->second);
+    queued_.erase(it);
+}
+
+void TransferScheduler::removeWaiting(uint64_t transferID, const Entry& entry) {
+    auto classIt = waiting_.find(entry.priority);
+    if (classIt == waiting_.end()) {
+        return;
+    }
+    auto destinationIt = classIt->second.find(entry.destinationID);
+    if (destinationIt == classIt->second.end()) {
+        return;
+    }
+    std::vector<Waiting>& queue = destinationIt->second;
+    queue.erase(std::remove_if(queue.begin(), queue.end(),
+                               [transferID](const Waiting& waiting) { return waiting.transferID == transferID; }),
+                queue.end());
+    if (queue.empty()) {
+        classIt->second.erase(destinationIt);
+        if (classIt->second.empty()) {
+            waiting_.erase(classIt);
+            lastDestination_.erase(entry.priority);
+        }
+    }
+}
+
+uint64_t TransferScheduler::next(const std::function<size_t(uint64_t)>& readyBytes) {
+    // Ends once a whole round finds nobody able to send; every visit to a
+    // transfer that can send adds credit, so one of them gets there. A
+    // transfer blocked by its window keeps its credit: it is only waiting
+    // for acknowledgments, not out of data
+    size_t idle = 0;
+    while (!active_.empty() && idle < active_.size()) {
+        if (cursor_ >= active_.size()) {
+            cursor_ = 0;
+        }
+        Running& running = active_[cursor_];
+        size_t bytes = readyBytes(running.transferID);
+        if (bytes == 0) {
+            cursor_++;
+            idle++;
+            continue;
+        }
+        idle = 0;
+        
+        // The turn stays here while the credit lasts
+        if (running.deficit >= bytes) {
+            running.deficit -= bytes;
+            return running.transferID;
+        }
+        running.deficit += weight(running.priority) * DATA_SCHEDULER_QUANTUM;
+        cursor_++;
+    }
+    return 0;
+}
+
+bool TransferScheduler::isActive(uint64_t transferID) const {
+    return std::any_of(active_.begin(), active_.end(),
+                       [transferID](const Running& running) { return running.transferID == transferID; });
+}
+
+std::vector<uint64_t> TransferScheduler::getActive() const {
+    std::vector<uint64_t> transfers;
+    for (const Running& running : active_) {
+        transfers.push_back(running.transferID);
+    }
+    return transfers;
+}
+
+} // namespace P2POverlay
@@ -8,6 +8,7 @@
 #include "MessageRouter.h"
 #include "DataExchange.h"
 #include "ReliableMessaging.h"
+#include "SwimMembership.h"
 #include "Common.h"
 #include <iostream>
 #include <memory>
@@ -16,12 +17,15 @@
 #include <random>
 #include <string>
 #include <limits>
+#include <map>
+#include <cstring>
 #include <Poco/Net/DNS.h>
 
 using namespace P2POverlay;
 
 void printUsage(const char* programName) {
-    std::cout << "Usage: " << programName << " <port> [bootstrap_host] [bootstrap_port]" << std::endl;
+    std::cout << "Usage: " << programName << " [--swim] <port> [bootstrap_host] [bootstrap_port]" << std::endl;
+    std::cout << "  --swim: Monitor peers with SWIM probes instead of heartbeats" << std::endl;
     std::cout << "  port: Local port to listen on" << std::endl;
     std::cout << "  bootstrap_host: Optional bootstrap node hostname" << std::endl;
     std::cout << "  bootstrap_port: Optional bootstrap node port" << std::endl;
@@ -121,6 +125,7 @@ void printReliableMessagingMenu() {
     std::cout << "  2. Check Message Status" << std::endl;
     std::cout << "  3. Retry Pending Messages" << std::endl;
     std::cout << "  4. Show Statistics" << std::endl;
+    std::cout << "  5. Enable Durable Outbox" << std::endl;
     std::cout << "  0. Back to Main Menu" << std::endl;
     std::cout << "\nEnter option number: ";
 }
@@ -133,6 +138,13 @@ void printDataExchangeMenu() {
     std::cout << "  4. Show Active Transfers" << std::endl;
     std::cout << "  5. Get Received Data" << std::endl;
     std::cout << "  6. Show Statistics" << std::endl;
+    std::cout << "  7. Publish Content" << std::endl;
+    std::cout << "  8. Download From Several Sources" << std::endl;
+    std::cout << "  9. Send Data (Deduplicated)" << std::endl;
+    std::cout << "  10. Enable Transfer Journal" << std::endl;
+    std::cout << "  11. Configure Erasure Coding" << std::endl;
+    std::cout << "  12. Set Transfer Priority" << std::endl;
+    std::cout << "  13. Send Data (Delta Against Earlier Transfer)" << std::endl;
     std::cout << "  0. Back to Main Menu" << std::endl;
     std::cout << "\nEnter option number: ";
 }
@@ -407,6 +419,7 @@ void handleNodeManagementOption(int option,
                 std::cout << "Address: " << info.address.toString() << std::endl;
                 std::cout << "State: " << static_cast<int>(info.state) << std::endl;
                 std::cout << "Failure Count: " << info.failureCount << std::endl;
+                std::cout << "Suspicion (phi): " << dynamicNodeManager->getSuspicionLevel(nodeID) << std::endl;
             } else {
                 std::cout << "Node not found." << std::endl;
             }
@@ -585,7 +598,7 @@ void handleReliableMessagingOption(int option,
         }
         case 3: {
             std::cout << "\nRetrying pending messages..." << std::endl;
-            reliableMessaging->retryPendingMessages(30, 3);
+            reliableMessaging->retryPendingMessages();
             std::cout << "Retry complete." << std::endl;
             break;
         }
@@ -595,6 +608,23 @@ void handleReliableMessagingOption(int option,
             std::cout << "Acknowledged: " << reliableMessaging->getAcknowledgedMessages() << std::endl;
             std::cout << "Failed: " << reliableMessaging->getFailedMessages() << std::endl;
             std::cout << "Delivery Rate: " << reliableMessaging->getDeliveryRate() << "%" << std::endl;
+            std::cout << "Congestion Events: " << reliableMessaging->getCongestionController().getLossEvents()
+                      << " losses, " << reliableMessaging->getCongestionController().getTimeouts() << " timeouts" << std::endl;
+            if (reliableMessaging->getOutbox()) {
+                std::cout << "Outbox Pending: " << reliableMessaging->getOutbox()->getLiveMessageCount() << std::endl;
+                std::cout << "Outbox Syncs: " << reliableMessaging->getOutbox()->getSyncCount() << std::endl;
+            }
+            break;
+        }
+        case 5: {
+            std::cout << "\nEnter outbox directory: ";
+            std::string directory;
+            std::cin >> directory;
+            if (reliableMessaging->enableDurableOutbox(directory)) {
+                std::cout << "Durable outbox enabled in " << directory << std::endl;
+            } else {
+                std::cout << "Failed to enable durable outbox." << std::endl;
+            }
             break;
         }
         case 0:
@@ -634,6 +664,10 @@ void handleDataExchangeOption(int option,
                 std::cout << "Transfer ID: " << transfer.transferID << std::endl;
                 std::cout << "Status: " << static_cast<int>(transfer.status) << std::endl;
                 std::cout << "Progress: " << transfer.transferredSize << "/" << transfer.totalSize << " bytes" << std::endl;
+                std::cout << "Priority: " << static_cast<int>(transfer.priority) << std::endl;
+                if (transfer.chunkSize > 0) {
+                    std::cout << "Chunk Size: " << transfer.chunkSize << " bytes" << std::endl;
+                }
             } else {
                 std::cout << "Transfer not found." << std::endl;
             }
@@ -677,6 +711,120 @@ void handleDataExchangeOption(int option,
             std::cout << "Data Received: " << (dataExchange->getReceivedDataSize() / 1024) << " KB" << std::endl;
             std::cout << "Completed: " << dataExchange->getCompletedTransfers() << std::endl;
             std::cout << "Failed: " << dataExchange->getFailedTransfers() << std::endl;
+            std::cout << "Queued Pushes: " << dataExchange->getQueuedTransfers() << " (at most "
+                      << dataExchange->getMaxConcurrentTransfers() << " running)" << std::endl;
+            std::cout << "Chunks Served: " << dataExchange->getServedChunks() << std::endl;
+            std::cout << "Corrupt Chunks: " << dataExchange->getCorruptChunks() << std::endl;
+            std::cout << "Resumed Transfers: " << dataExchange->getResumedTransfers() << std::endl;
+            std::cout << "Parity Chunks Sent: " << dataExchange->getParityChunks() << std::endl;
+            std::cout << "Chunks Rebuilt From Parity: " << dataExchange->getRecoveredChunks() << std::endl;
+            std::cout << "Skipped (Deduplicated): " << (dataExchange->getDeduplicatedBytes() / 1024) << " KB" << std::endl;
+            std::cout << "Saved By Delta: " << (dataExchange->getDeltaSavedBytes() / 1024) << " KB" << std::endl;
+            if (dataExchange->getChunkStore()) {
+                std::cout << "Chunk Store: " << dataExchange->getChunkStore()->getChunkCount() << " chunks, "
+                          << (dataExchange->getChunkStore()->getStoredBytes() / 1024) << " KB" << std::endl;
+            }
+            break;
+        }
+        case 7: {
+            std::cout << "\nEnter content ID: ";
+            uint64_t contentID;
+            std::cin >> contentID;
+            std::cout << "Enter content size in bytes: ";
+            size_t contentSize;
+            std::cin >> contentSize;
+            auto content = std::make_shared<std::vector<uint8_t>>(contentSize, 0x42);
+            bool published = dataExchange->publishContent(contentID, [content](size_t offset, uint8_t* buffer, size_t length) {
+                std::memcpy(buffer, content->data() + offset, length);
+                return length;
+            }, contentSize);
+            std::cout << (published ? "Content published." : "Failed to publish content.") << std::endl;
+            break;
+        }
+        case 8: {
+            std::cout << "\nEnter content ID: ";
+            uint64_t contentID;
+            std::cin >> contentID;
+            std::cout << "Enter content size in bytes: ";
+            size_t contentSize;
+            std::cin >> contentSize;
+            std::cout << "Enter source node IDs (0 to finish): ";
+            std::vector<NodeID> sources;
+            NodeID sourceID;
+            while (std::cin >> sourceID && sourceID != 0) {
+                sources.push_back(sourceID);
+            }
+            uint64_t transferID = dataExchange->downloadContent(contentID, contentSize, sources);
+            if (transferID != 0) {
+                std::cout << "Download started from " << sources.size() << " sources (ID: " << transferID << ")" << std::endl;
+            } else {
+                std::cout << "Failed to start download." << std::endl;
+            }
+            break;
+        }
+        case 9: {
+            std::cout << "\nEnter target node ID: ";
+            NodeID targetID;
+            std::cin >> targetID;
+            std::cout << "Enter data size in bytes: ";
+            size_t dataSize;
+            std::cin >> dataSize;
+            std::vector<uint8_t> data(dataSize, 0x42);
+            uint64_t transferID = dataExchange->sendDeduplicated(targetID, data);
+            std::cout << "Chunk manifest offered (ID: " << transferID << ")" << std::endl;
+            break;
+        }
+        case 10: {
+            std::cout << "\nEnter journal directory: ";
+            std::string directory;
+            std::cin >> directory;
+            if (dataExchange->enableTransferJournal(directory)) {
+                std::cout << "Transfer journal enabled in " << directory << std::endl;
+            } else {
+                std::cout << "Failed to enable transfer journal." << std::endl;
+            }
+            break;
+        }
+        case 11: {
+            std::cout << "\nEnter data chunks per group: ";
+            size_t groupChunks;
+            std::cin >> groupChunks;
+            std::cout << "Enter parity chunks per group (0 to disable): ";
+            size_t parityChunks;
+            std::cin >> parityChunks;
+            dataExchange->setErasureCoding(groupChunks, parityChunks);
+            std::cout << "New pushes send " << parityChunks << " parity chunks per " << groupChunks
+                      << " data chunks." << std::endl;
+            break;
+        }
+        case 12: {
+            std::cout << "\nEnter transfer ID: ";
+            uint64_t transferID;
+            std::cin >> transferID;
+            std::cout << "Enter priority (0=background, 1=normal, 2=interactive): ";
+            int priority;
+            std::cin >> priority;
+            priority = std::max(0, std::min(priority, 2));
+            if (dataExchange->setTransferPriority(transferID, static_cast<TransferPriority>(priority))) {
+                std::cout << "Transfer " << transferID << " priority set to " << priority << "." << std::endl;
+            } else {
+                std::cout << "Transfer not found." << std::endl;
+            }
+            break;
+        }
+        case 13: {
+            std::cout << "\nEnter target node ID: ";
+            NodeID targetID;
+            std::cin >> targetID;
+            std::cout << "Enter ID of a transfer the target already holds: ";
+            uint64_t basisID;
+            std::cin >> basisID;
+            std::cout << "Enter data size in bytes: ";
+            size_t dataSize;
+            std::cin >> dataSize;
+            std::vector<uint8_t> data(dataSize, 0x42);
+            uint64_t transferID = dataExchange->sendDelta(targetID, data, basisID);
+            std::cout << "Delta offered (ID: " << transferID << ")" << std::endl;
             break;
         }
         case 0:
@@ -702,6 +850,11 @@ void printNodeInfo(std::shared_ptr<Node> node,
     std::cout << "Server Running: " << (networkManager->isServerRunning() ? "Yes" : "No") << std::endl;
     std::cout << "Messages Sent: " << networkManager->getSentMessageCount() << std::endl;
     std::cout << "Messages Received: " << networkManager->getReceivedMessageCount() << std::endl;
+    std::cout << "Compressed Frames: " << networkManager->getCompressedFrames() << " ("
+              << networkManager->getIncompressibleFrames() << " sent as they were), "
+              << (networkManager->getCompressionSavedBytes() / 1024) << " KB saved" << std::endl;
+    std::cout << "Compression CPU: " << (networkManager->getCompressionMicros() / 1000) << " ms compressing, "
+              << (networkManager->getDecompressionMicros() / 1000) << " ms decompressing" << std::endl;
     
     if (dynamicNodeManager) {
         std::cout << "Active Nodes: " << dynamicNodeManager->getActiveNodeCount() << std::endl;
@@ -731,19 +884,36 @@ void printNodeInfo(std::shared_ptr<Node> node,
         std::cout << "\nConnected Peers:" << std::endl;
         for (NodeID peerID : peerIDs) {
             NetworkAddress addr = topologyManager->getNodeAddress(peerID);
-            std::cout << "  - Node " << peerID << " at " << addr.toString() << std::endl;
+            PeerStatsSnapshot stats = node->getPeerStatsSnapshot(peerID);
+            std::cout << "  - Node " << peerID << " at " << addr.toString()
+                      << " (RTT: " << stats.smoothedRttMs << " ms"
+                      << ", Sent: " << stats.bytesSent << " B"
+                      << ", Received: " << stats.bytesReceived << " B"
+                      << ", Errors: " << (stats.errorRate * 100.0) << "%"
+                      << ", Retransmissions: " << stats.retransmissions << ")" << std::endl;
         }
     }
     std::cout << "========================\n" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
+    // The membership flag may appear anywhere; the rest are positional
+    MembershipMode membershipMode = MembershipMode::HEARTBEAT;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--swim") == 0) {
+            membershipMode = MembershipMode::SWIM;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    
+    if (args.empty()) {
         printUsage(argv[0]);
         return 1;
     }
     
-    Port port = static_cast<Port>(std::stoi(argv[1]));
+    Port port = static_cast<Port>(std::stoi(args[0]));
     
     // Generate a unique node ID (in production, use a proper ID generation scheme)
     std::random_device rd;
@@ -767,6 +937,10 @@ int main(int argc, char* argv[]) {
     // Create network manager
     std::shared_ptr<NetworkManager> networkManager = std::make_shared<NetworkManager>(node);
     
+    // Compress frames to peers that decode them, with zstd when it was built in
+    networkManager->setCompression(isCodecAvailable(CompressionCodec::ZSTD) ? CompressionCodec::ZSTD
+                                                                             : CompressionCodec::LZ4);
+    
     // Create topology manager
     std::shared_ptr<TopologyManager> topologyManager = std::make_shared<TopologyManager>(node);
     
@@ -802,6 +976,59 @@ int main(int argc, char* argv[]) {
     std::shared_ptr<DataExchange> dataExchange = std::make_shared<DataExchange>(
         node, networkManager, messageRouter
     );
+    dataExchange->setReliableMessaging(reliableMessaging);
+    dataExchange->setChunkStore(std::make_shared<ChunkStore>());
+    dataExchange->setAdaptiveChunkSize(true);
+    
+    // Reliable frames follow the routing table and are relayed on receipt
+    // until they reach their destination; destinations behind the same
+    // first relay share one bottleneck
+    reliableMessaging->setTransport([messageRouter](NodeID /*peerID*/, const Message& frame) {
+        return messageRouter->routeMessage(frame, RoutingStrategy::SHORTEST_PATH);
+    });
+    reliableMessaging->getCongestionController().setPathResolver([messageRouter](NodeID destinationID) {
+        std::vector<NodeID> route = messageRouter->findRoute(destinationID);
+        return route.size() > 1 ? route[1] : destinationID;
+    });
+    
+    std::shared_ptr<SwimMembership> swimMembership = std::make_shared<SwimMembership>(
+        node, networkManager, topologyManager
+    );
+    
+    // Probes follow the routing table like reliable frames, so members
+    // learned by piggyback that are not neighbours can still be probed;
+    // relays pass them on rather than answering for the member
+    swimMembership->setTransport([messageRouter](NodeID /*memberID*/, const Message& probe) {
+        return messageRouter->routeMessage(probe, RoutingStrategy::SHORTEST_PATH);
+    });
+    
+    // Answer SWIM probes so peers running in SWIM mode can monitor this node
+    auto swimHandler = [swimMembership](const Message& msg) { swimMembership->handleMessage(msg); };
+    messageHandler->registerHandler(MessageType::SWIM_PING, swimHandler);
+    messageHandler->registerHandler(MessageType::SWIM_PING_REQ, swimHandler);
+    messageHandler->registerHandler(MessageType::SWIM_ACK, swimHandler);
+    
+    // Membership updates ride along on ordinary outgoing frames
+    networkManager->setPiggybackProvider([swimMembership](const Message& msg) {
+        if (msg.type == MessageType::SWIM_PING || msg.type == MessageType::SWIM_PING_REQ ||
+            msg.type == MessageType::SWIM_ACK) {
+            return std::vector<uint8_t>(); // Probes carry their own updates
+        }
+        return swimMembership->collectPiggyback();
+    });
+    networkManager->setPiggybackHandler([swimMembership](NodeID senderID, const std::vector<uint8_t>& data) {
+        swimMembership->applyPiggyback(senderID, data);
+    });
+    
+    // Members SWIM learns of join the overlay; those it confirms dead leave it
+    swimMembership->setOnMemberJoinedCallback([dynamicNodeManager](NodeID nodeID, const NetworkAddress& address) {
+        dynamicNodeManager->addNode(nodeID, address);
+    });
+    swimMembership->setOnMemberFailedCallback([node, dynamicNodeManager](NodeID nodeID) {
+        if (!dynamicNodeManager->removeNodeForced(nodeID)) {
+            node->removePeer(nodeID);
+        }
+    });
     
     // Set up discovery callbacks (silent - user can check status manually)
     nodeDiscovery->setOnPeerDiscoveredCallback([dynamicNodeManager](NodeID id, const NetworkAddress& addr) {
@@ -816,9 +1043,13 @@ int main(int argc, char* argv[]) {
         // Registration successful (silent)
     });
     
-    // Set up dynamic node manager callbacks (silent)
-    dynamicNodeManager->setOnNodeAddedCallback([](NodeID /*id*/, const NetworkAddress& /*addr*/) {
-        // Node added (silent)
+    // Set up dynamic node manager callbacks (silent); in SWIM mode every
+    // node added becomes a member to probe
+    dynamicNodeManager->setOnNodeAddedCallback([swimMembership, membershipMode](NodeID id,
+                                                                                const NetworkAddress& addr) {
+        if (membershipMode == MembershipMode::SWIM) {
+            swimMembership->addMember(id, addr);
+        }
     });
     
     dynamicNodeManager->setOnNodeRemovedCallback([](NodeID /*id*/) {
@@ -856,21 +1087,70 @@ int main(int argc, char* argv[]) {
     });
     
     // Set up message callback (enhanced to handle all message types)
-    networkManager->setMessageCallback([messageHandler, dataExchange, reliableMessaging](const Message& msg) {
-        // Handle data chunks
-        if (msg.type == MessageType::DATA_CHUNK && dataExchange) {
-            // Parse chunk from payload (simplified - in real implementation, proper deserialization)
-            // For now, let MessageHandler process it
+    // Any frame proves the neighbour that sent it is alive; a relayed
+    // frame says nothing about its origin
+    networkManager->setFrameReceivedCallback([dynamicNodeManager](NodeID hopID) {
+        if (dynamicNodeManager) {
+            dynamicNodeManager->recordHeartbeat(hopID);
+        }
+    });
+    
+    networkManager->setMessageCallback([messageHandler, dataExchange, reliableMessaging, messageRouter](const Message& msg) {
+        // Frames for other nodes, and their ACKs, go on along the route
+        // untouched; only the addressee acknowledges and consumes them
+        if (messageRouter->relayIncoming(msg)) {
+            return;
         }
         
         // Handle acknowledgments
         if (msg.type == MessageType::MESSAGE_ACK && reliableMessaging) {
-            // Extract message ID from payload and acknowledge
-            // For now, let MessageHandler process it
+            reliableMessaging->handleAck(msg);
+            return;
         }
         
-        // Process message normally
-        messageHandler->processMessage(msg);
+        // Strip the reliable envelope, drop duplicates and release whatever
+        // an ordered channel now has in sequence
+        std::vector<Message> delivered;
+        if (!reliableMessaging->handleIncomingMessage(msg, delivered)) {
+            return;
+        }
+        
+        // Process messages normally; data chunks go to their reassembly buffer
+        for (const auto& message : delivered) {
+            if (message.type == MessageType::DATA_CHUNK && dataExchange) {
+                dataExchange->handleChunkMessage(message);
+                continue;
+            }
+            if (message.type == MessageType::TRANSFER_REQUEST && dataExchange) {
+                dataExchange->handleTransferRequest(message);
+                continue;
+            }
+            if (message.type == MessageType::TRANSFER_RESPONSE && dataExchange) {
+                dataExchange->handleTransferResponse(message);
+                continue;
+            }
+            if (message.type == MessageType::CHUNK_OFFER && dataExchange) {
+                dataExchange->handleChunkOffer(message);
+                continue;
+            }
+            if (message.type == MessageType::CHUNK_WANT && dataExchange) {
+                dataExchange->handleChunkWant(message);
+                continue;
+            }
+            if (message.type == MessageType::DELTA_OFFER && dataExchange) {
+                dataExchange->handleDeltaOffer(message);
+                continue;
+            }
+            if (message.type == MessageType::DELTA_SIGNATURES && dataExchange) {
+                dataExchange->handleDeltaSignatures(message);
+                continue;
+            }
+            if (message.type == MessageType::TRANSFER_SETUP && dataExchange) {
+                dataExchange->handleTransferSetup(message);
+                continue;
+            }
+            messageHandler->processMessage(message);
+        }
     });
     
     // Update routing table periodically
@@ -880,6 +1160,7 @@ int main(int argc, char* argv[]) {
     std::cout << "Starting P2P Overlay Network Node..." << std::endl;
     std::cout << "Node ID: " << nodeID << std::endl;
     std::cout << "Listening on: " << nodeAddress.toString() << std::endl;
+    std::cout << "Membership: " << (membershipMode == MembershipMode::SWIM ? "SWIM" : "heartbeat") << std::endl;
     
     if (!networkManager->startServer(port)) {
         std::cerr << "Failed to start server on port " << port << std::endl;
@@ -887,9 +1168,9 @@ int main(int argc, char* argv[]) {
     }
     
     // Connect to bootstrap node if provided (using advanced components)
-    if (argc >= 4) {
-        std::string bootstrapHost = argv[2];
-        Port bootstrapPort = static_cast<Port>(std::stoi(argv[3]));
+    if (args.size() >= 3) {
+        std::string bootstrapHost = args[1];
+        Port bootstrapPort = static_cast<Port>(std::stoi(args[2]));
         NetworkAddress bootstrapAddr(bootstrapHost, bootstrapPort);
         
         // Use NodeDiscovery to discover network
@@ -898,13 +1179,18 @@ int main(int argc, char* argv[]) {
         nodeRegistration->registerWithNetwork(bootstrapAddr);
     }
     
-    // Start background services (silently)
-    dynamicNodeManager->startFailureDetection(30);
+    // Start background services (silently); SWIM does its own failure
+    // detection, and without heartbeats the phi-accrual detector would
+    // suspect every quiet peer
+    if (membershipMode == MembershipMode::HEARTBEAT) {
+        dynamicNodeManager->startFailureDetection();
+    }
+    reliableMessaging->startTimers();
     nodeDiscovery->startPeriodicDiscovery(60);
     
     // Main loop
     bool running = true;
-    auto lastHeartbeat = std::chrono::steady_clock::now();
+    auto lastHeartbeatCheck = std::chrono::steady_clock::now();
     auto lastStatusUpdate = std::chrono::steady_clock::now();
     
     std::cout << "\n=== P2P Overlay Network Node Running ===" << std::endl;
@@ -951,14 +1237,17 @@ int main(int argc, char* argv[]) {
     while (running) {
         auto now = std::chrono::steady_clock::now();
         
-        // Send periodic heartbeats (using reliable messaging)
-        if (std::chrono::duration_cast<std::chrono::seconds>(now - lastHeartbeat).count() >= HEARTBEAT_INTERVAL_SEC) {
-            std::vector<NodeID> peerIDs = node->getPeerIDs();
-            for (NodeID peerID : peerIDs) {
-                Message heartbeat = messageHandler->createHeartbeat(peerID);
-                reliableMessaging->sendReliableMessage(peerID, heartbeat);
-            }
-            lastHeartbeat = now;
+        if (membershipMode == MembershipMode::SWIM) {
+            // One probe per protocol period instead of all-to-all heartbeats
+            swimMembership->tick();
+        } else if (std::chrono::duration_cast<std::chrono::seconds>(now - lastHeartbeatCheck).count() >= 1) {
+            // Heartbeat only links with no outgoing traffic for a full interval
+            // (using reliable messaging)
+            messageHandler->sendIdleHeartbeats(HEARTBEAT_INTERVAL_SEC * 1000000ULL,
+                [&reliableMessaging](NodeID peerID, const Message& heartbeat) {
+                    return reliableMessaging->sendReliableMessage(peerID, heartbeat) != 0;
+                });
+            lastHeartbeatCheck = now;
         }
         
         // Update routing table periodically
@@ -973,10 +1262,14 @@ int main(int argc, char* argv[]) {
             lastMaintenance = now;
         }
         
+        // Swarm requests stuck on slow sources move elsewhere; idle pushes
+        // ask their sender for the chunks still missing
+        dataExchange->retrySwarmRequests();
+        dataExchange->resumeStalledTransfers();
+        
         // Cleanup operations (background)
         if (std::chrono::duration_cast<std::chrono::seconds>(now - lastCleanup).count() >= 300) {
             reliableMessaging->cleanupAcknowledgedMessages(300);
-            reliableMessaging->retryPendingMessages(30, 3);
             dataExchange->cleanupCompletedTransfers(3600);
             lastCleanup = now;
         }
@@ -1007,6 +1300,7 @@ int main(int argc, char* argv[]) {
     dynamicNodeManager->removeNodeGracefully(node->getID());
     
     // Stop server
+    reliableMessaging->stopTimers();
     networkManager->stopServer();
     node->setActive(false);
     
@@ -2,6 +2,13 @@
 #define TEST_SUITE_H
 
 #include "../include/NodeSimulator.h"
+#include "../include/FailureDetector.h"
+#include "../include/SwimMembership.h"
+#include "../include/MessageHandler.h"
+#include "../include/ReliableMessaging.h"
+#include "../include/DataExchange.h"
+#include "../include/ErasureCode.h"
+#include "../include/Compression.h"
 #include <string>
 #include <vector>
 #include <functional>
@@ -41,10 +48,28 @@ public:
     TestResult testNetworkIntegrity();
     TestResult testMessageRouting();
     TestResult testReliableMessaging();
+    TestResult testDedupWindow();
+    TestResult testDurableOutbox();
+    TestResult testCongestionControl();
     TestResult testDataExchange();
+    TestResult testSwarmDownload();
+    TestResult testChunkStore();
+    TestResult testMerkleTree();
+    TestResult testResumableTransfer();
+    TestResult testErasureCode();
+    TestResult testAdaptiveChunkSize();
+    TestResult testTransferScheduler();
+    TestResult testDeltaTransfer();
+    TestResult testCompression();
     TestResult testMultiHopRouting();
     TestResult testNetworkScalability();
     TestResult testConcurrentOperations();
+    TestResult testPeerStatistics();
+    TestResult testFailureDetector();
+    TestResult testHeartbeatSuppression();
+    TestResult testSwimMembership();
+    TestResult testNodeStateTracking();
+    TestResult testChurnCoalescing();
     
     // Test utilities
     void setupTestNetwork(size_t nodeCount);